@@ -0,0 +1,398 @@
+/*
+ * V810 dynamic recompiler for AArch64
+ *
+ * This file is distributed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ARM64_EMIT_H
+#define ARM64_EMIT_H
+
+#include "vb_types.h"
+
+// Like the x86 backend, instructions are encoded straight into a word buffer;
+// the only fixups needed are the branches between V810 instructions, which
+// are resolved once the block has been placed.
+//
+// Register usage inside a block:
+// x19: &vb_state->v810_state
+// NZCV: V810 flags, with the carry in the V810 sense (set on borrow)
+// x20: NZCV saved across calls
+// x21-x28: cached V810 registers
+// x0-x15: scratch
+// x16, x17: scratch for the macros below
+// [sp]: address of postexec; blocks exit with "ldr x30, [sp]; ret"
+
+#define MAX_A64_INST 0x10000
+#define A64_NUM_CACHE_REGS 8
+
+extern WORD* a64_ptr;
+
+enum {
+    A64_X0 = 0, A64_X1, A64_X2, A64_X3, A64_X4, A64_X5, A64_X6, A64_X7,
+    A64_X8, A64_X9, A64_X10, A64_X11, A64_X12, A64_X13, A64_X14, A64_X15,
+    A64_X16, A64_X17, A64_X18, A64_X19, A64_X20, A64_X21, A64_X22, A64_X23,
+    A64_X24, A64_X25, A64_X26, A64_X27, A64_X28, A64_X29, A64_X30, A64_ZR,
+};
+
+#define A64_SP A64_ZR
+#define A64_LR A64_X30
+#define A64_STATE A64_X19
+#define A64_FLAGS A64_X20
+#define A64_CACHE_REG_START A64_X21
+
+enum {
+    A64_CC_EQ = 0x0, A64_CC_NE = 0x1, A64_CC_CS = 0x2, A64_CC_CC = 0x3,
+    A64_CC_MI = 0x4, A64_CC_PL = 0x5, A64_CC_VS = 0x6, A64_CC_VC = 0x7,
+    A64_CC_HI = 0x8, A64_CC_LS = 0x9, A64_CC_GE = 0xA, A64_CC_LT = 0xB,
+    A64_CC_GT = 0xC, A64_CC_LE = 0xD, A64_CC_AL = 0xE,
+    // Not encodable: V810 NH/H, evaluated into w16 by drc_testCond
+    A64_CC_W16_NZ = 0x10, A64_CC_W16_Z = 0x11,
+};
+
+enum {
+    A64_SHIFT_LSL = 0, A64_SHIFT_LSR = 1, A64_SHIFT_ASR = 2, A64_SHIFT_ROR = 3,
+};
+
+// Bits of NZCV
+#define A64_FLAG_V 0x10000000
+#define A64_FLAG_C 0x20000000
+#define A64_FLAG_Z 0x40000000
+#define A64_FLAG_N 0x80000000
+
+static inline void a64_emit(WORD inst) {
+    *a64_ptr++ = inst;
+}
+
+static inline int a64_invertCond(int cc) {
+    return cc ^ 1;
+}
+
+// Encodes a 32-bit logical immediate (N:immr:imms), or returns -1 if the
+// value isn't a rotated run of ones
+static inline int a64_logicalImm(WORD imm) {
+    WORD size = 32, mask, elem, v;
+    int r, ones;
+
+    if (imm == 0 || imm == 0xFFFFFFFF)
+        return -1;
+    // find the smallest repeating element
+    while (size > 2) {
+        WORD half = size / 2;
+        WORD half_mask = (1u << half) - 1;
+        if ((imm & half_mask) != ((imm >> half) & half_mask))
+            break;
+        size = half;
+    }
+    mask = size == 32 ? 0xFFFFFFFF : (1u << size) - 1;
+    elem = imm & mask;
+    for (r = 0; r < size; r++) {
+        v = r == 0 ? elem : ((elem >> r) | (elem << (size - r))) & mask;
+        if ((v & (v + 1)) == 0) {
+            ones = __builtin_popcount(v);
+            return (((size - r) % size) << 6) | (((-size << 1) | (ones - 1)) & 0x3F);
+        }
+    }
+    return -1;
+}
+
+// Emits a b/bl/b.cond/cbz/cbnz/tbz/tbnz with a zero offset and returns a pointer
+// to it, to be fixed with a64_patch. cc is an A64_CC_*, or -1 for "always".
+static inline WORD* a64_branch(int cc) {
+    if (cc < 0 || cc == A64_CC_AL)
+        a64_emit(0x14000000);
+    else if (cc == A64_CC_W16_NZ)
+        a64_emit(0x35000000 | A64_X16);
+    else if (cc == A64_CC_W16_Z)
+        a64_emit(0x34000000 | A64_X16);
+    else
+        a64_emit(0x54000000 | cc);
+    return a64_ptr - 1;
+}
+
+// Points a branch at the given location (only the offset bits are touched)
+static inline void a64_patch(WORD* inst, WORD* target) {
+    int32_t rel = (int32_t)(target - inst);
+    if ((*inst & 0x7C000000) == 0x14000000) {
+        // b, bl: imm26
+        *inst = (*inst & 0xFC000000) | (rel & 0x03FFFFFF);
+    } else if ((*inst & 0x7E000000) == 0x36000000) {
+        // tbz, tbnz: imm14
+        *inst = (*inst & 0xFFF8001F) | ((rel & 0x3FFF) << 5);
+    } else {
+        // b.cond, cbz, cbnz: imm19
+        *inst = (*inst & 0xFF00001F) | ((rel & 0x7FFFF) << 5);
+    }
+}
+
+// Whether a branch at inst can reach target with a 19-bit offset
+static inline bool a64_inRange19(WORD* inst, WORD* target) {
+    ptrdiff_t rel = target - inst;
+    return rel >= -(1 << 18) && rel < (1 << 18);
+}
+
+/**
+* Higher level macros
+* All of them operate on 32-bit registers unless suffixed with 64.
+*/
+
+// <add/sub/adds/subs> Rd, Rn, Rm{, <shift> #amount}
+#define ADD_RR(Rd, Rn, Rm)  a64_emit(0x0B000000 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define ADDS_RR(Rd, Rn, Rm) a64_emit(0x2B000000 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define SUB_RR(Rd, Rn, Rm)  a64_emit(0x4B000000 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define SUBS_RR(Rd, Rn, Rm) a64_emit(0x6B000000 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define CMP_RR(Rn, Rm) SUBS_RR(A64_ZR, Rn, Rm)
+#define ADD_RRS(Rd, Rn, Rm, shift, amount) \
+    a64_emit(0x0B000000 | ((shift) << 22) | ((Rm) << 16) | ((amount) << 10) | ((Rn) << 5) | (Rd))
+
+// cmp Xn, Wm, sxtw
+#define CMP_SXTW64(Rn, Rm) a64_emit(0xEB20C000 | ((Rm) << 16) | ((Rn) << 5) | A64_ZR)
+#define CMP_RR64(Rn, Rm) a64_emit(0xEB000000 | ((Rm) << 16) | ((Rn) << 5) | A64_ZR)
+
+// <add/sub/adds/subs> Rd, Rn, #imm12 (Rn can be sp for add/sub)
+#define ADD_I(Rd, Rn, imm)  a64_emit(0x11000000 | (((imm) & 0xFFF) << 10) | ((Rn) << 5) | (Rd))
+#define ADDS_I(Rd, Rn, imm) a64_emit(0x31000000 | (((imm) & 0xFFF) << 10) | ((Rn) << 5) | (Rd))
+#define SUB_I(Rd, Rn, imm)  a64_emit(0x51000000 | (((imm) & 0xFFF) << 10) | ((Rn) << 5) | (Rd))
+#define SUBS_I(Rd, Rn, imm) a64_emit(0x71000000 | (((imm) & 0xFFF) << 10) | ((Rn) << 5) | (Rd))
+#define CMP_I(Rn, imm) SUBS_I(A64_ZR, Rn, imm)
+#define CMN_I(Rn, imm) ADDS_I(A64_ZR, Rn, imm)
+
+// <and/orr/eor/ands/orn/bic> Rd, Rn, Rm{, <shift> #amount}
+#define A64_LOGIC_AND  0x0A000000
+#define A64_LOGIC_ORR  0x2A000000
+#define A64_LOGIC_EOR  0x4A000000
+#define A64_LOGIC_ANDS 0x6A000000
+#define A64_LOGIC_BIC  0x0A200000
+#define A64_LOGIC_ORN  0x2A200000
+#define LOGIC_RR(op, Rd, Rn, Rm) a64_emit((op) | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define LOGIC_RRS(op, Rd, Rn, Rm, shift, amount) \
+    a64_emit((op) | ((shift) << 22) | ((Rm) << 16) | ((amount) << 10) | ((Rn) << 5) | (Rd))
+#define AND_RR(Rd, Rn, Rm) LOGIC_RR(A64_LOGIC_AND, Rd, Rn, Rm)
+#define ORR_RR(Rd, Rn, Rm) LOGIC_RR(A64_LOGIC_ORR, Rd, Rn, Rm)
+#define EOR_RR(Rd, Rn, Rm) LOGIC_RR(A64_LOGIC_EOR, Rd, Rn, Rm)
+#define MVN_RR(Rd, Rm) LOGIC_RR(A64_LOGIC_ORN, Rd, A64_ZR, Rm)
+#define TST_RR(Rn, Rm) LOGIC_RR(A64_LOGIC_ANDS, A64_ZR, Rn, Rm)
+#define TST_RR64(Rn, Rm) LOGIC_RR(A64_LOGIC_ANDS | 0x80000000, A64_ZR, Rn, Rm)
+// orr Xd, Xn, Xm, lsl #amount
+#define ORR_RRS64(Rd, Rn, Rm, amount) LOGIC_RRS(A64_LOGIC_ORR | 0x80000000, Rd, Rn, Rm, A64_SHIFT_LSL, amount)
+
+// mov Rd, Rm / mov Rd, sp
+#define MOV_RR(Rd, Rm) ORR_RR(Rd, A64_ZR, Rm)
+#define MOV_RR64(Rd, Rm) LOGIC_RR(A64_LOGIC_ORR | 0x80000000, Rd, A64_ZR, Rm)
+
+// movz/movk/movn Rd, #imm16, lsl #(hw * 16)
+#define MOVZ(Rd, imm, hw) a64_emit(0x52800000 | ((hw) << 21) | (((imm) & 0xFFFF) << 5) | (Rd))
+#define MOVK(Rd, imm, hw) a64_emit(0x72800000 | ((hw) << 21) | (((imm) & 0xFFFF) << 5) | (Rd))
+#define MOVN(Rd, imm, hw) a64_emit(0x12800000 | ((hw) << 21) | (((imm) & 0xFFFF) << 5) | (Rd))
+
+// mov Rd, imm32
+static inline void a64_movImm(BYTE rd, WORD imm) {
+    if ((imm & 0xFFFF0000) == 0xFFFF0000) {
+        MOVN(rd, ~imm, 0);
+    } else if ((imm & 0xFFFF) == 0 && imm != 0) {
+        MOVZ(rd, imm >> 16, 1);
+    } else {
+        MOVZ(rd, imm, 0);
+        if (imm & 0xFFFF0000)
+            MOVK(rd, imm >> 16, 1);
+    }
+}
+#define MOV_I(Rd, imm) a64_movImm(Rd, (WORD)(imm))
+
+// <and/orr/eor/ands> Rd, Rn, #imm, with any 32-bit immediate (uses w17 if
+// the immediate can't be encoded, so Rn must not be w17 in that case)
+static inline void a64_logicImm(WORD op, BYTE rd, BYTE rn, WORD imm) {
+    int enc = a64_logicalImm(imm);
+    if (enc >= 0) {
+        // logical (immediate) has the same opc bits as logical (shifted register)
+        a64_emit((op & 0x60000000) | 0x12000000 | (enc << 10) | (rn << 5) | rd);
+    } else {
+        MOV_I(A64_X17, imm);
+        LOGIC_RR(op, rd, rn, A64_X17);
+    }
+}
+#define AND_I(Rd, Rn, imm) a64_logicImm(A64_LOGIC_AND, Rd, Rn, imm)
+#define ORR_I(Rd, Rn, imm) a64_logicImm(A64_LOGIC_ORR, Rd, Rn, imm)
+#define EOR_I(Rd, Rn, imm) a64_logicImm(A64_LOGIC_EOR, Rd, Rn, imm)
+
+// add Rd, Rn, #imm, with any 32-bit immediate (uses w17 if it doesn't fit
+// in 12 bits, so Rn must not be w17 in that case)
+static inline void a64_addImm(BYTE rd, BYTE rn, int32_t imm, bool set_flags) {
+    WORD s = set_flags ? 0x20000000 : 0;
+    if (imm >= 0 && imm < 0x1000)
+        a64_emit(0x11000000 | s | (imm << 10) | (rn << 5) | rd);
+    else if (imm < 0 && imm > -0x1000)
+        a64_emit(0x51000000 | s | ((-imm) << 10) | (rn << 5) | rd);
+    else {
+        MOV_I(A64_X17, imm);
+        a64_emit(0x0B000000 | s | (A64_X17 << 16) | (rn << 5) | rd);
+    }
+}
+#define ADD_IMM(Rd, Rn, imm) a64_addImm(Rd, Rn, imm, false)
+#define ADDS_IMM(Rd, Rn, imm) a64_addImm(Rd, Rn, imm, true)
+
+// Bitfield moves
+#define SBFM(Rd, Rn, immr, imms) a64_emit(0x13000000 | ((immr) << 16) | ((imms) << 10) | ((Rn) << 5) | (Rd))
+#define BFM(Rd, Rn, immr, imms)  a64_emit(0x33000000 | ((immr) << 16) | ((imms) << 10) | ((Rn) << 5) | (Rd))
+#define UBFM(Rd, Rn, immr, imms) a64_emit(0x53000000 | ((immr) << 16) | ((imms) << 10) | ((Rn) << 5) | (Rd))
+#define SBFM64(Rd, Rn, immr, imms) a64_emit(0x93400000 | ((immr) << 16) | ((imms) << 10) | ((Rn) << 5) | (Rd))
+#define UBFM64(Rd, Rn, immr, imms) a64_emit(0xD3400000 | ((immr) << 16) | ((imms) << 10) | ((Rn) << 5) | (Rd))
+
+#define LSL_I(Rd, Rn, sh) UBFM(Rd, Rn, (32 - (sh)) & 31, 31 - (sh))
+#define LSR_I(Rd, Rn, sh) UBFM(Rd, Rn, sh, 31)
+#define ASR_I(Rd, Rn, sh) SBFM(Rd, Rn, sh, 31)
+#define LSL_I64(Rd, Rn, sh) UBFM64(Rd, Rn, (64 - (sh)) & 63, 63 - (sh))
+#define LSR_I64(Rd, Rn, sh) UBFM64(Rd, Rn, sh, 63)
+#define UBFX(Rd, Rn, lsb, width) UBFM(Rd, Rn, lsb, (lsb) + (width) - 1)
+#define SBFX(Rd, Rn, lsb, width) SBFM(Rd, Rn, lsb, (lsb) + (width) - 1)
+#define UBFX64(Rd, Rn, lsb, width) UBFM64(Rd, Rn, lsb, (lsb) + (width) - 1)
+#define BFI(Rd, Rn, lsb, width) BFM(Rd, Rn, (32 - (lsb)) & 31, (width) - 1)
+#define SXTB(Rd, Rn) SBFM(Rd, Rn, 0, 7)
+#define SXTH(Rd, Rn) SBFM(Rd, Rn, 0, 15)
+#define UXTB(Rd, Rn) UBFM(Rd, Rn, 0, 7)
+#define UXTH(Rd, Rn) UBFM(Rd, Rn, 0, 15)
+#define SXTW64(Rd, Rn) SBFM64(Rd, Rn, 0, 31)
+
+// ror Rd, Rn, #sh
+#define ROR_I(Rd, Rn, sh) a64_emit(0x13800000 | ((Rn) << 16) | ((sh) << 10) | ((Rn) << 5) | (Rd))
+
+// <lsl/lsr/asr> Rd, Rn, Rm (by register, modulo the register size)
+#define LSLV(Rd, Rn, Rm) a64_emit(0x1AC02000 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define LSRV(Rd, Rn, Rm) a64_emit(0x1AC02400 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define ASRV(Rd, Rn, Rm) a64_emit(0x1AC02800 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define LSLV64(Rd, Rn, Rm) a64_emit(0x9AC02000 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define LSRV64(Rd, Rn, Rm) a64_emit(0x9AC02400 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define ASRV64(Rd, Rn, Rm) a64_emit(0x9AC02800 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+
+// rbit/rev16 Rd, Rn
+#define RBIT(Rd, Rn)  a64_emit(0x5AC00000 | ((Rn) << 5) | (Rd))
+#define REV16(Rd, Rn) a64_emit(0x5AC00400 | ((Rn) << 5) | (Rd))
+
+// Multiplication and division
+#define MUL(Rd, Rn, Rm)    a64_emit(0x1B007C00 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define MSUB(Rd, Rn, Rm, Ra) a64_emit(0x1B008000 | ((Rm) << 16) | ((Ra) << 10) | ((Rn) << 5) | (Rd))
+#define SMULL(Rd, Rn, Rm)  a64_emit(0x9B207C00 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define UMULL(Rd, Rn, Rm)  a64_emit(0x9BA07C00 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define SDIV(Rd, Rn, Rm)   a64_emit(0x1AC00C00 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+#define UDIV(Rd, Rn, Rm)   a64_emit(0x1AC00800 | ((Rm) << 16) | ((Rn) << 5) | (Rd))
+
+// Conditional select
+#define CSEL(Rd, Rn, Rm, cc)  a64_emit(0x1A800000 | ((Rm) << 16) | ((cc) << 12) | ((Rn) << 5) | (Rd))
+#define CSINC(Rd, Rn, Rm, cc) a64_emit(0x1A800400 | ((Rm) << 16) | ((cc) << 12) | ((Rn) << 5) | (Rd))
+#define CSET(Rd, cc) CSINC(Rd, A64_ZR, A64_ZR, (cc) ^ 1)
+// ccmp Rn, Rm, #nzcv, cc
+#define CCMP_RR(Rn, Rm, nzcv, cc) a64_emit(0x7A400000 | ((Rm) << 16) | ((cc) << 12) | ((Rn) << 5) | (nzcv))
+
+// ldr/str Rt, [Rn, #off] (off must be a multiple of the access size)
+#define LDR_W(Rt, Rn, off) a64_emit(0xB9400000 | (((off) / 4) << 10) | ((Rn) << 5) | (Rt))
+#define STR_W(Rt, Rn, off) a64_emit(0xB9000000 | (((off) / 4) << 10) | ((Rn) << 5) | (Rt))
+#define LDR_X(Rt, Rn, off) a64_emit(0xF9400000 | (((off) / 8) << 10) | ((Rn) << 5) | (Rt))
+
+// mrs Xt, nzcv / msr nzcv, Xt
+#define MRS_NZCV(Rt) a64_emit(0xD53B4200 | (Rt))
+#define MSR_NZCV(Rt) a64_emit(0xD51B4200 | (Rt))
+
+// blr Xn / ret
+#define BLR(Rn) a64_emit(0xD63F0000 | ((Rn) << 5))
+#define RET() a64_emit(0xD65F03C0)
+#define NOP() a64_emit(0xD503201F)
+
+// Single precision floating point
+#define FMOV_SW(Sd, Rn) a64_emit(0x1E270000 | ((Rn) << 5) | (Sd))
+#define FMOV_WS(Rd, Sn) a64_emit(0x1E260000 | ((Sn) << 5) | (Rd))
+#define FADD_S(Sd, Sn, Sm) a64_emit(0x1E202800 | ((Sm) << 16) | ((Sn) << 5) | (Sd))
+#define FSUB_S(Sd, Sn, Sm) a64_emit(0x1E203800 | ((Sm) << 16) | ((Sn) << 5) | (Sd))
+#define FMUL_S(Sd, Sn, Sm) a64_emit(0x1E200800 | ((Sm) << 16) | ((Sn) << 5) | (Sd))
+#define FDIV_S(Sd, Sn, Sm) a64_emit(0x1E201800 | ((Sm) << 16) | ((Sn) << 5) | (Sd))
+#define FCMP_S0(Sn) a64_emit(0x1E202008 | ((Sn) << 5))
+#define SCVTF_SW(Sd, Rn) a64_emit(0x1E220000 | ((Rn) << 5) | (Sd))
+#define FCVTZS_WS(Rd, Sn) a64_emit(0x1E380000 | ((Sn) << 5) | (Rd))
+#define FCVTAS_WS(Rd, Sn) a64_emit(0x1E240000 | ((Sn) << 5) | (Rd))
+
+// Leaves the block through the postexec address at [sp]
+#define EXIT_BLOCK() { \
+    LDR_X(A64_LR, A64_SP, 0); \
+    RET(); \
+}
+
+// Inverts the carry, for V810 subtractions (set on borrow)
+#define INV_CARRY() { \
+    MRS_NZCV(A64_X16); \
+    EOR_I(A64_X16, A64_X16, A64_FLAG_C); \
+    MSR_NZCV(A64_X16); \
+}
+
+// Sets N and Z from Rd for V810 logic operations, which clear OV and leave
+// CY alone
+#define SAVE_FLAGS_LOGIC(Rd) { \
+    MRS_NZCV(A64_X16); \
+    AND_I(A64_X16, A64_X16, A64_FLAG_C); \
+    TST_RR(Rd, Rd); \
+    MRS_NZCV(A64_X17); \
+    ORR_RR(A64_X16, A64_X16, A64_X17); \
+    MSR_NZCV(A64_X16); \
+}
+
+#define ADDCYCLES() { \
+    if (cycles != 0) { \
+        LDR_W(A64_X16, A64_STATE, offsetof(cpu_state, cycles_until_event_partial)); \
+        ADD_IMM(A64_X16, A64_X16, -(int32_t)cycles); \
+        STR_W(A64_X16, A64_STATE, offsetof(cpu_state, cycles_until_event_partial)); \
+    } \
+    cycles = 0; \
+}
+
+// Calls the interrupt handler with the flags in w0 and the PC in w1.
+// The handler doesn't return if the block has to be exited.
+#define CALL_IRQ_HANDLER(ret_PC) { \
+    MRS_NZCV(A64_FLAGS); \
+    MOV_RR(A64_X0, A64_FLAGS); \
+    MOV_I(A64_X1, ret_PC); \
+    LDR_X(A64_X16, A64_STATE, offsetof(cpu_state, irq_handler)); \
+    BLR(A64_X16); \
+    MSR_NZCV(A64_FLAGS); \
+}
+
+// Subtracts the pending cycles and calls the interrupt handler if an event
+// is due. The flags are left alone, so the check is done with tbz.
+#define HANDLEINT(ret_PC) { \
+    WORD *skip; \
+    LDR_W(A64_X16, A64_STATE, offsetof(cpu_state, cycles_until_event_partial)); \
+    ADD_IMM(A64_X16, A64_X16, -(int32_t)cycles); \
+    STR_W(A64_X16, A64_STATE, offsetof(cpu_state, cycles_until_event_partial)); \
+    /* cuep <= 0 <=> cuep - 1 < 0 */ \
+    SUB_I(A64_X16, A64_X16, 1); \
+    skip = a64_ptr; \
+    a64_emit(0x36000000 | (31 << 19) | A64_X16); \
+    CALL_IRQ_HANDLER(ret_PC); \
+    a64_patch(skip, a64_ptr); \
+    cycles = 0; \
+}
+
+// Skips ahead to the next event until the handler exits the block
+#define HALT(next_PC) { \
+    WORD *loop = a64_ptr; \
+    STR_W(A64_ZR, A64_STATE, offsetof(cpu_state, cycles_until_event_partial)); \
+    CALL_IRQ_HANDLER(next_PC); \
+    a64_patch(a64_branch(-1), loop); \
+    cycles = 0; \
+}
+
+#endif //ARM64_EMIT_H
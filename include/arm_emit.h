@@ -406,6 +406,41 @@ static inline void new_floating_point(BYTE cond, BYTE opc1, BYTE opc2, BYTE b12,
 #define LDR_IO(Rd, Rn, off) \
     new_ldst_imm_off(ARM_COND_AL, 1, 1, 0, 0, 1, Rn, Rd, off)
 
+// strb Rd, [Rn, #off]
+// Store byte with immediate offset
+#define STRB_IO(Rd, Rn, off) \
+    new_ldst_imm_off(ARM_COND_AL, 1, 1, 1, 0, 0, Rn, Rd, off)
+
+// str Rd, [Rn, Rm]
+// Store with register offset
+#define STR_R(Rd, Rn, Rm) \
+    new_ldst_reg_off(ARM_COND_AL, 1, 1, 0, 0, 0, Rn, Rd, 0, ARM_SHIFT_LSL, Rm)
+
+// ldr Rd, [Rn, Rm]
+// Load with register offset
+#define LDR_R(Rd, Rn, Rm) \
+    new_ldst_reg_off(ARM_COND_AL, 1, 1, 0, 0, 1, Rn, Rd, 0, ARM_SHIFT_LSL, Rm)
+
+// strb Rd, [Rn, Rm]
+// Store byte with register offset
+#define STRB_R(Rd, Rn, Rm) \
+    new_ldst_reg_off(ARM_COND_AL, 1, 1, 1, 0, 0, Rn, Rd, 0, ARM_SHIFT_LSL, Rm)
+
+// strh Rd, [Rn, Rm]
+// Store halfword with register offset
+#define STRH_R(Rd, Rn, Rm) \
+    new_ldst_hb2(ARM_COND_AL, 1, 1, 0, 0, Rn, Rd, 0, 0, 1, Rm)
+
+// ldrsb Rd, [Rn, Rm]
+// Load signed byte with register offset
+#define LDRSB_R(Rd, Rn, Rm) \
+    new_ldst_hb2(ARM_COND_AL, 1, 1, 0, 1, Rn, Rd, 0, 1, 0, Rm)
+
+// ldrsh Rd, [Rn, Rm]
+// Load signed halfword with register offset
+#define LDRSH_R(Rd, Rn, Rm) \
+    new_ldst_hb2(ARM_COND_AL, 1, 1, 0, 1, Rn, Rd, 0, 1, 1, Rm)
+
 // cmp Rn, imm8, ror #rot
 // Compare immediate
 // imm8 can be rotated an even number of times
@@ -675,6 +710,20 @@ static inline void new_floating_point(BYTE cond, BYTE opc1, BYTE opc2, BYTE b12,
 #define REV(Rd, Rm) \
     new_media(ARM_COND_AL, 0b01011, 0b1111, Rd, 0b1111001, Rm)
 
+// rev16 Rd, Rm
+#define REV16(Rd, Rm) \
+    new_media(ARM_COND_AL, 0b01011, 0b1111, Rd, 0b1111101, Rm)
+
+// rbit Rd, Rm
+// ARMv6T2 and up only
+#define RBIT(Rd, Rm) \
+    new_media(ARM_COND_AL, 0b01111, 0b1111, Rd, 0b1111001, Rm)
+
+// pkhbt Rd, Rn, Rm, lsl #shift_imm
+// Low halfword from Rn, high halfword from Rm
+#define PKHBT(Rd, Rn, Rm, shift_imm) \
+    new_media(ARM_COND_AL, 0b01000, Rn, Rd, (shift_imm)<<2, Rm)
+
 // uxtab
 #define UXTAB(Rd, Rn, Rm, rot) \
     new_extend(ARM_COND_AL, 0b1110, Rn, Rd, rot, Rm)
@@ -718,6 +767,19 @@ static inline void new_floating_point(BYTE cond, BYTE opc1, BYTE opc2, BYTE b12,
 #define TRUNC(Sd, Sm) \
     new_floating_point(ARM_COND_AL, 0b1011|((Sd&1)<<2), 0b1101, Sd>>1, 0, 0b11, (Sm&1)<<1, Sm>>1)
 
+// vcvt.f64.f32 Dd, Sm
+#define VCVT_F64_F32(Dd, Sm) \
+    new_floating_point(ARM_COND_AL, 0b1011|((Dd>>4)<<2), 0b0111, Dd&0xf, 0, 0b11, (Sm&1)<<1, Sm>>1)
+
+// vcvt.s32.f64 Sd, Dm
+// Rounds toward zero
+#define TRUNC_F64(Sd, Dm) \
+    new_floating_point(ARM_COND_AL, 0b1011|((Sd&1)<<2), 0b1101, Sd>>1, 1, 0b11, (Dm>>4)<<1, Dm&0xf)
+
+// vadd.f64 Dd, Dn, Dm
+#define VADD_F64(Dd, Dn, Dm) \
+    new_floating_point(ARM_COND_AL, 0b11|((Dd>>4)<<2), Dn&0xf, Dd&0xf, 1, (Dn>>4)<<1, (Dm>>4)<<1, Dm&0xf)
+
 // vadd.f32 Sd, Sn, Sm
 #define VADD_F32(Sd, Sn, Sm) \
     new_floating_point(ARM_COND_AL, 0b11|((Sd&1)<<2), Sn>>1, Sd>>1, 0, (Sn&1)<<1, (Sm&1)<<1, Sm>>1)
@@ -0,0 +1,16 @@
+#ifndef BUSYWAIT_H
+#define BUSYWAIT_H
+
+#include "drc_core.h"
+
+// Busywait detection shared by the dynarec and the interpreter.
+// insts holds consecutive decoded instructions in address order.
+
+// Looks back from the conditional instruction at insts[pos].
+// Sets save_flags on the unconditional instructions leading up to it, and
+// busywait on it if it's a backwards branch over a loop that only polls.
+void busywait_findLastConditionalInst(v810_instruction *insts, int pos);
+// Marks the Waterworld-specific polling loops
+void busywait_findWaterworld(v810_instruction *insts, int size);
+
+#endif
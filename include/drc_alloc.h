@@ -1,7 +1,9 @@
 #include "vb_types.h"
 #include "drc_core.h"
 
-extern int free_block_count;
-
+// Forgets all the free space, for when the cache is cleared
+void drc_allocReset(void);
 WORD *drc_alloc(uint32_t inst_count);
-void drc_free(exec_block *p_block);
\ No newline at end of file
+void drc_free(exec_block *p_block);
+// How much of the free space is outside the largest free block, in percent
+int drc_fragmentation(void);
\ No newline at end of file
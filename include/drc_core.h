@@ -2,22 +2,53 @@
 #define DRC_CORE_H
 
 #include "vb_types.h"
-#include "arm_emit.h"
 
 #if __ARM_ARCH >= 6 && __arm__
 #define DRC_AVAILABLE true
+// bkpt
+#define DRC_TRAP_WORD 0xe1200070
+// host registers V810 registers get cached in
+#define DRC_NUM_CACHE_REGS 6
+#elif defined(__x86_64__) && defined(__linux__)
+#define DRC_AVAILABLE true
+// int3 x4
+#define DRC_TRAP_WORD 0xcccccccc
+#define DRC_NUM_CACHE_REGS 4
+#elif defined(__aarch64__) && defined(__linux__)
+#define DRC_AVAILABLE true
+// brk #0
+#define DRC_TRAP_WORD 0xd4200000
+#define DRC_NUM_CACHE_REGS 8
 #else
 #define DRC_AVAILABLE false
 #endif
 
 #define MAX_ROM_SIZE 0x1000000
 #define BLOCK_MAP_COUNT (MAX_ROM_SIZE / 2 / 2)
+// The block map is split into pages of MAP_PAGE_SIZE entries
+#define MAP_PAGE_BITS 10
+#define MAP_PAGE_SIZE (1 << MAP_PAGE_BITS)
+#define MAP_PAGE_COUNT (BLOCK_MAP_COUNT >> MAP_PAGE_BITS)
 #define CACHE_SIZE  0x200000
 #define MAX_V810_INST 8192
 #define MAX_ARM_INST  32768
 #define ARM_CACHE_REG_START 4
 #define ARM_NUM_CACHE_REGS 6
 #define MAX_NUM_BLOCKS 4096
+#define MAX_NUM_LINKS 8192
+// A jal or far jr out of a block is counted down from HOT_JUMP_COUNT each
+// time it's taken; when it runs out, its target is pulled into the block if
+// the two fit in SUPERBLOCK_MAX_SPAN bytes of ROM
+#define HOT_JUMP_COUNT 256
+#define SUPERBLOCK_MAX_SPAN 0x2000
+
+// Profiling builds (DRC_PROFILE=1) count the runs and V810 cycles of every
+// block. Blocks aren't linked in them, so that each run goes through drc_run.
+#ifndef DRC_PROFILE
+#define DRC_PROFILE 0
+#endif
+// Blocks listed by drc_profileDump, at most
+#define PROFILE_TOP_BLOCKS 64
 
 #if MAX_ARM_INST >= 65536
 #error "MAX_ARM_INST can't be more than 64K"
@@ -43,9 +74,10 @@ enum {
     DRC_RELOC_WWORD     = 7,
     DRC_RELOC_BSTR      = 8,
     DRC_RELOC_REV       = 24,
-    DRC_RELOC_GOLFHACK  = 25,
-    DRC_RELOC_BALLSCALE = 26,
-    DRC_RELOC_BALLSORT  = 27,
+    DRC_RELOC_HLEHOOK   = 25,
+    DRC_RELOC_CHAIN     = 26,
+    DRC_RELOC_RETSTACK  = 27,
+    DRC_RELOC_BSTRWORDS = 28,
 };
 
 #define END_BLOCK 0xFF
@@ -57,12 +89,28 @@ typedef struct {
     // We can use ARM_NUM_CACHE_REGS registers at a time, r4-r10, and r11 will
     // have the address of v810_state
     // reg_map & 0x1F would have the VB register that is mapped to r4
-    WORD reg_map;
+    // (5 bits per host register, the AArch64 backend caches more than 6)
+    uint64_t reg_map;
     bool free;
     WORD start_pc;
     WORD pc_range; // start_pc + pc_range = the address of the last instruction in the block
+    WORD last_used; // block_clock when drc_run last entered the block
+#if DRC_PROFILE
+    WORD exec_count;
+    uint64_t exec_cycles;
+#endif
 } exec_block;
 
+// Return points pushed by jal, so jmp [lp] can go straight back to the caller
+#define RET_STACK_SIZE 16
+typedef struct {
+    WORD top;
+    struct {
+        WORD PC;
+        WORD *site;
+    } entries[RET_STACK_SIZE];
+} return_stack;
+
 typedef struct {
     WORD PC;
     WORD imm;
@@ -74,10 +122,27 @@ typedef struct {
     bool save_flags;
     bool busywait;
     bool is_branch_target;
+    // For loads and stores, the likely address >> 24 (or MEM_REGION_UNKNOWN)
+    BYTE mem_region;
+    // For jal and far jr, where the target is (JUMP_TARGET_*)
+    BYTE jump_target;
+    // If the next instruction went to another block, its PC, to leave for
+    // it after this one
+    WORD fallthrough_PC;
 } v810_instruction;
 
+#define MEM_REGION_UNKNOWN 0xFF
+#define MEM_REGION_WRAM 5
+
+#define JUMP_TARGET_FAR 0   // too far to pull into the block
+#define JUMP_TARGET_NEAR 1  // can be pulled in once the jump gets hot
+#define JUMP_TARGET_LOCAL 2 // in the block
+
 extern WORD* cache_start;
 extern WORD* cache_pos;
+extern WORD reg_usage[32];
+extern v810_instruction *inst_cache;
+extern return_stack ret_stack;
 
 int __divsi3(int a, int b);
 int __modsi3(int a, int b);
@@ -85,19 +150,56 @@ unsigned int __udivsi3(unsigned int a, unsigned int b);
 unsigned int __umodsi3(unsigned int a, unsigned int b);
 
 void drc_executeBlock(WORD* entrypoint, exec_block* block);
+void drc_chainBlock(exec_block* block, WORD* entrypoint);
 int drc_handleInterrupts(WORD cpsr, WORD* PC);
 void drc_relocTable(void);
 void drc_clearCache(void);
 
+WORD* drc_getEntry(WORD loc, exec_block **p_block);
 void drc_setEntry(WORD loc, WORD *entry, exec_block *block);
 exec_block* drc_getNextBlockStruct(void);
+extern exec_block* block_ptr_start;
+
+// Front end shared by all backends (source/drc)
+void drc_scanBlockBounds(WORD* p_start_PC, WORD* p_end_PC);
+unsigned int drc_decodeInstructions(exec_block *block, WORD start_PC, WORD end_PC);
+// Translates the block holding PC and flushes it out to be run
+int drc_translate(WORD PC);
+// Translates one of the jump targets seen so far that's still missing
+bool drc_translateJumpTarget(void);
+
+// Implemented by each backend (source/arm, source/arm64, source/x86)
+// Translates the block at start_PC and registers its entrypoints. It can run
+// on the translation worker while the CPU carries on, so it gets the PC
+// rather than going by v810_state.PC.
+// The flags are kept in the ARM CPSR layout (NZCV in the top nibble) in
+// v810_state.flags and except_flags, whatever the host.
+int drc_translateBlock(WORD start_PC);
+void drc_backendInit(void);
+void drc_backendExit(void);
+// Patches the exit that set v810_state.link_site to jump straight to entry,
+// which is PC's entrypoint in block, and back again.
+void drc_linkExit(WORD *site, WORD PC, WORD *entry, exec_block *block);
+void drc_unlinkExit(WORD *site);
+
+// Drops the links into and out of a block that's being freed
+void drc_unlinkBlock(exec_block *block);
 
 void drc_init(void);
 void drc_reset(void);
 void drc_exit(void);
 int drc_run(void);
+// Translation cache kept on disk between runs, per ROM
 void drc_loadSavedCache(void);
+void drc_saveCache(void);
 void drc_dumpCache(char* filename);
 void drc_dumpDebugInfo(int code);
+#if DRC_PROFILE
+// Zeroes the runs and cycles counted for every block
+void drc_profileReset(void);
+// Writes the blocks that took the most cycles, and the ones that keep
+// getting translated again, to filename
+void drc_profileDump(const char *filename);
+#endif
 
 #endif //DRC_CORE_H
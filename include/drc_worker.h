@@ -0,0 +1,34 @@
+#ifndef DRC_WORKER_H
+#define DRC_WORKER_H
+
+#include "vb_types.h"
+
+// Blocks are translated on a spare core while the emulation thread keeps
+// going in the interpreter. Without a spare core, drc_run translates them
+// itself as before.
+// The worker owns the whole dynarec while it has a job, so the emulation
+// thread mustn't run translated code or touch the cache until it's done.
+
+// Returned by drc_workerPoll while the job is still going
+#define DRC_WORKER_BUSY -1
+// Jump targets translated ahead of time after each job, at most
+#define DRC_WORKER_SPECULATE_MAX 4
+
+// Starts the worker; returns false if there's nowhere to run it
+bool drc_workerInit(void);
+void drc_workerExit(void);
+// Hands the block at PC to the worker; returns false if there's no worker
+bool drc_workerPost(WORD PC);
+// DRC_WORKER_BUSY while the job is going, then its result once it's done
+// and the block can be run, then 0
+int drc_workerPoll(void);
+// Whether there's a worker to translate on
+bool drc_workerRunning(void);
+// Whether the emulation thread has to keep out of the dynarec for the job;
+// cheap enough for the interpreter to check after every jump
+bool drc_workerBusy(void);
+// Waits for the worker and drops its job, before anything else changes the
+// cache under it
+void drc_workerSync(void);
+
+#endif //DRC_WORKER_H
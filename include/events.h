@@ -0,0 +1,38 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "vb_types.h"
+
+// Sources of timed hardware events, in the order they are serviced.
+// Each source has at most one pending deadline at a time.
+typedef enum {
+    EVENT_INPUT,    // hardware controller read finishing
+    EVENT_TIMER,    // hardware timer reaching zero
+    EVENT_DRAW,     // XPSTTS row changes and end of drawing
+    EVENT_DISPLAY,  // DPSTTS changes and frame end
+    EVENT_SYNC,     // multiplayer player switch
+    EVENT_COMM,     // link cable transfer finishing
+    EVENT_COUNT,
+    EVENT_NONE = EVENT_COUNT
+} event_id;
+
+// Binary min-heap of deadlines, in absolute cycles.
+// Deadlines are compared with wraparound, like the rest of the cycle maths.
+typedef struct {
+    WORD when[EVENT_COUNT];
+    BYTE heap[EVENT_COUNT]; // event ids, soonest first
+    BYTE pos[EVENT_COUNT];  // index of each event in heap, or EVENT_NONE
+    BYTE count;
+} event_queue;
+
+void events_clear(event_queue *q);
+// Adds the event, or moves it if it's already pending
+void events_schedule(event_queue *q, event_id id, WORD when);
+void events_cancel(event_queue *q, event_id id);
+
+// Returns the soonest pending event, or EVENT_NONE
+static inline event_id events_peek(const event_queue *q) {
+    return q->count ? (event_id)q->heap[0] : EVENT_NONE;
+}
+
+#endif
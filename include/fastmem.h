@@ -0,0 +1,32 @@
+#ifndef FASTMEM_H
+#define FASTMEM_H
+
+#include "v810_mem.h"
+
+// 64-bit Linux hosts have the address space to spare
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#define FASTMEM_AVAILABLE true
+#else
+#define FASTMEM_AVAILABLE false
+#endif
+
+#define FASTMEM_SIZE 0x08000000
+
+// Each player gets a reserved host region laid out like the V810 address
+// space, with WRAM, SRAM and ROM mapped in at every mirror. Anything else
+// (VIP, sound, hardware control) is left inaccessible.
+// A plain access at addr is then just base[addr & 0x07FFFFFF].
+// SRAM accesses made through the region have to set is_sram themselves.
+
+// Moves ROM, WRAM and SRAM into the regions; returns false if it couldn't
+bool fastmem_init(void);
+void fastmem_exit(void);
+// Mirrors the ROM across 0x07000000-0x07FFFFFF, once its size is known
+void fastmem_mapRom(void);
+
+// The region holding the state's memory, or NULL
+BYTE *fastmem_base(const VB_STATE *state);
+// Whether the ROM is mapped in the regions
+bool fastmem_hasRom(void);
+
+#endif
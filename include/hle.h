@@ -0,0 +1,54 @@
+#ifndef HLE_H
+#define HLE_H
+
+#include "vb_types.h"
+
+// Game routines replaced with native code, shared by the dynarec and the
+// interpreter. Each one is found either by its code, for routines that turn
+// up in many games, or by its address in a given game.
+//
+// Calls replace a whole routine: a jal to it runs the native version instead
+// and carries on at the return address, as the routine's jmp [lp] would.
+// Hooks are spliced into the middle of the code by the dynarec: the native
+// version runs there, then the block either goes on or skips ahead. They're
+// called from translated code, so they mustn't touch the V810 registers.
+
+#define HLE_CALL 0
+#define HLE_HOOK 1
+
+// Returned by a call to run the original routine after all
+#define HLE_PASS -1
+
+typedef struct {
+    const char *name;
+    BYTE kind;              // HLE_CALL or HLE_HOOK
+    const char *game_id;    // NULL for any game
+    WORD rom_size;          // smallest ROM the native version is safe with
+    WORD PC;                // 0 to find the routine by its code instead
+    const BYTE *code;
+    BYTE code_size;
+    // Calls: the single instruction the jal can be decoded as instead, with
+    // its registers, or 0 if it has to be called
+    BYTE inline_op, inline_reg1, inline_reg2;
+    // Calls: returns the cycles the routine would have taken, or HLE_PASS
+    int (*call)(void);
+    // Hooks: where to carry on afterwards, or 0 for the next instruction
+    WORD resume_PC;
+    void (*hook)(void);
+} hle_entry;
+
+// Indexed by id - 1
+extern const hle_entry hle_entries[];
+
+// Works out which entries apply to the loaded game
+void hle_reset(void);
+// The id of the call replacing the routine at PC, or 0
+int hle_find(WORD PC);
+// The id of the hook at PC, or 0
+int hle_findHook(WORD PC);
+// Runs the call with the given id; returns its cycles or HLE_PASS
+int hle_call(int id);
+// Runs the hook with the given id, from translated code
+void hle_runHook(WORD id);
+
+#endif //HLE_H
@@ -1 +1,34 @@
-int interpreter_run(void);
\ No newline at end of file
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include "vb_types.h"
+#include "v810_mem.h"
+
+#define PREDECODE_INVALID 0xff
+#define PREDECODE_WRAM_SIZE (0x10000 / 2)
+
+// An instruction decoded once and cached by the interpreter
+typedef struct {
+    BYTE opcode;    // PREDECODE_INVALID if the entry needs decoding
+    BYTE reg1;      // condition code for Bcond
+    BYTE reg2;      // for Bcond, whether it closes a busywait loop; for jal, the HLE id
+    BYTE cycles;    // base cost from opcycle[]
+    WORD imm;       // sign/zero-extended immediate, displacement, or FPP subop
+} predecoded_inst;
+
+// WRAM code can be rewritten, so each player has its own table
+extern predecoded_inst interpreter_wram_cache[2][PREDECODE_WRAM_SIZE];
+
+int interpreter_run(void);
+void interpreter_clearCache(void);
+
+// Drop any cached instruction overlapping the halfword at addr
+static inline void interpreter_invalidateWram(WORD addr) {
+    predecoded_inst *cache = interpreter_wram_cache[vb_state - vb_players];
+    WORD i = (addr & 0xfffe) >> 1;
+    cache[i].opcode = PREDECODE_INVALID;
+    // a 32-bit instruction starting on the previous halfword
+    cache[(i - 1) & (PREDECODE_WRAM_SIZE - 1)].opcode = PREDECODE_INVALID;
+}
+
+#endif
@@ -91,6 +91,11 @@ typedef struct {
     int (*irq_handler)(WORD, WORD*);
     void(*reloc_table)(void);
     BYTE ret;
+    WORD halted; // set by HALT until an interrupt is taken, PC stays on the HALT
+    uint64_t idle_cycles; // total cycles skipped while halted
+    WORD *link_site; // set by a block exit that drc_run can link to its target
+    void *wram_code; // the interpreter's predecoded WRAM, for inline stores to invalidate
+    WORD hot_jump; // set by a jump that got hot, to its PC, so drc_run can form a superblock
 } cpu_state;
 
 ///////////////////////////////////////////////////////////////////
@@ -31,6 +31,8 @@ extern int  ins_ornbsu  (WORD src, WORD dst, WORD len, SWORD offs);
 extern int  ins_andnbsu (WORD src, WORD dst, WORD len, SWORD offs);
 extern int  ins_xornbsu (WORD src, WORD dst, WORD len, SWORD offs);
 extern int  ins_notbsu  (WORD src, WORD dst, WORD len, SWORD offs);
+// Word-aligned fast path, with the operation in offs instead of the offsets
+extern int  ins_bstrWords(WORD src, WORD dst, WORD len, SWORD offs);
 
 //FPU SubOpcodes
 extern WORD ins_rev(WORD n);   //Undocumented opcode REV (non-FPU)
@@ -2,6 +2,7 @@
 #define V810_MEM_H
 
 #include "v810_cpu.h"
+#include "events.h"
 
 // Memory Structure for the VIP Reg (Could have done it with an array
 // but this is pretier...)
@@ -60,6 +61,24 @@ typedef struct {
     WORD nextcomm;  //Next communication event
 } V810_HREGDAT;
 
+// Page table over the 27-bit address space.
+// Pages backed by plain memory are accessed directly, everything else
+// goes through the decoding in v810_mem.c.
+#define MEM_PAGE_BITS   12
+#define MEM_PAGE_SIZE   (1 << MEM_PAGE_BITS)
+#define MEM_PAGE_COUNT  (0x08000000 >> MEM_PAGE_BITS)
+
+#define MEM_PAGE_READ   1
+#define MEM_PAGE_WRITE  2
+
+typedef struct {
+    size_t off;     // Displacement... (off+addr = host pointer)
+    void (*written)(WORD addr, int size); // side effects of a direct write, if any
+    BYTE flags;     // MEM_PAGE_READ/MEM_PAGE_WRITE if it can be accessed directly
+    BYTE rwait;     // wait states for a byte or halfword read
+    BYTE wwait;     // wait states for a byte or halfword write
+} V810_MEMPAGE;
+
 // VB state
 typedef struct {
     cpu_state v810_state;
@@ -69,10 +88,17 @@ typedef struct {
     V810_MEMORYFETCH V810_GAME_RAM;
     V810_VIPREGDAT   tVIPREG;
     V810_HREGDAT     tHReg;
+    event_queue      events; // not saved, rebuilt with scheduleAllEvents
+    V810_MEMPAGE    *pages;  // MEM_PAGE_COUNT entries, rebuilt with mem_mapPages
 } VB_STATE;
 
 extern VB_STATE *vb_state;
 
+// Works out when an event source next needs servicing, from the hardware state.
+// Call it after changing anything its timing depends on.
+void scheduleEvent(VB_STATE *state, event_id id);
+void scheduleAllEvents(VB_STATE *state);
+
 extern VB_STATE vb_players[2];
 extern bool is_multiplayer;
 extern bool emulating_self;
@@ -83,6 +109,9 @@ extern V810_MEMORYFETCH V810_ROM1;
 
 extern int is_sram; //Flag if writes to sram...
 
+// Fill in the page table for the state's memory and the current ROM
+void mem_mapPages(VB_STATE *state);
+
 // Memory read functions
 uint64_t  mem_rbyte(WORD addr);
 uint64_t mem_rhword(WORD addr);
@@ -0,0 +1,400 @@
+/*
+ * V810 dynamic recompiler for x86-64
+ *
+ * This file is distributed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef X86_EMIT_H
+#define X86_EMIT_H
+
+#include <string.h>
+#include "vb_types.h"
+
+// Unlike the ARM backend, instructions are encoded straight into a byte
+// buffer; the only fixups needed are the rel32 branches between V810
+// instructions, which are resolved once the block has been placed.
+//
+// Register usage inside a block:
+// rbx: &vb_state->v810_state
+// r14: V810 flags, in the x86 EFLAGS layout (CF, ZF, SF and OF only)
+// rbp, r12, r13, r15: cached V810 registers
+// rax, rcx, rdx, rsi, rdi, r8-r11: scratch
+// The stack is 16-byte aligned, so C functions can be called directly.
+
+#define MAX_X86_BYTES 0x40000
+#define X86_NUM_CACHE_REGS 4
+
+extern BYTE* x86_ptr;
+
+enum {
+    X86_RAX = 0, X86_RCX, X86_RDX, X86_RBX, X86_RSP, X86_RBP, X86_RSI, X86_RDI,
+    X86_R8, X86_R9, X86_R10, X86_R11, X86_R12, X86_R13, X86_R14, X86_R15,
+};
+
+enum {
+    X86_CC_O  = 0x0, X86_CC_NO = 0x1, X86_CC_B  = 0x2, X86_CC_AE = 0x3,
+    X86_CC_E  = 0x4, X86_CC_NE = 0x5, X86_CC_BE = 0x6, X86_CC_A  = 0x7,
+    X86_CC_S  = 0x8, X86_CC_NS = 0x9, X86_CC_P  = 0xA, X86_CC_NP = 0xB,
+    X86_CC_L  = 0xC, X86_CC_GE = 0xD, X86_CC_LE = 0xE, X86_CC_G  = 0xF,
+};
+
+// Group 1 ALU operations (the /digit of opcodes 0x81/0x83)
+enum {
+    X86_ALU_ADD = 0, X86_ALU_OR  = 1, X86_ALU_ADC = 2, X86_ALU_SBB = 3,
+    X86_ALU_AND = 4, X86_ALU_SUB = 5, X86_ALU_XOR = 6, X86_ALU_CMP = 7,
+};
+
+// Group 2 shift operations (the /digit of opcodes 0xC1/0xD3)
+enum {
+    X86_SHIFT_ROL = 0, X86_SHIFT_ROR = 1,
+    X86_SHIFT_SHL = 4, X86_SHIFT_SHR = 5, X86_SHIFT_SAR = 7,
+};
+
+// Bits of EFLAGS kept in r14
+#define X86_FLAG_C 0x001
+#define X86_FLAG_Z 0x040
+#define X86_FLAG_S 0x080
+#define X86_FLAG_V 0x800
+#define X86_FLAG_MASK (X86_FLAG_C | X86_FLAG_Z | X86_FLAG_S | X86_FLAG_V)
+
+static inline void x86_byte(BYTE b) {
+    *x86_ptr++ = b;
+}
+
+static inline void x86_dword(WORD w) {
+    memcpy(x86_ptr, &w, 4);
+    x86_ptr += 4;
+}
+
+static inline void x86_qword(uint64_t q) {
+    memcpy(x86_ptr, &q, 8);
+    x86_ptr += 8;
+}
+
+// REX prefix, only emitted when needed (or forced, for sil/dil/bpl/spl)
+static inline void x86_rex(bool w, BYTE reg, BYTE rm, bool force) {
+    BYTE rex = 0x40 | (w << 3) | (((reg >> 3) & 1) << 2) | ((rm >> 3) & 1);
+    if (rex != 0x40 || force)
+        x86_byte(rex);
+}
+
+// ModRM for a register operand
+static inline void x86_modrm_reg(BYTE reg, BYTE rm) {
+    x86_byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// ModRM (and SIB if needed) for a [base + disp] operand
+static inline void x86_modrm_mem(BYTE reg, BYTE base, int32_t disp) {
+    BYTE mod;
+    if (disp == 0 && (base & 7) != X86_RBP)
+        mod = 0x00;
+    else if (disp >= -128 && disp < 128)
+        mod = 0x40;
+    else
+        mod = 0x80;
+    x86_byte(mod | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == X86_RSP)
+        x86_byte(0x24);
+    if (mod == 0x40)
+        x86_byte((BYTE)disp);
+    else if (mod == 0x80)
+        x86_dword(disp);
+}
+
+// <op> reg, rm (register form)
+static inline void x86_op_rr(BYTE op, bool w, BYTE reg, BYTE rm) {
+    x86_rex(w, reg, rm, false);
+    x86_byte(op);
+    x86_modrm_reg(reg, rm);
+}
+
+// <op> reg, [base + disp]
+static inline void x86_op_rm(BYTE op, bool w, BYTE reg, BYTE base, int32_t disp) {
+    x86_rex(w, reg, base, false);
+    x86_byte(op);
+    x86_modrm_mem(reg, base, disp);
+}
+
+// 0x0F-prefixed <op> reg, rm
+static inline void x86_op2_rr(BYTE op, bool w, BYTE reg, BYTE rm) {
+    x86_rex(w, reg, rm, false);
+    x86_byte(0x0F);
+    x86_byte(op);
+    x86_modrm_reg(reg, rm);
+}
+
+// SSE <prefix> 0F <op> reg, rm
+static inline void x86_sse_rr(BYTE prefix, BYTE op, bool w, BYTE reg, BYTE rm) {
+    if (prefix)
+        x86_byte(prefix);
+    x86_op2_rr(op, w, reg, rm);
+}
+
+// Group 1 ALU operation with an immediate
+static inline void x86_alu_ri(BYTE op, bool w, BYTE rm, int32_t imm) {
+    x86_rex(w, 0, rm, false);
+    if (imm >= -128 && imm < 128) {
+        x86_byte(0x83);
+        x86_modrm_reg(op, rm);
+        x86_byte((BYTE)imm);
+    } else {
+        x86_byte(0x81);
+        x86_modrm_reg(op, rm);
+        x86_dword(imm);
+    }
+}
+
+// Group 1 ALU operation with an immediate, on a dword in memory
+static inline void x86_alu_mi(BYTE op, BYTE base, int32_t disp, int32_t imm) {
+    x86_rex(false, 0, base, false);
+    if (imm >= -128 && imm < 128) {
+        x86_byte(0x83);
+        x86_modrm_mem(op, base, disp);
+        x86_byte((BYTE)imm);
+    } else {
+        x86_byte(0x81);
+        x86_modrm_mem(op, base, disp);
+        x86_dword(imm);
+    }
+}
+
+// mov r32, imm32 (doesn't affect the flags)
+static inline void x86_mov_ri(BYTE rd, WORD imm) {
+    x86_rex(false, 0, rd, false);
+    x86_byte(0xB8 + (rd & 7));
+    x86_dword(imm);
+}
+
+// Emits a jcc/jmp rel32 and returns a pointer to its displacement
+static inline BYTE* x86_jcc32(int cc) {
+    if (cc < 0) {
+        x86_byte(0xE9);
+    } else {
+        x86_byte(0x0F);
+        x86_byte(0x80 | cc);
+    }
+    x86_dword(0);
+    return x86_ptr - 4;
+}
+
+// Emits a jcc/jmp rel8 and returns a pointer to its displacement
+static inline BYTE* x86_jcc8(int cc) {
+    x86_byte(cc < 0 ? 0xEB : 0x70 | cc);
+    x86_byte(0);
+    return x86_ptr - 1;
+}
+
+// Points a rel32/rel8 displacement at the given location
+static inline void x86_patch32(BYTE* disp, BYTE* target) {
+    int32_t rel = (int32_t)(target - (disp + 4));
+    memcpy(disp, &rel, 4);
+}
+
+static inline void x86_patch8(BYTE* disp, BYTE* target) {
+    *disp = (BYTE)(target - (disp + 1));
+}
+
+// Pads with multi-byte nops until x86_ptr is 4-byte aligned
+static inline void x86_align4(void) {
+    switch ((uintptr_t)x86_ptr & 3) {
+        case 1: x86_byte(0x0F); x86_byte(0x1F); x86_byte(0x00); break;
+        case 2: x86_byte(0x66); x86_byte(0x90); break;
+        case 3: x86_byte(0x90); break;
+    }
+}
+
+/**
+* Higher level macros
+*/
+
+// mov Rd, Rs
+#define MOV_RR(Rd, Rs) x86_op_rr(0x89, false, Rs, Rd)
+#define MOV_RR64(Rd, Rs) x86_op_rr(0x89, true, Rs, Rd)
+
+// mov Rd, [Rb + off]
+#define MOV_RM(Rd, Rb, off) x86_op_rm(0x8B, false, Rd, Rb, off)
+#define MOV_RM64(Rd, Rb, off) x86_op_rm(0x8B, true, Rd, Rb, off)
+
+// mov [Rb + off], Rs
+#define MOV_MR(Rb, off, Rs) x86_op_rm(0x89, false, Rs, Rb, off)
+
+// mov dword [Rb + off], imm32
+#define MOV_MI(Rb, off, imm) { \
+    x86_rex(false, 0, Rb, false); \
+    x86_byte(0xC7); \
+    x86_modrm_mem(0, Rb, off); \
+    x86_dword(imm); \
+}
+
+// mov Rd, imm32
+#define MOV_RI(Rd, imm) x86_mov_ri(Rd, imm)
+
+// <op> Rd, Rs, for add/or/adc/sbb/and/sub/xor/cmp
+#define ALU_RR(op, Rd, Rs) x86_op_rr(((op) << 3) | 1, false, Rs, Rd)
+#define ALU_RR64(op, Rd, Rs) x86_op_rr(((op) << 3) | 1, true, Rs, Rd)
+
+// <op> Rd, imm
+#define ALU_RI(op, Rd, imm) x86_alu_ri(op, false, Rd, imm)
+
+// <op> dword [Rb + off], imm
+#define ALU_MI(op, Rb, off, imm) x86_alu_mi(op, Rb, off, imm)
+
+// <op> Rd, [Rb + off]
+#define ALU_RM(op, Rd, Rb, off) x86_op_rm(((op) << 3) | 3, false, Rd, Rb, off)
+
+// <op> [Rb + off], Rs
+#define ALU_MR(op, Rb, off, Rs) x86_op_rm(((op) << 3) | 1, false, Rs, Rb, off)
+
+// test Rd, Rs
+#define TEST_RR(Rd, Rs) x86_op_rr(0x85, false, Rs, Rd)
+#define TEST_RR64(Rd, Rs) x86_op_rr(0x85, true, Rs, Rd)
+
+// test Rd, imm32
+#define TEST_RI(Rd, imm) { \
+    x86_rex(false, 0, Rd, false); \
+    x86_byte(0xF7); \
+    x86_modrm_reg(0, Rd); \
+    x86_dword(imm); \
+}
+
+// <shift> Rd, imm8
+#define SHIFT_RI(op, Rd, imm) { \
+    x86_rex(false, 0, Rd, false); \
+    x86_byte(0xC1); \
+    x86_modrm_reg(op, Rd); \
+    x86_byte(imm); \
+}
+#define SHIFT_RI64(op, Rd, imm) { \
+    x86_rex(true, 0, Rd, false); \
+    x86_byte(0xC1); \
+    x86_modrm_reg(op, Rd); \
+    x86_byte(imm); \
+}
+
+// <shift> Rd, cl
+#define SHIFT_RCL(op, Rd) x86_op_rr(0xD3, false, op, Rd)
+
+// rol Rd16, 8 (swaps the two low bytes)
+#define ROL16_8(Rd) { \
+    x86_byte(0x66); \
+    x86_rex(false, 0, Rd, false); \
+    x86_byte(0xC1); \
+    x86_modrm_reg(X86_SHIFT_ROL, Rd); \
+    x86_byte(8); \
+}
+
+// not Rd / neg Rd
+#define NOT_R(Rd) x86_op_rr(0xF7, false, 2, Rd)
+#define NEG_R(Rd) x86_op_rr(0xF7, false, 3, Rd)
+
+// imul Rd, Rs (truncated)
+#define IMUL_RR(Rd, Rs) x86_op2_rr(0xAF, false, Rd, Rs)
+#define IMUL_RR64(Rd, Rs) x86_op2_rr(0xAF, true, Rd, Rs)
+
+// cdq; idiv Rs / div Rs (edx:eax)
+#define CDQ() x86_byte(0x99)
+#define IDIV_R(Rs) x86_op_rr(0xF7, false, 7, Rs)
+#define DIV_R(Rs) x86_op_rr(0xF7, false, 6, Rs)
+
+// movsxd Rd64, Rs32
+#define MOVSXD_RR(Rd, Rs) x86_op_rr(0x63, true, Rd, Rs)
+
+// movsx/movzx Rd32, Rs8/Rs16
+#define MOVSX8_RR(Rd, Rs) { x86_rex(false, Rd, Rs, (Rs) >= 4 && (Rs) < 8); x86_byte(0x0F); x86_byte(0xBE); x86_modrm_reg(Rd, Rs); }
+#define MOVZX8_RR(Rd, Rs) { x86_rex(false, Rd, Rs, (Rs) >= 4 && (Rs) < 8); x86_byte(0x0F); x86_byte(0xB6); x86_modrm_reg(Rd, Rs); }
+#define MOVSX16_RR(Rd, Rs) x86_op2_rr(0xBF, false, Rd, Rs)
+#define MOVZX16_RR(Rd, Rs) x86_op2_rr(0xB7, false, Rd, Rs)
+
+// set<cc> Rd8 (only use al, cl, dl, bl)
+#define SETCC(cc, Rd) { x86_byte(0x0F); x86_byte(0x90 | (cc)); x86_modrm_reg(0, Rd); }
+
+// bswap Rd
+#define BSWAP(Rd) { x86_rex(false, 0, Rd, false); x86_byte(0x0F); x86_byte(0xC8 + ((Rd) & 7)); }
+
+// push/pop Rd
+#define PUSH_R(Rd) { x86_rex(false, 0, Rd, false); x86_byte(0x50 + ((Rd) & 7)); }
+#define POP_R(Rd) { x86_rex(false, 0, Rd, false); x86_byte(0x58 + ((Rd) & 7)); }
+#define PUSHFQ() x86_byte(0x9C)
+
+// call [Rb + off]
+#define CALL_M(Rb, off) { x86_rex(false, 0, Rb, false); x86_byte(0xFF); x86_modrm_mem(2, Rb, off); }
+
+#define RET() x86_byte(0xC3)
+
+// SSE scalar single precision
+#define MOVD_XR(Xd, Rs) x86_sse_rr(0x66, 0x6E, false, Xd, Rs)
+#define MOVD_RX(Rd, Xs) x86_sse_rr(0x66, 0x7E, false, Xs, Rd)
+#define CVTSI2SS(Xd, Rs) x86_sse_rr(0xF3, 0x2A, false, Xd, Rs)
+#define CVTTSS2SI(Rd, Xs) x86_sse_rr(0xF3, 0x2C, false, Rd, Xs)
+#define ADDSS(Xd, Xs) x86_sse_rr(0xF3, 0x58, false, Xd, Xs)
+#define MULSS(Xd, Xs) x86_sse_rr(0xF3, 0x59, false, Xd, Xs)
+#define SUBSS(Xd, Xs) x86_sse_rr(0xF3, 0x5C, false, Xd, Xs)
+#define DIVSS(Xd, Xs) x86_sse_rr(0xF3, 0x5E, false, Xd, Xs)
+#define UCOMISS(Xd, Xs) x86_sse_rr(0, 0x2E, false, Xd, Xs)
+#define XORPS(Xd, Xs) x86_sse_rr(0, 0x57, false, Xd, Xs)
+
+// Captures the result flags of the last operation in r14
+#define SAVE_FLAGS() { \
+    PUSHFQ(); \
+    POP_R(X86_R14); \
+    ALU_RI(X86_ALU_AND, X86_R14, X86_FLAG_MASK); \
+}
+
+// Same, but for V810 logic operations, which clear OV and leave CY alone
+// Clobbers rdx.
+#define SAVE_FLAGS_LOGIC() { \
+    PUSHFQ(); \
+    POP_R(X86_RDX); \
+    ALU_RI(X86_ALU_AND, X86_RDX, X86_FLAG_Z | X86_FLAG_S); \
+    ALU_RI(X86_ALU_AND, X86_R14, X86_FLAG_C); \
+    ALU_RR(X86_ALU_OR, X86_R14, X86_RDX); \
+}
+
+#define ADDCYCLES() { \
+    if (cycles != 0) \
+        ALU_MI(X86_ALU_SUB, X86_RBX, offsetof(cpu_state, cycles_until_event_partial), cycles); \
+    cycles = 0; \
+}
+
+// Subtracts the pending cycles and calls the interrupt handler if an event
+// is due. The handler doesn't return if the block has to be exited.
+#define HANDLEINT(ret_PC) { \
+    ALU_MI(X86_ALU_SUB, X86_RBX, offsetof(cpu_state, cycles_until_event_partial), cycles); \
+    BYTE *skip = x86_jcc8(X86_CC_G); \
+    MOV_RR(X86_RDI, X86_R14); \
+    MOV_RI(X86_RSI, ret_PC); \
+    CALL_M(X86_RBX, offsetof(cpu_state, irq_handler)); \
+    x86_patch8(skip, x86_ptr); \
+    cycles = 0; \
+}
+
+// Skips ahead to the next event until the handler exits the block
+#define HALT(next_PC) { \
+    BYTE *loop = x86_ptr; \
+    MOV_MI(X86_RBX, offsetof(cpu_state, cycles_until_event_partial), 0); \
+    MOV_RR(X86_RDI, X86_R14); \
+    MOV_RI(X86_RSI, next_PC); \
+    CALL_M(X86_RBX, offsetof(cpu_state, irq_handler)); \
+    x86_patch8(x86_jcc8(-1), loop); \
+    cycles = 0; \
+}
+
+#endif //X86_EMIT_H
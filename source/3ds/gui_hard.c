@@ -3273,6 +3273,8 @@ static void forwarder_error(int err) {
 
 static bool load_rom(char *rom_message) {
     if (save_thread) threadJoin(save_thread, U64_MAX);
+    // keep what was translated for the last game
+    drc_saveCache();
     int ret;
     if ((ret = v810_load_init())) {
         // instant fail
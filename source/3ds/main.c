@@ -431,6 +431,7 @@ exit:
     endThreads();
     local_disconnect();
     video_quit();
+    drc_saveCache();
     drc_exit();
     v810_exit();
 
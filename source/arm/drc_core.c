@@ -42,6 +42,9 @@
 #include "utils.h"
 #include "drc_alloc.h"
 #include "drc_core.h"
+#include "busywait.h"
+#include "hle.h"
+#include "interpreter.h"
 #include "v810_cpu.h"
 #include "v810_mem.h"
 #include "v810_opt.h"
@@ -55,21 +58,9 @@
 
 #include "vb_dsp.h"
 
-HWORD* rom_block_map;
-HWORD* rom_entry_map;
-BYTE* rom_data_code_map;
-BYTE reg_usage[32];
-WORD* cache_start;
-WORD* cache_pos;
-exec_block* block_ptr_start;
-int block_pos = 1;
-
-static v810_instruction *inst_cache;
 static arm_inst *trans_cache;
 arm_inst *inst_ptr;
 
-static WORD* drc_getEntry(WORD loc, exec_block **p_block);
-
 // Maps the most used registers in the block to V810 registers
 static void drc_mapRegs(exec_block* block) {
     int i, j, max, max_pos;
@@ -108,650 +99,251 @@ static BYTE drc_getPhysReg(BYTE vb_reg, WORD reg_map) {
     return 0;
 }
 
-static bool is_byte_getter(WORD start_PC) {
-    static BYTE byte_getter_func[] = {
-        0x46, 0xc1, 0x00, 0x00, // ld.b [r6], r10
-        0x1f, 0x18,             // jmp  [lp] 
-    };
-    BYTE* dest = (BYTE*)V810_ROM1.off + start_PC;
-    return !memcmp(dest, byte_getter_func, sizeof(byte_getter_func));
-}
-
-static bool is_hword_getter(WORD start_PC) {
-    static BYTE hword_getter_func[] = {
-        0x46, 0xc5, 0x00, 0x00, // ld.h [r6], r10
-        0x1f, 0x18,             // jmp  [lp] 
-    };
-    static BYTE hword_getter_jr_func[] = {
-        0x46, 0xc5, 0x00, 0x00, // ld.h [r6], r10
-        0x00, 0xa8, 0x04, 0x00, // jr   +4
-        0x1f, 0x18,             // jmp  [lp]
-    };
-    BYTE* dest = (BYTE*)V810_ROM1.off + start_PC;
-    return !memcmp(dest, hword_getter_func, sizeof(hword_getter_func))
-        || !memcmp(dest, hword_getter_jr_func, sizeof(hword_getter_jr_func));
+// A linkable exit ends in LINK_SITE_SIZE words that drc_linkExit rewrites,
+// followed by the index of the block the exit belongs to, shifted up to make
+// room for the kind of exit. An index rather than a pointer keeps the code
+// position independent, so it can be saved to disk. Indirect exits also keep
+// the PC they're linked to after that, and counted exits their count.
+#define LINK_SITE_SIZE 6
+#define LINK_SITE_BLOCK LINK_SITE_SIZE
+#define LINK_SITE_PC (LINK_SITE_SIZE + 1)
+// The branch that guards an indirect exit, relative to the site
+#define LINK_SITE_GUARD -4
+
+enum {
+    EXIT_DIRECT     = 0,
+    // jmp: only taken while the target is the one linked
+    EXIT_INDIRECT   = 1,
+    // the return point of a jal, entered from a jmp [lp] in another block
+    EXIT_RETURN     = 2,
+    // a jal or far jr that counts down to pulling its target into the block
+    EXIT_COUNTED    = 3,
+};
+
+static struct {
+    HWORD pos;
+    BYTE kind;
+} exit_sites[MAX_ARM_INST / 16];
+static unsigned int num_exits;
+
+#define EXIT_ROOM(n) (num_exits + (n) <= sizeof(exit_sites) / sizeof(exit_sites[0]))
+
+// The unlinked tail of an exit: tell drc_run where we left from, so it can
+// link us to wherever we were going
+static void drc_emitUnlinkedExit(void) {
+    SUB_I(0, 15, 8, 0);
+    STR_IO(0, 11, offsetof(cpu_state, link_site));
+    POP(1 << 15);
+    // room for the linked version
+    NOP();
+    NOP();
+    NOP();
 }
 
-static void drc_markCode(WORD PC) {
-    rom_data_code_map[(((PC & V810_ROM1.highaddr) >> 1) & (BLOCK_MAP_COUNT - 1)) >> 3] |= 1 << ((PC >> 1) & 7);
+static void drc_emitExitSite(BYTE kind) {
+    drc_emitUnlinkedExit();
+    exit_sites[num_exits].pos = inst_ptr - trans_cache;
+    exit_sites[num_exits].kind = kind;
+    num_exits++;
+    // the block, filled in once it's been allocated
+    NOP();
+    if (kind == EXIT_INDIRECT || kind == EXIT_COUNTED)
+        NOP();
 }
 
-static void drc_markData(WORD PC) {
-    rom_data_code_map[(((PC & V810_ROM1.highaddr) >> 1) & (BLOCK_MAP_COUNT - 1)) >> 3] &= ~(1 << ((PC >> 1) & 7));
+// Leaves the block once the new PC has been saved. If there's time left
+// before the next event, this can be linked to go straight to the next block.
+static void drc_emitExit(void) {
+    MRS(3);
+    LDR_IO(0, 11, offsetof(cpu_state, cycles_until_event_partial));
+    CMP(0, 10);
+    Boff(ARM_COND_GT, 3);
+    MSR(3);
+    POP(1 << 15);
+    MSR(3);
+    drc_emitExitSite(EXIT_DIRECT);
 }
 
-static bool drc_isCode(WORD PC) {
-    return !!(rom_data_code_map[(((PC & V810_ROM1.highaddr) >> 1) & (BLOCK_MAP_COUNT - 1)) >> 3] & (1 << ((PC >> 1) & 7)));
+// Like drc_emitExit, but the PC isn't known in advance, so the link is
+// guarded by a check against the PC it was made for. Until then the guard
+// always lets the exit through.
+static void drc_emitIndirectExit(void) {
+    MRS(3);
+    LDR_IO(0, 11, offsetof(cpu_state, cycles_until_event_partial));
+    CMP(0, 10);
+    Boff(ARM_COND_LE, 5);
+    LDR_IO(0, 11, offsetof(cpu_state, PC));
+    // pc is 8 bytes ahead, and the site starts 6 words in
+    LDR_IO(1, 15, (6 - 2 + LINK_SITE_PC) * 4);
+    CMP(0, 1);
+    Boff(ARM_COND_AL, 3);
+    MSR(3);
+    POP(1 << 15);
+    MSR(3);
+    drc_emitExitSite(EXIT_INDIRECT);
 }
 
-// Finds the starting and ending address of a V810 code block. It stops after a
-// jmp, jal, reti or a long jr unless it branches further.
-// All code accessible from the entry point is accounted for.
-static void drc_scanBlockBounds(WORD* p_start_PC, WORD* p_end_PC) {
-    WORD start_PC = *p_start_PC & V810_ROM1.highaddr;
-    WORD end_PC = start_PC;
-    WORD cur_PC;
-    WORD branch_addr;
-    int branch_offset;
-    BYTE opcode;
-    bool finished;
-    BYTE lowB, highB, lowB2, highB2;
-
-    cur_PC = start_PC;
-    finished = false;
-    while(!finished) {
-        bool potentiallyDone = false;
-
-        exec_block *existing_block;
-        if (drc_getEntry(cur_PC, &existing_block) != cache_start) {
-            drc_free(existing_block);
-            WORD existing_start = existing_block->start_pc;
-            WORD existing_end = existing_start + existing_block->pc_range;
-            if (cur_PC < existing_start || cur_PC > existing_end) {
-                for (WORD PC = existing_start; PC <= existing_end; PC += 2)
-                    drc_markData(PC);
-                if (existing_start < cur_PC) cur_PC = start_PC;
-            } else {
-                if (existing_start < start_PC) start_PC = existing_start;
-                if (existing_end > end_PC) end_PC = existing_end;
-            }
-        }
-
-        drc_markCode(cur_PC);
-        if (cur_PC > end_PC)
-            end_PC = cur_PC;
-
-        cur_PC = (cur_PC & V810_ROM1.highaddr);
-        lowB   = ((BYTE *)(V810_ROM1.off + cur_PC))[0];
-        highB  = ((BYTE *)(V810_ROM1.off + cur_PC))[1];
-        lowB2  = ((BYTE *)(V810_ROM1.off + cur_PC))[2];
-        highB2 = ((BYTE *)(V810_ROM1.off + cur_PC))[3];
-
-        if ((highB & 0xE0) == 0x80)
-            opcode = highB>>1;
-        else
-            opcode = highB>>2;
-
-        switch (opcode) {
-            case V810_OP_JR:
-                branch_offset = (signed)sign_26(((highB & 0x3) << 24) + (lowB << 16) + (highB2 << 8) + lowB2);
-                if (abs(branch_offset) < 1024) {
-                    branch_addr = cur_PC + branch_offset;
-                    bool should_backjump = false;
-                    if (branch_addr < start_PC) {
-                        start_PC = branch_addr;
-                        should_backjump = true;
-                    } else if (branch_addr > end_PC) {
-                        end_PC = branch_addr;
-                    }
-
-                    bool was_code = drc_isCode(branch_addr);
-                    drc_markCode(branch_addr);
-                    if (branch_offset < 0) {
-                        if (!was_code) {
-                            // Not already scanned, so scan it.
-                            cur_PC = branch_addr;
-                            continue;
-                        } else {
-                            // Was previously scanned, so as long as we scanned it just now,
-                            // anything following from it should be accounted for.
-                            if (should_backjump) {
-                                cur_PC = branch_addr;
-                                continue;
-                            }
-                        }
-                    }
-                    
-                    potentiallyDone = true;
-                    break;
-                }
-            case V810_OP_JAL:
-                branch_addr = cur_PC + (signed)sign_26(((highB & 0x3) << 24) + (lowB << 16) + (highB2 << 8) + lowB2);
-                if (is_byte_getter(branch_addr) || is_hword_getter(branch_addr)) break;
-            case V810_OP_JMP:
-            case V810_OP_RETI:
-                potentiallyDone = true;
-                break;
-            case V810_OP_BV:
-            case V810_OP_BL:
-            case V810_OP_BE:
-            case V810_OP_BNH:
-            case V810_OP_BN:
-            case V810_OP_BR:
-            case V810_OP_BLT:
-            case V810_OP_BLE:
-            case V810_OP_BNV:
-            case V810_OP_BNL:
-            case V810_OP_BNE:
-            case V810_OP_BH:
-            case V810_OP_BP:
-            case V810_OP_BGE:
-            case V810_OP_BGT:
-                branch_offset = (signed)sign_9(((highB & 0x1) << 8) + (lowB & 0xFE));
-                branch_addr = cur_PC + branch_offset;
-                bool should_backjump = false;
-                if (branch_addr < start_PC) {
-                    start_PC = branch_addr;
-                    should_backjump = true;
-                } else if (branch_addr > end_PC) {
-                    end_PC = branch_addr;
-                }
-                
-                if (opcode == V810_OP_BR) {
-                    potentiallyDone = true;
-                }
-
-                bool was_code = drc_isCode(branch_addr);
-                drc_markCode(branch_addr);
-                if (branch_offset < 0) {
-                    if (!was_code) {
-                        // Not already scanned, so scan it.
-                        cur_PC = branch_addr;
-                        continue;
-                    } else {
-                        // Was previously scanned, so as long as we scanned it just now,
-                        // anything following from it should be accounted for.
-                        if (should_backjump) {
-                            cur_PC = branch_addr;
-                            continue;
-                        }
-                    }
-                }
-                break;
-        }
-
-        if (potentiallyDone) {
-            if (cur_PC >= end_PC) {
-                end_PC = cur_PC;
-                finished = true;
-            } else {
-                // end_PC should always be marked as code, so we don't need to bounds check
-                do {
-                    cur_PC += 2;
-                } while (!drc_isCode(cur_PC));
-            }
-        } else {
-            cur_PC += am_size_table[optable[opcode].addr_mode];
-        }
-    }
-
-    *p_start_PC = start_PC;
-    *p_end_PC = end_PC;
+// Like drc_emitExit, for a jump whose target could be pulled into the block.
+// Each time it's taken with time to spare, it counts down the word after the
+// site. When that runs out, it leaves with hot_jump set instead of going
+// through the site, so drc_run can translate the block again as a superblock.
+static void drc_emitCountedExit(WORD jump_PC) {
+    arm_inst *to_exit, *to_site, *load_count, *store_count;
+    MRS(3);
+    LDR_IO(0, 11, offsetof(cpu_state, cycles_until_event_partial));
+    CMP(0, 10);
+    to_exit = inst_ptr;
+    Boff(ARM_COND_LE, 0);
+    load_count = inst_ptr;
+    LDR_IO(0, 15, 0);
+    SUBS_I(0, 0, 1, 0);
+    store_count = inst_ptr;
+    STR_IO(0, 15, 0);
+    to_site = inst_ptr;
+    Boff(ARM_COND_NE, 0);
+    LDW_I(0, jump_PC);
+    STR_IO(0, 11, offsetof(cpu_state, hot_jump));
+    to_exit->b_bl.imm = inst_ptr - to_exit - 2;
+    MSR(3);
+    POP(1 << 15);
+    to_site->b_bl.imm = inst_ptr - to_site - 2;
+    MSR(3);
+    drc_emitExitSite(EXIT_COUNTED);
+    // pc is 8 bytes ahead
+    load_count->ldst_io.imm = (inst_ptr - 1 - load_count - 2) * 4;
+    store_count->ldst_io.imm = (inst_ptr - 1 - store_count - 2) * 4;
 }
 
-// Finds an instruction in the given range at the given PC, or the one just after it.
-static v810_instruction *drc_findInstruction(v810_instruction *left, v810_instruction *right, WORD goal_PC) {
-    while (left != right) {
-        v810_instruction *pivot = left + (right - left) / 2;
-        if (pivot->PC < goal_PC) left = pivot + 1;
-        else if (pivot->PC > goal_PC) right = pivot;
-        else return pivot;
-    }
-    return right;
+// Pushes the return point of a jal to the return stack. The return site has
+// to be emitted with drc_emitReturnSite right after the exit.
+static arm_inst* drc_emitPushReturn(WORD ret_PC) {
+    arm_inst *site_addr;
+    LDR_IO(2, 11, offsetof(cpu_state, reloc_table));
+    LDR_IO(2, 2, DRC_RELOC_RETSTACK*4);
+    LDR_IO(1, 2, offsetof(return_stack, top));
+    ADD_I(1, 1, 1, 0);
+    AND_I(1, 1, RET_STACK_SIZE - 1, 0);
+    STR_IO(1, 2, offsetof(return_stack, top));
+    ADD_IS(2, 2, 1, ARM_SHIFT_LSL, 3);
+    LDW_I(0, ret_PC);
+    STR_IO(0, 2, offsetof(return_stack, entries[0].PC));
+    site_addr = inst_ptr;
+    ADD_I(0, 15, 0, 0);
+    STR_IO(0, 2, offsetof(return_stack, entries[0].site));
+    return site_addr;
 }
 
-// Finds the target of a branch, or the instruction just after it.
-static v810_instruction *drc_findBranchTarget(int size, int pos) {
-    // attempt to narrow down
-    int close = pos;
-    int far = pos + inst_cache[pos].branch_offset / 2;
-    int left = close < far ? close : far;
-    int right = close < far ? far : close;
-    if (left < 0) left = 0;
-    if (right >= size) right = size - 1;
-    // if it's somehow outside our guessed range, look at the rest of it
-    WORD goal_PC = inst_cache[pos].PC + inst_cache[pos].branch_offset;
-    if (inst_cache[left].PC > goal_PC) {
-        right = left;
-        left = left > pos ? pos : 0;
-    } else if (inst_cache[right].PC < goal_PC) {
-        left = right;
-        right = right < pos ? pos : size - 1;
-    }
-    return drc_findInstruction(&inst_cache[left], &inst_cache[right], goal_PC);
+static void drc_emitReturnSite(arm_inst *site_addr) {
+    site_addr->dpi.imm = (inst_ptr - site_addr - 2) * 4;
+    drc_emitExitSite(EXIT_RETURN);
 }
 
-static void drc_findWaterworldBusywait(int size) {
-    for (int i = 3; i < size; i++) {
-        // scan for this pattern:
-        // ld.h <...>[gp], r10
-        // cmp <...>, r10
-        // b<...> +
-        // jr <...>
-        // + ...
-        if (inst_cache[i].opcode == V810_OP_JR && abs(inst_cache[i].branch_offset) < 1024 &&
-            inst_cache[i - 1].branch_offset == 6 &&
-            inst_cache[i - 2].opcode == V810_OP_CMP_I && inst_cache[i - 2].reg2 == 10 &&
-            inst_cache[i - 3].opcode == V810_OP_LD_H && inst_cache[i - 3].reg1 == 4 && inst_cache[i - 3].reg2 == 10
-        ) {
-            // check some known combinations
-            if ((inst_cache[i - 1].opcode == V810_OP_BNE && inst_cache[i - 2].imm == 0 && inst_cache[i - 3].imm == 0x8030) ||
-                (inst_cache[i - 1].opcode == V810_OP_BE && inst_cache[i - 2].imm == 1 && inst_cache[i - 3].imm == 0x8010)
-            ) {
-                // it's probably safe at this point
-                inst_cache[i].busywait = true;
-                dprintf(1, "waterworld busywait at %lx\n", inst_cache[i].PC);
-            }
-        }
-    }
+// The return site of a jal to somewhere in the same block. Returning from
+// within the block, the registers are already right, so it can go straight
+// on after the jal; the branch for that is returned to be patched once it's
+// known where that is. Returns from other blocks still go through the exit.
+static arm_inst* drc_emitLocalReturnSite(arm_inst *site_addr, HWORD block_id) {
+    arm_inst *to_next;
+    site_addr->dpi.imm = (inst_ptr - site_addr - 2) * 4;
+    LDW_I(1, block_id);
+    CMP(1, 2);
+    Boff(ARM_COND_NE, 3);
+    MSR(3);
+    to_next = inst_ptr;
+    Boff(ARM_COND_AL, 0);
+    MSR(3);
+    drc_emitExitSite(EXIT_RETURN);
+    return to_next;
 }
 
-void drc_clearScreenForGolf(void) {
-    if (!emulating_self) return;
-#ifdef __3DS__
-    C3D_FrameBegin(0);
-    for (int i = 0; i < 2; i++) {
-        C3D_RenderTargetClear(screenTargetHard[i], C3D_CLEAR_COLOR, 0, 0);
-    }
-    C3D_FrameEnd(0);
-#endif
+// jmp [lp]: pops the return stack and, if it matches, goes straight to the
+// return site of the jal, with the returning block in r2 and the flags in r3
+static void drc_emitReturn(HWORD block_id) {
+    MRS(3);
+    LDR_IO(2, 11, offsetof(cpu_state, reloc_table));
+    LDR_IO(2, 2, DRC_RELOC_RETSTACK*4);
+    LDR_IO(1, 2, offsetof(return_stack, top));
+    ADD_IS(0, 2, 1, ARM_SHIFT_LSL, 3);
+    SUB_I(1, 1, 1, 0);
+    AND_I(1, 1, RET_STACK_SIZE - 1, 0);
+    STR_IO(1, 2, offsetof(return_stack, top));
+    LDR_IO(1, 0, offsetof(return_stack, entries[0].PC));
+    LDR_IO(0, 0, offsetof(return_stack, entries[0].site));
+    LDR_IO(2, 11, offsetof(cpu_state, PC));
+    CMP(1, 2);
+    LDR_IO(1, 11, offsetof(cpu_state, cycles_until_event_partial));
+    LDW_I(2, block_id);
+    Boff(ARM_COND_NE, 5);
+    CMP(1, 10);
+    Boff(ARM_COND_LE, 3);
+    MSR(3);
+    MOV(15, 0);
+    MSR(3);
+    POP(1 << 15);
 }
 
-// Baseball 2 unpacked sprite cache. Not strictly required for performance,
-// but since we're HLE'ing this anyway, might as well.
-#define BASEBALL2_SPRITES_COUNT 512
-static bool baseball2_sprites_is_unpacked[BASEBALL2_SPRITES_COUNT];
-static WORD baseball2_sprites_address[BASEBALL2_SPRITES_COUNT];
-static BYTE baseball2_sprites_unpacked[BASEBALL2_SPRITES_COUNT][32][32];
-
-void baseball2_scaling(WORD in_img, WORD out_img, WORD scale_fixed) {
-    // The input/output format is 4x4 tiles
-    void *in_ptr = (void*)(V810_ROM1.off + in_img);
-    void *out_ptr = (void*)(vb_state->V810_VB_RAM.off + out_img);
-
-    // Get cached sprite if possible
-    unsigned sprite_id = (in_img >> 8) % BASEBALL2_SPRITES_COUNT;
-    BYTE (*in_unpacked)[32] = baseball2_sprites_unpacked[sprite_id];
-    bool is_unpacked = baseball2_sprites_is_unpacked[sprite_id] && baseball2_sprites_address[sprite_id] == in_img;
-    if (!is_unpacked) {
-        // Cached doesn't exist, so unpack input image
-        baseball2_sprites_is_unpacked[sprite_id] = true;
-        baseball2_sprites_address[sprite_id] = in_img;
-        for (int ty = 0; ty < 4; ty++) {
-            for (int tx = 0; tx < 4; tx++) {
-                for (int y = 0; y < 8; y++) {
-                    HWORD row = ((HWORD*)in_ptr)[ty*8*4+tx*8+y];
-                    for (int x = 0; x < 8; x++) {
-                        in_unpacked[ty*8+y][tx*8+x] = (row >> (x*2)) & 3;
-                    }
-                }
-            }
-        }
-    }
-
-    // Pre-compute x offsets
-    int xcount = 32;
-    BYTE x_offsets[32];
-    for (int i = 0; i < 32; i++) {
-        unsigned x_offset = (i * scale_fixed) >> 16;
-        if (x_offset >= 32) {
-            xcount = i;
-            break;
-        }
-        x_offsets[i] = x_offset;
-    }
-
-    // Scale
-    static BYTE out_unpacked[32][32];
-    memset(out_unpacked, 0, sizeof(out_unpacked));
-    for (
-        unsigned y = 0, scaled_y_fp = 0, scaled_y = 0;
-        y < 32 && scaled_y < 32;
-        y++, scaled_y_fp += scale_fixed, scaled_y = scaled_y_fp >> 16
-    ) {
-        unsigned scaled_y = scaled_y_fp >> 16;
-        for (unsigned x = 0; x < xcount; x++) {
-            unsigned scaled_x = x_offsets[x];
-            out_unpacked[y][x] = in_unpacked[scaled_y][scaled_x];
-        }
-    }
-    
-    // Re-pack into output
-    for (int ty = 0; ty < 4; ty++) {
-        for (int tx = 0; tx < 4; tx++) {
-            for (int y = 0; y < 8; y++) {
-                HWORD row = 0;
-                for (int x = 0; x < 8; x++) {
-                    row |= out_unpacked[ty*8+y][tx*8+x] << (x*2);
-                }
-                ((HWORD*)out_ptr)[ty*8*4+tx*8+y] = row;
-            }
-        }
-    }
-}
+void drc_linkExit(WORD *site, WORD PC, WORD *entry, exec_block *block) {
+    BYTE kind = site[LINK_SITE_BLOCK] & 3;
+    exec_block *from = &block_ptr_start[site[LINK_SITE_BLOCK] >> 2];
+    arm_inst link[LINK_SITE_SIZE];
+    arm_inst *old_inst_ptr = inst_ptr;
+    int i;
 
-void baseball2_sort(void) {
-    u8 ids[13];
-    typedef struct {
-        WORD padding1;
-        HWORD key;
-        HWORD padding2[sizeof(ids)];
-    } SortableItem;
-    SortableItem *out = (SortableItem*)(vb_state->V810_VB_RAM.pmemory + 0x93a0);
-    SortableItem originals[sizeof(ids)];
-    memcpy(originals, out, sizeof(originals));
-    for (int i = 0; i < sizeof(ids); i++) ids[i] = i;
-    // insertion sort
-    for (int i = 1; i < sizeof(ids); i++) {
-        u8 x = ids[i];
-        u8 key = originals[x].key;
-        int j;
-        for (j = i; j > 0 && originals[ids[j - 1]].key > key; j--) {
-            ids[j] = ids[j - 1];
-        }
-        ids[j] = x;
+    inst_ptr = link;
+    // Return sites run with the registers of whichever block returned
+    if (kind != EXIT_RETURN && from->reg_map == block->reg_map) {
+        // Same registers cached, so nothing to swap
+        Boff(ARM_COND_AL, entry - site);
+    } else {
+        // Go through drc_chainBlock to swap them
+        LDR_IO(2, 11, offsetof(cpu_state, reloc_table));
+        LDR_IO(0, 15, 4);
+        LDR_IO(1, 15, 4);
+        LDR_IO(15, 2, DRC_RELOC_CHAIN*4);
+        site[4] = (WORD)block;
+        site[5] = (WORD)entry;
     }
-    for (int i = 0; i < sizeof(ids); i++) {
-        memcpy(&out[i], &originals[ids[i]], sizeof(out[i]));
+    if (kind == EXIT_INDIRECT) {
+        site[LINK_SITE_PC] = PC;
+        Boff(ARM_COND_EQ, 3);
+        drc_assemble(site + LINK_SITE_GUARD, inst_ptr - 1);
+        inst_ptr--;
     }
+    // patch the first instruction last
+    for (i = inst_ptr - link - 1; i >= 0; i--)
+        drc_assemble(site + i, &link[i]);
+    inst_ptr = old_inst_ptr;
+
+    if (kind == EXIT_INDIRECT)
+        FlushInvalidateCache(site + LINK_SITE_GUARD, (LINK_SITE_PC + 1 - LINK_SITE_GUARD) * 4);
+    else
+        FlushInvalidateCache(site, LINK_SITE_SIZE * 4);
 }
 
-// Workaround for an issue where the CPSR is modified outside of the block
-// before a conditional branch.
-// Sets save_flags for all unconditional instructions prior to a branch.
-static void drc_findLastConditionalInst(int pos) {
-    bool save_flags = true, busywait = inst_cache[pos].branch_offset <= 0 && inst_cache[pos].opcode != V810_OP_SETF;
-    if (inst_cache[pos].branch_offset == 0) {
-        // catch edge case of block that starts with branch to self
-        dprintf(0, "busywait at %lx to %lx\n", inst_cache[pos].PC, inst_cache[pos].PC + inst_cache[pos].branch_offset);
-        inst_cache[pos].busywait = true;
-        busywait = false;
-    }
-    for (int i = pos - 1; i >= 0; i--) {
-        switch (inst_cache[i].opcode) {
-            case V810_OP_LD_W:
-            case V810_OP_IN_W:
-                inst_cache[i].save_flags = save_flags;
-                // if a register is loading itself, it might not be a busywait
-                if (inst_cache[i].reg1 == inst_cache[i].reg2) {
-                    busywait = false;
-                }
-                break;
-            case V810_OP_LD_B:
-            case V810_OP_LD_H:
-            case V810_OP_IN_B:
-            case V810_OP_IN_H:
-            case V810_OP_ST_B:
-            case V810_OP_ST_H:
-            case V810_OP_ST_W:
-            case V810_OP_OUT_B:
-            case V810_OP_OUT_H:
-            case V810_OP_OUT_W:
-            case V810_OP_MOV:
-            case V810_OP_MOV_I:
-            case V810_OP_MOVEA:
-            case V810_OP_MOVHI:
-                inst_cache[i].save_flags = save_flags;
-                break;
-            case V810_OP_AND:
-            case V810_OP_ANDI:
-            case V810_OP_CMP:
-            case V810_OP_CMP_I:
-                // affects flags but is used in busywait
-                save_flags = false;
-                break;
-            case V810_OP_JAL:
-                // nester's funky bowling calls a function to do its busywait read
-                // and it does this several times
-                if (memcmp(tVBOpt.GAME_ID, "01VNFE", 6) == 0 && (
-                    inst_cache[i].PC + inst_cache[i].branch_offset == 0x07005326 ||
-                    inst_cache[i].PC + inst_cache[i].branch_offset == 0x07001f2c
-                )) break;
-            case V810_OP_ADD:
-            case V810_OP_OR:
-                // only certain operators are ok for busywait here, otherwise fallthrough
-                if (
-                    (inst_cache[i].opcode == V810_OP_OR && inst_cache[i].reg1 == inst_cache[i].reg2) ||
-                    (inst_cache[i].opcode == V810_OP_ADD && inst_cache[i].reg1 == 0)
-                ) {
-                    save_flags = false;
-                    break;
-                }
-            case V810_OP_SHR_I:
-                // virtual league baseball 2 uses a shr in busywaits in several places
-                if (i == pos - 1 && i >= 2
-                    && inst_cache[i - 2].opcode == V810_OP_MOVHI
-                    && inst_cache[i - 2].reg1 == 0
-                    && inst_cache[i - 1].opcode == V810_OP_LD_H
-                    && inst_cache[i - 1].reg1 == inst_cache[i - 2].reg2
-                    && inst_cache[i].opcode == V810_OP_SHR_I
-                    && inst_cache[i].reg2 == inst_cache[i - 1].reg2
-                    && inst_cache[pos].PC + inst_cache[pos].branch_offset == inst_cache[i - 2].PC
-                ) {
-                    save_flags = false;
-                    break;
-                }
-            default:
-                return;
-        }
-        if (busywait && inst_cache[i].PC <= inst_cache[pos].PC + inst_cache[pos].branch_offset) {
-            dprintf(0, "busywait at %lx to %lx\n", inst_cache[pos].PC, inst_cache[pos].PC + inst_cache[pos].branch_offset);
-            inst_cache[pos].busywait = true;
-            busywait = false;
-        }
-    }
-}
-
-// Decodes the instructions from start_PC to end_PC and stores them in
-// inst_cache.
-// Returns the number of instructions decoded.
-static unsigned int drc_decodeInstructions(exec_block *block, WORD start_PC, WORD end_PC) {
-    unsigned int i = 0;
-    // Up to 4 bytes for instruction (either 16 or 32 bits)
-    BYTE lowB, highB, lowB2, highB2;
-    WORD cur_PC = start_PC;
-    bool finished;
-
-    WORD entry_PC = vb_state->v810_state.PC;
-
-    for (; (i < MAX_V810_INST) && (cur_PC <= end_PC); i++) {
-        cur_PC = (cur_PC & V810_ROM1.highaddr);
-        lowB   = ((BYTE *)(V810_ROM1.off + cur_PC))[0];
-        highB  = ((BYTE *)(V810_ROM1.off + cur_PC))[1];
-        lowB2  = ((BYTE *)(V810_ROM1.off + cur_PC))[2];
-        highB2 = ((BYTE *)(V810_ROM1.off + cur_PC))[3];
-
-        if (cur_PC == 0x07004e1a) {
-            dprintf(0, "iaupsdfhjasdjklfhasdlf %lx", cur_PC);
-        }
-
-        inst_cache[i].PC = cur_PC;
-        inst_cache[i].save_flags = false;
-        inst_cache[i].busywait = false;
-        inst_cache[i].is_branch_target = false;
-        inst_cache[i].branch_offset = 0;
-
-        inst_cache[i].opcode = highB >> 2;
-        if ((highB & 0xE0) == 0x80)              // Special opcode format for
-            inst_cache[i].opcode = (highB >> 1); // type III instructions.
-
-        if ((inst_cache[i].opcode > 0x4F) || (inst_cache[i].opcode < 0))
-            return 0;
-
-        switch (optable[inst_cache[i].opcode].addr_mode) {
-            case AM_I:
-                inst_cache[i].reg1 = (BYTE)((lowB & 0x1F));
-                reg_usage[inst_cache[i].reg1]++;
-
-                // jmp [reg1] doesn't use the second register
-                if (inst_cache[i].opcode != V810_OP_JMP) {
-                    inst_cache[i].reg2 = (BYTE)((lowB >> 5) + ((highB & 0x3) << 3));
-                    reg_usage[inst_cache[i].reg2]++;
-                } else {
-                    inst_cache[i].reg2 = 0xFF;
-                }
-                break;
-            case AM_II:
-                inst_cache[i].imm = (unsigned)((lowB & 0x1F));
-                inst_cache[i].reg2 = (BYTE)((lowB >> 5) + ((highB & 0x3) << 3));
-                reg_usage[inst_cache[i].reg2]++;
-
-                inst_cache[i].reg1 = 0xFF;
-
-                if (inst_cache[i].opcode == V810_OP_SETF) {
-                    drc_findLastConditionalInst(i);
-                }
-                break;
-            case AM_III: // Branch instructions
-                inst_cache[i].imm = (unsigned)(((highB & 0x1) << 8) + (lowB & 0xFE));
-                inst_cache[i].branch_offset = sign_9(inst_cache[i].imm);
-
-                inst_cache[i].reg1 = 0xFF;
-                inst_cache[i].reg2 = 0xFF;
-
-                if (inst_cache[i].opcode != V810_OP_BR &&
-                    inst_cache[i].opcode != V810_OP_NOP)
-                    drc_findLastConditionalInst(i);
-                break;
-            case AM_IV: // Middle distance jump
-                inst_cache[i].imm = (unsigned)(((highB & 0x3) << 24) + (lowB << 16) + (highB2 << 8) + lowB2);
-                inst_cache[i].branch_offset = (signed)sign_26(inst_cache[i].imm);
-
-                inst_cache[i].reg1 = 0xFF;
-                inst_cache[i].reg2 = 0xFF;
-
-                // inlining
-                static BYTE hword_getter_func[] = {
-                    0x46, 0xc5, 0x00, 0x00, // ld.h [r6], r10
-                    0x1f, 0x18,             // jmp  [lp] 
-                };
-                static BYTE hword_getter_jr_func[] = {
-                    0x46, 0xc5, 0x00, 0x00, // ld.h [r6], r10
-                    0x00, 0xa8, 0x04, 0x00, // jr   +4
-                    0x1f, 0x18,             // jmp  [lp]
-                };
-                if (inst_cache[i].opcode == V810_OP_JAL) {
-                    if (is_hword_getter(inst_cache[i].PC + inst_cache[i].branch_offset)) {
-                        inst_cache[i].opcode = V810_OP_LD_H;
-                        inst_cache[i].imm = 0;
-                        inst_cache[i].reg1 = 6;
-                        inst_cache[i].reg2 = 10;
-                    } else if (is_byte_getter(inst_cache[i].PC + inst_cache[i].branch_offset)) {
-                        inst_cache[i].opcode = V810_OP_LD_B;
-                        inst_cache[i].imm = 0;
-                        inst_cache[i].reg1 = 6;
-                        inst_cache[i].reg2 = 10;
-                    }
-                }
-                break;
-            case AM_V:
-                inst_cache[i].reg2 = (BYTE)((lowB >> 5) + ((highB & 0x3) << 3));
-                inst_cache[i].reg1 = (BYTE)((lowB & 0x1F));
-                inst_cache[i].imm = (highB2 << 8) + lowB2;
-                reg_usage[inst_cache[i].reg1]++;
-                reg_usage[inst_cache[i].reg2]++;
-                break;
-            case AM_VIa: // Mode6 form1
-                inst_cache[i].imm = (highB2 << 8) + lowB2;
-                inst_cache[i].reg1 = (BYTE)((lowB & 0x1F));
-                inst_cache[i].reg2 = (BYTE)((lowB >> 5) + ((highB & 0x3) << 3));
-                reg_usage[inst_cache[i].reg1]++;
-                reg_usage[inst_cache[i].reg2]++;
-                break;
-            case AM_VIb: // Mode6 form2
-                inst_cache[i].reg2 = (BYTE)((lowB >> 5) + ((highB & 0x3) << 3));
-                inst_cache[i].imm = (highB2 << 8) + lowB2; // Whats the order??? 2,3,1 or 1,3,2
-                inst_cache[i].reg1 = (BYTE)((lowB & 0x1F));
-                reg_usage[inst_cache[i].reg1]++;
-                reg_usage[inst_cache[i].reg2]++;
-                break;
-            case AM_VII: // Unhandled
-                break;
-            case AM_VIII: // Unhandled
-                break;
-            case AM_IX:
-                inst_cache[i].imm = (unsigned)((lowB & 0x1)); // Mode ID, Ignore for now
-
-                inst_cache[i].reg1 = 0xFF;
-                inst_cache[i].reg2 = 0xFF;
-                break;
-            case AM_BSTR: // Bit String Subopcodes
-                inst_cache[i].imm = (unsigned)((lowB & 0x1F));
-                reg_usage[26]++;
-                reg_usage[27]++;
-                reg_usage[28]++;
-                reg_usage[29]++;
-                reg_usage[30]++;
-
-                inst_cache[i].reg1 = 0xFF;
-                inst_cache[i].reg2 = 0xFF;
-                break;
-            case AM_FPP: // Floating Point Subcode
-                inst_cache[i].reg2 = (BYTE)((lowB >> 5) + ((highB & 0x3) << 3));
-                inst_cache[i].reg1 = (BYTE)((lowB & 0x1F));
-                inst_cache[i].imm = (unsigned)(((highB2 >> 2)&0x3F));
-                reg_usage[inst_cache[i].reg1]++;
-                reg_usage[inst_cache[i].reg2]++;
-                break;
-            case AM_UDEF: // Invalid opcode.
-                inst_cache[i].reg1 = 0xFF;
-                inst_cache[i].reg2 = 0xFF;
-                break;
-            default: // Invalid opcode.
-                inst_cache[i].reg1 = 0xFF;
-                inst_cache[i].reg2 = 0xFF;
-                cur_PC += 2;
-                break;
-        }
-        
-        cur_PC += am_size_table[optable[inst_cache[i].opcode].addr_mode];
-        block->cycles += opcycle[inst_cache[i].opcode];
-
-        while (!drc_isCode(cur_PC) && cur_PC < end_PC) {
-            cur_PC += 2;
-        }
-    }
-
-    // mark branch targets
-    for (int j = 0; j < i; j++) {
-        if (optable[inst_cache[j].opcode].addr_mode != AM_III && inst_cache[j].opcode != V810_OP_JR)
-            continue;
-        if (inst_cache[j].branch_offset == 0)
-            continue;
-        if (inst_cache[j].opcode != V810_OP_JR || abs(inst_cache[j].branch_offset) < 1024) {
-            // find the branch target
-            v810_instruction *target = drc_findBranchTarget(i, j);
-            WORD target_PC = inst_cache[j].PC + inst_cache[j].branch_offset;
-            if (target->PC != target_PC) {
-                // this really should not happen anymore
-                dprintf(0, "Invalid jump from %lx to %lx (found %lx between %lx and %lx)\n", inst_cache[j].PC, target_PC, target->PC, inst_cache[0].PC, inst_cache[i-1].PC);
-                break;
-            } else {
-                // it's a valid target, so mark it as such
-                target->is_branch_target = true;
-            }
-        }
-    }
+void drc_unlinkExit(WORD *site) {
+    BYTE kind = site[LINK_SITE_BLOCK] & 3;
+    arm_inst unlinked[LINK_SITE_SIZE + 1];
+    arm_inst *old_inst_ptr = inst_ptr;
+    int i;
 
-    if (i == MAX_V810_INST) {
-        dprintf(0, "WARN:%lx-%lx exceeds max instrs\n", start_PC, end_PC);
+    inst_ptr = unlinked;
+    drc_emitUnlinkedExit();
+    for (i = 0; i < LINK_SITE_SIZE; i++)
+        drc_assemble(site + i, &unlinked[i]);
+    if (kind == EXIT_INDIRECT) {
+        Boff(ARM_COND_AL, 3);
+        drc_assemble(site + LINK_SITE_GUARD, inst_ptr - 1);
     }
+    inst_ptr = old_inst_ptr;
 
-    return i;
+    if (kind == EXIT_INDIRECT)
+        FlushInvalidateCache(site + LINK_SITE_GUARD, (LINK_SITE_PC + 1 - LINK_SITE_GUARD) * 4);
+    else
+        FlushInvalidateCache(site, LINK_SITE_SIZE * 4);
 }
 
 // Translates a V810 block into ARM code
-static int drc_translateBlock(void) {
+int drc_translateBlock(WORD start_PC) {
     int i, j;
     int err = 0;
     // Stores the number of clock cycles since the last branch
@@ -763,7 +355,6 @@ static int drc_translateBlock(void) {
     // they're not cached, they will be mapped to r2 and r3.
     BYTE arm_reg1, arm_reg2;
     BYTE arm_cond;
-    WORD start_PC = vb_state->v810_state.PC;
     WORD end_PC;
     // For each V810 instruction, tells if either reg1 or reg2 is cached
     bool unmapped_registers;
@@ -773,13 +364,14 @@ static int drc_translateBlock(void) {
     bool reg2_modified;
     // The value of inst_ptr at the start of a V810 instruction
     arm_inst* inst_ptr_start;
+    // Branches around the inline WRAM access of a load or store
+    arm_inst *wram_miss, *wram_done;
+    // The return site of a jal within the block, to go on from the jal
+    arm_inst *local_return = NULL;
     
     // Games with specific hacks; additional explanation follows where each check is used.
     bool is_waterworld = memcmp(tVBOpt.GAME_ID, "67VWEE", 6) == 0;
     bool is_virtual_lab = memcmp(tVBOpt.GAME_ID, "AHVJVJ", 6) == 0;
-    bool is_golf_us = memcmp(tVBOpt.GAME_ID, "01VVGE", 6) == 0;
-    bool is_golf_jp = memcmp(tVBOpt.GAME_ID, "E4VVGJ", 6) == 0;
-    bool is_baseball_2 = memcmp(tVBOpt.GAME_ID, "7FVVQE", 6) == 0 && V810_ROM1.size >= 0x100000; // size check for memory safety
     bool is_space_invaders = memcmp(tVBOpt.GAME_ID, "C0VSPJ", 6) == 0;
     bool is_jack_bros = memcmp(tVBOpt.GAME_ID, "EBVJBE", 6) == 0 || memcmp(tVBOpt.GAME_ID, "EBVJBJ", 6) == 0;
     bool chcw_load_seen = (vb_state->v810_state.S_REG[CHCW] & 2) != 0;
@@ -811,7 +403,7 @@ static int drc_translateBlock(void) {
     dprintf(3, "[DRC]: new block - 0x%lx->0x%lx\n", start_PC, end_PC);
 
     // Clear previous block register stats
-    memset(reg_usage, 0, 32);
+    memset(reg_usage, 0, sizeof(reg_usage));
 
     block = drc_getNextBlockStruct();
     if (block == NULL)
@@ -827,7 +419,7 @@ static int drc_translateBlock(void) {
 
     // Waterworld-excluive pass: find busywaits
     if (is_waterworld)
-        drc_findWaterworldBusywait(num_v810_inst);
+        busywait_findWaterworld(inst_cache, num_v810_inst);
 
     // Second pass: map the most used V810 registers to ARM registers
     drc_mapRegs(block);
@@ -836,6 +428,7 @@ static int drc_translateBlock(void) {
         phys_regs[i] = drc_getPhysReg(i, block->reg_map);
 
     inst_ptr = &trans_cache[0];
+    num_exits = 0;
 #ifdef LITERAL_POOL
     pool_ptr = pool_cache_start;
 #endif
@@ -884,6 +477,79 @@ static int drc_translateBlock(void) {
         if (arm_reg2 < 4) STR_IO(r, 11, offsetof(cpu_state, P_REG[inst_cache[i].reg2])); \
         else if(arm_reg2 != r) MOV(arm_reg2, r);
 
+    // r0 = reg1 + disp16, for loads and stores
+    #define LOAD_ADDR() \
+        if (inst_cache[i].imm == 0) { \
+            RELOAD_REG1(0); \
+        } else if ((short)inst_cache[i].imm > 0) { \
+            LOAD_REG1(); \
+            int ctz = __builtin_ctz(inst_cache[i].imm) & ~1; \
+            int clz = __builtin_clz(inst_cache[i].imm << 16); \
+            int width = (16 - clz) - ctz; \
+            if (width <= 8) { \
+                ADD_I(0, arm_reg1, inst_cache[i].imm >> ctz, (32 - ctz) & 31); \
+            } else { \
+                ADD_I(0, arm_reg1, inst_cache[i].imm & 0xff, 0); \
+                ADD_I(0, 0, inst_cache[i].imm >> 8, 24); \
+            } \
+        } else if ((short)inst_cache[i].imm < 0) { \
+            LOAD_REG1(); \
+            int ctz = __builtin_ctz(-inst_cache[i].imm) & ~1; \
+            int clz = __builtin_clz(-inst_cache[i].imm << 16); \
+            int width = (16 - clz) - ctz; \
+            if (width <= 8) { \
+                SUB_I(0, arm_reg1, (-inst_cache[i].imm & 0xffff) >> ctz, (32 - ctz) & 31); \
+            } else { \
+                SUB_I(0, arm_reg1, -inst_cache[i].imm & 0xff, 0); \
+                SUB_I(0, 0, (-inst_cache[i].imm >> 8) & 0xff, 24); \
+            } \
+        }
+
+    // Loads and stores that the front end expects to hit WRAM check the
+    // address (in r0) and access it inline, as it's plain memory with no wait
+    // states. Anything else goes through the mem_* functions as usual.
+    // After WRAM_INLINE_BEGIN, r0 is the offset into WRAM and scratch points
+    // to it.
+    #define WRAM_INLINE_BEGIN(scratch) \
+        wram_miss = wram_done = NULL; \
+        if (inst_cache[i].mem_region == MEM_REGION_WRAM) { \
+            AND_I(scratch, 0, 0x07, 8); \
+            CMP_I(scratch, MEM_REGION_WRAM, 8); \
+            wram_miss = inst_ptr; \
+            Boff(ARM_COND_NE, 0); \
+            LDR_IO(scratch, 11, offsetof(VB_STATE, V810_VB_RAM.pmemory)); \
+            UXTH(0, 0, 0);
+
+    #define WRAM_INLINE_ELSE() \
+            wram_done = inst_ptr; \
+            Boff(ARM_COND_AL, 0); \
+            wram_miss->b_bl.imm = inst_ptr - wram_miss - 2; \
+        }
+
+    #define WRAM_INLINE_END() \
+        if (wram_done) wram_done->b_bl.imm = inst_ptr - wram_done - 2;
+
+    // Drops what the interpreter predecoded from the halfwords a store of
+    // size bytes at WRAM offset r0 overwrote, like wram_written does.
+    // Each predecoded_inst is 8 bytes, so the entry for r0 is at r0 << 2.
+    #define INVALIDATE_WRAM_CODE(size) \
+        LDR_IO(2, 11, offsetof(cpu_state, wram_code)); \
+        MOV_I(1, PREDECODE_INVALID, 0); \
+        BIC_I(0, 0, 1, 0); \
+        ADD_IS(3, 2, 0, ARM_SHIFT_LSL, 2); \
+        STRB_IO(1, 3, offsetof(predecoded_inst, opcode)); \
+        /* a 32-bit instruction starting on the previous halfword */ \
+        SUB_I(0, 0, 2, 0); \
+        UXTH(0, 0, 0); \
+        ADD_IS(3, 2, 0, ARM_SHIFT_LSL, 2); \
+        STRB_IO(1, 3, offsetof(predecoded_inst, opcode)); \
+        if ((size) == 4) { \
+            ADD_I(0, 0, 4, 0); \
+            UXTH(0, 0, 0); \
+            ADD_IS(3, 2, 0, ARM_SHIFT_LSL, 2); \
+            STRB_IO(1, 3, offsetof(predecoded_inst, opcode)); \
+        }
+
     // Third pass: generate ARM instructions
     for (i = 0; i < num_v810_inst; i++) {
 
@@ -896,25 +562,18 @@ static int drc_translateBlock(void) {
         cycles += opcycle[inst_cache[i].opcode];
 
     
-        // Golf hack: this function clears the screen, so we should do the same
-        if (unlikely((is_golf_us && inst_cache[i].PC == 0x0700ca64) ||
-                    (is_golf_jp && inst_cache[i].PC == 0x0701602a))) {
+        // Native code spliced in here (see hle.c)
+        int hook = hle_findHook(inst_cache[i].PC);
+        if (unlikely(hook)) {
+            LDW_I(0, hook);
             LDR_IO(2, 11, offsetof(cpu_state, reloc_table));
-            LDR_IO(2, 2, DRC_RELOC_GOLFHACK*4);
+            LDR_IO(2, 2, DRC_RELOC_HLEHOOK*4);
             BLX(ARM_COND_AL, 2);
-        }
-
-        // In Virtual League Baseball 2's overhead view, the draw order of the
-        // fielders is sorted very inefficiently: each fielder is a 32-byte
-        // object, and every swap in the sort swaps the entire set of 32 bytes.
-        // Replace with code that sorts the same array much more efficiently.
-        if (unlikely(is_baseball_2 && inst_cache[i].PC == 0x07007428)) {
-            LDR_IO(2, 11, offsetof(cpu_state, reloc_table));
-            LDR_IO(2, 2, DRC_RELOC_BALLSORT*4);
-            BLX(ARM_COND_AL, 2);
-            // skip to after sorting code
-            inst_cache[i].branch_offset = 0x070074b8 - 0x07007428;
-            B(ARM_COND_AL, 0);
+            if (hle_entries[hook - 1].resume_PC) {
+                // skip the code it replaces
+                inst_cache[i].branch_offset = hle_entries[hook - 1].resume_PC - inst_cache[i].PC;
+                B(ARM_COND_AL, 0);
+            }
         }
 
         // Waterworld hack: slow down the sample at the start.
@@ -968,7 +627,12 @@ static int drc_translateBlock(void) {
                 LOAD_REG1();
                 STR_IO(arm_reg1, 11, offsetof(cpu_state, PC));
                 ADDCYCLES();
-                POP(1 << 15);
+                if (inst_cache[i].reg1 == 31)
+                    drc_emitReturn(block - block_ptr_start);
+                else if (EXIT_ROOM(1))
+                    drc_emitIndirectExit();
+                else
+                    POP(1 << 15);
                 break;
             case V810_OP_JR: // jr imm26
                 if (abs(inst_cache[i].branch_offset) < 1024) {
@@ -982,40 +646,29 @@ static int drc_translateBlock(void) {
                         }
                         B(ARM_COND_AL, 0);
                     }
+                } else if (inst_cache[i].jump_target == JUMP_TARGET_LOCAL) {
+                    // pulled into the block as part of a superblock
+                    if (inst_cache[i].branch_offset <= 0) {
+                        HANDLEINT(inst_cache[i].PC + inst_cache[i].branch_offset);
+                    } else {
+                        ADDCYCLES();
+                    }
+                    B(ARM_COND_AL, 0);
                 } else {
                     ADDCYCLES();
                     LDW_I(0, inst_cache[i].PC + inst_cache[i].branch_offset);
                     // Save the new PC
                     STR_IO(0, 11, offsetof(cpu_state, PC));
-                    POP(1 << 15);
+                    if (!EXIT_ROOM(1))
+                        POP(1 << 15);
+                    else if (inst_cache[i].jump_target == JUMP_TARGET_NEAR)
+                        drc_emitCountedExit(inst_cache[i].PC);
+                    else
+                        drc_emitExit();
                 }
                 break;
             case V810_OP_JAL: // jal disp26
             {
-                arm_inst *branch_to_tweak = NULL;
-                if (unlikely(is_baseball_2 && inst_cache[i].PC + inst_cache[i].branch_offset == 0x070077ca)) {
-                    // In the overhead view in Virtual League Baseball 2,
-                    // the fielders are scaled in software.
-                    // This algorithm is slow when recompiled, so we override it
-                    // with a faster native implementation.
-
-                    // Verify that our values make sense, otherwise revert to original
-                    LOAD_REG(0, 17);
-                    LOAD_REG(1, 18);
-                    MOV_IS(2, 0, ARM_SHIFT_LSR, 20);
-                    CMP_I(2, 0x70, 0);
-                    Boff(ARM_COND_NE, 9);
-                    MOV_IS(2, 1, ARM_SHIFT_LSR, 16);
-                    CMP_I(2, 0x5, 24);
-                    Boff(ARM_COND_NE, 6);
-                    // Do HLE
-                    LDR_IO(3, 11, offsetof(cpu_state, reloc_table));
-                    LDR_IO(3, 3, DRC_RELOC_BALLSCALE*4);
-                    LOAD_REG(2, 19);
-                    BLX(ARM_COND_AL, 3);
-                    branch_to_tweak = inst_ptr;
-                    Boff(ARM_COND_AL, 0);
-                }
                 if (is_space_invaders && inst_cache[i].PC == 0x07007fb6) {
                     // Make sure the Space Invaders intro FMV runs at the correct speed (ish).
                     // Value determined through trial and error.
@@ -1023,6 +676,24 @@ static int drc_translateBlock(void) {
                     cycles += 24;
                 }
 
+                if (inst_cache[i].jump_target == JUMP_TARGET_LOCAL && i + 1 < num_v810_inst && EXIT_ROOM(1)) {
+                    // Call within the block, as part of a superblock
+                    LDW_I(1, inst_cache[i].PC + 4);
+                    if (phys_regs[31])
+                        MOV(phys_regs[31], 1);
+                    else
+                        STR_IO(1, 11, offsetof(cpu_state, P_REG[31]));
+                    arm_inst *ret_site = drc_emitPushReturn(inst_cache[i].PC + 4);
+                    if (inst_cache[i].branch_offset <= 0) {
+                        HANDLEINT(inst_cache[i].PC + inst_cache[i].branch_offset);
+                    } else {
+                        ADDCYCLES();
+                    }
+                    B(ARM_COND_AL, 0);
+                    local_return = drc_emitLocalReturnSite(ret_site, block - block_ptr_start);
+                    break;
+                }
+
                 LDW_I(0, inst_cache[i].PC + inst_cache[i].branch_offset);
                 LDW_I(1, inst_cache[i].PC + 4);
                 // Save the new PC
@@ -1033,9 +704,16 @@ static int drc_translateBlock(void) {
                 else
                     STR_IO(1, 11, offsetof(cpu_state, P_REG[31]));
                 ADDCYCLES();
-                POP(1 << 15);
-                // fix the skip if needed
-                if (branch_to_tweak) branch_to_tweak->b_bl.imm = inst_ptr - branch_to_tweak - 2;
+                if (EXIT_ROOM(2)) {
+                    arm_inst *ret_site = drc_emitPushReturn(inst_cache[i].PC + 4);
+                    if (inst_cache[i].jump_target == JUMP_TARGET_NEAR)
+                        drc_emitCountedExit(inst_cache[i].PC);
+                    else
+                        drc_emitExit();
+                    drc_emitReturnSite(ret_site);
+                } else {
+                    POP(1 << 15);
+                }
                 break;
             }
             case V810_OP_RETI:
@@ -1576,39 +1254,17 @@ static int drc_translateBlock(void) {
             case V810_OP_LD_B: // ld.b disp16 [reg1], reg2
             case V810_OP_IN_B: // in.b disp16 [reg1], reg2
                 if (arm_reg1 < 4) arm_reg1 = 0;
-                LDR_IO(1, 11, offsetof(cpu_state, reloc_table));
-                LDR_IO(1, 1, DRC_RELOC_RBYTE*4);
-                
-                if (inst_cache[i].imm == 0) {
-                    RELOAD_REG1(0);
-                } else if ((short)inst_cache[i].imm > 0) {
-                    LOAD_REG1();
-                    int ctz = __builtin_ctz(inst_cache[i].imm) & ~1;
-                    int clz = __builtin_clz(inst_cache[i].imm << 16);
-                    int width = (16 - clz) - ctz;
-                    if (width <= 8) {
-                        ADD_I(0, arm_reg1, inst_cache[i].imm >> ctz, (32 - ctz) & 31);
-                    } else {
-                        ADD_I(0, arm_reg1, inst_cache[i].imm & 0xff, 0);
-                        ADD_I(0, 0, inst_cache[i].imm >> 8, 24);
-                    }
-                } else if ((short)inst_cache[i].imm < 0) {
-                    LOAD_REG1();
-                    int ctz = __builtin_ctz(-inst_cache[i].imm) & ~1;
-                    int clz = __builtin_clz(-inst_cache[i].imm << 16);
-                    int width = (16 - clz) - ctz;
-                    if (width <= 8) {
-                        SUB_I(0, arm_reg1, (-inst_cache[i].imm & 0xffff) >> ctz, (32 - ctz) & 31);
-                    } else {
-                        SUB_I(0, arm_reg1, -inst_cache[i].imm & 0xff, 0);
-                        SUB_I(0, 0, (-inst_cache[i].imm >> 8) & 0xff, 24);
-                    }
-                }
-
-                BLX(ARM_COND_AL, 1);
+                LOAD_ADDR();
 
-                // Add cycles returned in r1.
-                if (!is_pinball) ADD(10, 10, 1);
+                WRAM_INLINE_BEGIN(1);
+                    LDRSB_R(0, 1, 0);
+                WRAM_INLINE_ELSE();
+                    LDR_IO(1, 11, offsetof(cpu_state, reloc_table));
+                    LDR_IO(1, 1, DRC_RELOC_RBYTE*4);
+                    BLX(ARM_COND_AL, 1);
+                    // Add cycles returned in r1.
+                    if (!is_pinball) ADD(10, 10, 1);
+                WRAM_INLINE_END();
 
                 if (slow_memory) cycles += 2;
 
@@ -1631,39 +1287,18 @@ static int drc_translateBlock(void) {
             case V810_OP_LD_H: // ld.h disp16 [reg1], reg2
             case V810_OP_IN_H: // in.h disp16 [reg1], reg2
                 if (arm_reg1 < 4) arm_reg1 = 0;
-                LDR_IO(1, 11, offsetof(cpu_state, reloc_table));
-                LDR_IO(1, 1, DRC_RELOC_RHWORD*4);
+                LOAD_ADDR();
 
-                if (inst_cache[i].imm == 0) {
-                    RELOAD_REG1(0);
-                } else if ((short)inst_cache[i].imm > 0) {
-                    LOAD_REG1();
-                    int ctz = __builtin_ctz(inst_cache[i].imm) & ~1;
-                    int clz = __builtin_clz(inst_cache[i].imm << 16);
-                    int width = (16 - clz) - ctz;
-                    if (width <= 8) {
-                        ADD_I(0, arm_reg1, inst_cache[i].imm >> ctz, (32 - ctz) & 31);
-                    } else {
-                        ADD_I(0, arm_reg1, inst_cache[i].imm & 0xff, 0);
-                        ADD_I(0, 0, inst_cache[i].imm >> 8, 24);
-                    }
-                } else if ((short)inst_cache[i].imm < 0) {
-                    LOAD_REG1();
-                    int ctz = __builtin_ctz(-inst_cache[i].imm) & ~1;
-                    int clz = __builtin_clz(-inst_cache[i].imm << 16);
-                    int width = (16 - clz) - ctz;
-                    if (width <= 8) {
-                        SUB_I(0, arm_reg1, (-inst_cache[i].imm & 0xffff) >> ctz, (32 - ctz) & 31);
-                    } else {
-                        SUB_I(0, arm_reg1, -inst_cache[i].imm & 0xff, 0);
-                        SUB_I(0, 0, (-inst_cache[i].imm >> 8) & 0xff, 24);
-                    }
-                }
-
-                BLX(ARM_COND_AL, 1);
-
-                // Add cycles returned in r1.
-                if (!is_pinball) ADD(10, 10, 1);
+                WRAM_INLINE_BEGIN(1);
+                    BIC_I(0, 0, 1, 0);
+                    LDRSH_R(0, 1, 0);
+                WRAM_INLINE_ELSE();
+                    LDR_IO(1, 11, offsetof(cpu_state, reloc_table));
+                    LDR_IO(1, 1, DRC_RELOC_RHWORD*4);
+                    BLX(ARM_COND_AL, 1);
+                    // Add cycles returned in r1.
+                    if (!is_pinball) ADD(10, 10, 1);
+                WRAM_INLINE_END();
 
                 if (slow_memory) cycles += 2;
 
@@ -1686,39 +1321,18 @@ static int drc_translateBlock(void) {
             case V810_OP_LD_W: // ld.w disp16 [reg1], reg2
             case V810_OP_IN_W: // in.w disp16 [reg1], reg2
                 if (arm_reg1 < 4) arm_reg1 = 0;
-                LDR_IO(1, 11, offsetof(cpu_state, reloc_table));
-                LDR_IO(1, 1, DRC_RELOC_RWORD*4);
-
-                if (inst_cache[i].imm == 0) {
-                    RELOAD_REG1(0);
-                } else if ((short)inst_cache[i].imm > 0) {
-                    LOAD_REG1();
-                    int ctz = __builtin_ctz(inst_cache[i].imm) & ~1;
-                    int clz = __builtin_clz(inst_cache[i].imm << 16);
-                    int width = (16 - clz) - ctz;
-                    if (width <= 8) {
-                        ADD_I(0, arm_reg1, inst_cache[i].imm >> ctz, (32 - ctz) & 31);
-                    } else {
-                        ADD_I(0, arm_reg1, inst_cache[i].imm & 0xff, 0);
-                        ADD_I(0, 0, inst_cache[i].imm >> 8, 24);
-                    }
-                } else if ((short)inst_cache[i].imm < 0) {
-                    LOAD_REG1();
-                    int ctz = __builtin_ctz(-inst_cache[i].imm) & ~1;
-                    int clz = __builtin_clz(-inst_cache[i].imm << 16);
-                    int width = (16 - clz) - ctz;
-                    if (width <= 8) {
-                        SUB_I(0, arm_reg1, (-inst_cache[i].imm & 0xffff) >> ctz, (32 - ctz) & 31);
-                    } else {
-                        SUB_I(0, arm_reg1, -inst_cache[i].imm & 0xff, 0);
-                        SUB_I(0, 0, (-inst_cache[i].imm >> 8) & 0xff, 24);
-                    }
-                }
+                LOAD_ADDR();
 
-                BLX(ARM_COND_AL, 1);
-
-                // Add cycles returned in r1.
-                if (!is_pinball) ADD(10, 10, 1);
+                WRAM_INLINE_BEGIN(1);
+                    BIC_I(0, 0, 3, 0);
+                    LDR_R(0, 1, 0);
+                WRAM_INLINE_ELSE();
+                    LDR_IO(1, 11, offsetof(cpu_state, reloc_table));
+                    LDR_IO(1, 1, DRC_RELOC_RWORD*4);
+                    BLX(ARM_COND_AL, 1);
+                    // Add cycles returned in r1.
+                    if (!is_pinball) ADD(10, 10, 1);
+                WRAM_INLINE_END();
 
                 SAVE_REG2(0);
 
@@ -1736,41 +1350,23 @@ static int drc_translateBlock(void) {
             case V810_OP_ST_B:  // st.h reg2, disp16 [reg1]
             case V810_OP_OUT_B: // out.h reg2, disp16 [reg1]
                 if (arm_reg1 < 4) arm_reg1 = 0;
-                LDR_IO(2, 11, offsetof(cpu_state, reloc_table));
-                LDR_IO(2, 2, DRC_RELOC_WBYTE*4);
-
-                if (inst_cache[i].imm == 0) {
-                    RELOAD_REG1(0);
-                } else if ((short)inst_cache[i].imm > 0) {
-                    LOAD_REG1();
-                    int ctz = __builtin_ctz(inst_cache[i].imm) & ~1;
-                    int clz = __builtin_clz(inst_cache[i].imm << 16);
-                    int width = (16 - clz) - ctz;
-                    if (width <= 8) {
-                        ADD_I(0, arm_reg1, inst_cache[i].imm >> ctz, (32 - ctz) & 31);
-                    } else {
-                        ADD_I(0, arm_reg1, inst_cache[i].imm & 0xff, 0);
-                        ADD_I(0, 0, inst_cache[i].imm >> 8, 24);
-                    }
-                } else if ((short)inst_cache[i].imm < 0) {
-                    LOAD_REG1();
-                    int ctz = __builtin_ctz(-inst_cache[i].imm) & ~1;
-                    int clz = __builtin_clz(-inst_cache[i].imm << 16);
-                    int width = (16 - clz) - ctz;
-                    if (width <= 8) {
-                        SUB_I(0, arm_reg1, (-inst_cache[i].imm & 0xffff) >> ctz, (32 - ctz) & 31);
-                    } else {
-                        SUB_I(0, arm_reg1, -inst_cache[i].imm & 0xff, 0);
-                        SUB_I(0, 0, (-inst_cache[i].imm >> 8) & 0xff, 24);
-                    }
-                }
+                LOAD_ADDR();
 
                 if (inst_cache[i].reg2 == 0)
                     MOV_I(1, 0, 0);
                 else
                     RELOAD_REG2(1);
 
-                BLX(ARM_COND_AL, 2);
+                WRAM_INLINE_BEGIN(2);
+                    STRB_R(1, 2, 0);
+                    INVALIDATE_WRAM_CODE(2);
+                WRAM_INLINE_ELSE();
+                    LDR_IO(2, 11, offsetof(cpu_state, reloc_table));
+                    LDR_IO(2, 2, DRC_RELOC_WBYTE*4);
+                    BLX(ARM_COND_AL, 2);
+                    // Add cycles returned in r0.
+                    if (!is_pinball) ADD(10, 10, 0);
+                WRAM_INLINE_END();
 
                 if (slow_memory) cycles += 2;
 
@@ -1778,48 +1374,28 @@ static int drc_translateBlock(void) {
                     // with two consecutive stores, the second takes 2 cycles instead of 1
                     cycles += 1;
                 }
-
-                // Add cycles returned in r0.
-                if (!is_pinball) ADD(10, 10, 0);
                 break;
             case V810_OP_ST_H:  // st.h reg2, disp16 [reg1]
             case V810_OP_OUT_H: // out.h reg2, disp16 [reg1]
                 if (arm_reg1 < 4) arm_reg1 = 0;
-                LDR_IO(2, 11, offsetof(cpu_state, reloc_table));
-                LDR_IO(2, 2, DRC_RELOC_WHWORD*4);
-
-                if (inst_cache[i].imm == 0) {
-                    RELOAD_REG1(0);
-                } else if ((short)inst_cache[i].imm > 0) {
-                    LOAD_REG1();
-                    int ctz = __builtin_ctz(inst_cache[i].imm) & ~1;
-                    int clz = __builtin_clz(inst_cache[i].imm << 16);
-                    int width = (16 - clz) - ctz;
-                    if (width <= 8) {
-                        ADD_I(0, arm_reg1, inst_cache[i].imm >> ctz, (32 - ctz) & 31);
-                    } else {
-                        ADD_I(0, arm_reg1, inst_cache[i].imm & 0xff, 0);
-                        ADD_I(0, 0, inst_cache[i].imm >> 8, 24);
-                    }
-                } else if ((short)inst_cache[i].imm < 0) {
-                    LOAD_REG1();
-                    int ctz = __builtin_ctz(-inst_cache[i].imm) & ~1;
-                    int clz = __builtin_clz(-inst_cache[i].imm << 16);
-                    int width = (16 - clz) - ctz;
-                    if (width <= 8) {
-                        SUB_I(0, arm_reg1, (-inst_cache[i].imm & 0xffff) >> ctz, (32 - ctz) & 31);
-                    } else {
-                        SUB_I(0, arm_reg1, -inst_cache[i].imm & 0xff, 0);
-                        SUB_I(0, 0, (-inst_cache[i].imm >> 8) & 0xff, 24);
-                    }
-                }
+                LOAD_ADDR();
 
                 if (inst_cache[i].reg2 == 0)
                     MOV_I(1, 0, 0);
                 else
                     RELOAD_REG2(1);
 
-                BLX(ARM_COND_AL, 2);
+                WRAM_INLINE_BEGIN(2);
+                    BIC_I(0, 0, 1, 0);
+                    STRH_R(1, 2, 0);
+                    INVALIDATE_WRAM_CODE(2);
+                WRAM_INLINE_ELSE();
+                    LDR_IO(2, 11, offsetof(cpu_state, reloc_table));
+                    LDR_IO(2, 2, DRC_RELOC_WHWORD*4);
+                    BLX(ARM_COND_AL, 2);
+                    // Add cycles returned in r0.
+                    if (!is_pinball) ADD(10, 10, 0);
+                WRAM_INLINE_END();
 
                 if (slow_memory) cycles += 2;
 
@@ -1827,48 +1403,28 @@ static int drc_translateBlock(void) {
                     // with two consecutive stores, the second takes 2 cycles instead of 1
                     cycles += 1;
                 }
-
-                // Add cycles returned in r0.
-                if (!is_pinball) ADD(10, 10, 0);
                 break;
             case V810_OP_ST_W:  // st.h reg2, disp16 [reg1]
             case V810_OP_OUT_W: // out.h reg2, disp16 [reg1]
                 if (arm_reg1 < 4) arm_reg1 = 0;
-                LDR_IO(2, 11, offsetof(cpu_state, reloc_table));
-                LDR_IO(2, 2, DRC_RELOC_WWORD*4);
-
-                if (inst_cache[i].imm == 0) {
-                    RELOAD_REG1(0);
-                } else if ((short)inst_cache[i].imm > 0) {
-                    LOAD_REG1();
-                    int ctz = __builtin_ctz(inst_cache[i].imm) & ~1;
-                    int clz = __builtin_clz(inst_cache[i].imm << 16);
-                    int width = (16 - clz) - ctz;
-                    if (width <= 8) {
-                        ADD_I(0, arm_reg1, inst_cache[i].imm >> ctz, (32 - ctz) & 31);
-                    } else {
-                        ADD_I(0, arm_reg1, inst_cache[i].imm & 0xff, 0);
-                        ADD_I(0, 0, inst_cache[i].imm >> 8, 24);
-                    }
-                } else if ((short)inst_cache[i].imm < 0) {
-                    LOAD_REG1();
-                    int ctz = __builtin_ctz(-inst_cache[i].imm) & ~1;
-                    int clz = __builtin_clz(-inst_cache[i].imm << 16);
-                    int width = (16 - clz) - ctz;
-                    if (width <= 8) {
-                        SUB_I(0, arm_reg1, (-inst_cache[i].imm & 0xffff) >> ctz, (32 - ctz) & 31);
-                    } else {
-                        SUB_I(0, arm_reg1, -inst_cache[i].imm & 0xff, 0);
-                        SUB_I(0, 0, (-inst_cache[i].imm >> 8) & 0xff, 24);
-                    }
-                }
+                LOAD_ADDR();
 
                 if (inst_cache[i].reg2 == 0)
                     MOV_I(1, 0, 0);
                 else
                     RELOAD_REG2(1);
 
-                BLX(ARM_COND_AL, 2);
+                WRAM_INLINE_BEGIN(2);
+                    BIC_I(0, 0, 3, 0);
+                    STR_R(1, 2, 0);
+                    INVALIDATE_WRAM_CODE(4);
+                WRAM_INLINE_ELSE();
+                    LDR_IO(2, 11, offsetof(cpu_state, reloc_table));
+                    LDR_IO(2, 2, DRC_RELOC_WWORD*4);
+                    BLX(ARM_COND_AL, 2);
+                    // Add cycles returned in r0.
+                    if (!is_pinball) ADD(10, 10, 0);
+                WRAM_INLINE_END();
 
                 if (slow_memory) cycles += 4;
 
@@ -1877,11 +1433,9 @@ static int drc_translateBlock(void) {
                     cycles += 3;
                 }
 
-                // Add cycles returned in r0.
-                if (!is_pinball) ADD(10, 10, 0);
-
                 // if we load the same thing immediately after saving it, skip the loading
                 if (i + 1 < num_v810_inst &&
+                    !inst_cache[i].fallthrough_PC && !inst_cache[i + 1].fallthrough_PC &&
                     (inst_cache[i + 1].opcode == V810_OP_LD_W || inst_cache[i + 1].opcode == V810_OP_IN_W) &&
                     inst_cache[i + 1].imm == inst_cache[i].imm && inst_cache[i + 1].reg1 == inst_cache[i].reg1 &&
                     inst_cache[i + 1].reg2 == inst_cache[i].reg2
@@ -1978,7 +1532,13 @@ static int drc_translateBlock(void) {
                 reg2_modified = true;
                 break;
             case V810_OP_HALT: // halt
-                HALT(inst_cache[i].PC);
+                // leave the block and let v810_run idle
+                ADDCYCLES();
+                LDW_I(0, inst_cache[i].PC);
+                STR_IO(0, 11, offsetof(cpu_state, PC));
+                MOV_I(0, 1, 0);
+                STR_IO(0, 11, offsetof(cpu_state, halted));
+                POP(1 << 15);
                 break;
             case V810_OP_BSTR:
                 MOV_I(2, 31, 0);
@@ -2027,7 +1587,19 @@ static int drc_translateBlock(void) {
                 // call the function
                 PUSH(1<<5);
                 LDR_IO(5, 11, offsetof(cpu_state, reloc_table));
-                LDR_IO(5, 5, (DRC_RELOC_BSTR+inst_cache[i].imm)*4);
+                if (inst_cache[i].imm >= 8) {
+                    // whole words at offset 0 take the word-aligned path,
+                    // which gets the operation where the offsets were
+                    // movs r12, r3, lsl #22
+                    MOVS_IS(12, 3, ARM_SHIFT_LSL, 22);
+                    // tsteq r2, #31
+                    new_data_proc_imm(ARM_COND_EQ, ARM_OP_TST, 1, 2, 0, 0, 31);
+                    ORRCC_I(ARM_COND_EQ, 3, inst_cache[i].imm & 7, 0);
+                    new_ldst_imm_off(ARM_COND_EQ, 1, 1, 0, 0, 1, 5, 5, DRC_RELOC_BSTRWORDS*4);
+                    new_ldst_imm_off(ARM_COND_NE, 1, 1, 0, 0, 1, 5, 5, (DRC_RELOC_BSTR+inst_cache[i].imm)*4);
+                } else {
+                    LDR_IO(5, 5, (DRC_RELOC_BSTR+inst_cache[i].imm)*4);
+                }
                 BLX(ARM_COND_AL, 5);
                 POP(1<<5);
 
@@ -2067,9 +1639,20 @@ static int drc_translateBlock(void) {
                     reg2_modified = true;
                     break;
                 case V810_OP_CVT_SW:
+                    // round halves away from zero like round() in the
+                    // interpreter: add 0.5 with the same sign, then truncate
+                    // (done in double, where the sum is exact)
                     LOAD_REG1();
                     VMOV_SR(0, arm_reg1);
-                    VCVT_S32_F32(0, 0);
+                    VCVT_F64_F32(1, 0);
+                    AND_I(0, arm_reg1, 2, 2);
+                    ORR_I(0, 0, 0x3f, 8);
+                    ORR_I(0, 0, 0x0e, 12);
+                    MOV_I(1, 0, 0);
+                    VMOV_SR(4, 1);
+                    VMOV_SR(5, 0);
+                    VADD_F64(1, 1, 2);
+                    TRUNC_F64(0, 1);
                     VMOV_RS(arm_reg2, 0);
                     ORRS(arm_reg2, arm_reg2, arm_reg2);
                     reg2_modified = true;
@@ -2135,10 +1718,8 @@ static int drc_translateBlock(void) {
                 case V810_OP_XB:
                     cycles += 6;
                     LOAD_REG2();
-                    REV(0, arm_reg2);
-                    MOV_IS(arm_reg2, arm_reg2, ARM_SHIFT_LSR, 16);
-                    MOV_IS(arm_reg2, arm_reg2, ARM_SHIFT_LSL, 16);
-                    ORR_IS(arm_reg2, arm_reg2, 0, ARM_SHIFT_LSR, 16);
+                    REV16(0, arm_reg2);
+                    PKHBT(arm_reg2, 0, arm_reg2, 0);
                     reg2_modified = true;
                     break;
                 case V810_OP_XH:
@@ -2149,12 +1730,25 @@ static int drc_translateBlock(void) {
                     break;
                 case V810_OP_REV:
                     cycles += 22;
-                    // RBIT would be great here, but that's only in ARMv6T2, so we'll do it manually.
-                    LDR_IO(1, 11, offsetof(cpu_state, reloc_table));
-                    LDR_IO(1, 1, DRC_RELOC_REV*4);
-                    RELOAD_REG1(0);
-                    BLX(ARM_COND_AL, 1);
-                    MOV(arm_reg2, 0);
+                    LOAD_REG1();
+#if __ARM_ARCH >= 7
+                    RBIT(arm_reg2, arm_reg1);
+#else
+                    // no RBIT before ARMv6T2, so reverse the bytes and then
+                    // swap nibbles, bit pairs and bits within them
+                    REV(arm_reg2, arm_reg1);
+                    MOV_I(1, 0x0f, 0);
+                    ORR_IS(1, 1, 1, ARM_SHIFT_LSL, 8);
+                    ORR_IS(1, 1, 1, ARM_SHIFT_LSL, 16);
+                    for (int shift = 4; shift; shift >>= 1) {
+                        if (shift != 4)
+                            EOR_IS(1, 1, 1, ARM_SHIFT_LSL, shift); // 0x33333333, 0x55555555
+                        EOR_IS(0, arm_reg2, arm_reg2, ARM_SHIFT_LSR, shift);
+                        AND(0, 0, 1);
+                        EOR(arm_reg2, arm_reg2, 0);
+                        EOR_IS(arm_reg2, arm_reg2, 0, ARM_SHIFT_LSL, shift);
+                    }
+#endif
                     reg2_modified = true;
                     break;
                 case V810_OP_TRNC_SW:
@@ -2193,6 +1787,12 @@ static int drc_translateBlock(void) {
                 break;
         }
 
+        // a jal within the block returns here
+        if (local_return) {
+            local_return->b_bl.imm = inst_ptr - local_return - 2;
+            local_return = NULL;
+        }
+
         if (inst_cache[i].save_flags) {
             POP(1<<0);
             MSR(0);
@@ -2205,7 +1805,16 @@ static int drc_translateBlock(void) {
                 STR_IO(arm_reg2, 11, offsetof(cpu_state, P_REG[inst_cache[i].reg2]));
         }
 
-        if (i + 1 < num_v810_inst) {
+        if (inst_cache[i].fallthrough_PC) {
+            // the next instruction is in another block (see drc_splitLoops)
+            ADDCYCLES();
+            LDW_I(0, inst_cache[i].fallthrough_PC);
+            STR_IO(0, 11, offsetof(cpu_state, PC));
+            if (!EXIT_ROOM(1))
+                POP(1 << 15);
+            else
+                drc_emitExit();
+        } else if (i + 1 < num_v810_inst) {
             if (is_virtual_lab && inst_cache[i + 1].PC == 0x07002446) {
                 // virtual lab hack
                 // interrupts don't save registers, and clearing levels relies on
@@ -2270,6 +1879,8 @@ static int drc_translateBlock(void) {
     // Fourth pass: align to new memory block
     WORD *cache_ptr = drc_alloc(num_arm_inst);
     if (cache_ptr == NULL) {
+        // hand the block back, drc_run will make room and try again
+        block->free = true;
         err = DRC_ERR_CACHE_FULL;
         goto cleanup;
     }
@@ -2306,6 +1917,11 @@ static int drc_translateBlock(void) {
             drc_assemble(cache_ptr + j, &trans_cache[j]);
         }
     }
+    for (i = 0; i < num_exits; i++) {
+        cache_ptr[exit_sites[i].pos] = ((block - block_ptr_start) << 2) | exit_sites[i].kind;
+        if (exit_sites[i].kind == EXIT_COUNTED)
+            cache_ptr[exit_sites[i].pos + 1] = HOT_JUMP_COUNT;
+    }
 
     block->size = num_arm_inst + pool_offset;
 
@@ -2316,229 +1932,11 @@ cleanup:
     return err;
 }
 
-// Clear and invalidate the dynarec cache
-void drc_clearCache(void) {
-    dprintf(0, "[DRC]: clearing cache...\n");
-    cache_pos = cache_start + 1;
-    block_pos = 1;
-    free_block_count = 0;
-
-    memset(cache_start, 0, CACHE_SIZE);
-    memset(rom_block_map, 0, sizeof(rom_block_map[0])*BLOCK_MAP_COUNT);
-    memset(rom_entry_map, 0, sizeof(rom_entry_map[0])*BLOCK_MAP_COUNT);
-
-    *cache_start = -1;
-}
-
-// Returns the entrypoint for the V810 instruction in location loc if it exists
-// and NULL if it needs to be translated. If p_block != NULL it will point to
-// the block structure.
-static WORD* drc_getEntry(WORD loc, exec_block **p_block) {
-    unsigned int map_pos;
-    exec_block *block;
-
-    map_pos = ((loc&V810_ROM1.highaddr)>>1)&(BLOCK_MAP_COUNT-1);
-    block = block_ptr_start + rom_block_map[map_pos];
-    if (block == block_ptr_start || block->free) return cache_start;
-    if (p_block)
-        *p_block = block;
-    return block->phys_offset + rom_entry_map[map_pos];
-}
-
-// Sets a new entrypoint for the V810 instruction in location loc and the
-// corresponding block
-void drc_setEntry(WORD loc, WORD *entry, exec_block *block) {
-    unsigned int map_pos = ((loc&V810_ROM1.highaddr)>>1)&(BLOCK_MAP_COUNT-1);
-    rom_block_map[map_pos] = block - block_ptr_start;
-    rom_entry_map[map_pos] = entry - block->phys_offset;
-}
-
-// Initialize the dynarec
-void drc_init(void) {
-    // V810 instructions are 16-bit aligned, so we can ignore the last bit of the PC
-    rom_block_map = calloc(sizeof(rom_block_map[0]), BLOCK_MAP_COUNT);
-    rom_entry_map = linearAlloc(sizeof(rom_entry_map[0]) * BLOCK_MAP_COUNT);
-    rom_data_code_map = calloc(sizeof(rom_data_code_map[0]), BLOCK_MAP_COUNT >> 3);
-    block_ptr_start = linearAlloc(MAX_NUM_BLOCKS*sizeof(exec_block));
-
-    inst_cache = linearAlloc(MAX_V810_INST*sizeof(v810_instruction));
+// Allocate the ARM-specific translation buffers
+void drc_backendInit(void) {
     trans_cache = linearAlloc(MAX_ARM_INST*sizeof(arm_inst));
-
-    hbHaxInit();
-
-    cache_start = linearMemAlign(CACHE_SIZE, 0x1000);
-    ReprotectMemory(cache_start, CACHE_SIZE/0x1000, 0x7);
-    detectCitra(cache_start);
-
-    *cache_start = -1;
-    cache_pos = cache_start + 1;
-    dprintf(0, "[DRC]: cache_start = %p\n", cache_start);
-}
-
-void drc_reset(void) {
-    memset(rom_data_code_map, 0, sizeof(rom_data_code_map[0])*(BLOCK_MAP_COUNT >> 3));
-    memset(baseball2_sprites_is_unpacked, 0, sizeof(baseball2_sprites_is_unpacked));
-    drc_clearCache();
 }
 
-// Cleanup and exit
-void drc_exit(void) {
-    linearFree(cache_start);
-    free(rom_block_map);
-    linearFree(rom_entry_map);
-    free(rom_data_code_map);
-    linearFree(block_ptr_start);
+void drc_backendExit(void) {
     linearFree(trans_cache);
-    linearFree(inst_cache);
-    hbHaxExit();
-}
-
-exec_block* drc_getNextBlockStruct(void) {
-    if (block_pos >= MAX_NUM_BLOCKS) {
-        for (int i = 0; i < MAX_NUM_BLOCKS; i++) {
-            if (block_ptr_start[i].free) {
-                return &block_ptr_start[i];
-            }
-        }
-        return NULL;
-    }
-    return &block_ptr_start[block_pos++];
-}
-
-// Run V810 code until the next frame interrupt
-int drc_run(void) {
-    exec_block* cur_block = NULL;
-    WORD* entrypoint;
-    WORD entry_PC;
-
-    vb_state->v810_state.PC &= V810_ROM1.highaddr;
-
-    // set up arm flags
-    {
-        WORD psw = vb_state->v810_state.S_REG[PSW];
-        WORD cpsr;
-        asm volatile ("mrs %0, CPSR" : "=r" (cpsr));
-        cpsr &= 0x0fffffff;
-        cpsr |= (psw & 0x3) << 30;
-        cpsr |= (psw & 0xc) << 26;
-        vb_state->v810_state.flags = cpsr;
-    }
-
-    serviceInt(vb_state->v810_state.cycles, vb_state->v810_state.PC);
-
-    while (true) {
-        // extra interrupt check in case we're jumping functions without looping
-        if (unlikely(vb_state->v810_state.cycles_until_event_partial <= 0)) {
-            serviceInt(vb_state->v810_state.cycles, vb_state->v810_state.PC);
-            if (unlikely(vb_state->v810_state.ret)) break;
-        }
-
-        entry_PC = vb_state->v810_state.PC;
-
-        // Try to find a cached block
-        entrypoint = drc_getEntry(vb_state->v810_state.PC, &cur_block);
-        // entry_PC < cur_block->start_pc || entry_PC > cur_block->end_pc
-        if (unlikely(entrypoint == cache_start || entry_PC - cur_block->start_pc > cur_block->pc_range)) {
-            int result = drc_translateBlock();
-            if (unlikely(result == DRC_ERR_CACHE_FULL || result == DRC_ERR_NO_BLOCKS)) {
-                drc_clearCache();
-                continue;
-            } else if (unlikely(result)) {
-                return result;
-            }
-
-//            drc_dumpCache("cache_dump_rf.bin");
-
-            entrypoint = drc_getEntry(entry_PC, &cur_block);
-            dprintf(3, "[DRC]: ARM block size - %ld\n", cur_block->size);
-
-            FlushInvalidateCache(cur_block->phys_offset, cur_block->size * 4);
-        }
-        dprintf(3, "[DRC]: entry - 0x%lx (0x%x)\n", entry_PC, (int)(entrypoint - cache_start)*4);
-        // entrypoint <= cache_start || entrypoint >= cache_start + CACHE_SIZE
-        if (unlikely(entrypoint - (cache_start + 1) >= CACHE_SIZE - 1)) {
-            dprintf(0, "Bad entry %p\n", drc_getEntry(entry_PC, NULL));
-            return DRC_ERR_BAD_ENTRY;
-        }
-
-        drc_executeBlock(entrypoint, cur_block);
-
-        vb_state->v810_state.PC &= V810_ROM1.highaddr;
-
-        dprintf(4, "[DRC]: end - 0x%lx\n", vb_state->v810_state.PC);
-        if (unlikely(vb_state->v810_state.PC - V810_ROM1.lowaddr >= V810_ROM1.size)) {
-            dprintf(0, "Last entry: 0x%lx\n", entry_PC);
-            //return DRC_ERR_BAD_PC;
-            break;
-        }
-
-        if (unlikely(vb_state->v810_state.ret)) {
-            break;
-        }
-    }
-
-    // sync arm flags to PSW
-    {
-        WORD cpsr = vb_state->v810_state.flags;
-        WORD psw = vb_state->v810_state.S_REG[PSW];
-        psw &= ~0xf;
-        psw |= cpsr >> 30;
-        psw |= (cpsr >> 26) & 0xc;
-        vb_state->v810_state.S_REG[PSW] = psw;
-    }
-
-    return 0;
-}
-
-void drc_loadSavedCache(void) {
-    FILE* f;
-    f = fopen("rom_block_map", "r");
-    fread(rom_block_map, sizeof(rom_block_map[0]), BLOCK_MAP_COUNT, f);
-    fclose(f);
-    f = fopen("rom_entry_map", "r");
-    fread(rom_entry_map, sizeof(rom_entry_map[0]), BLOCK_MAP_COUNT, f);
-    fclose(f);
-    f = fopen("block_heap", "r");
-    fread(block_ptr_start, sizeof(exec_block*), MAX_NUM_BLOCKS, f);
-    fclose(f);
-}
-
-// Dumps the translation cache onto a file
-void drc_dumpCache(char* filename) {
-    FILE* f = fopen(filename, "w");
-    fwrite(cache_start, CACHE_SIZE, 1, f);
-    fclose(f);
-
-    f = fopen("rom_block_map", "w");
-    fwrite(rom_block_map, sizeof(rom_block_map[0]), BLOCK_MAP_COUNT, f);
-    fclose(f);
-    f = fopen("rom_entry_map", "w");
-    fwrite(rom_entry_map, sizeof(rom_entry_map[0]), BLOCK_MAP_COUNT, f);
-    fclose(f);
-    f = fopen("block_heap", "w");
-    fwrite(block_ptr_start, sizeof(exec_block*), MAX_NUM_BLOCKS, f);
-    fclose(f);
-}
-
-void drc_dumpDebugInfo(int code) {
-    int i;
-    FILE* f = fopen("debug_info.txt", "w");
-
-    fprintf(f, "Error code: %d\n", code);
-    fprintf(f, "PC: 0x%08" PRIx32 "\n", vb_state->v810_state.PC);
-    for (i = 0; i < 32; i++)
-        fprintf(f, "r%d: 0x%08" PRIx32 "\n", i, vb_state->v810_state.P_REG[i]);
-
-    for (i = 0; i < 32; i++)
-        fprintf(f, "s%d: 0x%08" PRIx32 "\n", i, vb_state->v810_state.S_REG[i]);
-
-    fprintf(f, "Cycles: %" PRIu32 "\n", vb_state->v810_state.cycles);
-    fprintf(f, "Cache start: %p\n", cache_start);
-    fprintf(f, "Cache pos: %p\n", cache_pos);
-
-    fprintf(f, "VIP overclock: %d\n", tVBOpt.VIP_OVERCLOCK);
-
-    replay_save("debug_replay.bin.gz");
-
-    fclose(f);
 }
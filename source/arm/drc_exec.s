@@ -125,6 +125,26 @@ postexec:
     str     r0, [r11, #state_cycles]
     pop     {r4-r11, ip, pc}
 
+@ void drc_chainBlock(exec_block* block, WORD* entrypoint);
+@ Jumped to from a linked exit to enter a block that caches different
+@ registers. The flags and r10 carry over.
+
+.globl drc_chainBlock
+.type drc_chainBlock, %function
+drc_chainBlock:
+    mov     lr, r1
+
+    @ Swap the block postexec will see
+    mov     r1, r0
+    ldr     r0, [sp, #4]
+    str     r1, [sp, #4]
+
+    push    {r1, lr}
+    stRegs
+    pop     {r1, lr}
+    ldRegs
+    bx      lr
+
 @ Checks for pending interrupts and exits the block if necessary
 .globl drc_handleInterrupts
 .type drc_executeBlock, %function
@@ -1,7 +1,7 @@
 .arm
 .align 4
 
-.extern __divsi3, __modsi3, __udivsi3, __umodsi3, mem_rbyte, mem_rhword, mem_rword, mem_wbyte, mem_whword, mem_wword, ins_err, ins_rev, drc_clearScreenForGolf, baseball2_scaling
+.extern __divsi3, __modsi3, __udivsi3, __umodsi3, mem_rbyte, mem_rhword, mem_rword, mem_wbyte, mem_whword, mem_wword, ins_err, ins_rev, hle_runHook, drc_chainBlock, ret_stack, ins_bstrWords
 
 .text
 @ A cheap relocation table
@@ -32,6 +32,7 @@ drc_relocTable:
 .word       ins_xornbsu
 .word       ins_notbsu
 .word       ins_rev
-.word       drc_clearScreenForGolf
-.word       baseball2_scaling
-.word       baseball2_sort
+.word       hle_runHook
+.word       drc_chainBlock
+.word       ret_stack
+.word       ins_bstrWords
@@ -0,0 +1,1099 @@
+/*
+ * V810 dynamic recompiler for AArch64
+ *
+ * This file is distributed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "utils.h"
+#include "drc_alloc.h"
+#include "drc_core.h"
+#include "busywait.h"
+#include "hle.h"
+#include "v810_cpu.h"
+#include "v810_mem.h"
+#include "v810_opt.h"
+#include "vb_set.h"
+#include "vb_types.h"
+
+#include "arm64_emit.h"
+
+#define A64_NOREG 0xFF
+
+static WORD *trans_cache;
+WORD *a64_ptr;
+
+// Maps V810 registers to host registers (A64_NOREG if not cached)
+static BYTE phys_regs[32];
+
+// A branch to a V810 address, resolved once the block has been placed.
+// Conditional ones take two words: a branch over the next one when the
+// condition is false, and an unconditional branch.
+typedef struct {
+    unsigned int pos;
+    int cc;
+    WORD v810_dest;
+} a64_fixup;
+
+static a64_fixup fixups[MAX_V810_INST * 2];
+static unsigned int num_fixups;
+
+// Maps the most used registers in the block to V810 registers
+static void drc_mapRegs(exec_block* block) {
+    int i, j, max, max_pos;
+
+    block->reg_map = 0;
+
+    for (i = 0; i < A64_NUM_CACHE_REGS; i++) {
+        max = max_pos = 0;
+        // P_REG[0] is always 0, so it's never worth caching
+        for (j = 1; j < 32; j++) {
+            if (reg_usage[j] > max) {
+                max_pos = j;
+                max = reg_usage[j];
+            }
+        }
+        if (max) {
+            block->reg_map |= (uint64_t)max_pos << (5 * i);
+            reg_usage[max_pos] = 0;
+        }
+    }
+}
+
+// Gets the host register corresponding to a cached V810 register
+static BYTE drc_getPhysReg(BYTE vb_reg, uint64_t reg_map) {
+    int i;
+    for (i = 0; i < A64_NUM_CACHE_REGS; i++) {
+        if (((reg_map >> (i * 5)) & 0x1f) == vb_reg)
+            return A64_CACHE_REG_START + i;
+    }
+    return A64_NOREG;
+}
+
+// Loads a V810 register into a host register
+static void drc_loadReg(BYTE rd, BYTE vb_reg) {
+    if (vb_reg == 0)
+        MOV_RR(rd, A64_ZR);
+    else if (phys_regs[vb_reg] == A64_NOREG)
+        LDR_W(rd, A64_STATE, offsetof(cpu_state, P_REG[vb_reg]));
+    else if (phys_regs[vb_reg] != rd)
+        MOV_RR(rd, phys_regs[vb_reg]);
+}
+
+// Gets the host register holding a V810 register, loading it into rd if it
+// isn't cached
+static BYTE drc_getReg(BYTE rd, BYTE vb_reg) {
+    if (vb_reg != 0 && phys_regs[vb_reg] != A64_NOREG)
+        return phys_regs[vb_reg];
+    drc_loadReg(rd, vb_reg);
+    return rd;
+}
+
+// Gets the host register an instruction should write a V810 register to
+static BYTE drc_getDestReg(BYTE rd, BYTE vb_reg) {
+    if (vb_reg != 0 && phys_regs[vb_reg] != A64_NOREG)
+        return phys_regs[vb_reg];
+    return rd;
+}
+
+// Writes back a V810 register computed in rs (writes to r0 are dropped)
+static void drc_storeReg(BYTE vb_reg, BYTE rs) {
+    if (vb_reg == 0)
+        return;
+    if (phys_regs[vb_reg] == A64_NOREG)
+        STR_W(rs, A64_STATE, offsetof(cpu_state, P_REG[vb_reg]));
+    else if (phys_regs[vb_reg] != rs)
+        MOV_RR(phys_regs[vb_reg], rs);
+}
+
+// Subtracts the cycles in rs from cycles_until_event_partial
+static void drc_subCycles(BYTE rs) {
+    LDR_W(A64_X16, A64_STATE, offsetof(cpu_state, cycles_until_event_partial));
+    SUB_RR(A64_X16, A64_X16, rs);
+    STR_W(A64_X16, A64_STATE, offsetof(cpu_state, cycles_until_event_partial));
+}
+
+// Calls an entry of the relocation table, keeping the flags
+static void drc_callReloc(int index) {
+    MRS_NZCV(A64_FLAGS);
+    LDR_X(A64_X16, A64_STATE, offsetof(cpu_state, reloc_table));
+    LDR_X(A64_X16, A64_X16, index * 8);
+    BLR(A64_X16);
+    MSR_NZCV(A64_FLAGS);
+}
+
+// Emits a branch to a V810 address, taken if cc holds (-1 for always)
+static void drc_jumpTo(int cc, WORD v810_dest) {
+    fixups[num_fixups].pos = (unsigned int)(a64_ptr - trans_cache);
+    fixups[num_fixups].cc = cc;
+    fixups[num_fixups].v810_dest = v810_dest;
+    num_fixups++;
+    if (cc >= 0)
+        a64_patch(a64_branch(a64_invertCond(cc)), a64_ptr + 1);
+    a64_branch(-1);
+}
+
+// Tests a V810 condition (as in Bcond and SETF) against NZCV.
+// Returns the A64 condition code that's true when the V810 one is, or -1 if
+// the condition is always true and -2 if it's never true. NH and H have no
+// A64 equivalent, so CY || Z is computed in w16 for them.
+static int drc_testCond(BYTE cond) {
+    int cc;
+    switch (cond & 7) {
+        case 0: cc = A64_CC_VS; break; // V
+        case 1: cc = A64_CC_CS; break; // C/L
+        case 2: cc = A64_CC_EQ; break; // Z/E
+        case 3: // NH
+            CSET(A64_X16, A64_CC_CS);
+            CSINC(A64_X16, A64_X16, A64_ZR, A64_CC_NE);
+            cc = A64_CC_W16_NZ;
+            break;
+        case 4: cc = A64_CC_MI; break; // N
+        case 5: // T
+            return (cond & 8) ? -2 : -1;
+        case 6: cc = A64_CC_LT; break; // LT
+        default: cc = A64_CC_LE; break; // LE
+    }
+    return (cond & 8) ? a64_invertCond(cc) : cc;
+}
+
+// Sets NZCV from the float in s0: Z if zero, N and C if negative
+static void drc_saveFloatFlags(void) {
+    // fcmp gives 0110 for zero, 1000 for negative and 0010 for positive
+    // (0011 if unordered)
+    FCMP_S0(0);
+    MRS_NZCV(A64_X16);
+    EOR_I(A64_X16, A64_X16, A64_FLAG_C);
+    AND_I(A64_X16, A64_X16, A64_FLAG_N | A64_FLAG_Z | A64_FLAG_C);
+    MSR_NZCV(A64_X16);
+}
+
+// Converts the low nibble of a PSW value in rs to NZCV (in the
+// except_flags layout) in rd
+static void drc_flagsFromPsw(BYTE rd, BYTE rs) {
+    AND_I(rd, rs, 3);
+    LSL_I(rd, rd, 30);
+    AND_I(A64_X17, rs, 0xc);
+    LOGIC_RRS(A64_LOGIC_ORR, rd, rd, A64_X17, A64_SHIFT_LSL, 26);
+}
+
+// Converts NZCV in rs to the low nibble of a PSW value in rd
+static void drc_pswFromFlags(BYTE rd, BYTE rs) {
+    LSR_I(rd, rs, 30);
+    UBFX(A64_X17, rs, 28, 2);
+    LOGIC_RRS(A64_LOGIC_ORR, rd, rd, A64_X17, A64_SHIFT_LSL, 2);
+}
+
+// Computes the effective address of a load/store into w0
+static void drc_loadAddress(BYTE vb_reg, WORD imm) {
+    drc_loadReg(A64_X0, vb_reg);
+    if ((SHWORD)imm != 0)
+        ADD_IMM(A64_X0, A64_X0, (SHWORD)imm);
+}
+
+// Translates a V810 block into AArch64 code
+int drc_translateBlock(WORD start_PC) {
+    int i, j;
+    int err = 0;
+    // Stores the number of clock cycles since the last branch
+    unsigned int cycles = 0;
+    unsigned int num_v810_inst;
+    WORD end_PC, next_PC;
+    // For each V810 instruction, the host registers holding reg1 and reg2
+    BYTE src, dst;
+
+    // Games with specific hacks; additional explanation follows where each check is used.
+    bool is_waterworld = memcmp(tVBOpt.GAME_ID, "67VWEE", 6) == 0;
+    bool is_virtual_lab = memcmp(tVBOpt.GAME_ID, "AHVJVJ", 6) == 0;
+    bool is_space_invaders = memcmp(tVBOpt.GAME_ID, "C0VSPJ", 6) == 0;
+    bool is_jack_bros = memcmp(tVBOpt.GAME_ID, "EBVJBE", 6) == 0 || memcmp(tVBOpt.GAME_ID, "EBVJBJ", 6) == 0;
+    bool is_vertical_force = memcmp(tVBOpt.GAME_ID, "01VH3E", 6) == 0 || memcmp(tVBOpt.GAME_ID, "18VH3J", 6) == 0;
+    bool chcw_load_seen = (vb_state->v810_state.S_REG[CHCW] & 2) != 0;
+    bool is_marios_tennis_multiplayer = memcmp(tVBOpt.GAME_ID, "01VMTJ", 6) == 0 &&
+        memcmp((u8*)V810_ROM1.pmemory + (0x1FFDB0 & V810_ROM1.highaddr), "MULTIPLAYER HACK V0.1 BY MARTIN KUJACZYNSKI ", 44) == 0;
+
+    // Virtual Bowling and Niko-Chan Battle need their interrupts to run a little slower
+    // in order for the samples to play at the right speed.
+    bool is_virtual_bowling = memcmp(tVBOpt.GAME_ID, "E7VVBJ", 6) == 0;
+    bool is_niko_chan = memcmp(tVBOpt.GAME_ID, "8BVTRJ", 6) == 0;
+    bool slow_memory = is_virtual_bowling || is_niko_chan ||
+        // If memory is too fast, Blox 2's intro jingle doesn't finish.
+        memcmp(tVBOpt.GAME_ID, "CRVB2M", 6) == 0;
+
+    // Emulating memory clocks introduces lag to Galactic Pinball's UFO table.
+    bool is_pinball = memcmp(tVBOpt.GAME_ID, "01VGPJ", 6) == 0;
+
+    bool is_waterworld_sample = is_waterworld && (start_PC == 0x0701b2b2);
+
+    exec_block *block = NULL;
+
+    drc_scanBlockBounds(&start_PC, &end_PC);
+    dprintf(3, "[DRC]: new block - 0x%lx->0x%lx\n", start_PC, end_PC);
+
+    // Clear previous block register stats
+    memset(reg_usage, 0, sizeof(reg_usage));
+
+    block = drc_getNextBlockStruct();
+    if (block == NULL)
+        return DRC_ERR_NO_BLOCKS;
+    block->free = false;
+
+    block->start_pc = start_PC;
+    block->pc_range = end_PC - start_PC;
+
+    // First pass: decode V810 instructions
+    num_v810_inst = drc_decodeInstructions(block, start_PC, end_PC);
+    dprintf(3, "[DRC]: V810 block size - %d\n", num_v810_inst);
+
+    // Waterworld-exclusive pass: find busywaits
+    if (is_waterworld)
+        busywait_findWaterworld(inst_cache, num_v810_inst);
+
+    // Second pass: map the most used V810 registers to host registers
+    drc_mapRegs(block);
+    phys_regs[0] = A64_NOREG;
+    for (i = 1; i < 32; i++)
+        phys_regs[i] = drc_getPhysReg(i, block->reg_map);
+
+    a64_ptr = trans_cache;
+    num_fixups = 0;
+
+    // Third pass: generate AArch64 code
+    for (i = 0; i < num_v810_inst; i++) {
+        // The longest sequence (bitstring) is about 60 instructions, keep some margin
+        if (a64_ptr - trans_cache >= MAX_A64_INST - 256) {
+            // Truncate the block, the rest will be translated separately
+            num_v810_inst = i;
+            block->pc_range = inst_cache[i - 1].PC - block->start_pc;
+            break;
+        }
+
+        inst_cache[i].start_pos = (HWORD) (a64_ptr - trans_cache);
+        cycles += opcycle[inst_cache[i].opcode];
+
+        // Native code spliced in here (see hle.c)
+        int hook = hle_findHook(inst_cache[i].PC);
+        if (unlikely(hook)) {
+            MOV_I(A64_X0, hook);
+            drc_callReloc(DRC_RELOC_HLEHOOK);
+            // skip the code it replaces
+            if (hle_entries[hook - 1].resume_PC)
+                drc_jumpTo(-1, hle_entries[hook - 1].resume_PC);
+        }
+
+        // Waterworld hack: slow down the sample at the start.
+        // This roughly emulates register hazards to a certain extent,
+        // with some tweaks to bring it as close as possible to a hardware recording.
+        if (is_waterworld_sample) {
+            if (inst_cache[i].PC == 0x0701b2b4) cycles -= 1;
+            if (opcycle[inst_cache[i].opcode] == 1 && (inst_cache[i].PC & 6) == 0) {
+                if (i > 0 && inst_cache[i-1].reg2 != 0xFF && (inst_cache[i].reg1 == inst_cache[i-1].reg2)) {
+                    cycles++;
+                }
+            }
+        }
+
+        switch (inst_cache[i].opcode) {
+            case V810_OP_JMP: // jmp [reg1]
+                src = drc_getReg(A64_X0, inst_cache[i].reg1);
+                STR_W(src, A64_STATE, offsetof(cpu_state, PC));
+                ADDCYCLES();
+                EXIT_BLOCK();
+                break;
+            case V810_OP_JR: // jr imm26
+                if (abs(inst_cache[i].branch_offset) < 1024) {
+                    if (inst_cache[i].busywait) {
+                        HALT(inst_cache[i].PC + inst_cache[i].branch_offset);
+                    } else {
+                        if (inst_cache[i].branch_offset <= 0) {
+                            HANDLEINT(inst_cache[i].PC + inst_cache[i].branch_offset);
+                        } else {
+                            ADDCYCLES();
+                        }
+                        drc_jumpTo(-1, inst_cache[i].PC + inst_cache[i].branch_offset);
+                    }
+                } else {
+                    ADDCYCLES();
+                    MOV_I(A64_X0, inst_cache[i].PC + inst_cache[i].branch_offset);
+                    STR_W(A64_X0, A64_STATE, offsetof(cpu_state, PC));
+                    EXIT_BLOCK();
+                }
+                break;
+            case V810_OP_JAL: // jal disp26
+            {
+                if (is_space_invaders && inst_cache[i].PC == 0x07007fb6) {
+                    // Make sure the Space Invaders intro FMV runs at the correct speed (ish).
+                    // Value determined through trial and error.
+                    cycles += 24;
+                }
+
+                // Save the new PC
+                MOV_I(A64_X0, inst_cache[i].PC + inst_cache[i].branch_offset);
+                STR_W(A64_X0, A64_STATE, offsetof(cpu_state, PC));
+                // Link the return address
+                dst = drc_getDestReg(A64_X0, 31);
+                MOV_I(dst, inst_cache[i].PC + 4);
+                drc_storeReg(31, dst);
+                ADDCYCLES();
+                EXIT_BLOCK();
+                break;
+            }
+            case V810_OP_RETI:
+            {
+                WORD *is_eip, *done;
+                LDR_W(A64_X0, A64_STATE, offsetof(cpu_state, S_REG[PSW]));
+                is_eip = a64_ptr;
+                a64_emit(0x36000000 | (15 << 19) | A64_X0); // tbz w0, #15 (PSW_NP)
+                LDR_W(A64_X1, A64_STATE, offsetof(cpu_state, S_REG[FEPC]));
+                LDR_W(A64_X2, A64_STATE, offsetof(cpu_state, S_REG[FEPSW]));
+                done = a64_branch(-1);
+                a64_patch(is_eip, a64_ptr);
+                LDR_W(A64_X1, A64_STATE, offsetof(cpu_state, S_REG[EIPC]));
+                LDR_W(A64_X2, A64_STATE, offsetof(cpu_state, S_REG[EIPSW]));
+                a64_patch(done, a64_ptr);
+
+                STR_W(A64_X1, A64_STATE, offsetof(cpu_state, PC));
+                STR_W(A64_X2, A64_STATE, offsetof(cpu_state, S_REG[PSW]));
+
+                ADDCYCLES();
+
+                // restore flags and handle any lingering interrupts
+                LDR_W(A64_FLAGS, A64_STATE, offsetof(cpu_state, except_flags));
+                STR_W(A64_FLAGS, A64_STATE, offsetof(cpu_state, flags));
+                MSR_NZCV(A64_FLAGS);
+                MOV_RR(A64_X0, A64_FLAGS);
+                LDR_X(A64_X16, A64_STATE, offsetof(cpu_state, irq_handler));
+                BLR(A64_X16);
+                MSR_NZCV(A64_FLAGS);
+
+                // if we didn't exit already, leave the block
+                EXIT_BLOCK();
+                break;
+            }
+            case V810_OP_BR:
+                if (inst_cache[i].branch_offset == 0) {
+                    HALT(inst_cache[i].PC);
+                    break;
+                }
+                // vertical force doesn't have a tight spinloop like most games, so we can't detect it
+                // it just continuously loops through entities, doing nothing more when each one done
+                // so let's just artificially skip a bunch of time so that the game isn't slow
+                if (is_vertical_force && inst_cache[i].PC == 0x07000c08) {
+                    cycles += 1 << 25;
+                    HANDLEINT(inst_cache[i].PC + inst_cache[i].branch_offset);
+                    drc_jumpTo(-1, inst_cache[i].PC + inst_cache[i].branch_offset);
+                    break;
+                }
+            case V810_OP_BV:
+            case V810_OP_BL:
+            case V810_OP_BE:
+            case V810_OP_BNH:
+            case V810_OP_BN:
+            case V810_OP_BLT:
+            case V810_OP_BLE:
+            case V810_OP_BNV:
+            case V810_OP_BNL:
+            case V810_OP_BNE:
+            case V810_OP_BH:
+            case V810_OP_BP:
+            case V810_OP_BGE:
+            case V810_OP_BGT:
+            {
+                int cc;
+                if (inst_cache[i].busywait) {
+                    WORD *not_taken;
+                    cc = drc_testCond(inst_cache[i].opcode & 0xF);
+                    not_taken = cc == -1 ? NULL : a64_branch(a64_invertCond(cc));
+                    HALT(inst_cache[i].PC + inst_cache[i].branch_offset);
+                    if (not_taken) a64_patch(not_taken, a64_ptr);
+                } else {
+                    // If we just got back from a JAL, an interrupt check already happened, so don't bother.
+                    if (inst_cache[i].branch_offset <= 0 && (inst_cache[i].is_branch_target || (i > 0 && inst_cache[i-1].opcode != V810_OP_JAL))) {
+                        // The Jack Bros. intro chime delay consists of "add; bne" loops
+                        // running with the instruction cache off, which take 24 cycles
+                        // per iteration (see the ARM backend for the details).
+                        if (is_jack_bros && !chcw_load_seen) {
+                            cycles += 20;
+                        }
+                        HANDLEINT(inst_cache[i].PC);
+                    } else {
+                        ADDCYCLES();
+                    }
+                    cc = drc_testCond(inst_cache[i].opcode & 0xF);
+                    drc_jumpTo(cc, inst_cache[i].PC + inst_cache[i].branch_offset);
+                }
+                // branch not taken, so it only took 1 cycle
+                LDR_W(A64_X16, A64_STATE, offsetof(cpu_state, cycles_until_event_partial));
+                ADD_I(A64_X16, A64_X16, 2);
+                STR_W(A64_X16, A64_STATE, offsetof(cpu_state, cycles_until_event_partial));
+                break;
+            }
+            case V810_OP_MOVHI: // movhi imm16, reg1, reg2
+                dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                if (inst_cache[i].reg1 == 0) {
+                    MOV_I(dst, inst_cache[i].imm << 16);
+                } else {
+                    src = drc_getReg(A64_X1, inst_cache[i].reg1);
+                    if (inst_cache[i].imm != 0)
+                        ADD_IMM(dst, src, inst_cache[i].imm << 16);
+                    else if (dst != src)
+                        MOV_RR(dst, src);
+                }
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            case V810_OP_MOVEA: // movea imm16, reg1, reg2
+                dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                if (inst_cache[i].reg1 == 0) {
+                    MOV_I(dst, (SHWORD)inst_cache[i].imm);
+                } else {
+                    src = drc_getReg(A64_X1, inst_cache[i].reg1);
+                    if (inst_cache[i].imm != 0)
+                        ADD_IMM(dst, src, (SHWORD)inst_cache[i].imm);
+                    else if (dst != src)
+                        MOV_RR(dst, src);
+                }
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            case V810_OP_MOV: // mov reg1, reg2
+                dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                drc_loadReg(dst, inst_cache[i].reg1);
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            case V810_OP_ADD: // add reg1, reg2
+                dst = drc_getReg(A64_X0, inst_cache[i].reg2);
+                src = drc_getReg(A64_X1, inst_cache[i].reg1);
+                ADDS_RR(dst, dst, src);
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            case V810_OP_SUB: // sub reg1, reg2
+            case V810_OP_CMP: // cmp reg1, reg2
+                dst = drc_getReg(A64_X0, inst_cache[i].reg2);
+                src = drc_getReg(A64_X1, inst_cache[i].reg1);
+                SUBS_RR(inst_cache[i].opcode == V810_OP_CMP ? A64_ZR : dst, dst, src);
+                INV_CARRY();
+                if (inst_cache[i].opcode == V810_OP_SUB)
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            case V810_OP_SHL: // shl reg1, reg2
+            case V810_OP_SHR: // shr reg1, reg2
+            case V810_OP_SAR: // sar reg1, reg2
+            case V810_OP_SHL_I: // shl imm5, reg2
+            case V810_OP_SHR_I: // shr imm5, reg2
+            case V810_OP_SAR_I: // sar imm5, reg2
+            {
+                BYTE opcode = inst_cache[i].opcode;
+                bool by_reg = opcode == V810_OP_SHL || opcode == V810_OP_SHR || opcode == V810_OP_SAR;
+                int imm = inst_cache[i].imm & 0x1F;
+                // shift amount -> w1
+                if (by_reg) {
+                    drc_loadReg(A64_X1, inst_cache[i].reg1);
+                    AND_I(A64_X1, A64_X1, 0x1F);
+                }
+                // w0 is zero-extended to x0
+                drc_loadReg(A64_X0, inst_cache[i].reg2);
+                // Shift in 64 bits so that the last bit shifted out is kept
+                // (in bit 32 for left shifts, in bit 0 for right shifts)
+                if (opcode == V810_OP_SHL || opcode == V810_OP_SHL_I) {
+                    if (by_reg)
+                        LSLV64(A64_X2, A64_X0, A64_X1);
+                    else
+                        LSL_I64(A64_X2, A64_X0, imm);
+                    UBFX64(A64_X3, A64_X2, 32, 1);
+                } else {
+                    if (opcode == V810_OP_SHR || opcode == V810_OP_SHR_I) {
+                        LSL_I64(A64_X2, A64_X0, 1);
+                        if (by_reg)
+                            LSRV64(A64_X2, A64_X2, A64_X1);
+                        else
+                            LSR_I64(A64_X2, A64_X2, imm);
+                    } else {
+                        SXTW64(A64_X2, A64_X0);
+                        LSL_I64(A64_X2, A64_X2, 1);
+                        if (by_reg)
+                            ASRV64(A64_X2, A64_X2, A64_X1);
+                        else
+                            SBFM64(A64_X2, A64_X2, imm, 63);
+                    }
+                    AND_I(A64_X3, A64_X2, 1);
+                    LSR_I64(A64_X2, A64_X2, 1);
+                }
+                dst = drc_getDestReg(A64_X2, inst_cache[i].reg2);
+                if (dst != A64_X2)
+                    MOV_RR(dst, A64_X2);
+                // Z and S from the result, CY from the last bit out, OV cleared
+                TST_RR(dst, dst);
+                MRS_NZCV(A64_X16);
+                LOGIC_RRS(A64_LOGIC_ORR, A64_X16, A64_X16, A64_X3, A64_SHIFT_LSL, 29);
+                MSR_NZCV(A64_X16);
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            }
+            case V810_OP_MUL: // mul reg1, reg2
+                dst = drc_getReg(A64_X0, inst_cache[i].reg2);
+                src = drc_getReg(A64_X1, inst_cache[i].reg1);
+                SMULL(A64_X2, dst, src);
+                // overflow if the result doesn't fit in 32 bits
+                CMP_SXTW64(A64_X2, A64_X2);
+                CSET(A64_X3, A64_CC_NE);
+                TST_RR64(A64_X2, A64_X2);
+                MRS_NZCV(A64_X16);
+                LOGIC_RRS(A64_LOGIC_ORR, A64_X16, A64_X16, A64_X3, A64_SHIFT_LSL, 28);
+                MSR_NZCV(A64_X16);
+                LSR_I64(A64_X1, A64_X2, 32);
+                drc_storeReg(30, A64_X1);
+                drc_storeReg(inst_cache[i].reg2, A64_X2);
+                break;
+            case V810_OP_MULU: // mulu reg1, reg2
+                dst = drc_getReg(A64_X0, inst_cache[i].reg2);
+                src = drc_getReg(A64_X1, inst_cache[i].reg1);
+                UMULL(A64_X2, dst, src);
+                LSR_I64(A64_X1, A64_X2, 32);
+                // sign from the low word, zero from the whole result,
+                // overflow if the high word isn't 0
+                LSR_I(A64_X16, A64_X2, 31);
+                LSL_I(A64_X16, A64_X16, 31);
+                TST_RR64(A64_X2, A64_X2);
+                CSET(A64_X3, A64_CC_EQ);
+                LOGIC_RRS(A64_LOGIC_ORR, A64_X16, A64_X16, A64_X3, A64_SHIFT_LSL, 30);
+                CMP_I(A64_X1, 0);
+                CSET(A64_X3, A64_CC_NE);
+                LOGIC_RRS(A64_LOGIC_ORR, A64_X16, A64_X16, A64_X3, A64_SHIFT_LSL, 28);
+                MSR_NZCV(A64_X16);
+                drc_storeReg(30, A64_X1);
+                drc_storeReg(inst_cache[i].reg2, A64_X2);
+                break;
+            case V810_OP_DIV: // div reg1, reg2
+            case V810_OP_DIVU: // divu reg1, reg2
+            {
+                // reg2/reg1 -> reg2 (w2)
+                // reg2%reg1 -> r30 (w3)
+                bool is_signed = inst_cache[i].opcode == V810_OP_DIV;
+                drc_loadReg(A64_X0, inst_cache[i].reg2);
+                drc_loadReg(A64_X1, inst_cache[i].reg1);
+                // keep the carry
+                MRS_NZCV(A64_X4);
+                AND_I(A64_X4, A64_X4, A64_FLAG_C);
+                // division by zero gives 0, and so does the remainder here
+                if (is_signed)
+                    SDIV(A64_X2, A64_X0, A64_X1);
+                else
+                    UDIV(A64_X2, A64_X0, A64_X1);
+                MSUB(A64_X3, A64_X2, A64_X1, A64_X0);
+                CMP_I(A64_X1, 0);
+                CSEL(A64_X3, A64_ZR, A64_X3, A64_CC_EQ);
+                if (is_signed) {
+                    // 0x80000000 / -1 overflows (and gives 0x80000000 rem 0)
+                    MOV_I(A64_X5, INT32_MIN);
+                    CMN_I(A64_X1, 1);
+                    CCMP_RR(A64_X0, A64_X5, 0, A64_CC_EQ);
+                    CSET(A64_X5, A64_CC_EQ);
+                    LOGIC_RRS(A64_LOGIC_ORR, A64_X4, A64_X4, A64_X5, A64_SHIFT_LSL, 28);
+                }
+
+                drc_storeReg(30, A64_X3);
+                drc_storeReg(inst_cache[i].reg2, A64_X2);
+
+                TST_RR(A64_X2, A64_X2);
+                MRS_NZCV(A64_X16);
+                ORR_RR(A64_X16, A64_X16, A64_X4);
+                MSR_NZCV(A64_X16);
+                break;
+            }
+            case V810_OP_OR: // or reg1, reg2
+            case V810_OP_AND: // and reg1, reg2
+            case V810_OP_XOR: // xor reg1, reg2
+            {
+                WORD op = inst_cache[i].opcode == V810_OP_OR ? A64_LOGIC_ORR :
+                          inst_cache[i].opcode == V810_OP_AND ? A64_LOGIC_AND : A64_LOGIC_EOR;
+                dst = drc_getReg(A64_X0, inst_cache[i].reg2);
+                src = drc_getReg(A64_X1, inst_cache[i].reg1);
+                LOGIC_RR(op, dst, dst, src);
+                drc_storeReg(inst_cache[i].reg2, dst);
+                SAVE_FLAGS_LOGIC(dst);
+                break;
+            }
+            case V810_OP_NOT: // not reg1, reg2
+                src = drc_getReg(A64_X1, inst_cache[i].reg1);
+                dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                MVN_RR(dst, src);
+                drc_storeReg(inst_cache[i].reg2, dst);
+                SAVE_FLAGS_LOGIC(dst);
+                break;
+            case V810_OP_MOV_I: // mov imm5, reg2
+                dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                MOV_I(dst, sign_5(inst_cache[i].imm));
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            case V810_OP_ADD_I: // add imm5, reg2
+            case V810_OP_CMP_I: // cmp imm5, reg2
+            {
+                int imm = sign_5(inst_cache[i].imm);
+                src = drc_getReg(A64_X0, inst_cache[i].reg2);
+                if (inst_cache[i].opcode == V810_OP_ADD_I) {
+                    // adding a negative number with subs gives the same carry
+                    dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                    ADDS_IMM(dst, src, imm);
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                } else {
+                    // likewise, subtracting one with adds gives the same borrow
+                    if (imm >= 0)
+                        SUBS_I(A64_ZR, src, imm);
+                    else
+                        ADDS_I(A64_ZR, src, -imm);
+                    INV_CARRY();
+                }
+                break;
+            }
+            case V810_OP_ANDI: // andi imm16, reg1, reg2
+            case V810_OP_XORI: // xori imm16, reg1, reg2
+            case V810_OP_ORI: // ori imm16, reg1, reg2
+            {
+                WORD op = inst_cache[i].opcode == V810_OP_ANDI ? A64_LOGIC_AND :
+                          inst_cache[i].opcode == V810_OP_XORI ? A64_LOGIC_EOR : A64_LOGIC_ORR;
+                src = drc_getReg(A64_X0, inst_cache[i].reg1);
+                dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                // the immediate is zero-extended
+                if ((inst_cache[i].imm & 0xFFFF) == 0)
+                    LOGIC_RR(op, dst, src, A64_ZR);
+                else
+                    a64_logicImm(op, dst, src, inst_cache[i].imm & 0xFFFF);
+                drc_storeReg(inst_cache[i].reg2, dst);
+                SAVE_FLAGS_LOGIC(dst);
+                break;
+            }
+            case V810_OP_ADDI: // addi imm16, reg1, reg2
+            {
+                src = drc_getReg(A64_X0, inst_cache[i].reg1);
+                dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                ADDS_IMM(dst, src, (SHWORD)inst_cache[i].imm);
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            }
+            case V810_OP_LD_B: // ld.b disp16 [reg1], reg2
+            case V810_OP_IN_B: // in.b disp16 [reg1], reg2
+            case V810_OP_LD_H: // ld.h disp16 [reg1], reg2
+            case V810_OP_IN_H: // in.h disp16 [reg1], reg2
+            case V810_OP_LD_W: // ld.w disp16 [reg1], reg2
+            case V810_OP_IN_W: // in.w disp16 [reg1], reg2
+            {
+                BYTE opcode = inst_cache[i].opcode;
+                bool is_word = opcode == V810_OP_LD_W || opcode == V810_OP_IN_W;
+                drc_loadAddress(inst_cache[i].reg1, inst_cache[i].imm);
+                if (opcode == V810_OP_LD_B || opcode == V810_OP_IN_B)
+                    drc_callReloc(DRC_RELOC_RBYTE);
+                else if (opcode == V810_OP_LD_H || opcode == V810_OP_IN_H)
+                    drc_callReloc(DRC_RELOC_RHWORD);
+                else
+                    drc_callReloc(DRC_RELOC_RWORD);
+
+                // Subtract the cycles returned in the high word
+                if (!is_pinball) {
+                    LSR_I64(A64_X1, A64_X0, 32);
+                    drc_subCycles(A64_X1);
+                }
+
+                if (slow_memory) cycles += is_word ? 4 : 2;
+
+                if (inst_cache[i].reg2 != 0) {
+                    dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                    switch (opcode) {
+                        case V810_OP_LD_B: SXTB(dst, A64_X0); break;
+                        case V810_OP_IN_B: UXTB(dst, A64_X0); break;
+                        case V810_OP_LD_H: SXTH(dst, A64_X0); break;
+                        case V810_OP_IN_H: UXTH(dst, A64_X0); break;
+                        default: if (dst != A64_X0) MOV_RR(dst, A64_X0); break;
+                    }
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                }
+
+                if (i > 0 && (inst_cache[i - 1].opcode & 0x34) == 0x30 && (inst_cache[i - 1].opcode & 3) != 2) {
+                    // load immediately following another load takes 1 cycle less
+                    cycles -= 1;
+                } else if (i > 0 && opcycle[inst_cache[i - 1].opcode] > 4) {
+                    // load following instruction taking "many" cycles only takes 1 cycles
+                    // guessing "many" is 4 for now
+                    cycles -= is_word ? 4 : 2;
+                }
+                break;
+            }
+            case V810_OP_ST_B:  // st.b reg2, disp16 [reg1]
+            case V810_OP_OUT_B: // out.b reg2, disp16 [reg1]
+            case V810_OP_ST_H:  // st.h reg2, disp16 [reg1]
+            case V810_OP_OUT_H: // out.h reg2, disp16 [reg1]
+            case V810_OP_ST_W:  // st.w reg2, disp16 [reg1]
+            case V810_OP_OUT_W: // out.w reg2, disp16 [reg1]
+            {
+                BYTE opcode = inst_cache[i].opcode;
+                bool is_word = opcode == V810_OP_ST_W || opcode == V810_OP_OUT_W;
+                drc_loadAddress(inst_cache[i].reg1, inst_cache[i].imm);
+                drc_loadReg(A64_X1, inst_cache[i].reg2);
+                if (opcode == V810_OP_ST_B || opcode == V810_OP_OUT_B)
+                    drc_callReloc(DRC_RELOC_WBYTE);
+                else if (opcode == V810_OP_ST_H || opcode == V810_OP_OUT_H)
+                    drc_callReloc(DRC_RELOC_WHWORD);
+                else
+                    drc_callReloc(DRC_RELOC_WWORD);
+
+                if (slow_memory) cycles += is_word ? 4 : 2;
+
+                if (i > 1 && (inst_cache[i - 1].opcode & 0x34) == 0x34 && (inst_cache[i - 1].opcode & 3) != 2) {
+                    // with two consecutive stores, the second one takes longer
+                    cycles += is_word ? 3 : 1;
+                }
+
+                // Subtract the cycles returned in w0
+                if (!is_pinball)
+                    drc_subCycles(A64_X0);
+
+                // if we load the same thing immediately after saving it, skip the loading
+                if (is_word && i + 1 < num_v810_inst &&
+                    !inst_cache[i].fallthrough_PC && !inst_cache[i + 1].fallthrough_PC &&
+                    (inst_cache[i + 1].opcode == V810_OP_LD_W || inst_cache[i + 1].opcode == V810_OP_IN_W) &&
+                    inst_cache[i + 1].imm == inst_cache[i].imm && inst_cache[i + 1].reg1 == inst_cache[i].reg1 &&
+                    inst_cache[i + 1].reg2 == inst_cache[i].reg2
+                ) {
+                    cycles += 5;
+                    ADDCYCLES();
+                    drc_jumpTo(-1, inst_cache[i].PC + 8);
+                }
+                break;
+            }
+            case V810_OP_LDSR: // ldsr reg2, regID
+                // Stores reg2 in vb_state->v810_state.S_REG[regID]
+                src = drc_getReg(A64_X0, inst_cache[i].reg2);
+                STR_W(src, A64_STATE, offsetof(cpu_state, S_REG[inst_cache[i].imm]));
+                if (inst_cache[i].imm == CHCW) chcw_load_seen = true;
+                if (inst_cache[i].imm == PSW) {
+                    drc_flagsFromPsw(A64_X1, src);
+                    MSR_NZCV(A64_X1);
+                } else if (inst_cache[i].imm == EIPSW) {
+                    drc_flagsFromPsw(A64_X1, src);
+                    STR_W(A64_X1, A64_STATE, offsetof(cpu_state, except_flags));
+                }
+                break;
+            case V810_OP_STSR: // stsr regID, reg2
+                // Loads vb_state->v810_state.S_REG[regID] into reg2
+                dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                LDR_W(dst, A64_STATE, offsetof(cpu_state, S_REG[inst_cache[i].imm]));
+                if (inst_cache[i].imm == PSW || inst_cache[i].imm == EIPSW) {
+                    if (inst_cache[i].imm == PSW)
+                        MRS_NZCV(A64_X1);
+                    else
+                        LDR_W(A64_X1, A64_STATE, offsetof(cpu_state, except_flags));
+                    // replace the condition flags
+                    drc_pswFromFlags(A64_X2, A64_X1);
+                    BFI(dst, A64_X2, 0, 4);
+                }
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            case V810_OP_SEI: // sei
+            case V810_OP_CLI: // cli
+                // Set or clear the 12th bit in vb_state->v810_state.S_REG[PSW]
+                LDR_W(A64_X0, A64_STATE, offsetof(cpu_state, S_REG[PSW]));
+                if (inst_cache[i].opcode == V810_OP_SEI)
+                    ORR_I(A64_X0, A64_X0, 1 << 12);
+                else
+                    AND_I(A64_X0, A64_X0, ~(1 << 12));
+                STR_W(A64_X0, A64_STATE, offsetof(cpu_state, S_REG[PSW]));
+                break;
+            case V810_OP_SETF: // setf imm5, reg2
+            {
+                int cc = drc_testCond(inst_cache[i].imm & 0xF);
+                dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                if (cc < 0)
+                    MOV_I(dst, cc == -1 ? 1 : 0);
+                else if (cc == A64_CC_W16_NZ)
+                    MOV_RR(dst, A64_X16);
+                else if (cc == A64_CC_W16_Z)
+                    EOR_I(dst, A64_X16, 1);
+                else
+                    CSET(dst, cc);
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            }
+            case V810_OP_HALT: // halt
+                // leave the block and let v810_run idle
+                ADDCYCLES();
+                MOV_I(A64_X0, inst_cache[i].PC);
+                STR_W(A64_X0, A64_STATE, offsetof(cpu_state, PC));
+                MOV_I(A64_X0, 1);
+                STR_W(A64_X0, A64_STATE, offsetof(cpu_state, halted));
+                EXIT_BLOCK();
+                break;
+            case V810_OP_BSTR:
+            {
+                WORD *inst_start = trans_cache + inst_cache[i].start_pos;
+                // offsets -> w3
+                drc_loadReg(A64_X3, 27);
+                AND_I(A64_X3, A64_X3, 31);
+                if (inst_cache[i].imm >= 4) {
+                    // non-search, we have a destination
+                    drc_loadReg(A64_X4, 26);
+                    AND_I(A64_X4, A64_X4, 31);
+                    LOGIC_RRS(A64_LOGIC_ORR, A64_X3, A64_X3, A64_X4, A64_SHIFT_LSL, 5);
+                    // cycle count << 10
+                    LDR_W(A64_X4, A64_STATE, offsetof(cpu_state, cycles_until_event_partial));
+                    LOGIC_RRS(A64_LOGIC_ORR, A64_X3, A64_X3, A64_X4, A64_SHIFT_LSL, 10);
+                    // destination address, word-aligned
+                    drc_loadReg(A64_X1, 29);
+                    AND_I(A64_X1, A64_X1, ~3);
+                } else {
+                    // search, leave as-is
+                    drc_loadReg(A64_X1, 29);
+                }
+                // source address, word-aligned
+                drc_loadReg(A64_X0, 30);
+                AND_I(A64_X0, A64_X0, ~3);
+                // length
+                drc_loadReg(A64_X2, 28);
+
+                drc_callReloc(DRC_RELOC_BSTR + inst_cache[i].imm);
+
+                // reload registers
+                for (j = inst_cache[i].imm >= 4 ? 26 : 27; j <= 30; j++)
+                    if (phys_regs[j] != A64_NOREG)
+                        LDR_W(phys_regs[j], A64_STATE, offsetof(cpu_state, P_REG[j]));
+                if (inst_cache[i].imm < 4) {
+                    // zero flag for search
+                    UXTB(A64_X0, A64_X0);
+                    MRS_NZCV(A64_X16);
+                    CMP_I(A64_X0, 0);
+                    CSET(A64_X0, A64_CC_EQ);
+                    BFI(A64_X16, A64_X0, 30, 1);
+                    MSR_NZCV(A64_X16);
+                } else {
+                    // subtract the cycles taken and check interrupt
+                    drc_subCycles(A64_X0);
+                    HANDLEINT(inst_cache[i].PC);
+                    // loop until the whole string has been processed
+                    src = drc_getReg(A64_X0, 28);
+                    a64_emit(0x35000000 | src); // cbnz
+                    a64_patch(a64_ptr - 1, inst_start);
+                }
+                break;
+            }
+            case V810_OP_FPP:
+                switch (inst_cache[i].imm) {
+                case V810_OP_CVT_WS:
+                    src = drc_getReg(A64_X1, inst_cache[i].reg1);
+                    SCVTF_SW(0, src);
+                    dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                    FMOV_WS(dst, 0);
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                    drc_saveFloatFlags();
+                    break;
+                case V810_OP_CVT_SW:
+                case V810_OP_TRNC_SW:
+                    src = drc_getReg(A64_X1, inst_cache[i].reg1);
+                    FMOV_SW(0, src);
+                    dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                    if (inst_cache[i].imm == V810_OP_CVT_SW) {
+                        // round to nearest, halfway cases away from zero
+                        FCVTAS_WS(dst, 0);
+                    } else {
+                        FCVTZS_WS(dst, 0);
+                    }
+                    TST_RR(dst, dst);
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                    break;
+                case V810_OP_CMPF_S:
+                case V810_OP_ADDF_S:
+                case V810_OP_SUBF_S:
+                case V810_OP_MULF_S:
+                case V810_OP_DIVF_S:
+                    src = drc_getReg(A64_X1, inst_cache[i].reg1);
+                    FMOV_SW(1, src);
+                    src = drc_getReg(A64_X0, inst_cache[i].reg2);
+                    FMOV_SW(0, src);
+                    switch (inst_cache[i].imm) {
+                        case V810_OP_ADDF_S: FADD_S(0, 0, 1); break;
+                        case V810_OP_MULF_S: FMUL_S(0, 0, 1); break;
+                        case V810_OP_DIVF_S: cycles += 44; FDIV_S(0, 0, 1); break;
+                        default: FSUB_S(0, 0, 1); break;
+                    }
+                    if (inst_cache[i].imm != V810_OP_CMPF_S) {
+                        dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                        FMOV_WS(dst, 0);
+                        drc_storeReg(inst_cache[i].reg2, dst);
+                    }
+                    drc_saveFloatFlags();
+                    break;
+                case V810_OP_XB:
+                    cycles += 6;
+                    dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                    src = drc_getReg(A64_X0, inst_cache[i].reg2);
+                    REV16(A64_X1, src);
+                    if (dst != src)
+                        MOV_RR(dst, src);
+                    BFI(dst, A64_X1, 0, 16);
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                    break;
+                case V810_OP_XH:
+                    cycles += 1;
+                    src = drc_getReg(A64_X0, inst_cache[i].reg2);
+                    dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                    ROR_I(dst, src, 16);
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                    break;
+                case V810_OP_REV:
+                    cycles += 22;
+                    src = drc_getReg(A64_X1, inst_cache[i].reg1);
+                    dst = drc_getDestReg(A64_X0, inst_cache[i].reg2);
+                    RBIT(dst, src);
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                    break;
+                case V810_OP_MPYHW:
+                    cycles += 9;
+                    // reg1 is sign-extended from 17 bits
+                    src = drc_getReg(A64_X1, inst_cache[i].reg1);
+                    SBFX(A64_X1, src, 0, 17);
+                    dst = drc_getReg(A64_X0, inst_cache[i].reg2);
+                    MUL(dst, dst, A64_X1);
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                    break;
+                default:
+                    dprintf(0, "[DRC]: Invalid FPU subop 0x%lx\n", inst_cache[i].imm);
+                    break;
+                }
+                break;
+            case V810_OP_NOP:
+                break;
+            case END_BLOCK:
+                EXIT_BLOCK();
+                break;
+            default:
+                dprintf(0, "[DRC]: %s (0x%x) not implemented\n", optable[inst_cache[i].opcode].opname, inst_cache[i].opcode);
+                // Skip unimplemented instructions and hope the game still runs
+                break;
+        }
+
+        if (inst_cache[i].fallthrough_PC) {
+            // the next instruction is in another block (see drc_splitLoops)
+            ADDCYCLES();
+            MOV_I(A64_X0, inst_cache[i].fallthrough_PC);
+            STR_W(A64_X0, A64_STATE, offsetof(cpu_state, PC));
+            EXIT_BLOCK();
+        } else if (i + 1 < num_v810_inst) {
+            if (is_virtual_lab && inst_cache[i + 1].PC == 0x07002446) {
+                // virtual lab hack
+                // interrupts don't save registers, and clearing levels relies on
+                // registers getting dirty
+                HALT(0x07002446);
+            } else if (inst_cache[i+1].opcode == V810_OP_ST_B
+                    && inst_cache[i+1].imm == 0x20
+                    && inst_cache[i].opcode == V810_OP_MOVEA
+                    && inst_cache[i].reg1 == 0
+                    && inst_cache[i].reg2 == inst_cache[i+1].reg2
+                    && inst_cache[i].imm == 0x1d) {
+                // Hack for Virtual Bowling and Niko-Chan Battle:
+                // These games acknowledge the timer in a way that only works
+                // if the timer is not zero at this point.
+                // Therefore, we need to handle the interrupt to update it,
+                // so that it doesn't accidentally run an extra time.
+                ADDCYCLES();
+                CALL_IRQ_HANDLER(inst_cache[i+1].PC);
+            } else if (is_marios_tennis_multiplayer && inst_cache[i + 1].PC == 0x07010442) {
+                // Mario's Tennis multiplayer hack:
+                // Place an interrupt check between the CC-Wr writes so that
+                // the two systems can desync (see the ARM backend).
+                HANDLEINT(inst_cache[i + 1].PC);
+            } else if (cycles >= 200) {
+                HANDLEINT(inst_cache[i + 1].PC);
+            } else if (cycles != 0 && (inst_cache[i + 1].is_branch_target || inst_cache[i + 1].opcode == V810_OP_BSTR)) {
+                // branch target or bitstring instruction coming up
+                ADDCYCLES();
+            } else if (inst_cache[i + 1].PC > (0xfffffe00 & V810_ROM1.highaddr) && !(inst_cache[i + 1].PC & 0xf)) {
+                // potential interrupt handler coming up
+                ADDCYCLES();
+            }
+        }
+    }
+
+    // Leave the block if execution falls off its end
+    if (num_v810_inst < 1)
+        return DRC_ERR_BAD_INST;
+    next_PC = inst_cache[num_v810_inst - 1].PC +
+        am_size_table[optable[inst_cache[num_v810_inst - 1].opcode].addr_mode];
+    ADDCYCLES();
+    MOV_I(A64_X0, next_PC);
+    STR_W(A64_X0, A64_STATE, offsetof(cpu_state, PC));
+    EXIT_BLOCK();
+
+    // Fourth pass: copy to the new memory block
+    unsigned int num_words = (unsigned int)(a64_ptr - trans_cache);
+    WORD *cache_ptr = drc_alloc(num_words);
+    if (cache_ptr == NULL) {
+        // hand the block back, drc_run will make room and try again
+        block->free = true;
+        err = DRC_ERR_CACHE_FULL;
+        goto cleanup;
+    }
+    block->phys_offset = cache_ptr;
+    memcpy(cache_ptr, trans_cache, num_words * 4);
+    for (i = 0; i < num_v810_inst; i++) {
+        drc_setEntry(inst_cache[i].PC, cache_ptr + inst_cache[i].start_pos, block);
+    }
+
+    // Fifth pass: link
+    for (i = 0; i < num_fixups; i++) {
+        WORD *inst = cache_ptr + fixups[i].pos;
+        WORD *a64_dest = drc_getEntry(fixups[i].v810_dest, NULL);
+
+        if (a64_dest == cache_start) {
+            // Should be fixed, but just in case
+            dprintf(0, "WARN:can't jump to %lx\n", fixups[i].v810_dest);
+        }
+
+        if (fixups[i].cc < 0) {
+            a64_patch(inst, a64_dest);
+        } else if (a64_inRange19(inst, a64_dest)) {
+            // use a single conditional branch when it can reach
+            a64_ptr = inst;
+            a64_patch(a64_branch(fixups[i].cc), a64_dest);
+            NOP();
+        } else {
+            a64_patch(inst + 1, a64_dest);
+        }
+    }
+
+    block->size = num_words;
+
+cleanup:
+    return err;
+}
+
+// Allocate the AArch64-specific translation buffer
+void drc_backendInit(void) {
+    trans_cache = linearAlloc(MAX_A64_INST * 4);
+}
+
+void drc_backendExit(void) {
+    linearFree(trans_cache);
+}
+
+// Blocks here always return to drc_run and never set link_site
+void drc_linkExit(WORD *site, WORD PC, WORD *entry, exec_block *block) {}
+void drc_unlinkExit(WORD *site) {}
@@ -0,0 +1,153 @@
+// Defining v810_state offsets
+.struct 0
+state_regs:
+.struct state_regs + (4*32)
+state_statusregs:
+.struct state_statusregs + (4*32)
+state_pc:
+.struct state_pc + 4
+state_flags:
+.struct state_flags + 4
+state_exceptflags:
+.struct state_exceptflags + 4
+state_cycles:
+.struct state_cycles + 4
+state_cycles_until_event_partial:
+.struct state_cycles_until_event_partial + 4
+state_cycles_until_event_full:
+.struct state_cycles_until_event_full + 4
+
+// Defining exec_block offsets
+.struct 0
+block_phys_offset:
+.struct block_phys_offset + 8
+block_virt_loc:
+.struct block_virt_loc + 4
+block_size:
+.struct block_size + 4
+block_cycles:
+.struct block_cycles + 4
+block_reg_map_pad:
+.struct block_reg_map_pad + 4
+block_reg_map:
+.struct block_reg_map + 8
+
+.text
+
+// Loads (or stores) the cached V810 register in \reg, from slot \slot of the
+// reg map in x2
+.macro cachedReg op, reg, slot
+    ubfx    x3, x2, #(5*\slot), #5
+.ifc \op, ld
+    ldr     \reg, [x19, x3, lsl #2]
+.else
+    str     \reg, [x19, x3, lsl #2]
+.endif
+.endm
+
+// cycles += cuef - cuep
+// cuef = cuep
+.macro syncCycles
+    ldr     w2, [x19, #state_cycles_until_event_partial]
+    ldr     w3, [x19, #state_cycles_until_event_full]
+    ldr     w4, [x19, #state_cycles]
+    str     w2, [x19, #state_cycles_until_event_full]
+    sub     w3, w3, w2
+    add     w4, w4, w3
+    str     w4, [x19, #state_cycles]
+.endm
+
+// void drc_executeBlock(WORD* entrypoint, exec_block* block);
+
+.globl drc_executeBlock
+.type drc_executeBlock, %function
+drc_executeBlock:
+    stp     x29, x30, [sp, #-96]!
+    mov     x29, sp
+    stp     x19, x20, [sp, #16]
+    stp     x21, x22, [sp, #32]
+    stp     x23, x24, [sp, #48]
+    stp     x25, x26, [sp, #64]
+    stp     x27, x28, [sp, #80]
+
+    // The block leaves through the address at [sp]
+    adr     x16, postexec
+    stp     x16, x1, [sp, #-16]!
+
+    adrp    x19, :got:vb_state
+    ldr     x19, [x19, #:got_lo12:vb_state]
+    ldr     x19, [x19]
+
+    ldr     w16, [x19, #state_flags]
+    msr     nzcv, x16
+
+    // Load cached V810 registers (r0 is a placeholder for unused slots)
+    ldr     x2, [x1, #block_reg_map]
+    cachedReg ld, w21, 0
+    cachedReg ld, w22, 1
+    cachedReg ld, w23, 2
+    cachedReg ld, w24, 3
+    cachedReg ld, w25, 4
+    cachedReg ld, w26, 5
+    cachedReg ld, w27, 6
+    cachedReg ld, w28, 7
+
+    br      x0
+
+postexec:
+    ldr     x1, [sp, #8]
+    add     sp, sp, #16
+
+    // Store cached V810 registers
+    ldr     x2, [x1, #block_reg_map]
+    cachedReg st, w21, 0
+    cachedReg st, w22, 1
+    cachedReg st, w23, 2
+    cachedReg st, w24, 3
+    cachedReg st, w25, 4
+    cachedReg st, w26, 5
+    cachedReg st, w27, 6
+    cachedReg st, w28, 7
+
+    mrs     x16, nzcv
+    str     w16, [x19, #state_flags]
+
+    syncCycles
+
+    ldp     x27, x28, [sp, #80]
+    ldp     x25, x26, [sp, #64]
+    ldp     x23, x24, [sp, #48]
+    ldp     x21, x22, [sp, #32]
+    ldp     x19, x20, [sp, #16]
+    ldp     x29, x30, [sp], #96
+    ret
+
+// Checks for pending interrupts and exits the block if necessary
+// int drc_handleInterrupts(WORD flags, WORD PC), called with the flags
+// also in x20
+.globl drc_handleInterrupts
+.type drc_handleInterrupts, %function
+drc_handleInterrupts:
+    stp     x29, x30, [sp, #-16]!
+    mov     x29, sp
+
+    // Save flags and PC
+    str     w0, [x19, #state_flags]
+    str     w1, [x19, #state_pc]
+
+    syncCycles
+
+    mov     w0, w4
+    bl      serviceInt
+    ldp     x29, x30, [sp], #16
+    cbnz    w0, exit_block
+
+    // Return to the block
+    ret
+
+exit_block:
+    // Restore the flags and exit the block, ignoring the return address
+    msr     nzcv, x20
+    b       postexec
+
+.section .note.GNU-stack,"",%progbits
@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <string.h>
+#include "vb_types.h"
+#include "vb_set.h"
+#include "v810_opt.h"
+#include "busywait.h"
+
+// Workaround for an issue where the CPSR is modified outside of the block
+// before a conditional branch.
+// Sets save_flags for all unconditional instructions prior to a branch.
+void busywait_findLastConditionalInst(v810_instruction *insts, int pos) {
+    bool save_flags = true, busywait = insts[pos].branch_offset <= 0 && insts[pos].opcode != V810_OP_SETF;
+    if (insts[pos].branch_offset == 0) {
+        // catch edge case of block that starts with branch to self
+        dprintf(0, "busywait at %lx to %lx\n", insts[pos].PC, insts[pos].PC + insts[pos].branch_offset);
+        insts[pos].busywait = true;
+        busywait = false;
+    }
+    for (int i = pos - 1; i >= 0; i--) {
+        switch (insts[i].opcode) {
+            case V810_OP_LD_W:
+            case V810_OP_IN_W:
+                insts[i].save_flags = save_flags;
+                // if a register is loading itself, it might not be a busywait
+                if (insts[i].reg1 == insts[i].reg2) {
+                    busywait = false;
+                }
+                break;
+            case V810_OP_LD_B:
+            case V810_OP_LD_H:
+            case V810_OP_IN_B:
+            case V810_OP_IN_H:
+            case V810_OP_ST_B:
+            case V810_OP_ST_H:
+            case V810_OP_ST_W:
+            case V810_OP_OUT_B:
+            case V810_OP_OUT_H:
+            case V810_OP_OUT_W:
+            case V810_OP_MOV:
+            case V810_OP_MOV_I:
+            case V810_OP_MOVEA:
+            case V810_OP_MOVHI:
+                insts[i].save_flags = save_flags;
+                break;
+            case V810_OP_AND:
+            case V810_OP_ANDI:
+            case V810_OP_CMP:
+            case V810_OP_CMP_I:
+                // affects flags but is used in busywait
+                save_flags = false;
+                break;
+            case V810_OP_JAL:
+                // nester's funky bowling calls a function to do its busywait read
+                // and it does this several times
+                if (memcmp(tVBOpt.GAME_ID, "01VNFE", 6) == 0 && (
+                    insts[i].PC + insts[i].branch_offset == 0x07005326 ||
+                    insts[i].PC + insts[i].branch_offset == 0x07001f2c
+                )) break;
+            case V810_OP_ADD:
+            case V810_OP_OR:
+                // only certain operators are ok for busywait here, otherwise fallthrough
+                if (
+                    (insts[i].opcode == V810_OP_OR && insts[i].reg1 == insts[i].reg2) ||
+                    (insts[i].opcode == V810_OP_ADD && insts[i].reg1 == 0)
+                ) {
+                    save_flags = false;
+                    break;
+                }
+            case V810_OP_SHR_I:
+                // virtual league baseball 2 uses a shr in busywaits in several places
+                if (i == pos - 1 && i >= 2
+                    && insts[i - 2].opcode == V810_OP_MOVHI
+                    && insts[i - 2].reg1 == 0
+                    && insts[i - 1].opcode == V810_OP_LD_H
+                    && insts[i - 1].reg1 == insts[i - 2].reg2
+                    && insts[i].opcode == V810_OP_SHR_I
+                    && insts[i].reg2 == insts[i - 1].reg2
+                    && insts[pos].PC + insts[pos].branch_offset == insts[i - 2].PC
+                ) {
+                    save_flags = false;
+                    break;
+                }
+            default:
+                return;
+        }
+        if (busywait && insts[i].PC <= insts[pos].PC + insts[pos].branch_offset) {
+            dprintf(0, "busywait at %lx to %lx\n", insts[pos].PC, insts[pos].PC + insts[pos].branch_offset);
+            insts[pos].busywait = true;
+            busywait = false;
+        }
+    }
+}
+
+void busywait_findWaterworld(v810_instruction *insts, int size) {
+    for (int i = 3; i < size; i++) {
+        // scan for this pattern:
+        // ld.h <...>[gp], r10
+        // cmp <...>, r10
+        // b<...> +
+        // jr <...>
+        // + ...
+        if (insts[i].opcode == V810_OP_JR && abs(insts[i].branch_offset) < 1024 &&
+            insts[i - 1].branch_offset == 6 &&
+            insts[i - 2].opcode == V810_OP_CMP_I && insts[i - 2].reg2 == 10 &&
+            insts[i - 3].opcode == V810_OP_LD_H && insts[i - 3].reg1 == 4 && insts[i - 3].reg2 == 10
+        ) {
+            // check some known combinations
+            if ((insts[i - 1].opcode == V810_OP_BNE && insts[i - 2].imm == 0 && insts[i - 3].imm == 0x8030) ||
+                (insts[i - 1].opcode == V810_OP_BE && insts[i - 2].imm == 1 && insts[i - 3].imm == 0x8010)
+            ) {
+                // it's probably safe at this point
+                insts[i].busywait = true;
+                dprintf(1, "waterworld busywait at %lx\n", insts[i].PC);
+            }
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#include "events.h"
+
+static inline bool before(const event_queue *q, int a, int b) {
+    return (SWORD)(q->when[q->heap[a]] - q->when[q->heap[b]]) < 0;
+}
+
+static inline void swap(event_queue *q, int a, int b) {
+    BYTE tmp = q->heap[a];
+    q->heap[a] = q->heap[b];
+    q->heap[b] = tmp;
+    q->pos[q->heap[a]] = a;
+    q->pos[q->heap[b]] = b;
+}
+
+static void siftUp(event_queue *q, int i) {
+    while (i > 0 && before(q, i, (i - 1) / 2)) {
+        swap(q, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void siftDown(event_queue *q, int i) {
+    while (true) {
+        int min = i;
+        int l = 2 * i + 1, r = 2 * i + 2;
+        if (l < q->count && before(q, l, min)) min = l;
+        if (r < q->count && before(q, r, min)) min = r;
+        if (min == i) return;
+        swap(q, i, min);
+        i = min;
+    }
+}
+
+void events_clear(event_queue *q) {
+    q->count = 0;
+    for (int i = 0; i < EVENT_COUNT; i++) {
+        q->when[i] = 0;
+        q->pos[i] = EVENT_NONE;
+    }
+}
+
+void events_schedule(event_queue *q, event_id id, WORD when) {
+    int i = q->pos[id];
+    if (i == EVENT_NONE) {
+        i = q->count++;
+        q->heap[i] = id;
+        q->pos[id] = i;
+        q->when[id] = when;
+        siftUp(q, i);
+    } else {
+        bool earlier = (SWORD)(when - q->when[id]) < 0;
+        q->when[id] = when;
+        if (earlier) siftUp(q, i);
+        else siftDown(q, i);
+    }
+}
+
+void events_cancel(event_queue *q, event_id id) {
+    int i = q->pos[id];
+    if (i == EVENT_NONE) return;
+    q->pos[id] = EVENT_NONE;
+    if (i == --q->count) return;
+    // fill the hole with the last event, which can belong above or below it
+    BYTE moved = q->heap[q->count];
+    q->heap[i] = moved;
+    q->pos[moved] = i;
+    siftUp(q, i);
+    siftDown(q, q->pos[moved]);
+}
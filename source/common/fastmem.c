@@ -0,0 +1,122 @@
+#define _GNU_SOURCE
+#include "fastmem.h"
+
+#if FASTMEM_AVAILABLE
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "drc_core.h"
+
+// Backing file layout: the ROM, then WRAM and SRAM for each player
+#define FASTMEM_WRAM_SIZE   0x10000
+#define FASTMEM_SRAM_SIZE   0x4000
+#define FASTMEM_PLAYER_OFF(i) (MAX_ROM_SIZE + (i) * (FASTMEM_WRAM_SIZE + FASTMEM_SRAM_SIZE))
+
+static int fastmem_fd = -1;
+static BYTE *fastmem_regions[2];
+static bool fastmem_rom;
+
+// Maps size bytes of the file at every multiple of size within [start, end)
+static bool mirror(BYTE *start, BYTE *end, WORD size, off_t off, int prot) {
+    for (BYTE *p = start; p < end; p += size) {
+        if (mmap(p, size, prot, MAP_SHARED | MAP_FIXED, fastmem_fd, off) == MAP_FAILED) return false;
+    }
+    return true;
+}
+
+bool fastmem_init(void) {
+    // SRAM is the smallest mirror, so it has to fill whole host pages
+    if (FASTMEM_SRAM_SIZE % sysconf(_SC_PAGESIZE) != 0) return false;
+
+    fastmem_fd = memfd_create("v810", MFD_CLOEXEC);
+    if (fastmem_fd < 0) return false;
+    if (ftruncate(fastmem_fd, FASTMEM_PLAYER_OFF(2)) != 0) goto fail;
+
+    BYTE *rom = mmap(NULL, MAX_ROM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fastmem_fd, 0);
+    if (rom == MAP_FAILED) goto fail;
+
+    for (int i = 0; i < 2; i++) {
+        BYTE *base = mmap(NULL, FASTMEM_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED) goto fail_rom;
+        fastmem_regions[i] = base;
+        if (!mirror(base + 0x05000000, base + 0x06000000, FASTMEM_WRAM_SIZE, FASTMEM_PLAYER_OFF(i), PROT_READ | PROT_WRITE)) goto fail_rom;
+        if (!mirror(base + 0x06000000, base + 0x07000000, FASTMEM_SRAM_SIZE, FASTMEM_PLAYER_OFF(i) + FASTMEM_WRAM_SIZE, PROT_READ | PROT_WRITE)) goto fail_rom;
+    }
+
+    // everything is in place, so swap the buffers over
+    memcpy(rom, V810_ROM1.pmemory, MAX_ROM_SIZE);
+    free(V810_ROM1.pmemory);
+    V810_ROM1.pmemory = rom;
+    V810_ROM1.off = (size_t)V810_ROM1.pmemory - V810_ROM1.lowaddr;
+    for (int i = 0; i < 2; i++) {
+        V810_MEMORYFETCH *wram = &vb_players[i].V810_VB_RAM;
+        V810_MEMORYFETCH *sram = &vb_players[i].V810_GAME_RAM;
+        BYTE *base = fastmem_regions[i];
+        memcpy(base + 0x05000000, wram->pmemory, FASTMEM_WRAM_SIZE);
+        free(wram->pmemory);
+        wram->pmemory = base + 0x05000000;
+        wram->off = (size_t)wram->pmemory - wram->lowaddr;
+        memcpy(base + 0x06000000, sram->pmemory, FASTMEM_SRAM_SIZE);
+        free(sram->pmemory);
+        sram->pmemory = base + 0x06000000;
+        sram->off = (size_t)sram->pmemory - sram->lowaddr;
+    }
+    return true;
+
+fail_rom:
+    munmap(rom, MAX_ROM_SIZE);
+fail:
+    for (int i = 0; i < 2; i++) {
+        if (fastmem_regions[i]) munmap(fastmem_regions[i], FASTMEM_SIZE);
+        fastmem_regions[i] = NULL;
+    }
+    close(fastmem_fd);
+    fastmem_fd = -1;
+    return false;
+}
+
+void fastmem_exit(void) {
+    if (fastmem_fd < 0) return;
+    munmap(V810_ROM1.pmemory, MAX_ROM_SIZE);
+    V810_ROM1.pmemory = NULL;
+    for (int i = 0; i < 2; i++) {
+        munmap(fastmem_regions[i], FASTMEM_SIZE);
+        fastmem_regions[i] = NULL;
+        vb_players[i].V810_VB_RAM.pmemory = NULL;
+        vb_players[i].V810_GAME_RAM.pmemory = NULL;
+    }
+    close(fastmem_fd);
+    fastmem_fd = -1;
+    fastmem_rom = false;
+}
+
+void fastmem_mapRom(void) {
+    if (fastmem_fd < 0) return;
+    WORD size = V810_ROM1.highaddr + 1 - V810_ROM1.lowaddr;
+    // mirroring with & highaddr only repeats cleanly for whole pages of a power of two
+    fastmem_rom = (size & (size - 1)) == 0 && size % sysconf(_SC_PAGESIZE) == 0;
+    for (int i = 0; i < 2; i++) {
+        BYTE *rom = fastmem_regions[i] + 0x07000000;
+        if (fastmem_rom) {
+            // read only, so stray writes fault instead of patching the ROM
+            fastmem_rom = mirror(rom, rom + 0x01000000, size, 0, PROT_READ);
+        }
+        if (!fastmem_rom) {
+            // drop any mirrors of the previous ROM
+            mmap(rom, 0x01000000, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        }
+    }
+}
+
+BYTE *fastmem_base(const VB_STATE *state) {
+    if (fastmem_fd < 0) return NULL;
+    // savestates swap buffers between players, so go by where WRAM is
+    return state->V810_VB_RAM.pmemory - 0x05000000;
+}
+
+bool fastmem_hasRom(void) {
+    return fastmem_rom;
+}
+
+#endif
@@ -0,0 +1,261 @@
+#include <string.h>
+
+#ifdef __3DS__
+#include <3ds.h>
+#include <citro3d.h>
+#endif
+
+#include "vb_types.h"
+#include "vb_set.h"
+#include "vb_dsp.h"
+#include "v810_cpu.h"
+#include "v810_mem.h"
+#include "v810_opt.h"
+#include "hle.h"
+
+// Getters, which games call rather than loading from hardware registers
+// themselves. The dynarec decodes the jal as the load instead.
+static const BYTE byte_getter_code[] = {
+    0x46, 0xc1, 0x00, 0x00, // ld.b [r6], r10
+    0x1f, 0x18,             // jmp  [lp]
+};
+static const BYTE hword_getter_code[] = {
+    0x46, 0xc5, 0x00, 0x00, // ld.h [r6], r10
+    0x1f, 0x18,             // jmp  [lp]
+};
+static const BYTE hword_getter_jr_code[] = {
+    0x46, 0xc5, 0x00, 0x00, // ld.h [r6], r10
+    0x00, 0xa8, 0x04, 0x00, // jr   +4
+    0x1f, 0x18,             // jmp  [lp]
+};
+
+static int getByte(void) {
+    vb_state->v810_state.P_REG[10] = (SBYTE)mem_rbyte(vb_state->v810_state.P_REG[6]);
+    return opcycle[V810_OP_LD_B] + opcycle[V810_OP_JMP];
+}
+
+static int getHword(void) {
+    vb_state->v810_state.P_REG[10] = (SHWORD)mem_rhword(vb_state->v810_state.P_REG[6]);
+    return opcycle[V810_OP_LD_H] + opcycle[V810_OP_JMP];
+}
+
+static int getHwordJr(void) {
+    return getHword() + opcycle[V810_OP_JR];
+}
+
+// This function clears the screen, so we should do the same
+static void golf_clearScreen(void) {
+    if (!emulating_self) return;
+#ifdef __3DS__
+    C3D_FrameBegin(0);
+    for (int i = 0; i < 2; i++) {
+        C3D_RenderTargetClear(screenTargetHard[i], C3D_CLEAR_COLOR, 0, 0);
+    }
+    C3D_FrameEnd(0);
+#endif
+}
+
+// Baseball 2 unpacked sprite cache. Not strictly required for performance,
+// but since we're HLE'ing this anyway, might as well.
+#define BASEBALL2_SPRITES_COUNT 512
+static bool baseball2_sprites_is_unpacked[BASEBALL2_SPRITES_COUNT];
+static WORD baseball2_sprites_address[BASEBALL2_SPRITES_COUNT];
+static BYTE baseball2_sprites_unpacked[BASEBALL2_SPRITES_COUNT][32][32];
+
+static void baseball2_scaling(WORD in_img, WORD out_img, WORD scale_fixed) {
+    // The input/output format is 4x4 tiles
+    void *in_ptr = (void*)(V810_ROM1.off + in_img);
+    void *out_ptr = (void*)(vb_state->V810_VB_RAM.off + out_img);
+
+    // Get cached sprite if possible
+    unsigned sprite_id = (in_img >> 8) % BASEBALL2_SPRITES_COUNT;
+    BYTE (*in_unpacked)[32] = baseball2_sprites_unpacked[sprite_id];
+    bool is_unpacked = baseball2_sprites_is_unpacked[sprite_id] && baseball2_sprites_address[sprite_id] == in_img;
+    if (!is_unpacked) {
+        // Cached doesn't exist, so unpack input image
+        baseball2_sprites_is_unpacked[sprite_id] = true;
+        baseball2_sprites_address[sprite_id] = in_img;
+        for (int ty = 0; ty < 4; ty++) {
+            for (int tx = 0; tx < 4; tx++) {
+                for (int y = 0; y < 8; y++) {
+                    HWORD row = ((HWORD*)in_ptr)[ty*8*4+tx*8+y];
+                    for (int x = 0; x < 8; x++) {
+                        in_unpacked[ty*8+y][tx*8+x] = (row >> (x*2)) & 3;
+                    }
+                }
+            }
+        }
+    }
+
+    // Pre-compute x offsets
+    int xcount = 32;
+    BYTE x_offsets[32];
+    for (int i = 0; i < 32; i++) {
+        unsigned x_offset = (i * scale_fixed) >> 16;
+        if (x_offset >= 32) {
+            xcount = i;
+            break;
+        }
+        x_offsets[i] = x_offset;
+    }
+
+    // Scale
+    static BYTE out_unpacked[32][32];
+    memset(out_unpacked, 0, sizeof(out_unpacked));
+    for (
+        unsigned y = 0, scaled_y_fp = 0, scaled_y = 0;
+        y < 32 && scaled_y < 32;
+        y++, scaled_y_fp += scale_fixed, scaled_y = scaled_y_fp >> 16
+    ) {
+        unsigned scaled_y = scaled_y_fp >> 16;
+        for (unsigned x = 0; x < xcount; x++) {
+            unsigned scaled_x = x_offsets[x];
+            out_unpacked[y][x] = in_unpacked[scaled_y][scaled_x];
+        }
+    }
+    
+    // Re-pack into output
+    for (int ty = 0; ty < 4; ty++) {
+        for (int tx = 0; tx < 4; tx++) {
+            for (int y = 0; y < 8; y++) {
+                HWORD row = 0;
+                for (int x = 0; x < 8; x++) {
+                    row |= out_unpacked[ty*8+y][tx*8+x] << (x*2);
+                }
+                ((HWORD*)out_ptr)[ty*8*4+tx*8+y] = row;
+            }
+        }
+    }
+}
+
+// In the overhead view in Virtual League Baseball 2, the fielders are scaled
+// in software. This algorithm is slow when recompiled, so we override it with
+// a faster native implementation.
+static int baseball2_scalingCall(void) {
+    WORD *regs = vb_state->v810_state.P_REG;
+    // Verify that our values make sense, otherwise revert to original
+    if (regs[17] >> 20 != 0x070 || regs[18] >> 16 != 0x0500) return HLE_PASS;
+    baseball2_scaling(regs[17], regs[18], regs[19]);
+    // takes no time, as it always has
+    return 0;
+}
+
+// In Virtual League Baseball 2's overhead view, the draw order of the
+// fielders is sorted very inefficiently: each fielder is a 32-byte object,
+// and every swap in the sort swaps the entire set of 32 bytes. This sorts
+// the same array much more efficiently.
+static void baseball2_sort(void) {
+    u8 ids[13];
+    typedef struct {
+        WORD padding1;
+        HWORD key;
+        HWORD padding2[sizeof(ids)];
+    } SortableItem;
+    SortableItem *out = (SortableItem*)(vb_state->V810_VB_RAM.pmemory + 0x93a0);
+    SortableItem originals[sizeof(ids)];
+    memcpy(originals, out, sizeof(originals));
+    for (int i = 0; i < sizeof(ids); i++) ids[i] = i;
+    // insertion sort
+    for (int i = 1; i < sizeof(ids); i++) {
+        u8 x = ids[i];
+        u8 key = originals[x].key;
+        int j;
+        for (j = i; j > 0 && originals[ids[j - 1]].key > key; j--) {
+            ids[j] = ids[j - 1];
+        }
+        ids[j] = x;
+    }
+    for (int i = 0; i < sizeof(ids); i++) {
+        memcpy(&out[i], &originals[ids[i]], sizeof(out[i]));
+    }
+}
+
+const hle_entry hle_entries[] = {
+    {
+        .name = "byte getter", .kind = HLE_CALL,
+        .code = byte_getter_code, .code_size = sizeof(byte_getter_code),
+        .inline_op = V810_OP_LD_B, .inline_reg1 = 6, .inline_reg2 = 10,
+        .call = getByte,
+    },
+    {
+        .name = "hword getter", .kind = HLE_CALL,
+        .code = hword_getter_code, .code_size = sizeof(hword_getter_code),
+        .inline_op = V810_OP_LD_H, .inline_reg1 = 6, .inline_reg2 = 10,
+        .call = getHword,
+    },
+    {
+        .name = "hword getter (jr)", .kind = HLE_CALL,
+        .code = hword_getter_jr_code, .code_size = sizeof(hword_getter_jr_code),
+        .inline_op = V810_OP_LD_H, .inline_reg1 = 6, .inline_reg2 = 10,
+        .call = getHwordJr,
+    },
+    {
+        .name = "Golf (U) screen clear", .kind = HLE_HOOK,
+        .game_id = "01VVGE", .PC = 0x0700ca64,
+        .hook = golf_clearScreen,
+    },
+    {
+        .name = "T&E Virtual Golf (J) screen clear", .kind = HLE_HOOK,
+        .game_id = "E4VVGJ", .PC = 0x0701602a,
+        .hook = golf_clearScreen,
+    },
+    // the ROM size checks are for memory safety
+    {
+        .name = "Virtual League Baseball 2 sprite scaling", .kind = HLE_CALL,
+        .game_id = "7FVVQE", .rom_size = 0x100000, .PC = 0x070077ca,
+        .call = baseball2_scalingCall,
+    },
+    {
+        .name = "Virtual League Baseball 2 fielder sort", .kind = HLE_HOOK,
+        .game_id = "7FVVQE", .rom_size = 0x100000, .PC = 0x07007428,
+        .resume_PC = 0x070074b8, .hook = baseball2_sort,
+    },
+};
+
+#define HLE_ENTRY_COUNT (sizeof(hle_entries) / sizeof(hle_entries[0]))
+
+// Whether each entry applies to the loaded game
+static bool hle_active[HLE_ENTRY_COUNT];
+
+void hle_reset(void) {
+    for (int i = 0; i < HLE_ENTRY_COUNT; i++) {
+        const hle_entry *entry = &hle_entries[i];
+        hle_active[i] = (!entry->game_id || memcmp(tVBOpt.GAME_ID, entry->game_id, 6) == 0) &&
+            V810_ROM1.size >= entry->rom_size;
+        if (hle_active[i] && entry->game_id)
+            dprintf(0, "[HLE]: using %s\n", entry->name);
+    }
+    memset(baseball2_sprites_is_unpacked, 0, sizeof(baseball2_sprites_is_unpacked));
+}
+
+static bool hle_matches(const hle_entry *entry, BYTE kind, WORD PC) {
+    if (entry->kind != kind) return false;
+    if (entry->PC) return entry->PC == PC;
+    return PC + entry->code_size - 1 <= V810_ROM1.highaddr &&
+        !memcmp((BYTE*)V810_ROM1.off + PC, entry->code, entry->code_size);
+}
+
+static int hle_findKind(BYTE kind, WORD PC) {
+    if ((PC & 0x07000000) != 0x07000000) return 0;
+    PC &= V810_ROM1.highaddr;
+    for (int i = 0; i < HLE_ENTRY_COUNT; i++) {
+        if (hle_active[i] && hle_matches(&hle_entries[i], kind, PC)) return i + 1;
+    }
+    return 0;
+}
+
+int hle_find(WORD PC) {
+    return hle_findKind(HLE_CALL, PC);
+}
+
+int hle_findHook(WORD PC) {
+    return hle_findKind(HLE_HOOK, PC);
+}
+
+int hle_call(int id) {
+    return hle_entries[id - 1].call();
+}
+
+void hle_runHook(WORD id) {
+    hle_entries[id - 1].hook();
+}
@@ -1,9 +1,67 @@
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include "v810_cpu.h"
 #include "v810_mem.h"
 #include "v810_opt.h"
 #include "vb_types.h"
 #include "drc_core.h"
+#include "drc_worker.h"
+#include "interpreter.h"
+#include "busywait.h"
+#include "hle.h"
+
+// Dispatch with computed goto instead of a switch where GCC extensions exist
+#ifndef INTERPRETER_THREADED
+#ifdef __GNUC__
+#define INTERPRETER_THREADED 1
+#else
+#define INTERPRETER_THREADED 0
+#endif
+#endif
+
+predecoded_inst interpreter_wram_cache[2][PREDECODE_WRAM_SIZE];
+// With a dynarec, the interpreter only runs ROM code while the worker
+// translates, so there's no cache without one
+static predecoded_inst *rom_cache;
+static WORD rom_cache_size;
+
+// How the condition flags in PSW relate to the lazy flag state in interpreter_run
+enum {
+    FLAGS_PSW,      // PSW is up to date
+    FLAGS_ADD,      // res = a + b
+    FLAGS_SUB,      // res = a - b
+    FLAGS_LOGIC,    // overflow clear, carry in a
+};
+
+// z/s/ov/cy for the last flag-setting instruction
+static inline WORD lazy_flags(BYTE kind, WORD res, WORD a, WORD b) {
+    WORD flags = (res == 0) | (((SWORD)res < 0) << 1);
+    switch (kind) {
+        case FLAGS_ADD:
+            flags |= ((SWORD)(~(a ^ b) & (a ^ res)) < 0) << 2;
+            flags |= (res < a) << 3;
+            break;
+        case FLAGS_SUB:
+            flags |= ((SWORD)((a ^ b) & (a ^ res)) < 0) << 2;
+            flags |= (a < b) << 3;
+            break;
+        case FLAGS_LOGIC:
+            flags |= a << 3;
+            break;
+    }
+    return flags;
+}
+
+// Just the carry, for instructions that leave it alone
+static inline WORD lazy_carry(BYTE kind, WORD res, WORD a, WORD b) {
+    switch (kind) {
+        case FLAGS_ADD: return res < a;
+        case FLAGS_SUB: return a < b;
+        case FLAGS_LOGIC: return a;
+        default: return (vb_state->v810_state.S_REG[PSW] >> 3) & 1;
+    }
+}
 
 static bool get_cond(BYTE code, WORD psw) {
     bool cond = false;
@@ -21,17 +79,199 @@ static bool get_cond(BYTE code, WORD psw) {
     return cond;
 }
 
+static void predecode(predecoded_inst *inst, WORD PC) {
+    HWORD instr = mem_rhword(PC);
+    BYTE opcode = instr >> 10;
+    inst->reg1 = instr & 31;
+    inst->reg2 = (instr >> 5) & 31;
+    inst->cycles = opcycle[opcode];
+    if (opcode < 0x20) {
+        // small instr
+        inst->imm = inst->reg1 & 0x10 ? inst->reg1 | 0xfffffff0 : inst->reg1;
+    } else if (opcode < 0x28) {
+        // branch
+        inst->reg1 = (instr >> 9) & 0xf;
+        inst->reg2 = false;
+        inst->imm = instr & (1 << 8) ? (instr | 0xfffffe00) : (instr & 0x1ff);
+    } else {
+        // long instr
+        HWORD instr2 = mem_rhword(PC + 2);
+        switch (opcode) {
+            case V810_OP_JAL: case V810_OP_JR: {
+                SWORD disp = instr2 | ((SWORD)instr << 16);
+                if (disp & 0x02000000) disp |= 0xfc000000;
+                else disp &= ~(0xfc000000);
+                inst->imm = disp;
+                // for jal, the routine run natively instead, if any
+                inst->reg2 = opcode == V810_OP_JAL ? hle_find(PC + disp) : 0;
+                break;
+            }
+            case V810_OP_ORI: case V810_OP_ANDI: case V810_OP_XORI:
+                inst->imm = instr2;
+                break;
+            case V810_OP_MOVHI:
+                inst->imm = (WORD)instr2 << 16;
+                break;
+            case V810_OP_FPP:
+                inst->imm = instr2 >> 10;
+                break;
+            default:
+                inst->imm = (SHWORD)instr2;
+                break;
+        }
+    }
+    inst->opcode = opcode;
+}
+
+// Longest loop body checked for busywaits
+#define BUSYWAIT_MAX_INST 16
+
+// Checks whether the backwards branch at PC closes a loop that only polls
+static bool is_busywait(WORD PC, BYTE cond, SWORD disp) {
+    v810_instruction insts[BUSYWAIT_MAX_INST + 1];
+    memset(insts, 0, sizeof(insts));
+    int n = 0;
+    WORD cur_PC = PC + disp;
+    for (; cur_PC < PC; n++) {
+        if (n == BUSYWAIT_MAX_INST) return false;
+        predecoded_inst inst;
+        predecode(&inst, cur_PC);
+        insts[n].PC = cur_PC;
+        insts[n].opcode = inst.opcode < 0x20 || inst.opcode >= 0x28 ? inst.opcode : 0x40 | inst.reg1;
+        insts[n].reg1 = inst.reg1;
+        insts[n].reg2 = inst.reg2;
+        insts[n].imm = inst.imm;
+        if (inst.opcode == V810_OP_JAL || inst.opcode == V810_OP_JR) insts[n].branch_offset = (SWORD)inst.imm;
+        cur_PC += inst.opcode < 0x28 ? 2 : 4;
+    }
+    if (cur_PC != PC) return false;
+    insts[n].PC = PC;
+    insts[n].opcode = 0x40 | cond;
+    insts[n].branch_offset = disp;
+    busywait_findLastConditionalInst(insts, n);
+    return insts[n].busywait;
+}
+
+void interpreter_clearCache(void) {
+    memset(interpreter_wram_cache, PREDECODE_INVALID, sizeof(interpreter_wram_cache));
+    #if DRC_AVAILABLE
+    if (!drc_workerRunning()) return;
+    #endif
+    if (rom_cache_size != V810_ROM1.size) {
+        free(rom_cache);
+        rom_cache = malloc(V810_ROM1.size / 2 * sizeof(predecoded_inst));
+        rom_cache_size = rom_cache ? V810_ROM1.size : 0;
+    }
+    if (rom_cache) memset(rom_cache, PREDECODE_INVALID, V810_ROM1.size / 2 * sizeof(predecoded_inst));
+}
+
+static inline predecoded_inst *fetch(WORD PC, predecoded_inst *wram_cache, predecoded_inst *uncached) {
+    predecoded_inst *inst = uncached;
+    if ((PC & 0x07000000) == 0x05000000) {
+        inst = &wram_cache[(PC & 0xfffe) >> 1];
+    }
+    else if ((PC & 0x07000000) == 0x07000000 && rom_cache) {
+        inst = &rom_cache[(PC & (V810_ROM1.size - 1)) >> 1];
+        if (inst->opcode == PREDECODE_INVALID) {
+            predecode(inst, PC);
+            // ROM can't change under us, so its loops only need checking once
+            if (inst->opcode >= 0x20 && inst->opcode < 0x28 && (SWORD)inst->imm <= 0) {
+                inst->reg2 = is_busywait(PC, inst->reg1, inst->imm);
+            }
+        }
+        return inst;
+    }
+    if (inst == uncached || inst->opcode == PREDECODE_INVALID) predecode(inst, PC);
+    return inst;
+}
+
 int interpreter_run(void) {
     // keep PC and cycles in local variables for extra speed
-    // can't do this with PSW because interrupts modify it
+    // PSW flags are only computed when something reads them
     WORD PC = vb_state->v810_state.PC;
     WORD last_PC = PC;
     WORD cycles = vb_state->v810_state.cycles;
     BYTE last_opcode = 0;
     WORD target = cycles;
+    predecoded_inst *wram_cache = interpreter_wram_cache[vb_state - vb_players];
+    predecoded_inst uncached;
+    predecoded_inst *inst;
+    BYTE opcode, reg1, reg2;
+    WORD reg1_val, imm;
+    BYTE flag_kind = FLAGS_PSW;
+    WORD flag_res = 0, flag_a = 0, flag_b = 0;
+
+    #define SET_FLAGS(kind, res, a, b) \
+        flag_kind = kind; \
+        flag_res = res; \
+        flag_a = a; \
+        flag_b = b;
+    // z and s from res, ov cleared, cy kept
+    #define SET_FLAGS_LOGIC(res) \
+        flag_a = lazy_carry(flag_kind, flag_res, flag_a, flag_b); \
+        flag_kind = FLAGS_LOGIC; \
+        flag_res = res;
+    // Writes the pending flags back to PSW
+    #define SYNC_FLAGS() \
+        if (flag_kind != FLAGS_PSW) { \
+            vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | lazy_flags(flag_kind, flag_res, flag_a, flag_b); \
+            flag_kind = FLAGS_PSW; \
+        }
+
+    // Fetches the next instruction, leaving PC after it
+    #define FETCH() \
+        inst = fetch(PC, wram_cache, &uncached); \
+        opcode = inst->opcode; \
+        reg1 = inst->reg1; \
+        reg2 = inst->reg2; \
+        imm = inst->imm; \
+        reg1_val = reg1 ? vb_state->v810_state.P_REG[reg1] : 0; \
+        cycles += inst->cycles; \
+        PC += opcode < 0x28 ? 2 : 4;
+
+    #if INTERPRETER_THREADED
+    static const void *const handlers[0x40] = {
+        [0 ... 0x3f] = &&op_invalid,
+        [V810_OP_MOV] = &&op_MOV, [V810_OP_ADD] = &&op_ADD, [V810_OP_SUB] = &&op_SUB, [V810_OP_CMP] = &&op_CMP,
+        [V810_OP_SHL] = &&op_SHL, [V810_OP_SHR] = &&op_SHR, [V810_OP_JMP] = &&op_JMP, [V810_OP_SAR] = &&op_SAR,
+        [V810_OP_MUL] = &&op_MUL, [V810_OP_DIV] = &&op_DIV, [V810_OP_MULU] = &&op_MULU, [V810_OP_DIVU] = &&op_DIVU,
+        [V810_OP_OR] = &&op_OR, [V810_OP_AND] = &&op_AND, [V810_OP_XOR] = &&op_XOR, [V810_OP_NOT] = &&op_NOT,
+        [V810_OP_MOV_I] = &&op_MOV_I, [V810_OP_ADD_I] = &&op_ADD_I, [V810_OP_SETF] = &&op_SETF, [V810_OP_CMP_I] = &&op_CMP_I,
+        [V810_OP_SHL_I] = &&op_SHL_I, [V810_OP_SHR_I] = &&op_SHR_I, [V810_OP_CLI] = &&op_CLI, [V810_OP_SAR_I] = &&op_SAR_I,
+        [V810_OP_RETI] = &&op_RETI, [V810_OP_HALT] = &&op_HALT, [V810_OP_LDSR] = &&op_LDSR, [V810_OP_STSR] = &&op_STSR,
+        [V810_OP_SEI] = &&op_SEI, [V810_OP_BSTR] = &&op_BSTR,
+        [0x20 ... 0x27] = &&op_branch,
+        [V810_OP_MOVEA] = &&op_MOVEA, [V810_OP_ADDI] = &&op_ADDI, [V810_OP_JR] = &&op_JR, [V810_OP_JAL] = &&op_JAL,
+        [V810_OP_ORI] = &&op_ORI, [V810_OP_ANDI] = &&op_ANDI, [V810_OP_XORI] = &&op_XORI, [V810_OP_MOVHI] = &&op_MOVHI,
+        [V810_OP_LD_B] = &&op_LD_B, [V810_OP_LD_H] = &&op_LD_H, [V810_OP_LD_W] = &&op_LD_W,
+        [V810_OP_ST_B] = &&op_ST_B, [V810_OP_ST_H] = &&op_ST_H, [V810_OP_ST_W] = &&op_ST_W,
+        [V810_OP_IN_B] = &&op_IN_B, [V810_OP_IN_H] = &&op_IN_H, [V810_OP_IN_W] = &&op_IN_W,
+        [V810_OP_OUT_B] = &&op_OUT_B, [V810_OP_OUT_H] = &&op_OUT_H, [V810_OP_OUT_W] = &&op_OUT_W,
+        [V810_OP_FPP] = &&op_FPP,
+    };
+    // Each handler dispatches the next instruction itself. Interrupts are
+    // only checked after branches and jumps, like the dynarec does.
+    #define OP(name) op_##name
+    #define OP_BRANCH op_branch
+    #define OP_INVALID op_invalid
+    #define NEXT() \
+        last_opcode = opcode; \
+        last_PC = PC; \
+        FETCH(); \
+        goto *handlers[opcode]
+    #define NEXT_JUMP() goto jump
+    #else
+    #define OP(name) case V810_OP_##name
+    #define OP_BRANCH case 0x20 ... 0x27
+    #define OP_INVALID default
+    #define NEXT() break
+    #define NEXT_JUMP() break
+    #endif
+
     do {
         if ((SWORD)(target - cycles) <= 0) {
             vb_state->v810_state.PC = PC;
+            SYNC_FLAGS();
             if (serviceInt(cycles, PC) && (PC != vb_state->v810_state.PC || vb_state->v810_state.ret)) {
                 // interrupt triggered, so we exit
                 // PC may have been modified so don't reset it
@@ -40,553 +280,500 @@ int interpreter_run(void) {
             }
             target = cycles + vb_state->v810_state.cycles_until_event_partial;
         }
-        HWORD instr = mem_rhword(PC);
-        PC += 2;
-        BYTE opcode = instr >> 10;
-        BYTE reg1 = instr & 31;
-        BYTE reg2 = (instr >> 5) & 31;
-        cycles += opcycle[opcode];
-        if (opcode < 0x20) {
-            // small instr
-            WORD reg1_val = 0;
-            if (!(opcode & 0x10) && reg1) reg1_val = vb_state->v810_state.P_REG[reg1];
-            switch (opcode) {
-                case V810_OP_MOV:
-                    vb_state->v810_state.P_REG[reg2] = reg1_val;
-                    break;
-                case V810_OP_ADD: {
-                    WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
-                    WORD res = reg2_val + reg1_val;
-                    bool z = res == 0;
-                    bool s = (SWORD)res < 0;
-                    bool ov = (SWORD)(~(reg2_val ^ reg1_val) & (reg2_val ^ res)) < 0;
-                    bool cy = (unsigned)res < (unsigned)reg2_val;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2) | (cy << 3);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_SUB: case V810_OP_CMP: {
-                    WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
-                    WORD res = reg2_val - reg1_val;
-                    bool z = res == 0;
-                    bool s = (SWORD)res < 0;
-                    bool ov = (SWORD)((reg2_val ^ reg1_val) & (reg2_val ^ res)) < 0;
-                    bool cy = (unsigned)reg2_val < (unsigned)reg1_val;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2) | (cy << 3);
-                    if (opcode == V810_OP_SUB) vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_SHL: {
-                    WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
-                    reg1_val &= 31;
-                    WORD res = reg2_val << reg1_val;
-                    bool z = res == 0;
-                    bool s = (SWORD)res < 0;
-                    bool ov = false;
-                    bool cy = reg1_val != 0 ? (reg2_val >> (32 - reg1_val)) & 1 : 0;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2) | (cy << 3);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_SHR: {
-                    WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
-                    reg1_val &= 31;
-                    WORD res = reg2_val >> reg1_val;
-                    bool z = res == 0;
-                    bool s = (SWORD)res < 0;
-                    bool ov = false;
-                    bool cy = reg1_val != 0 ? (reg2_val >> (reg1_val - 1)) & 1 : 0;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2) | (cy << 3);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_JMP:
-                    PC = reg1_val;
-                    break;
-                case V810_OP_SAR: {
-                    WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
-                    reg1_val &= 31;
-                    WORD res = (SWORD)reg2_val >> reg1_val;
-                    bool z = res == 0;
-                    bool s = (SWORD)res < 0;
-                    bool ov = false;
-                    bool cy = reg1_val != 0 ? (reg2_val >> (reg1_val - 1)) & 1 : 0;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2) | (cy << 3);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_MUL: {
-                    SWORD reg2_val = reg2 ? (SWORD)vb_state->v810_state.P_REG[reg2] : 0;
-                    int64_t res = (int64_t)(SWORD)reg1_val * (int64_t)reg2_val;
-                    bool ov = res != (int64_t)(int32_t)res;
+        FETCH();
+        #if INTERPRETER_THREADED
+        goto *handlers[opcode];
+        {
+        #else
+        switch (opcode) {
+        #endif
+            OP(MOV):
+                vb_state->v810_state.P_REG[reg2] = reg1_val;
+                NEXT();
+            OP(ADD): {
+                WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                WORD res = reg2_val + reg1_val;
+                SET_FLAGS(FLAGS_ADD, res, reg2_val, reg1_val);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(SUB): OP(CMP): {
+                WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                WORD res = reg2_val - reg1_val;
+                SET_FLAGS(FLAGS_SUB, res, reg2_val, reg1_val);
+                if (opcode == V810_OP_SUB) vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(SHL): {
+                WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                reg1_val &= 31;
+                WORD res = reg2_val << reg1_val;
+                WORD cy = reg1_val != 0 ? (reg2_val >> (32 - reg1_val)) & 1 : 0;
+                SET_FLAGS(FLAGS_LOGIC, res, cy, 0);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(SHR): {
+                WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                reg1_val &= 31;
+                WORD res = reg2_val >> reg1_val;
+                WORD cy = reg1_val != 0 ? (reg2_val >> (reg1_val - 1)) & 1 : 0;
+                SET_FLAGS(FLAGS_LOGIC, res, cy, 0);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(JMP):
+                PC = reg1_val;
+                NEXT_JUMP();
+            OP(SAR): {
+                WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                reg1_val &= 31;
+                WORD res = (SWORD)reg2_val >> reg1_val;
+                WORD cy = reg1_val != 0 ? (reg2_val >> (reg1_val - 1)) & 1 : 0;
+                SET_FLAGS(FLAGS_LOGIC, res, cy, 0);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(MUL): {
+                SWORD reg2_val = reg2 ? (SWORD)vb_state->v810_state.P_REG[reg2] : 0;
+                int64_t res = (int64_t)(SWORD)reg1_val * (int64_t)reg2_val;
+                bool ov = res != (int64_t)(int32_t)res;
+                bool z = res == 0;
+                bool s = res < 0;
+                vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2);
+                flag_kind = FLAGS_PSW;
+                vb_state->v810_state.P_REG[30] = (WORD)(res >> 32);
+                vb_state->v810_state.P_REG[reg2] = (WORD)res;
+                NEXT();
+            }
+            OP(DIV): {
+                SYNC_FLAGS();
+                SWORD reg2_val = reg2 ? (SWORD)vb_state->v810_state.P_REG[reg2] : 0;
+                if (reg2_val == 0x80000000 && (SWORD)reg1_val == -1) {
+                    vb_state->v810_state.P_REG[30] = 0;
+                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0x7) | 6;
+                } else {
+                    vb_state->v810_state.P_REG[30] = reg2_val % (SWORD)reg1_val;
+                    SWORD res = reg2_val / (SWORD)reg1_val;
                     bool z = res == 0;
                     bool s = res < 0;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2);
-                    vb_state->v810_state.P_REG[30] = (WORD)(res >> 32);
-                    vb_state->v810_state.P_REG[reg2] = (WORD)res;
-                    break;
-                }
-                case V810_OP_DIV: {
-                    SWORD reg2_val = reg2 ? (SWORD)vb_state->v810_state.P_REG[reg2] : 0;
-                    if (reg2_val == 0x80000000 && (SWORD)reg1_val == -1) {
-                        vb_state->v810_state.P_REG[30] = 0;
-                        vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0x7) | 6;
-                    } else {
-                        vb_state->v810_state.P_REG[30] = reg2_val % (SWORD)reg1_val;
-                        SWORD res = reg2_val / (SWORD)reg1_val;
-                        bool z = res == 0;
-                        bool s = res < 0;
-                        vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0x7) | z | (s << 1);
-                        vb_state->v810_state.P_REG[reg2] = res;
-                    }
-                    break;
-                }
-                case V810_OP_MULU: {
-                    WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
-                    uint64_t res = (uint64_t)reg1_val * (uint64_t)reg2_val;
-                    bool ov = res != (uint64_t)(uint32_t)res;
-                    bool z = res == 0;
-                    bool s = (SWORD)res < 0;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2);
-                    vb_state->v810_state.P_REG[30] = (WORD)(res >> 32);
-                    vb_state->v810_state.P_REG[reg2] = (WORD)res;
-                    break;
-                }
-                case V810_OP_DIVU: {
-                    WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
-                    vb_state->v810_state.P_REG[30] = reg2_val % reg1_val;
-                    WORD res = reg2_val / reg1_val;
-                    bool z = res == 0;
-                    bool s = (SWORD)res < 0;
                     vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0x7) | z | (s << 1);
                     vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_OR: {
-                    WORD res = (reg2 ? vb_state->v810_state.P_REG[reg2] : 0) | reg1_val;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0x7) | (res == 0) | (((SWORD)res < 0) << 1);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_AND: {
-                    WORD res = (reg2 ? vb_state->v810_state.P_REG[reg2] : 0) & reg1_val;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0x7) | (res == 0) | (((SWORD)res < 0) << 1);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_XOR: {
-                    WORD res = (reg2 ? vb_state->v810_state.P_REG[reg2] : 0) ^ reg1_val;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0x7) | (res == 0) | (((SWORD)res < 0) << 1);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_NOT: {
-                    WORD res = ~reg1_val;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0x7) | (res == 0) | (((SWORD)res < 0) << 1);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_MOV_I: {
-                    WORD imm = reg1 & 0x10 ? reg1 | 0xfffffff0 : reg1;
-                    vb_state->v810_state.P_REG[reg2] = imm;
-                    break;
-                }
-                case V810_OP_ADD_I: {
-                    WORD imm = reg1 & 0x10 ? reg1 | 0xfffffff0 : reg1;
-                    WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
-                    WORD res = reg2_val + imm;
-                    bool z = res == 0;
-                    bool s = (SWORD)res < 0;
-                    bool ov = (SWORD)(~(reg2_val ^ imm) & (reg2_val ^ res)) < 0;
-                    bool cy = (unsigned)res < (unsigned)reg2_val;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2) | (cy << 3);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_SETF: {
-                    vb_state->v810_state.P_REG[reg2] = get_cond(reg1, vb_state->v810_state.S_REG[PSW]);
-                    break;
-                }
-                case V810_OP_CMP_I: {
-                    WORD imm = reg1 & 0x10 ? reg1 | 0xfffffff0 : reg1;
-                    WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
-                    WORD res = reg2_val - imm;
-                    bool z = res == 0;
-                    bool s = (SWORD)res < 0;
-                    bool ov = (SWORD)((reg2_val ^ imm) & (reg2_val ^ res)) < 0;
-                    bool cy = (unsigned)reg2_val < (unsigned)imm;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2) | (cy << 3);
-                    if (opcode == V810_OP_SUB) vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_SHL_I: {
-                    WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
-                    WORD res = reg2_val << reg1;
-                    bool z = res == 0;
-                    bool s = (SWORD)res < 0;
-                    bool ov = false;
-                    bool cy = reg1 != 0 ? (reg2_val >> (32 - reg1)) & 1 : 0;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2) | (cy << 3);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_SHR_I: {
-                    WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
-                    WORD res = reg2_val >> reg1;
-                    bool z = res == 0;
-                    bool s = (SWORD)res < 0;
-                    bool ov = false;
-                    bool cy = reg1 != 0 ? (reg2_val >> (reg1 - 1)) & 1 : 0;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2) | (cy << 3);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
                 }
-                case V810_OP_CLI:
-                    vb_state->v810_state.S_REG[PSW] &= ~(1 << 12);
-                    break;
-                case V810_OP_SAR_I: {
-                    WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
-                    WORD res = (SWORD)reg2_val >> reg1;
-                    bool z = res == 0;
-                    bool s = (SWORD)res < 0;
-                    bool ov = false;
-                    bool cy = reg1 != 0 ? (reg2_val >> (reg1 - 1)) & 1 : 0;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2) | (cy << 3);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                // case V810_OP_TRAP:
-                case V810_OP_RETI:
-                    if (vb_state->v810_state.S_REG[PSW] & PSW_NP) {
-                        PC = vb_state->v810_state.S_REG[FEPC];
-                        vb_state->v810_state.S_REG[PSW] = vb_state->v810_state.S_REG[FEPSW];
-                    } else {
-                        PC = vb_state->v810_state.S_REG[EIPC];
-                        vb_state->v810_state.S_REG[PSW] = vb_state->v810_state.S_REG[EIPSW];
-                    }
-                    break;
-                case V810_OP_HALT: {
-                    cycles = target;
-                    vb_state->v810_state.PC = PC;
-                    do {
-                        cycles += vb_state->v810_state.cycles_until_event_partial;
-                        vb_state->v810_state.cycles_until_event_partial = vb_state->v810_state.cycles_until_event_full = 0;
-                        vb_state->v810_state.cycles = cycles;
-                        serviceInt(cycles, PC);
-                    } while (!vb_state->v810_state.ret && vb_state->v810_state.PC == PC);
-                    if (vb_state->v810_state.PC == PC) {
-                        // no interrupt triggered, so repeat the halt
-                        vb_state->v810_state.PC = last_PC;
+                NEXT();
+            }
+            OP(MULU): {
+                WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                uint64_t res = (uint64_t)reg1_val * (uint64_t)reg2_val;
+                bool ov = res != (uint64_t)(uint32_t)res;
+                bool z = res == 0;
+                bool s = (SWORD)res < 0;
+                vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2);
+                flag_kind = FLAGS_PSW;
+                vb_state->v810_state.P_REG[30] = (WORD)(res >> 32);
+                vb_state->v810_state.P_REG[reg2] = (WORD)res;
+                NEXT();
+            }
+            OP(DIVU): {
+                SYNC_FLAGS();
+                WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                vb_state->v810_state.P_REG[30] = reg2_val % reg1_val;
+                WORD res = reg2_val / reg1_val;
+                bool z = res == 0;
+                bool s = (SWORD)res < 0;
+                vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0x7) | z | (s << 1);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(OR): {
+                WORD res = (reg2 ? vb_state->v810_state.P_REG[reg2] : 0) | reg1_val;
+                SET_FLAGS_LOGIC(res);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(AND): {
+                WORD res = (reg2 ? vb_state->v810_state.P_REG[reg2] : 0) & reg1_val;
+                SET_FLAGS_LOGIC(res);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(XOR): {
+                WORD res = (reg2 ? vb_state->v810_state.P_REG[reg2] : 0) ^ reg1_val;
+                SET_FLAGS_LOGIC(res);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(NOT): {
+                WORD res = ~reg1_val;
+                SET_FLAGS_LOGIC(res);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(MOV_I): {
+                vb_state->v810_state.P_REG[reg2] = imm;
+                NEXT();
+            }
+            OP(ADD_I): {
+                WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                WORD res = reg2_val + imm;
+                SET_FLAGS(FLAGS_ADD, res, reg2_val, imm);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(SETF): {
+                SYNC_FLAGS();
+                vb_state->v810_state.P_REG[reg2] = get_cond(reg1, vb_state->v810_state.S_REG[PSW]);
+                NEXT();
+            }
+            OP(CMP_I): {
+                WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                WORD res = reg2_val - imm;
+                SET_FLAGS(FLAGS_SUB, res, reg2_val, imm);
+                if (opcode == V810_OP_SUB) vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(SHL_I): {
+                WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                WORD res = reg2_val << reg1;
+                WORD cy = reg1 != 0 ? (reg2_val >> (32 - reg1)) & 1 : 0;
+                SET_FLAGS(FLAGS_LOGIC, res, cy, 0);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(SHR_I): {
+                WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                WORD res = reg2_val >> reg1;
+                WORD cy = reg1 != 0 ? (reg2_val >> (reg1 - 1)) & 1 : 0;
+                SET_FLAGS(FLAGS_LOGIC, res, cy, 0);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(CLI):
+                vb_state->v810_state.S_REG[PSW] &= ~(1 << 12);
+                NEXT();
+            OP(SAR_I): {
+                WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                WORD res = (SWORD)reg2_val >> reg1;
+                WORD cy = reg1 != 0 ? (reg2_val >> (reg1 - 1)) & 1 : 0;
+                SET_FLAGS(FLAGS_LOGIC, res, cy, 0);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            // case V810_OP_TRAP:
+            OP(RETI):
+                if (vb_state->v810_state.S_REG[PSW] & PSW_NP) {
+                    PC = vb_state->v810_state.S_REG[FEPC];
+                    vb_state->v810_state.S_REG[PSW] = vb_state->v810_state.S_REG[FEPSW];
+                } else {
+                    PC = vb_state->v810_state.S_REG[EIPC];
+                    vb_state->v810_state.S_REG[PSW] = vb_state->v810_state.S_REG[EIPSW];
+                }
+                flag_kind = FLAGS_PSW;
+                NEXT_JUMP();
+            OP(HALT):
+                // v810_run idles from here until an interrupt comes in
+                SYNC_FLAGS();
+                vb_state->v810_state.PC = last_PC;
+                vb_state->v810_state.cycles = cycles;
+                vb_state->v810_state.halted = true;
+                return 0;
+            OP(LDSR):
+                vb_state->v810_state.S_REG[reg1] = (reg2 ? vb_state->v810_state.P_REG[reg2] : 0);
+                if (reg1 == PSW) flag_kind = FLAGS_PSW;
+                NEXT();
+            OP(STSR):
+                if (reg1 == PSW) {
+                    SYNC_FLAGS();
+                }
+                vb_state->v810_state.P_REG[reg2] = vb_state->v810_state.S_REG[reg1];
+                NEXT();
+            OP(SEI):
+                vb_state->v810_state.S_REG[PSW] |= 1 << 12;
+                NEXT();
+            OP(BSTR): {
+                SYNC_FLAGS();
+                typedef bool (*bstr_func)(WORD,WORD,WORD,WORD);
+                bstr_func func = (bstr_func)bssuboptable[reg1].func;
+                WORD lastarg = reg1 < 4 ? vb_state->v810_state.P_REG[27] & 31 : ((vb_state->v810_state.P_REG[27] & 31)) | ((vb_state->v810_state.P_REG[26] & 31) << 5) | ((target - cycles) << 10);
+                WORD res = func(vb_state->v810_state.P_REG[30], vb_state->v810_state.P_REG[29], vb_state->v810_state.P_REG[28], lastarg);
+                if (reg1 < 4) {
+                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~1) | !res;
+                } else {
+                    vb_state->v810_state.cycles += res;
+                    if (vb_state->v810_state.P_REG[28]) {
+                        PC = last_PC;
                     }
-                    // PC was modified so don't reset it
-                    return 0;
                 }
-                case V810_OP_LDSR:
-                    vb_state->v810_state.S_REG[reg1] = (reg2 ? vb_state->v810_state.P_REG[reg2] : 0);
-                    break;
-                case V810_OP_STSR:
-                    vb_state->v810_state.P_REG[reg2] = vb_state->v810_state.S_REG[reg1];
-                    break;
-                case V810_OP_SEI:
-                    vb_state->v810_state.S_REG[PSW] |= 1 << 12;
-                    break;
-                case V810_OP_BSTR: {
-                    typedef bool (*bstr_func)(WORD,WORD,WORD,WORD);
-                    bstr_func func = (bstr_func)bssuboptable[reg1].func;
-                    WORD lastarg = reg1 < 4 ? vb_state->v810_state.P_REG[27] & 31 : ((vb_state->v810_state.P_REG[27] & 31)) | ((vb_state->v810_state.P_REG[26] & 31) << 5) | ((target - cycles) << 10);
-                    WORD res = func(vb_state->v810_state.P_REG[30], vb_state->v810_state.P_REG[29], vb_state->v810_state.P_REG[28], lastarg);
-                    if (reg1 < 4) {
-                        vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~1) | !res;
-                    } else {
-                        vb_state->v810_state.cycles += res;
-                        if (vb_state->v810_state.P_REG[28]) {
-                            PC = last_PC;
-                        }
+                NEXT_JUMP();
+            }
+            OP_BRANCH:
+                // branch
+                SYNC_FLAGS();
+                if (get_cond(reg1, vb_state->v810_state.S_REG[PSW])) {
+                    PC += imm - 2;
+                    // nothing will change before the next event, so skip to it
+                    if (reg2 && (SWORD)(target - cycles) > 0) cycles = target;
+                } else {
+                    // branch not taken, so it only took 1 cycle
+                    cycles -= 2;
+                }
+                NEXT_JUMP();
+            OP(MOVEA): {
+                vb_state->v810_state.P_REG[reg2] = reg1_val + imm;
+                NEXT();
+            }
+            OP(ADDI): {
+                WORD res = reg1_val + imm;
+                SET_FLAGS(FLAGS_ADD, res, reg1_val, imm);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(JAL):
+                vb_state->v810_state.P_REG[31] = PC;
+                if (unlikely(reg2)) {
+                    int hle_cycles = hle_call(reg2);
+                    // straight back, as if the routine had returned
+                    if (hle_cycles != HLE_PASS) {
+                        cycles += hle_cycles;
+                        NEXT_JUMP();
                     }
-                    break;
-                }
-                default: {
-                    vb_state->v810_state.PC = last_PC;
-                    return DRC_ERR_BAD_INST;
                 }
+                // fallthrough
+            OP(JR):
+                PC += imm - 4;
+                NEXT_JUMP();
+            OP(ORI): {
+                WORD res = imm;
+                if (reg1) res |= vb_state->v810_state.P_REG[reg1];
+                SET_FLAGS_LOGIC(res);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
             }
-        } else if (opcode < 0x28) {
-            // branch
-            if (get_cond(instr >> 9, vb_state->v810_state.S_REG[PSW])) {
-                SHWORD disp = instr & (1 << 8) ? (instr | 0xfe00) : (instr & ~0xfe00);
-                PC += disp - 2;
-            } else {
-                // branch not taken, so it only took 1 cycle
-                cycles -= 2;
-            }
-        } else {
-            // long instr
-            HWORD instr2 = mem_rhword(PC);
-            PC += 2;
-            switch (opcode) {
-                case V810_OP_MOVEA: {
-                    WORD reg1_val = 0;
-                    if (reg1) reg1_val = vb_state->v810_state.P_REG[reg1];
-                    vb_state->v810_state.P_REG[reg2] = reg1_val + (SHWORD)instr2;
-                    break;
-                }
-                case V810_OP_ADDI: {
-                    WORD reg1_val = reg1 ? vb_state->v810_state.P_REG[reg1] : 0;
-                    WORD imm = (SHWORD)instr2;
-                    WORD res = reg1_val + imm;
+            OP(ANDI): {
+                WORD res = 0;
+                if (reg1) res = vb_state->v810_state.P_REG[reg1] & imm;
+                SET_FLAGS_LOGIC(res);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(XORI): {
+                WORD res = imm;
+                if (reg1) res ^= vb_state->v810_state.P_REG[reg1];
+                SET_FLAGS_LOGIC(res);
+                vb_state->v810_state.P_REG[reg2] = res;
+                NEXT();
+            }
+            OP(MOVHI): {
+                vb_state->v810_state.P_REG[reg2] = reg1_val + imm;
+                NEXT();
+            }
+            OP(LD_B): {
+                vb_state->v810_state.P_REG[reg2] = (SBYTE)mem_rbyte(reg1_val + imm);
+                if ((last_opcode & 0x34) == 0x30 && (last_opcode & 3) != 2) {
+                // load immediately following another load takes 2 cycles instead of 3
+                    cycles -= 1;
+                } else if (opcycle[last_opcode] > 4) {
+                    // load following instruction taking "many" cycles only takes 1 cycles
+                    // guessing "many" is 4 for now
+                    cycles -= 2;
+                }
+                NEXT();
+            }
+            OP(LD_H): {
+                vb_state->v810_state.P_REG[reg2] = (SHWORD)mem_rhword(reg1_val + imm);
+                if ((last_opcode & 0x34) == 0x30 && (last_opcode & 3) != 2) {
+                // load immediately following another load takes 2 cycles instead of 3
+                    cycles -= 1;
+                } else if (opcycle[last_opcode] > 4) {
+                    // load following instruction taking "many" cycles only takes 1 cycles
+                    // guessing "many" is 4 for now
+                    cycles -= 2;
+                }
+                NEXT();
+            }
+            OP(LD_W): {
+                vb_state->v810_state.P_REG[reg2] = mem_rword(reg1_val + imm);
+                if ((last_opcode & 0x34) == 0x30 && (last_opcode & 3) != 2) {
+                // load immediately following another load takes 4 cycles instead of 5
+                    cycles -= 1;
+                } else if (opcycle[last_opcode] > 4) {
+                    // load following instruction taking "many" cycles only takes 1 cycles
+                    // guessing "many" is 4 for now
+                    cycles -= 4;
+                }
+                NEXT();
+            }
+            OP(IN_B): {
+                vb_state->v810_state.P_REG[reg2] = (BYTE)mem_rbyte(reg1_val + imm);
+                if ((last_opcode & 0x34) == 0x30 && (last_opcode & 3) != 2) {
+                // load immediately following another load takes 2 cycles instead of 3
+                    cycles -= 1;
+                } else if (opcycle[last_opcode] > 4) {
+                    // load following instruction taking "many" cycles only takes 1 cycles
+                    // guessing "many" is 4 for now
+                    cycles -= 2;
+                }
+                NEXT();
+            }
+            OP(IN_H): {
+                vb_state->v810_state.P_REG[reg2] = (HWORD)mem_rhword(reg1_val + imm);
+                if ((last_opcode & 0x34) == 0x30 && (last_opcode & 3) != 2) {
+                // load immediately following another load takes 2 cycles instead of 3
+                    cycles -= 1;
+                } else if (opcycle[last_opcode] > 4) {
+                    // load following instruction taking "many" cycles only takes 1 cycles
+                    // guessing "many" is 4 for now
+                    cycles -= 2;
+                }
+                NEXT();
+            }
+            OP(IN_W): {
+                vb_state->v810_state.P_REG[reg2] = (WORD)mem_rword(reg1_val + imm);
+                if ((last_opcode & 0x34) == 0x30 && (last_opcode & 3) != 2) {
+                // load immediately following another load takes 4 cycles instead of 5
+                    cycles -= 1;
+                } else if (opcycle[last_opcode] > 4) {
+                    // load following instruction taking "many" cycles only takes 1 cycles
+                    // guessing "many" is 4 for now
+                    cycles -= 4;
+                }
+                NEXT();
+            }
+            OP(ST_B): OP(OUT_B): {
+                BYTE reg2_val = 0;
+                if (reg2) reg2_val = vb_state->v810_state.P_REG[reg2];
+                mem_wbyte(reg1_val + imm, reg2_val);
+                if ((last_opcode & 0x34) == 0x34 && (last_opcode & 3) != 2) {
+                    // with two consecutive stores, the second takes 2 cycles instead of 1
+                    cycles += 1;
+                }
+                NEXT();
+            }
+            OP(ST_H): OP(OUT_H): {
+                HWORD reg2_val = 0;
+                if (reg2) reg2_val = vb_state->v810_state.P_REG[reg2];
+                mem_whword(reg1_val + imm, reg2_val);
+                if ((last_opcode & 0x34) == 0x34 && (last_opcode & 3) != 2) {
+                    // with two consecutive stores, the second takes 2 cycles instead of 1
+                    cycles += 1;
+                }
+                NEXT();
+            }
+            OP(ST_W): OP(OUT_W): {
+                WORD reg2_val = 0;
+                if (reg2) reg2_val = vb_state->v810_state.P_REG[reg2];
+                mem_wword(reg1_val + imm, reg2_val);
+                if ((last_opcode & 0x34) == 0x34 && (last_opcode & 3) != 2) {
+                    // with two consecutive stores, the second takes 4 cycles instead of 1
+                    cycles += 3;
+                }
+                NEXT();
+            }
+            // case V810_OP_CAXI:
+            OP(FPP): {
+                SYNC_FLAGS();
+                int subop = imm;
+                #pragma GCC diagnostic push
+                #pragma GCC diagnostic ignored "-Wstrict-aliasing"
+                if (subop == V810_OP_CVT_WS) {
+                    float res = reg1 ? (float)(SWORD)vb_state->v810_state.P_REG[reg1] : 0;
                     bool z = res == 0;
-                    bool s = (SWORD)res < 0;
-                    bool ov = (SWORD)(~(reg1_val ^ imm) & (reg1_val ^ res)) < 0;
-                    bool cy = (unsigned)res < (unsigned)reg1_val;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | (s << 1) | (ov << 2) | (cy << 3);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_JAL:
-                    vb_state->v810_state.P_REG[31] = PC;
-                    // fallthrough
-                case V810_OP_JR: {
-                    SWORD disp = instr2 | ((SWORD)instr << 16);
-                    if (disp & 0x02000000) disp |= 0xfc000000;
-                    else disp &= ~(0xfc000000);
-                    PC += disp - 4;
-                    break;
-                }
-                case V810_OP_ORI: {
-                    WORD res = instr2;
-                    if (reg1) res |= vb_state->v810_state.P_REG[reg1];
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0x7) | (res == 0) | (((SWORD)res < 0) << 1);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_ANDI: {
-                    WORD res = 0;
-                    if (reg1) res = vb_state->v810_state.P_REG[reg1] & instr2;
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0x7) | (res == 0) | (((SWORD)res < 0) << 1);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_XORI: {
-                    WORD res = instr2;
-                    if (reg1) res ^= vb_state->v810_state.P_REG[reg1];
-                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0x7) | (res == 0) | (((SWORD)res < 0) << 1);
-                    vb_state->v810_state.P_REG[reg2] = res;
-                    break;
-                }
-                case V810_OP_MOVHI: {
-                    WORD reg1_val = 0;
-                    if (reg1) reg1_val = vb_state->v810_state.P_REG[reg1];
-                    vb_state->v810_state.P_REG[reg2] = reg1_val + ((WORD)instr2 << 16);
-                    break;
-                }
-                case V810_OP_LD_B: {
-                    WORD reg1_val = 0;
-                    if (reg1) reg1_val = vb_state->v810_state.P_REG[reg1];
-                    vb_state->v810_state.P_REG[reg2] = (SBYTE)mem_rbyte(reg1_val + (SHWORD)instr2);
-                    if ((last_opcode & 0x34) == 0x30 && (last_opcode & 3) != 2) {
-                    // load immediately following another load takes 2 cycles instead of 3
-                        cycles -= 1;
-                    } else if (opcycle[last_opcode] > 4) {
-                        // load following instruction taking "many" cycles only takes 1 cycles
-                        // guessing "many" is 4 for now
-                        cycles -= 2;
-                    }
-                    break;
-                }
-                case V810_OP_LD_H: {
-                    WORD reg1_val = 0;
-                    if (reg1) reg1_val = vb_state->v810_state.P_REG[reg1];
-                    vb_state->v810_state.P_REG[reg2] = (SHWORD)mem_rhword(reg1_val + (SHWORD)instr2);
-                    if ((last_opcode & 0x34) == 0x30 && (last_opcode & 3) != 2) {
-                    // load immediately following another load takes 2 cycles instead of 3
-                        cycles -= 1;
-                    } else if (opcycle[last_opcode] > 4) {
-                        // load following instruction taking "many" cycles only takes 1 cycles
-                        // guessing "many" is 4 for now
-                        cycles -= 2;
-                    }
-                    break;
-                }
-                case V810_OP_LD_W: {
-                    WORD reg1_val = 0;
-                    if (reg1) reg1_val = vb_state->v810_state.P_REG[reg1];
-                    vb_state->v810_state.P_REG[reg2] = mem_rword(reg1_val + (SHWORD)instr2);
-                    if ((last_opcode & 0x34) == 0x30 && (last_opcode & 3) != 2) {
-                    // load immediately following another load takes 4 cycles instead of 5
-                        cycles -= 1;
-                    } else if (opcycle[last_opcode] > 4) {
-                        // load following instruction taking "many" cycles only takes 1 cycles
-                        // guessing "many" is 4 for now
-                        cycles -= 4;
-                    }
-                    break;
-                }
-                case V810_OP_IN_B: {
-                    WORD reg1_val = 0;
-                    if (reg1) reg1_val = vb_state->v810_state.P_REG[reg1];
-                    vb_state->v810_state.P_REG[reg2] = (BYTE)mem_rbyte(reg1_val + (SHWORD)instr2);
-                    if ((last_opcode & 0x34) == 0x30 && (last_opcode & 3) != 2) {
-                    // load immediately following another load takes 2 cycles instead of 3
-                        cycles -= 1;
-                    } else if (opcycle[last_opcode] > 4) {
-                        // load following instruction taking "many" cycles only takes 1 cycles
-                        // guessing "many" is 4 for now
-                        cycles -= 2;
-                    }
-                    break;
-                }
-                case V810_OP_IN_H: {
-                    WORD reg1_val = 0;
-                    if (reg1) reg1_val = vb_state->v810_state.P_REG[reg1];
-                    vb_state->v810_state.P_REG[reg2] = (HWORD)mem_rhword(reg1_val + (SHWORD)instr2);
-                    if ((last_opcode & 0x34) == 0x30 && (last_opcode & 3) != 2) {
-                    // load immediately following another load takes 2 cycles instead of 3
-                        cycles -= 1;
-                    } else if (opcycle[last_opcode] > 4) {
-                        // load following instruction taking "many" cycles only takes 1 cycles
-                        // guessing "many" is 4 for now
-                        cycles -= 2;
-                    }
-                    break;
-                }
-                case V810_OP_IN_W: {
-                    WORD reg1_val = 0;
-                    if (reg1) reg1_val = vb_state->v810_state.P_REG[reg1];
-                    vb_state->v810_state.P_REG[reg2] = (WORD)mem_rword(reg1_val + (SHWORD)instr2);
-                    if ((last_opcode & 0x34) == 0x30 && (last_opcode & 3) != 2) {
-                    // load immediately following another load takes 4 cycles instead of 5
-                        cycles -= 1;
-                    } else if (opcycle[last_opcode] > 4) {
-                        // load following instruction taking "many" cycles only takes 1 cycles
-                        // guessing "many" is 4 for now
-                        cycles -= 4;
-                    }
-                    break;
-                }
-                case V810_OP_ST_B: case V810_OP_OUT_B: {
-                    WORD reg1_val = 0;
-                    if (reg1) reg1_val = vb_state->v810_state.P_REG[reg1];
-                    BYTE reg2_val = 0;
-                    if (reg2) reg2_val = vb_state->v810_state.P_REG[reg2];
-                    mem_wbyte(reg1_val + (SHWORD)instr2, reg2_val);
-                    if ((last_opcode & 0x34) == 0x34 && (last_opcode & 3) != 2) {
-                        // with two consecutive stores, the second takes 2 cycles instead of 1
-                        cycles += 1;
-                    }
-                    break;
-                }
-                case V810_OP_ST_H: case V810_OP_OUT_H: {
-                    WORD reg1_val = 0;
-                    if (reg1) reg1_val = vb_state->v810_state.P_REG[reg1];
-                    HWORD reg2_val = 0;
-                    if (reg2) reg2_val = vb_state->v810_state.P_REG[reg2];
-                    mem_whword(reg1_val + (SHWORD)instr2, reg2_val);
-                    if ((last_opcode & 0x34) == 0x34 && (last_opcode & 3) != 2) {
-                        // with two consecutive stores, the second takes 2 cycles instead of 1
-                        cycles += 1;
-                    }
-                    break;
-                }
-                case V810_OP_ST_W: case V810_OP_OUT_W: {
-                    WORD reg1_val = 0;
-                    if (reg1) reg1_val = vb_state->v810_state.P_REG[reg1];
-                    WORD reg2_val = 0;
-                    if (reg2) reg2_val = vb_state->v810_state.P_REG[reg2];
-                    mem_wword(reg1_val + (SHWORD)instr2, reg2_val);
-                    if ((last_opcode & 0x34) == 0x34 && (last_opcode & 3) != 2) {
-                        // with two consecutive stores, the second takes 4 cycles instead of 1
-                        cycles += 3;
-                    }
-                    break;
-                }
-                // case V810_OP_CAXI:
-                case V810_OP_FPP: {
-                    int subop = instr2 >> 10;
-                    #pragma GCC diagnostic push
-                    #pragma GCC diagnostic ignored "-Wstrict-aliasing"
-                    if (subop == V810_OP_CVT_WS) {
-                        float res = reg1 ? (float)(SWORD)vb_state->v810_state.P_REG[reg1] : 0;
+                    int scy = res < 0 ? 0xa : 0;
+                    vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | scy;
+                    *(float*)&vb_state->v810_state.P_REG[reg2] = res;
+                } else if (!(subop & 8) || subop == V810_OP_TRNC_SW) {
+                    // float
+                    float reg1_val = reg1 ? *(float*)&vb_state->v810_state.P_REG[reg1] : 0;
+                    if (subop == V810_OP_CVT_SW) {
+                        SWORD res = round(reg1_val);
                         bool z = res == 0;
-                        int scy = res < 0 ? 0xa : 0;
+                        int scy = res < 0 ? 2 : 0;
                         vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | scy;
-                        *(float*)&vb_state->v810_state.P_REG[reg2] = res;
-                    } else if (!(subop & 8) || subop == V810_OP_TRNC_SW) {
-                        // float
-                        float reg1_val = reg1 ? *(float*)&vb_state->v810_state.P_REG[reg1] : 0;
-                        if (subop == V810_OP_CVT_SW) {
-                            SWORD res = round(reg1_val);
-                            bool z = res == 0;
-                            int scy = res < 0 ? 2 : 0;
-                            vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | scy;
-                            vb_state->v810_state.P_REG[reg2] = res;
-                        } else if (subop == V810_OP_TRNC_SW) {
-                            SWORD res = (SWORD)(reg1_val);
-                            bool z = res == 0;
-                            int scy = res < 0 ? 2 : 0;
-                            vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | scy;
-                            vb_state->v810_state.P_REG[reg2] = res;
-                        } else {
-                            float reg2_val = reg2 ? *(float*)&vb_state->v810_state.P_REG[reg2] : 0;
-                            float res;
-                            switch (subop) {
-                                case V810_OP_ADDF_S:
-                                    res = reg2_val + reg1_val;
-                                    break;
-                                case V810_OP_CMPF_S:
-                                case V810_OP_SUBF_S:
-                                    res = reg2_val - reg1_val;
-                                    break;
-                                case V810_OP_MULF_S:
-                                    res = reg2_val * reg1_val;
-                                    break;
-                                case V810_OP_DIVF_S:
-                                    res = reg2_val / reg1_val;
-                                    break;
-                                default:
-                                    return DRC_ERR_BAD_INST;
-                            }
-                            bool z = res == 0;
-                            int scy = res < 0 ? 0xa : 0;
-                            vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | scy;
-                            if (subop != V810_OP_CMPF_S) *(float*)&vb_state->v810_state.P_REG[reg2] = res;
-                        }
+                        vb_state->v810_state.P_REG[reg2] = res;
+                    } else if (subop == V810_OP_TRNC_SW) {
+                        SWORD res = (SWORD)(reg1_val);
+                        bool z = res == 0;
+                        int scy = res < 0 ? 2 : 0;
+                        vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | scy;
+                        vb_state->v810_state.P_REG[reg2] = res;
                     } else {
-                        // extended
-                        WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                        float reg2_val = reg2 ? *(float*)&vb_state->v810_state.P_REG[reg2] : 0;
+                        float res;
                         switch (subop) {
-                            case V810_OP_MPYHW:
-                                vb_state->v810_state.P_REG[reg2] *= reg1 ? (int)(vb_state->v810_state.P_REG[reg1] << 15) >> 15 : 0;
+                            case V810_OP_ADDF_S:
+                                res = reg2_val + reg1_val;
                                 break;
-                            case V810_OP_REV:
-                                vb_state->v810_state.P_REG[reg2] = reg1 ? ins_rev(vb_state->v810_state.P_REG[reg1]) : 0;
+                            case V810_OP_CMPF_S:
+                            case V810_OP_SUBF_S:
+                                res = reg2_val - reg1_val;
                                 break;
-                            case V810_OP_XB:
-                                vb_state->v810_state.P_REG[reg2] = (reg2_val & 0xFFFF0000) | ((reg2_val << 8) & 0xFF00) | ((reg2_val >> 8) & 0xFF);
+                            case V810_OP_MULF_S:
+                                res = reg2_val * reg1_val;
                                 break;
-                            case V810_OP_XH:
-                                vb_state->v810_state.P_REG[reg2] = (reg2_val << 16) | (reg2_val >> 16);
+                            case V810_OP_DIVF_S:
+                                res = reg2_val / reg1_val;
                                 break;
                             default:
                                 return DRC_ERR_BAD_INST;
                         }
+                        bool z = res == 0;
+                        int scy = res < 0 ? 0xa : 0;
+                        vb_state->v810_state.S_REG[PSW] = (vb_state->v810_state.S_REG[PSW] & ~0xf) | z | scy;
+                        if (subop != V810_OP_CMPF_S) *(float*)&vb_state->v810_state.P_REG[reg2] = res;
+                    }
+                } else {
+                    // extended
+                    WORD reg2_val = reg2 ? vb_state->v810_state.P_REG[reg2] : 0;
+                    switch (subop) {
+                        case V810_OP_MPYHW:
+                            vb_state->v810_state.P_REG[reg2] *= reg1 ? (int)(vb_state->v810_state.P_REG[reg1] << 15) >> 15 : 0;
+                            break;
+                        case V810_OP_REV:
+                            vb_state->v810_state.P_REG[reg2] = reg1 ? ins_rev(vb_state->v810_state.P_REG[reg1]) : 0;
+                            break;
+                        case V810_OP_XB:
+                            vb_state->v810_state.P_REG[reg2] = (reg2_val & 0xFFFF0000) | ((reg2_val << 8) & 0xFF00) | ((reg2_val >> 8) & 0xFF);
+                            break;
+                        case V810_OP_XH:
+                            vb_state->v810_state.P_REG[reg2] = (reg2_val << 16) | (reg2_val >> 16);
+                            break;
+                        default:
+                            return DRC_ERR_BAD_INST;
                     }
-                    #pragma GCC diagnostic pop
-                    break;
-                }
-                default: {
-                    vb_state->v810_state.PC = last_PC;
-                    return DRC_ERR_BAD_INST;
                 }
+                #pragma GCC diagnostic pop
+                NEXT();
+            }
+            OP_INVALID: {
+                SYNC_FLAGS();
+                vb_state->v810_state.PC = last_PC;
+                return DRC_ERR_BAD_INST;
             }
         }
+        #if INTERPRETER_THREADED
+        jump:
+        #endif
         last_opcode = opcode;
         if ((PC & 0x07000000) < 0x05000000) {
             vb_state->v810_state.PC = last_PC;
+            SYNC_FLAGS();
             return DRC_ERR_BAD_PC;
         }
         last_PC = PC;
-    } while (!vb_state->v810_state.ret && (!DRC_AVAILABLE || (PC & 0x07000000) != 0x07000000));
+    // back to the dynarec once in ROM, unless it's still being translated
+    } while (!vb_state->v810_state.ret && (!DRC_AVAILABLE || (PC & 0x07000000) != 0x07000000 || drc_workerBusy()));
     vb_state->v810_state.PC = PC;
     vb_state->v810_state.cycles = cycles;
+    SYNC_FLAGS();
     return 0;
+
+    #undef SET_FLAGS
+    #undef SET_FLAGS_LOGIC
+    #undef SYNC_FLAGS
+    #undef FETCH
+    #undef OP
+    #undef OP_BRANCH
+    #undef OP_INVALID
+    #undef NEXT
+    #undef NEXT_JUMP
 }
\ No newline at end of file
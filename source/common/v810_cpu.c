@@ -17,7 +17,9 @@
 #include "vb_set.h"
 #include "rom_db.h"
 #include "drc_core.h"
+#include "fastmem.h"
 #include "interpreter.h"
+#include "hle.h"
 #include "vb_sound.h"
 #include "vb_dsp.h"
 #include "patches.h"
@@ -105,7 +107,15 @@ void v810_init(void) {
         vb_players[i].V810_GAME_RAM.pmemory = (unsigned char *)calloc(vb_players[i].V810_GAME_RAM.size, sizeof(BYTE));
         // Offset + Lowaddr = pmemory
         vb_players[i].V810_GAME_RAM.off = (size_t)vb_players[i].V810_GAME_RAM.pmemory - vb_players[i].V810_GAME_RAM.lowaddr;
+
+        // Page table, filled in once a ROM is loaded
+        vb_players[i].pages = (V810_MEMPAGE *)calloc(MEM_PAGE_COUNT, sizeof(V810_MEMPAGE));
     }
+
+    #if FASTMEM_AVAILABLE
+    // keeps the buffers above if it can't set up the regions
+    fastmem_init();
+    #endif
 }
 
 static bool load_is_zip;
@@ -280,17 +290,25 @@ void v810_load_cancel(void) {
 }
 
 void v810_exit(void) {
+    #if FASTMEM_AVAILABLE
+    fastmem_exit();
+    #endif
     free(V810_ROM1.pmemory);
     for (int i = 0; i < 2; i++) {
         free(vb_players[i].V810_DISPLAY_RAM.pmemory);
         free(vb_players[i].V810_SOUND_RAM.pmemory);
         free(vb_players[i].V810_VB_RAM.pmemory);
         free(vb_players[i].V810_GAME_RAM.pmemory);
+        free(vb_players[i].pages);
     }
 }
 
 // Reinitialize the defaults in the CPU
 void v810_reset(void) {
+    #if FASTMEM_AVAILABLE
+    fastmem_mapRom();
+    #endif
+
     for (int i = 0; i < 2; i++) {
         vb_state = &vb_players[i];
 
@@ -302,6 +320,7 @@ void v810_reset(void) {
 
         vb_state->v810_state.irq_handler = &drc_handleInterrupts;
         vb_state->v810_state.reloc_table = &drc_relocTable;
+        vb_state->v810_state.wram_code = interpreter_wram_cache[i];
 
         vb_state->v810_state.P_REG[0]    =  0x00000000;
         vb_state->v810_state.PC          =  0xFFFFFFF0;
@@ -333,6 +352,9 @@ void v810_reset(void) {
         vb_state->tHReg.tCount = 0xFFFF;
 
         vb_state->tHReg.hwRead = 0;
+
+        mem_mapPages(vb_state);
+        scheduleAllEvents(vb_state);
     }
     
     emulated_player_id = 0;
@@ -368,180 +390,154 @@ void v810_reset(void) {
         memcmp(tVBOpt.GAME_ID, "01VREE", 6) == 0 || // Red Alarm (U)
         memcmp(tVBOpt.GAME_ID, "E4VREJ", 6) == 0; // Red Alarm (J)
 
+    hle_reset();
+    interpreter_clearCache();
+
     #if DRC_AVAILABLE
     drc_reset();
+    drc_loadSavedCache();
     #endif
 }
 
+// Event deadlines, in absolute cycles. Each is worked out from the same state
+// its handler below looks at, so they can't drift apart.
+static void scheduleAt(VB_STATE *state, event_id id, WORD cycles) {
+    event_queue *q = &state->events;
+    switch (id) {
+        case EVENT_INPUT:
+            if (state->tHReg.SCR & 2) {
+                events_schedule(q, id, state->tHReg.lastinput + state->tHReg.hwRead);
+                return;
+            }
+            break;
+        case EVENT_TIMER:
+            if (state->tHReg.TCR & 0x01) {
+                int ticks = state->tHReg.tCount ? state->tHReg.tCount : state->tHReg.tTHW;
+                if (!(state->tHReg.TCR & 0x10)) ticks = ticks * 5 - state->tHReg.ticks;
+                events_schedule(q, id, state->tHReg.lasttime + ticks * 400);
+                return;
+            }
+            break;
+        case EVENT_DRAW:
+            if (state->tVIPREG.drawing) {
+                int drawtime = cycles - state->tVIPREG.lastdraw;
+                int sboff = (state->tVIPREG.rowcount) * state->tVIPREG.frametime / 28 + 1120;
+                // the maths in handleDraw is slightly different, so add 1 to compensate
+                int nextrow = (state->tVIPREG.rowcount + 1) * state->tVIPREG.frametime / 28 + 1;
+                events_schedule(q, id, state->tVIPREG.lastdraw + (drawtime < sboff ? sboff : nextrow));
+                return;
+            }
+            break;
+        case EVENT_DISPLAY: {
+            int disptime = cycles - state->tVIPREG.lastdisp;
+            int next = 400000;
+            if (state->tVIPREG.displaying) {
+                if (disptime < 60000) next = 60000;
+                else if (disptime < 160000) next = 160000;
+                else if (disptime < 200000) next = 200000;
+                else if (disptime < 260000) next = 260000;
+                else if (disptime < 360000) next = 360000;
+            } else if (disptime < 200000) {
+                // FCLK goes low even when not displaying
+                next = 200000;
+            }
+            events_schedule(q, id, state->tVIPREG.lastdisp + next);
+            return;
+        }
+        case EVENT_SYNC:
+            if (is_multiplayer) {
+                events_schedule(q, id, state->tHReg.lastsync + MULTIPLAYER_SYNC_CYCLES);
+                return;
+            }
+            break;
+        case EVENT_COMM:
+            if (state->tHReg.CCR & 0x04) {
+                // communication underway
+                events_schedule(q, id, state->tHReg.nextcomm);
+                return;
+            }
+            break;
+        default:
+            return;
+    }
+    events_cancel(q, id);
+}
+
+void scheduleEvent(VB_STATE *state, event_id id) {
+    scheduleAt(state, id, state->v810_state.cycles);
+}
+
+void scheduleAllEvents(VB_STATE *state) {
+    events_clear(&state->events);
+    for (int id = 0; id < EVENT_COUNT; id++) {
+        scheduleEvent(state, id);
+    }
+}
+
 void predictEvent(bool increment) {
     if (increment) {
         vb_state->v810_state.cycles += vb_state->v810_state.cycles_until_event_full - vb_state->v810_state.cycles_until_event_partial;
     }
 
-    WORD cycles = vb_state->v810_state.cycles;
-    int disptime = cycles - vb_state->tVIPREG.lastdisp;
-    int next_event = 400000 - disptime;
-    if (vb_state->tVIPREG.displaying) {
-        if (disptime < 60000) next_event = 60000 - disptime;
-        else if (disptime < 160000) next_event = 160000 - disptime;
-        else if (disptime < 200000) next_event = 200000 - disptime;
-        else if (disptime < 260000) next_event = 260000 - disptime;
-        else if (disptime < 360000) next_event = 360000 - disptime;
-    }
-    if (vb_state->tHReg.TCR & 0x01) {
-        int ticks = vb_state->tHReg.tCount ? vb_state->tHReg.tCount : vb_state->tHReg.tTHW;
-        if (!(vb_state->tHReg.TCR & 0x10)) ticks = ticks * 5 - vb_state->tHReg.ticks;
-        int next_timer = ticks * 400 - (cycles - vb_state->tHReg.lasttime);
-        if (next_event > next_timer) next_event = next_timer;
-    }
-    if (vb_state->tHReg.SCR & 2) {
-        int next_input = vb_state->tHReg.hwRead - (cycles - vb_state->tHReg.lastinput);
-        if (next_event > next_input) next_event = next_input;
-    }
-    if (vb_state->tVIPREG.drawing) {
-        int drawtime = cycles - vb_state->tVIPREG.lastdraw;
-        int sboff = (vb_state->tVIPREG.rowcount) * vb_state->tVIPREG.frametime / 28 + 1120;
-        // the maths in serviceDisplayInt is slightly different, so add 1 to compensate
-        int nextrow = (vb_state->tVIPREG.rowcount + 1) * vb_state->tVIPREG.frametime / 28 + 1;
-        int next_draw;
-        if (drawtime < sboff) next_draw = sboff - drawtime;
-        else next_draw = nextrow - drawtime;
-        if (next_event > next_draw) next_event = next_draw;
-    }
-    if (is_multiplayer) {
-        int next_sync = vb_state->tHReg.lastsync + MULTIPLAYER_SYNC_CYCLES - cycles;
-        if (next_event > next_sync) next_event = next_sync;
-    }
-    if (vb_state->tHReg.CCR & 0x04) {
-        // communication underway
-        int next_comm = vb_state->tHReg.nextcomm - cycles;
-        if (next_event > next_comm) next_event = next_comm;
-    }
+    // the display event is always pending
+    event_id id = events_peek(&vb_state->events);
+    int next_event = vb_state->events.when[id] - vb_state->v810_state.cycles;
 
     if (next_event < 0) next_event = 0;
 
     vb_state->v810_state.cycles_until_event_full = vb_state->v810_state.cycles_until_event_partial = next_event;
 }
 
-static int serviceDisplayInt(unsigned int cycles, WORD PC);
-
-// Returns number of cycles until next timer interrupt.
-int serviceInt(unsigned int cycles, WORD PC) {
-    bool pending_int = false;
+// Event handlers, run once their deadline has passed.
+// They return true if there may be an interrupt to take or a reason to exit.
 
+static bool handleInput(unsigned int cycles) {
     // hardware read timing
-    if (vb_state->tHReg.SCR & 2) {
-        int next_input = vb_state->tHReg.hwRead - (cycles - vb_state->tHReg.lastinput);
-        vb_state->tHReg.hwRead = next_input;
-        if (next_input <= 0) {
-            vb_state->tHReg.SCR &= ~2;
-            pending_int = true;
-        }
-    }
+    vb_state->tHReg.SCR &= ~2;
+    vb_state->tHReg.hwRead = 0;
     vb_state->tHReg.lastinput = cycles;
+    return true;
+}
 
-    // timer
-    if ((cycles-vb_state->tHReg.lasttime) >= 400) {
-        int new_ticks = (cycles - vb_state->tHReg.lasttime) / 400;
-        vb_state->tHReg.lasttime += 400 * new_ticks;
-        int steps = (vb_state->tHReg.TCR & 0x10) ? new_ticks : (vb_state->tHReg.ticks + new_ticks) / 5;
-        vb_state->tHReg.ticks = (vb_state->tHReg.ticks + new_ticks) % 5;
-        if (vb_state->tHReg.TCR & 0x01) { // Timer Enabled
-            vb_state->tHReg.tCount -= steps;
-            if (vb_state->tHReg.tCount <= 0 && vb_state->tHReg.tCount + steps > 0) {
-                vb_state->tHReg.TCR |= 0x02;
-                if ((vb_state->tHReg.TCR & 0x09) == 0x09) vb_state->tHReg.tInt = true;
-            }
-            while (vb_state->tHReg.tCount < 0) {
-                vb_state->tHReg.tCount += vb_state->tHReg.tTHW + 1; //reset counter
-            }
-            vb_state->tHReg.TLB = (vb_state->tHReg.tCount&0xFF);
-            vb_state->tHReg.THB = ((vb_state->tHReg.tCount>>8)&0xFF);
-        }
-    }
-
-    // graphics has higher priority, so try that first
-    pending_int = serviceDisplayInt(cycles, PC) || pending_int;
+static bool handleTimer(unsigned int cycles) {
+    // the counter itself is kept up to date by updateTimer
+    return false;
+}
 
-    // multiplayer stuff
-    if (is_multiplayer) {
-        if ((SWORD)(cycles - vb_state->tHReg.lastsync) >= MULTIPLAYER_SYNC_CYCLES) {
-            vb_state->tHReg.lastsync += MULTIPLAYER_SYNC_CYCLES;
-            vb_state->v810_state.ret = true;
-            pending_int = true;
-        }
-    } else if ((vb_state->tHReg.CCR & 0x14) == 0x14) {
-        // single player remote comm should never finish
-        vb_state->tHReg.nextcomm = cycles + 3200;
-    }
+static bool handleDraw(unsigned int cycles) {
+    bool pending_int = false;
+    unsigned int drawtime = (cycles-vb_state->tVIPREG.lastdraw);
 
-    if (vb_state->tHReg.CCR & 0x04) {
-        // communication underway
-        if ((SWORD)(vb_state->tHReg.nextcomm - cycles) <= 0) {
-            // communication complete
-            vb_state->tHReg.cLock = false;
-            vb_state->tHReg.CCR &= ~0x06;
-            if (!(vb_state->tHReg.CCR & 0x80)) vb_state->tHReg.cInt = true;
-            if (is_multiplayer) {
-                vb_state->tHReg.CCSR = (vb_state->tHReg.CCSR & ~0x04) | (((vb_players[0].tHReg.CCSR & 0x0A) == 0x0A && (vb_players[1].tHReg.CCSR & 0x0A) == 0x0A) << 2);
-            } else {
-                vb_state->tHReg.CCSR = vb_state->tHReg.CCSR | 0x04;
-            }
-            if (!(vb_state->tHReg.CCSR & 0x80) && ((vb_state->tHReg.CCSR & 0x14) == 0x14 || (vb_state->tHReg.CCSR & 0x14) == 0)) {
-                vb_state->tHReg.ccInt = true;
+    // XPSTTS management
+    int rowcount = drawtime * 28 / vb_state->tVIPREG.frametime;
+    if (unlikely(rowcount > vb_state->tVIPREG.rowcount)) {
+        pending_int = true;
+        if (rowcount < 28) {
+            // new row mid-frame
+            vb_state->tVIPREG.rowcount = rowcount;
+            vb_state->tVIPREG.XPSTTS = (vb_state->tVIPREG.XPSTTS & 0xff) | (rowcount << 8) | SBOUT;
+            // SBCMP comparison
+            if (rowcount == ((vb_state->tVIPREG.XPCTRL >> 8) & 0x1f)) {
+                vb_state->tVIPREG.INTPND |= SBHIT;
             }
+        } else {
+            // finished drawing
+            vb_state->tVIPREG.drawing = false;
+            vb_state->tVIPREG.XPSTTS = 0x1b00 | (vb_state->tVIPREG.XPCTRL & XPEN);
+            vb_state->tVIPREG.INTPND |= XPEND;
         }
+    } else if (rowcount < 28 && drawtime - rowcount * vb_state->tVIPREG.frametime / 28 >= 1120) {
+        // it's been roughly 56 microseconds, so clear SBOUT
+        if (vb_state->tVIPREG.XPSTTS | SBOUT) pending_int = true;
+        vb_state->tVIPREG.XPSTTS &= ~SBOUT;
     }
 
-    if (vb_state->tHReg.cInt || vb_state->tHReg.ccInt) {
-        pending_int = v810_int(3, PC) || pending_int;
-    }
-
-    if (vb_state->tHReg.tInt) {
-        // zero & interrupt enabled
-        pending_int = v810_int(1, PC) || pending_int;
-    }
-
-    predictEvent(false);
-
     return pending_int;
 }
 
-static int serviceDisplayInt(unsigned int cycles, WORD PC) {
-    int gamestart;
+static bool handleDisplay(unsigned int cycles) {
     unsigned int disptime = (cycles - vb_state->tVIPREG.lastdisp);
-    bool pending_int = 0;
-
-    if (unlikely(vb_state->tVIPREG.newframe)) {
-        // new frame
-        vb_state->tVIPREG.newframe = false;
-        vb_state->tVIPREG.displaying = (vb_state->tVIPREG.DPCTRL & SYNCE) != 0;
-        vb_state->tVIPREG.DPSTTS = (vb_state->tVIPREG.DPCTRL & (DISP|RE|SYNCE)) | SCANRDY | FCLK;
-
-        int interrupts = FRAMESTART;
-
-        if (!vb_state->tVIPREG.drawing) {
-            vb_state->tVIPREG.lastdraw = vb_state->tVIPREG.lastdisp;
-        }
-
-        if (vb_state->tVIPREG.tFrame-- == 0) {
-            vb_state->tVIPREG.tFrame = vb_state->tVIPREG.FRMCYC;
-            interrupts |= GAMESTART;
-            if (vb_state->tVIPREG.XPCTRL & XPEN) {
-                if (vb_state->tVIPREG.drawing) {
-                    vb_state->tVIPREG.XPSTTS |= OVERTIME;
-                    interrupts |= TIMEERR;
-                } else {
-                    vb_state->tVIPREG.drawing = true;
-                    vb_state->tVIPREG.XPSTTS = XPEN | ((!vb_state->tVIPREG.tDisplayedFB+1)<<2) | SBOUT;
-                    vb_state->tVIPREG.rowcount = 0;
-                }
-            }
-        }
-
-        vb_state->tVIPREG.INTPND |= interrupts;
-        pending_int = 1;
-    }
+    bool pending_int = false;
 
     // DPSTTS management
     {
@@ -569,7 +565,7 @@ static int serviceDisplayInt(unsigned int cycles, WORD PC) {
         }
         if (unlikely(dpstts_new != dpstts_old)) {
             vb_state->tVIPREG.DPSTTS = dpstts_new;
-            pending_int = 1;
+            pending_int = true;
             if (dpstts_old & DPBSY) {
                 // old status had DPBSY, which necessarily means new one doesn't
                 vb_state->tVIPREG.INTPND |= (dpstts_old & (L0BSY | L1BSY)) ? LFBEND : RFBEND;
@@ -577,40 +573,12 @@ static int serviceDisplayInt(unsigned int cycles, WORD PC) {
         }
     }
 
-    unsigned int drawtime = (cycles-vb_state->tVIPREG.lastdraw);
-
-    // XPSTTS management
-    if (likely(vb_state->tVIPREG.drawing)) {
-        int rowcount = drawtime * 28 / vb_state->tVIPREG.frametime;
-        if (unlikely(rowcount > vb_state->tVIPREG.rowcount)) {
-            pending_int = 1;
-            if (rowcount < 28) {
-                // new row mid-frame
-                vb_state->tVIPREG.rowcount = rowcount;
-                vb_state->tVIPREG.XPSTTS = (vb_state->tVIPREG.XPSTTS & 0xff) | (rowcount << 8) | SBOUT;
-                // SBCMP comparison
-                if (rowcount == ((vb_state->tVIPREG.XPCTRL >> 8) & 0x1f)) {
-                    vb_state->tVIPREG.INTPND |= SBHIT;
-                }
-            } else {
-                // finished drawing
-                vb_state->tVIPREG.drawing = false;
-                vb_state->tVIPREG.XPSTTS = 0x1b00 | (vb_state->tVIPREG.XPCTRL & XPEN);
-                vb_state->tVIPREG.INTPND |= XPEND;
-            }
-        } else if (unlikely(rowcount < 28 && drawtime - rowcount * vb_state->tVIPREG.frametime / 28 >= 1120)) {
-            // it's been roughly 56 microseconds, so clear SBOUT
-            if (vb_state->tVIPREG.XPSTTS | SBOUT) pending_int = 1;
-            vb_state->tVIPREG.XPSTTS &= ~SBOUT;
-        }
-    }
-
-    if (unlikely(disptime >= 400000)) {
+    if (disptime >= 400000) {
         // frame end
         vb_state->v810_state.ret = 1;
         vb_state->tVIPREG.lastdisp += 400000;
         vb_state->tVIPREG.newframe = true;
-        pending_int = 1;
+        pending_int = true;
 
         if (vb_state->tVIPREG.tFrame == 0 && !vb_state->tVIPREG.drawing && (vb_state->tVIPREG.XPCTRL & XPEN)) {
             vb_state->tVIPREG.tDisplayedFB = !vb_state->tVIPREG.tDisplayedFB;
@@ -625,9 +593,142 @@ static int serviceDisplayInt(unsigned int cycles, WORD PC) {
         sound_update(cycles);
     }
 
+    return pending_int;
+}
+
+static bool handleSync(unsigned int cycles) {
+    if (!is_multiplayer) return false;
+    vb_state->tHReg.lastsync += MULTIPLAYER_SYNC_CYCLES;
+    vb_state->v810_state.ret = true;
+    return true;
+}
+
+static bool handleComm(unsigned int cycles) {
+    if (!is_multiplayer && (vb_state->tHReg.CCR & 0x14) == 0x14) {
+        // single player remote comm should never finish
+        vb_state->tHReg.nextcomm = cycles + 3200;
+        return false;
+    }
+
+    // communication complete
+    vb_state->tHReg.cLock = false;
+    vb_state->tHReg.CCR &= ~0x06;
+    if (!(vb_state->tHReg.CCR & 0x80)) vb_state->tHReg.cInt = true;
+    if (is_multiplayer) {
+        vb_state->tHReg.CCSR = (vb_state->tHReg.CCSR & ~0x04) | (((vb_players[0].tHReg.CCSR & 0x0A) == 0x0A && (vb_players[1].tHReg.CCSR & 0x0A) == 0x0A) << 2);
+    } else {
+        vb_state->tHReg.CCSR = vb_state->tHReg.CCSR | 0x04;
+    }
+    if (!(vb_state->tHReg.CCSR & 0x80) && ((vb_state->tHReg.CCSR & 0x14) == 0x14 || (vb_state->tHReg.CCSR & 0x14) == 0)) {
+        vb_state->tHReg.ccInt = true;
+    }
+    return true;
+}
+
+static bool (*const event_handlers[EVENT_COUNT])(unsigned int cycles) = {
+    [EVENT_INPUT] = handleInput,
+    [EVENT_TIMER] = handleTimer,
+    [EVENT_DRAW] = handleDraw,
+    [EVENT_DISPLAY] = handleDisplay,
+    [EVENT_SYNC] = handleSync,
+    [EVENT_COMM] = handleComm,
+};
+
+// The timer registers are readable, so keep them current whatever the event
+static void updateTimer(unsigned int cycles) {
+    if ((cycles-vb_state->tHReg.lasttime) >= 400) {
+        int new_ticks = (cycles - vb_state->tHReg.lasttime) / 400;
+        vb_state->tHReg.lasttime += 400 * new_ticks;
+        int steps = (vb_state->tHReg.TCR & 0x10) ? new_ticks : (vb_state->tHReg.ticks + new_ticks) / 5;
+        vb_state->tHReg.ticks = (vb_state->tHReg.ticks + new_ticks) % 5;
+        if (vb_state->tHReg.TCR & 0x01) { // Timer Enabled
+            vb_state->tHReg.tCount -= steps;
+            if (vb_state->tHReg.tCount <= 0 && vb_state->tHReg.tCount + steps > 0) {
+                vb_state->tHReg.TCR |= 0x02;
+                if ((vb_state->tHReg.TCR & 0x09) == 0x09) vb_state->tHReg.tInt = true;
+            }
+            while (vb_state->tHReg.tCount < 0) {
+                vb_state->tHReg.tCount += vb_state->tHReg.tTHW + 1; //reset counter
+            }
+            vb_state->tHReg.TLB = (vb_state->tHReg.tCount&0xFF);
+            vb_state->tHReg.THB = ((vb_state->tHReg.tCount>>8)&0xFF);
+        }
+    }
+}
+
+static void startFrame(unsigned int cycles) {
+    vb_state->tVIPREG.newframe = false;
+    vb_state->tVIPREG.displaying = (vb_state->tVIPREG.DPCTRL & SYNCE) != 0;
+    vb_state->tVIPREG.DPSTTS = (vb_state->tVIPREG.DPCTRL & (DISP|RE|SYNCE)) | SCANRDY | FCLK;
+
+    int interrupts = FRAMESTART;
+
+    if (!vb_state->tVIPREG.drawing) {
+        vb_state->tVIPREG.lastdraw = vb_state->tVIPREG.lastdisp;
+    }
+
+    if (vb_state->tVIPREG.tFrame-- == 0) {
+        vb_state->tVIPREG.tFrame = vb_state->tVIPREG.FRMCYC;
+        interrupts |= GAMESTART;
+        if (vb_state->tVIPREG.XPCTRL & XPEN) {
+            if (vb_state->tVIPREG.drawing) {
+                vb_state->tVIPREG.XPSTTS |= OVERTIME;
+                interrupts |= TIMEERR;
+            } else {
+                vb_state->tVIPREG.drawing = true;
+                vb_state->tVIPREG.XPSTTS = XPEN | ((!vb_state->tVIPREG.tDisplayedFB+1)<<2) | SBOUT;
+                vb_state->tVIPREG.rowcount = 0;
+            }
+        }
+    }
+
+    vb_state->tVIPREG.INTPND |= interrupts;
+
+    scheduleAt(vb_state, EVENT_DISPLAY, cycles);
+    scheduleAt(vb_state, EVENT_DRAW, cycles);
+}
+
+// Returns true if an interrupt was raised or there's another reason to stop.
+int serviceInt(unsigned int cycles, WORD PC) {
+    bool pending_int = false;
+    event_queue *q = &vb_state->events;
+
+    updateTimer(cycles);
+
+    // the new frame was left until after the previous one had been shown
+    if (unlikely(vb_state->tVIPREG.newframe)) {
+        startFrame(cycles);
+        pending_int = true;
+    }
+
+    // take every expired event off the queue first, so a handler can't
+    // make another one due and have it run twice in one go
+    int expired = 0;
+    event_id id;
+    while ((id = events_peek(q)) != EVENT_NONE && (SWORD)(q->when[id] - cycles) <= 0) {
+        events_cancel(q, id);
+        expired |= 1 << id;
+    }
+    for (id = 0; expired; id++, expired >>= 1) {
+        if (expired & 1) {
+            pending_int = event_handlers[id](cycles) || pending_int;
+            scheduleAt(vb_state, id, cycles);
+        }
+    }
+
+    // graphics has higher priority, so try that first
     if (unlikely(vb_state->tVIPREG.INTENB & vb_state->tVIPREG.INTPND)) {
         v810_int(4, PC);
-        pending_int = 1;
+        pending_int = true;
+    }
+
+    if (vb_state->tHReg.cInt || vb_state->tHReg.ccInt) {
+        pending_int = v810_int(3, PC) || pending_int;
+    }
+
+    if (vb_state->tHReg.tInt) {
+        // zero & interrupt enabled
+        pending_int = v810_int(1, PC) || pending_int;
     }
 
     predictEvent(false);
@@ -643,8 +744,9 @@ bool v810_int(WORD iNum, WORD PC) {
     if((vb_state->v810_state.S_REG[PSW] & PSW_ID)) return false; // Interupt disabled
     if(iNum < ((vb_state->v810_state.S_REG[PSW] & PSW_IA)>>16)) return false; // Interupt to low on the chain
 
-    // if an interrupt happened, skip a HALT instruction if we're on one
-    if (((HWORD)mem_rhword(PC) >> 10) == V810_OP_HALT) {
+    // an interrupt wakes the CPU up and returns past the HALT
+    if (vb_state->v810_state.halted) {
+        vb_state->v810_state.halted = false;
         PC += 2;
     }
 
@@ -699,17 +801,29 @@ void v810_exp(WORD iNum, WORD eCode) {
     }
 }
 
+// Skips a halted CPU straight to the next event
+static void v810_idle(void) {
+    predictEvent(false);
+    int skipped = vb_state->v810_state.cycles_until_event_partial;
+    vb_state->v810_state.cycles += skipped;
+    vb_state->v810_state.idle_cycles += skipped;
+    serviceInt(vb_state->v810_state.cycles, vb_state->v810_state.PC);
+}
+
 int v810_run(void) {
     vb_state->v810_state.ret = false;
 
     while (true) {
         int ret = 0;
+        if (vb_state->v810_state.halted) {
+            v810_idle();
+        }
         #if DRC_AVAILABLE
-        if (likely((vb_state->v810_state.PC & 0x07000000) == 0x07000000)) {
+        else if (likely((vb_state->v810_state.PC & 0x07000000) == 0x07000000)) {
             ret = drc_run();
-        } else
+        }
         #endif
-        {
+        else {
             ret = interpreter_run();
         }
         if (ret != 0) return ret;
@@ -737,6 +851,7 @@ int v810_run(void) {
                                 // waiting on nothing, so delay until after the next sync
                                 vb_players[i].tHReg.nextcomm = vb_players[i].v810_state.cycles + 8000;
                             }
+                            scheduleEvent(&vb_players[i], EVENT_COMM);
                         }
                     }
                 }
@@ -761,4 +876,7 @@ void v810_endmultiplayer() {
     emulated_player_id = 0;
     emulating_self = true;
     is_multiplayer = false;
+    for (int i = 0; i < 2; i++) {
+        scheduleEvent(&vb_players[i], EVENT_SYNC);
+    }
 }
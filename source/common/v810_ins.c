@@ -46,42 +46,6 @@ void ins_err(int arg1, int arg2) { //Mode1/2
     //dtprintf(6,ferr,"\nInvalid code! err");
 }
 
-//Bitstring routines, wrapper functions for bitstring instructions!
-void get_bitstr(WORD *str, WORD src, WORD srcoff, WORD len) {
-    WORD i=0,tword,tmp;
-
-    memset(str,0,(((len>>5)+1)<<2)); //clear bitstring data
-
-    tmp = ((i+srcoff)>>5);
-    tword = mem_rword(src+(tmp<<2));
-    while (i < len) {
-        if (((i+srcoff)>>5) != tmp) {
-            tmp = ((i+srcoff)>>5);
-            tword = mem_rword(src+(tmp<<2));
-        }
-        str[i>>5] |= (((tword >> ((srcoff+i)&0x1F)) & 1) << (i&0x1F));
-        i++;
-    }
-}
-
-void set_bitstr(WORD *str, WORD dst, WORD dstoff, WORD len) {
-    WORD i=0,tword,tmp;
-
-    tmp = ((i+dstoff)>>5);
-    tword = mem_rword(dst+(tmp<<2));
-    while (i < len) {
-        if (((i+dstoff)>>5) != tmp) {
-            tmp = ((i+dstoff)>>5);
-            tword = mem_rword(dst+(tmp<<2));
-        }
-        tword &= (~(1<<((dstoff+i)&0x1F)));
-        tword |= (((str[i>>5]>>(i&0x1F))&1)<<((dstoff+i)&0x1F));
-        i++;
-        if (!((i+dstoff)&0x1F)) mem_wword(dst+(tmp<<2),tword);
-    }
-    mem_wword(dst+(tmp<<2),tword);
-}
-
 //Bitstring SubOpcodes
 bool ins_sch0bsu (WORD src, WORD skipped, WORD len, WORD offs) {
     #define FLIP(x) ~(x)
@@ -413,6 +377,128 @@ bool ins_sch1bsd (WORD src, WORD skipped, WORD len, WORD offs) {
     return !searching;
 }
 
+// The bitstring operations, in suboperation order from ORBSU
+enum { BSTR_OR, BSTR_AND, BSTR_XOR, BSTR_MOV, BSTR_ORN, BSTR_ANDN, BSTR_XORN, BSTR_NOT };
+
+static inline WORD bstr_op(int op, WORD d, WORD s) {
+    switch (op) {
+        case BSTR_OR: return d | s;
+        case BSTR_AND: return d & s;
+        case BSTR_XOR: return d ^ s;
+        case BSTR_MOV: return s;
+        case BSTR_ORN: return d | ~s;
+        case BSTR_ANDN: return d & ~s;
+        case BSTR_XORN: return d ^ ~s;
+        default: return ~s;
+    }
+}
+
+// The host pointer for size bytes from the word at addr, if they can all be
+// accessed directly through the page table and are contiguous on the host
+static BYTE *bstr_host(WORD addr, WORD size, BYTE flags) {
+    addr &= 0x07fffffc;
+    if (addr + size > 0x08000000) return NULL;
+    const V810_MEMPAGE *page = &vb_state->pages[addr >> MEM_PAGE_BITS];
+    for (WORD i = addr >> MEM_PAGE_BITS; i <= (addr + size - 1) >> MEM_PAGE_BITS; i++) {
+        // mirrors are mapped with a different offset
+        if ((vb_state->pages[i].flags & flags) != flags || vb_state->pages[i].off != page->off) return NULL;
+    }
+    return (BYTE *)(page->off + addr);
+}
+
+// Side effects of writing the bits in mask of the destination word at addr
+static inline void bstr_wrote(int op, const V810_MEMPAGE *page, WORD addr, WORD mask) {
+    if (page->written) page->written(addr, 4);
+    // keep track of the framebuffer pixels that were drawn
+    if (op == BSTR_MOV && (addr & 0x07007000) < 0x6000) tDSPCACHE.OpaquePixels.u32[!!(addr & 0x8000)][!!(addr & 0x10000)][(addr & 0x7fff) >> 2] |= mask;
+}
+
+// n whole words, in ascending order like the hardware
+static inline void bstr_words(int op, const WORD *s, WORD *d, WORD n) {
+    if (s == d) {
+        // some operations on a string and itself don't depend on it at all
+        if (op == BSTR_XOR || op == BSTR_ANDN) {
+            memset(d, 0, n * 4);
+            return;
+        } else if (op == BSTR_ORN || op == BSTR_XORN) {
+            memset(d, 0xff, n * 4);
+            return;
+        }
+    }
+    if (op == BSTR_MOV && (d <= s || d >= s + n)) {
+        // nothing gets overwritten before it's read
+        memmove(d, s, n * 4);
+        return;
+    }
+    for (WORD i = 0; i < n; i++) d[i] = bstr_op(op, d[i], s[i]);
+}
+
+// Does the len bits the routines below have worked out the timing for, a
+// destination word at a time, if both strings can be accessed directly.
+// Whole words go in bulk, and the rest is shifted and masked into place with
+// the source words read in the same order as the routines do, so
+// overlapping strings come out the same. Leaves the registers where the
+// routine would, or returns false to leave it to the routine.
+static inline bool bstr_fast(int op, WORD *p_src, WORD *p_dst, WORD *p_len, WORD *p_srcoff, WORD *p_dstoff) {
+    WORD len = *p_len, soff = *p_srcoff, doff = *p_dstoff;
+    if (len == 0) return false;
+    const WORD *s = (const WORD *)bstr_host(*p_src, ((soff + len + 31) >> 5) * 4, MEM_PAGE_READ);
+    WORD *d = (WORD *)bstr_host(*p_dst, ((doff + len + 31) >> 5) * 4, MEM_PAGE_READ | MEM_PAGE_WRITE);
+    if (!s || !d) return false;
+    WORD d_addr = *p_dst & 0x07fffffc;
+    const V810_MEMPAGE *d_page = &vb_state->pages[d_addr >> MEM_PAGE_BITS];
+    WORD s_cur = 0, s_next = 0;
+    bool have_cur = false;
+
+    while (len > 0) {
+        if (soff == 0 && doff == 0 && len >= 32) {
+            WORD n = len >> 5;
+            bstr_words(op, s, d, n);
+            for (WORD i = 0; i < n; i++) bstr_wrote(op, d_page, d_addr + i * 4, -1);
+            s += n;
+            d += n;
+            d_addr += n * 4;
+            len -= n * 32;
+            have_cur = false;
+            continue;
+        }
+        WORD bits = 32 - doff < len ? 32 - doff : len;
+        WORD mask = (bits == 32 ? ~0U : (1U << bits) - 1) << doff;
+        if (!have_cur) s_cur = *s;
+        uint64_t window = s_cur;
+        if (soff + bits > 32) {
+            s_next = s[1];
+            window |= (uint64_t)s_next << 32;
+        }
+        WORD val = (WORD)(window >> soff) << doff;
+        *d = (*d & ~mask) | (bstr_op(op, *d, val) & mask);
+        bstr_wrote(op, d_page, d_addr, mask);
+        have_cur = true;
+        soff += bits;
+        if (soff >= 32) {
+            soff -= 32;
+            s++;
+            // read again after the write if it's all that's needed of it
+            s_cur = s_next;
+            have_cur = soff != 0;
+        }
+        doff += bits;
+        if (doff == 32) {
+            doff = 0;
+            d++;
+            d_addr += 4;
+        }
+        len -= bits;
+    }
+
+    *p_src += ((*p_srcoff + *p_len) >> 5) * 4;
+    *p_dst += ((*p_dstoff + *p_len) >> 5) * 4;
+    *p_srcoff = (*p_srcoff + *p_len) & 31;
+    *p_dstoff = (*p_dstoff + *p_len) & 31;
+    *p_len = 0;
+    return true;
+}
+
 // All the instructions have a Golf speedhack, but I'll write the explanation
 // here one time instead of copy-pasting it with everything else.
 // Golf's V810 performance is a very tight balancing act:
@@ -550,6 +636,8 @@ int ins_orbsu   (WORD src, WORD dst, WORD len, SWORD offs) {
         }
     }
 
+    // straight through the page table if possible (see bstr_fast)
+    bstr_fast(BSTR_OR, &src, &dst, &len, &srcoff, &dstoff);
     if (srcoff == dstoff) {
         if (srcoff != 0 && len > 32-srcoff) {
             dstbuf = mem_rword(dst);
@@ -597,7 +685,7 @@ int ins_orbsu   (WORD src, WORD dst, WORD len, SWORD offs) {
             }
             len = 0;
         }
-    } else {
+    } else if (len > 0) {
         WORD srcbuf = mem_rword(src);
         dstbuf = mem_rword(dst);
         while (len > 0) {
@@ -771,6 +859,7 @@ int ins_andbsu  (WORD src, WORD dst, WORD len, SWORD offs) {
         }
     }
 
+    bstr_fast(BSTR_AND, &src, &dst, &len, &srcoff, &dstoff);
     if (srcoff == dstoff) {
         if (srcoff != 0 && len > 32-srcoff) {
             dstbuf = mem_rword(dst);
@@ -818,7 +907,7 @@ int ins_andbsu  (WORD src, WORD dst, WORD len, SWORD offs) {
             }
             len = 0;
         }
-    } else {
+    } else if (len > 0) {
         WORD srcbuf = mem_rword(src);
         dstbuf = mem_rword(dst);
         while (len > 0) {
@@ -973,6 +1062,7 @@ int ins_xorbsu  (WORD src, WORD dst, WORD len, SWORD offs) {
         }
     }
 
+    bstr_fast(BSTR_XOR, &src, &dst, &len, &srcoff, &dstoff);
     if (srcoff == dstoff) {
         if (srcoff != 0 && len > 32-srcoff) {
             dstbuf = mem_rword(dst);
@@ -1020,7 +1110,7 @@ int ins_xorbsu  (WORD src, WORD dst, WORD len, SWORD offs) {
             }
             len = 0;
         }
-    } else {
+    } else if (len > 0) {
         WORD srcbuf = mem_rword(src);
         dstbuf = mem_rword(dst);
         while (len > 0) {
@@ -1195,6 +1285,7 @@ int ins_movbsu  (WORD src, WORD dst, WORD len, SWORD offs) {
         }
     }
 
+    bstr_fast(BSTR_MOV, &src, &dst, &len, &srcoff, &dstoff);
     if (srcoff == dstoff) {
         if (srcoff != 0 && len > 32-srcoff) {
             dstbuf = mem_rword(dst);
@@ -1245,7 +1336,7 @@ int ins_movbsu  (WORD src, WORD dst, WORD len, SWORD offs) {
             }
             len = 0;
         }
-    } else {
+    } else if (len > 0) {
         WORD srcbuf = mem_rword(src);
         dstbuf = mem_rword(dst);
         while (len > 0) {
@@ -1402,6 +1493,7 @@ int ins_ornbsu  (WORD src, WORD dst, WORD len, SWORD offs) {
         }
     }
 
+    bstr_fast(BSTR_ORN, &src, &dst, &len, &srcoff, &dstoff);
     if (srcoff == dstoff) {
         if (srcoff != 0 && len > 32-srcoff) {
             dstbuf = mem_rword(dst);
@@ -1449,7 +1541,7 @@ int ins_ornbsu  (WORD src, WORD dst, WORD len, SWORD offs) {
             }
             len = 0;
         }
-    } else {
+    } else if (len > 0) {
         WORD srcbuf = mem_rword(src);
         dstbuf = mem_rword(dst);
         while (len > 0) {
@@ -1604,6 +1696,7 @@ int ins_andnbsu (WORD src, WORD dst, WORD len, SWORD offs) {
         }
     }
 
+    bstr_fast(BSTR_ANDN, &src, &dst, &len, &srcoff, &dstoff);
     if (srcoff == dstoff) {
         if (srcoff != 0 && len > 32-srcoff) {
             dstbuf = mem_rword(dst);
@@ -1651,7 +1744,7 @@ int ins_andnbsu (WORD src, WORD dst, WORD len, SWORD offs) {
             }
             len = 0;
         }
-    } else {
+    } else if (len > 0) {
         WORD srcbuf = mem_rword(src);
         dstbuf = mem_rword(dst);
         while (len > 0) {
@@ -1806,6 +1899,7 @@ int ins_xornbsu (WORD src, WORD dst, WORD len, SWORD offs) {
         }
     }
 
+    bstr_fast(BSTR_XORN, &src, &dst, &len, &srcoff, &dstoff);
     if (srcoff == dstoff) {
         if (srcoff != 0 && len > 32-srcoff) {
             dstbuf = mem_rword(dst);
@@ -1853,7 +1947,7 @@ int ins_xornbsu (WORD src, WORD dst, WORD len, SWORD offs) {
             }
             len = 0;
         }
-    } else {
+    } else if (len > 0) {
         WORD srcbuf = mem_rword(src);
         dstbuf = mem_rword(dst);
         while (len > 0) {
@@ -2009,6 +2103,7 @@ int ins_notbsu  (WORD src, WORD dst, WORD len, SWORD offs) {
         }
     }
 
+    bstr_fast(BSTR_NOT, &src, &dst, &len, &srcoff, &dstoff);
     if (srcoff == dstoff) {
         if (srcoff != 0 && len > 32-srcoff) {
             dstbuf = mem_rword(dst);
@@ -2056,7 +2151,7 @@ int ins_notbsu  (WORD src, WORD dst, WORD len, SWORD offs) {
             }
             len = 0;
         }
-    } else {
+    } else if (len > 0) {
         WORD srcbuf = mem_rword(src);
         dstbuf = mem_rword(dst);
         while (len > 0) {
@@ -2128,6 +2223,58 @@ int ins_notbsu  (WORD src, WORD dst, WORD len, SWORD offs) {
     return cycles;
 }
 
+// Whole words at word-aligned offsets, which is what blits are made of.
+// The dynarec calls this when both bit offsets are 0 and the length is a
+// multiple of 32, with the operation (0-7, orbsu to notbsu) in the low bits
+// of offs where the offsets would be. It skips straight to bstr_fast, and
+// anything it can't do is passed on to the routines above.
+int ins_bstrWords(WORD src, WORD dst, WORD len, SWORD offs) {
+    static int (*const bstr_ops[8])(WORD, WORD, WORD, SWORD) = {
+        ins_orbsu, ins_andbsu, ins_xorbsu, ins_movbsu,
+        ins_ornbsu, ins_andnbsu, ins_xornbsu, ins_notbsu,
+    };
+    int op = offs & 7;
+    offs &= ~0x3ff;
+
+    // the Golf timing hacks live in the regular routines
+    if (len == 0 || (len & 31) ||
+        memcmp(tVBOpt.GAME_ID, "01VVGE", 6) == 0 || memcmp(tVBOpt.GAME_ID, "E4VVGJ", 6) == 0
+    ) {
+        return bstr_ops[op](src, dst, len, offs);
+    }
+
+    // type 1 timing, see ins_orbsu
+    int cycle_cap = -(offs >> 10);
+    int one_read = get_read_cycles(src);
+    int one_readwrite = get_readwrite_cycles(dst);
+    int words = len >> 5;
+    int cycles;
+    if (words == 1) cycles = 38 + one_read + one_readwrite;
+    else if (words == 2) cycles = 53 + 2 * (one_read + one_readwrite);
+    else {
+        int slope = 12 + one_read + one_readwrite;
+        cycles = slope * words + 30;
+        if (cycles > cycle_cap) {
+            words = 1 + (cycle_cap - 30) / slope;
+            if (words < 3) words = 3;
+            cycles = slope * words + 30;
+        }
+    }
+
+    WORD done = words * 32, srcoff = 0, dstoff = 0;
+    if (!bstr_fast(op, &src, &dst, &done, &srcoff, &dstoff)) {
+        return bstr_ops[op](src, dst, len, offs);
+    }
+
+    vb_state->v810_state.P_REG[30] = src;
+    vb_state->v810_state.P_REG[29] = dst;
+    vb_state->v810_state.P_REG[28] = len - words * 32;
+    vb_state->v810_state.P_REG[27] = 0;
+    vb_state->v810_state.P_REG[26] = 0;
+
+    return cycles;
+}
+
 WORD ins_rev(WORD n) {
     // swap adjacent bits
     n = ((n >> 1) & 0x55555555) | ((n << 1) & 0xAAAAAAAA);
@@ -3,48 +3,147 @@
 #include "vb_dsp.h"
 #include "vb_sound.h"
 #include "v810_mem.h"
+#include "interpreter.h"
+#include "fastmem.h"
 
 int is_sram = 0;
 
+/////////////////////////////////////////////////////////////////////////////
+// Page table
+
+// Direct writes to VRAM, which the renderer caches
+static void vram_written(WORD addr, int size) {
+    int i;
+    if (!emulating_self) return;
+    addr &= 0x7ffff;
+    if(addr < BGMAP_OFFSET) {
+        //Kill it if writes to Char Table
+        if((addr & 0x6000) == 0x6000) {
+            for(i=0;i<14;i++) tDSPCACHE.BGCacheInvalid[i]=1;
+            tDSPCACHE.ObjDataCacheInvalid=1;
+            tDSPCACHE.CharCacheInvalid=1;
+            tDSPCACHE.CharacterCache[((addr & 0x1fff) | ((addr & 0x18000) >> 2)) >> 4] = true;
+        } else { //Direct Mem Writes, darn thoes fragmented memorys!!!
+            tDSPCACHE.DDSPDataState[(addr>>15)&1] = CPU_WROTE;
+            SOFTBOUND *column = &tDSPCACHE.SoftBufWrote[(addr>>15)&1][(addr>>9)&63];
+            int y = (addr>>1) & 31;
+            if (y < column->min) column->min = y;
+            if (size == 4) y++; // 32-bit write covers two tiles, so add 1 for the max calc
+            if (y > column->max) column->max = y;
+        }
+    } else if (addr >= COLTABLE_OFFSET && addr < OBJ_OFFSET) {
+        tDSPCACHE.ColumnTableInvalid=1;
+    }else if((addr >=OBJ_OFFSET)&&(addr < (OBJ_OFFSET+(OBJ_SIZE*1024)))) { //Writes to Obj Table
+        tDSPCACHE.ObjDataCacheInvalid=1;
+    } else if((addr >=BGMAP_OFFSET)&&(addr < (BGMAP_OFFSET+(14*BGMAP_SIZE)))) { //Writes to BGMap Table
+        tDSPCACHE.BGCacheInvalid[((addr-BGMAP_OFFSET)/BGMAP_SIZE)]=1;
+    }
+}
+
+// Direct writes to the Chr ram mirror at 078000-07FFFF
+static void chr_written(WORD addr, int size) {
+    int i;
+    if (!emulating_self) return;
+    //Invalidate, writes to Char table
+    for(i=0;i<14;i++) tDSPCACHE.BGCacheInvalid[i]=1;
+    tDSPCACHE.ObjDataCacheInvalid=1;
+    tDSPCACHE.CharCacheInvalid=1;
+    tDSPCACHE.CharacterCache[((addr & 0x7ffff) - 0x78000) >> 4] = true;
+}
+
+// Direct writes to WRAM, which may hold predecoded code
+static void wram_written(WORD addr, int size) {
+    if (size == 4) {
+        interpreter_invalidateWram(addr & ~3);
+        interpreter_invalidateWram(addr | 2);
+    } else {
+        interpreter_invalidateWram(addr);
+    }
+}
+
+static void mem_mapPage(V810_MEMPAGE *pages, WORD addr, BYTE *host, BYTE flags, BYTE rwait, BYTE wwait, void (*written)(WORD, int)) {
+    V810_MEMPAGE *page = &pages[addr >> MEM_PAGE_BITS];
+    page->off = (size_t)host - addr;
+    page->written = written;
+    page->flags = flags;
+    page->rwait = rwait;
+    page->wwait = wwait;
+}
+
+// ROM wait states depend on WCR, so this is redone when it changes
+static void mem_mapRom(VB_STATE *state) {
+    // ROMs that don't fill whole pages are left to the slow path
+    if ((V810_ROM1.highaddr & (MEM_PAGE_SIZE - 1)) != MEM_PAGE_SIZE - 1) return;
+    BYTE wait = 2 - (state->tHReg.WCR & 1);
+    BYTE *fastmem = NULL;
+    #if FASTMEM_AVAILABLE
+    if (fastmem_hasRom()) fastmem = fastmem_base(state);
+    #endif
+    for (WORD addr = 0x07000000; addr < 0x08000000; addr += MEM_PAGE_SIZE) {
+        BYTE *host = fastmem ? fastmem + addr : (BYTE *)(V810_ROM1.off + (addr & V810_ROM1.highaddr));
+        mem_mapPage(state->pages, addr, host, MEM_PAGE_READ, wait, 0, NULL);
+    }
+}
+
+void mem_mapPages(VB_STATE *state) {
+    memset(state->pages, 0, MEM_PAGE_COUNT * sizeof(V810_MEMPAGE));
+
+    // VIP space, mirrored every 512K
+    for (WORD addr = 0; addr < 0x01000000; addr += MEM_PAGE_SIZE) {
+        WORD vip = addr & 0x7ffff;
+        if (!(vip & 0x40000)) {
+            mem_mapPage(state->pages, addr, state->V810_DISPLAY_RAM.pmemory + vip,
+                MEM_PAGE_READ | MEM_PAGE_WRITE, 4, 1, vram_written);
+        } else if (vip >= 0x78000) {
+            // Mirror the Chr ram table to 078000-07FFFF, 8K of it after each pair of framebuffers
+            BYTE *chr = state->V810_DISPLAY_RAM.pmemory + 0x6000 + ((vip - 0x78000) >> 13) * 0x8000 + (vip & 0x1fff);
+            mem_mapPage(state->pages, addr, chr, MEM_PAGE_READ | MEM_PAGE_WRITE, 4, 1, chr_written);
+        }
+    }
+
+    // WRAM, mirrored every 64K
+    BYTE *fastmem = NULL;
+    #if FASTMEM_AVAILABLE
+    // the mirrors are already in the host's address space
+    fastmem = fastmem_base(state);
+    #endif
+    for (WORD addr = 0x05000000; addr < 0x06000000; addr += MEM_PAGE_SIZE) {
+        mem_mapPage(state->pages, addr, fastmem ? fastmem + addr : state->V810_VB_RAM.pmemory + (addr & 0xffff),
+            MEM_PAGE_READ | MEM_PAGE_WRITE, 0, 0, wram_written);
+    }
+
+    mem_mapRom(state);
+}
+
+#define MEM_PAGE(addr) (&vb_state->pages[(addr) >> MEM_PAGE_BITS])
+
 // Memory read functions
 uint64_t mem_rbyte(WORD addr) {
     uint64_t wait;
 
+    addr &= 0x07ffffff;
+    const V810_MEMPAGE *page = MEM_PAGE(addr);
+    if (likely(page->flags & MEM_PAGE_READ)) {
+        return (WORD)((SBYTE *)(page->off + addr))[0] | ((uint64_t)page->rwait << 32);
+    }
+
     switch((addr&0x7000000)) {// switch on address
     case 0x7000000:
         wait = (uint64_t)(2 - (vb_state->tHReg.WCR & 1)) << 32;
         return (WORD)((SBYTE *)(V810_ROM1.off + (addr & V810_ROM1.highaddr)))[0] | wait;
         break;
     case 0:
+        // VRAM and the Chr ram mirror are in the page table
         addr &= 0x7ffff;
-        if(!(addr & 0x40000)) {
-            wait = 4LL << 32;
-            return (WORD)((SBYTE *)(vb_state->V810_DISPLAY_RAM.off + addr))[0] | wait;
-        } else if((addr & 0x7e000) == 0x5e000) {
+        if((addr & 0x7e000) == 0x5e000) {
             wait = 1LL << 32;
             return (WORD)vipcreg_rbyte(addr) | wait;
-            // Mirror the Chr ram table to 078000-07FFFF
-        } else if(addr >= 0x00078000) {
-            wait = 4LL << 32;
-            if(addr < 0x0007A000) //CHR 0-511
-                return (WORD)((SBYTE *)(vb_state->V810_DISPLAY_RAM.off + (addr-0x00078000 + 0x00006000)))[0] | wait;
-            else if(addr < 0x0007C000) //CHR 512-1023
-                return (WORD)((SBYTE *)(vb_state->V810_DISPLAY_RAM.off + (addr-0x0007A000 + 0x0000E000)))[0] | wait;
-            else if(addr < 0x0007E000) //CHR 1024-1535
-                return (WORD)((SBYTE *)(vb_state->V810_DISPLAY_RAM.off + (addr-0x0007C000 + 0x00016000)))[0] | wait;
-            else //CHR 1536-2047
-                return (WORD)((SBYTE *)(vb_state->V810_DISPLAY_RAM.off + (addr-0x0007E000 + 0x0001E000)))[0] | wait;
         }
         break;
     case 0x1000000:
         wait = 0LL << 32;
         return 0 | wait;
         break;
-    case 0x5000000:
-        wait = 0LL << 32;
-        //~ dtprintf(0,ferr,"\nRead  BYTE  [%08x]:%02x  //VBRam",addr,((BYTE *)(vb_state->V810_VB_RAM.off + (addr & vb_state->V810_VB_RAM.highaddr)))[0]);
-        return (WORD)((SBYTE *)(vb_state->V810_VB_RAM.off + (addr & 0x0500ffff)))[0] | wait;
-        break;
     case 0x6000000:
         is_sram = 1;
         wait = 0LL << 32;
@@ -69,41 +168,29 @@ uint64_t mem_rhword(WORD addr) {
     //~ if(dbg_watchpt_en)
     //~ dbg_watchpt(addr, 16, 0, 0);
 
+    addr &= 0x07fffffe;
+    const V810_MEMPAGE *page = MEM_PAGE(addr);
+    if (likely(page->flags & MEM_PAGE_READ)) {
+        return (WORD)((SHWORD *)(page->off + addr))[0] | ((uint64_t)page->rwait << 32);
+    }
+
     switch((addr&0x7000000)) {
     case 0x7000000:
         wait = (uint64_t)(2 - (vb_state->tHReg.WCR & 1)) << 32;
         return (WORD)((SHWORD *)(V810_ROM1.off + (addr & V810_ROM1.highaddr & ~1)))[0] | wait;
         break;
     case 0:
+        // VRAM and the Chr ram mirror are in the page table
         addr &= 0x7fffe;
-        if(!(addr & 0x40000)) {
-            wait = 4LL << 32;
-            return (WORD)((SHWORD *)(vb_state->V810_DISPLAY_RAM.off + addr))[0] | wait;
-        } else if((addr & 0x7e000) == 0x5e000) {
+        if((addr & 0x7e000) == 0x5e000) {
             wait = 1LL << 32;
             return (WORD)vipcreg_rhword(addr) | wait;
-            // Mirror the Chr ram table to 078000-07FFFF
-        } else if(addr >= 0x00078000) {
-            wait = 4LL << 32;
-            if(addr < 0x0007A000) //CHR 0-511
-                return (WORD)((SHWORD *)(vb_state->V810_DISPLAY_RAM.off + (addr-0x00078000 + 0x00006000)))[0] | wait;
-            else if(addr < 0x0007C000) //CHR 512-1023
-                return (WORD)((SHWORD *)(vb_state->V810_DISPLAY_RAM.off + (addr-0x0007A000 + 0x0000E000)))[0] | wait;
-            else if(addr < 0x0007E000) //CHR 1024-1535
-                return (WORD)((SHWORD *)(vb_state->V810_DISPLAY_RAM.off + (addr-0x0007C000 + 0x00016000)))[0] | wait;
-            else //CHR 1536-2047
-                return (WORD)((SHWORD *)(vb_state->V810_DISPLAY_RAM.off + (addr-0x0007E000 + 0x0001E000)))[0] | wait;
         }
         break;
     case 0x1000000:
         wait = 0LL << 32;
         return 0 | wait;
         break;
-    case 0x5000000:
-        wait = 0LL << 32;
-        //~ dtprintf(0,ferr,"\nRead  HWORD [%08x]:%04x  //VBRam",addr,((HWORD *)(vb_state->V810_VB_RAM.off + (addr & vb_state->V810_VB_RAM.highaddr)))[0]);
-        return (WORD)((SHWORD *)(vb_state->V810_VB_RAM.off + (addr & 0x0500fffe)))[0] | wait;
-        break;
     case 0x6000000:
         is_sram = 1;
         wait = 0LL << 32;
@@ -128,41 +215,29 @@ uint64_t mem_rword(WORD addr) {
     //~ if(dbg_watchpt_en)
     //~ dbg_watchpt(addr, 32, 0, 0);
 
+    addr &= 0x07fffffc;
+    const V810_MEMPAGE *page = MEM_PAGE(addr);
+    if (likely(page->flags & MEM_PAGE_READ)) {
+        return ((WORD *)(page->off + addr))[0] | ((uint64_t)page->rwait << 33);
+    }
+
     switch((addr&0x7000000)) {
     case 0x7000000:
         wait = (uint64_t)(2LL - (vb_state->tHReg.WCR & 1)) << 33;
         return ((WORD *)(V810_ROM1.off + (addr & V810_ROM1.highaddr & ~3)))[0] | wait;
         break;
     case 0:
+        // VRAM and the Chr ram mirror are in the page table
         addr &= 0x7fffc;
-        if(!(addr & 0x40000)) {
-            wait = 4LL << 33;
-            return ((WORD *)(vb_state->V810_DISPLAY_RAM.off + addr))[0] | wait;
-        } else if((addr & 0x7e000) == 0x5e000) {
+        if((addr & 0x7e000) == 0x5e000) {
             wait = 1LL << 33;
             return vipcreg_rword(addr) | wait;
-            // Mirror the Chr ram table to 078000-07FFFF
-        } else  if(addr >= 0x00078000) {
-            wait = 4LL << 33;
-            if(addr < 0x0007A000) //CHR 0-511
-                return ((WORD *)(vb_state->V810_DISPLAY_RAM.off + (addr-0x00078000 + 0x00006000)))[0] | wait;
-            else if(addr < 0x0007C000) //CHR 512-1023
-                return ((WORD *)(vb_state->V810_DISPLAY_RAM.off + (addr-0x0007A000 + 0x0000E000)))[0] | wait;
-            else if(addr < 0x0007E000) //CHR 1024-1535
-                return ((WORD *)(vb_state->V810_DISPLAY_RAM.off + (addr-0x0007C000 + 0x00016000)))[0] | wait;
-            else //CHR 1536-2047
-                return ((WORD *)(vb_state->V810_DISPLAY_RAM.off + (addr-0x0007E000 + 0x0001E000)))[0] | wait;
         }
         break;
     case 0x1000000:
         wait = 0LL << 33;
         return 0 | wait;
         break;
-    case 0x5000000:
-        wait = 0LL << 33;
-        //~ dtprintf(0,ferr,"\nRead  WORD  [%08x]:%08x  //VBRam",addr,((WORD *)(vb_state->V810_VB_RAM.off + (addr & vb_state->V810_VB_RAM.highaddr)))[0]);
-        return ((WORD *)(vb_state->V810_VB_RAM.off + (addr & 0x0500fffc)))[0] | wait;
-        break;
     case 0x6000000:
         is_sram = 1;
         wait = 0LL << 33;
@@ -184,69 +259,29 @@ uint64_t mem_rword(WORD addr) {
 /////////////////////////////////////////////////////////////////////////////
 //Memory Write Func
 WORD mem_wbyte(WORD addr, WORD data) {
-    int i =0;
-
     //~ if(dbg_watchpt_en)
     //~ dbg_watchpt(addr, 8, 1, data);
 
+    addr &= 0x07ffffff;
+    const V810_MEMPAGE *page = MEM_PAGE(addr);
+    if (likely(page->flags & MEM_PAGE_WRITE)) {
+        ((BYTE *)(page->off + addr))[0] = data;
+        if (page->written) page->written(addr, 1);
+        return page->wwait;
+    }
+
     switch((addr&0x7000000)) {
     case 0:
+        // VRAM and the Chr ram mirror are in the page table
         addr &= 0x7ffff;
-        if(!(addr & 0x40000)) {
-            ((BYTE *)(vb_state->V810_DISPLAY_RAM.off + addr))[0] = data;
-
-            if (emulating_self) {
-                if(addr < BGMAP_OFFSET) {
-                    //Kill it if writes to Char Table
-                    if((addr & 0x6000) == 0x6000) {
-                        for(i=0;i<14;i++) tDSPCACHE.BGCacheInvalid[i]=1;
-                        tDSPCACHE.ObjDataCacheInvalid=1;
-                        tDSPCACHE.CharCacheInvalid=1;
-                        tDSPCACHE.CharacterCache[((addr & 0x1fff) | ((addr & 0x18000) >> 2)) >> 4] = true;
-                    } else { //Direct Mem Writes, darn thoes fragmented memorys!!!
-                        tDSPCACHE.DDSPDataState[(addr>>15)&1] = CPU_WROTE;
-                        SOFTBOUND *column = &tDSPCACHE.SoftBufWrote[(addr>>15)&1][(addr>>9)&63];
-                        int y = (addr>>1) & 31;
-                        if (y < column->min) column->min = y;
-                        if (y > column->max) column->max = y;
-                    }
-                } else if (addr >= COLTABLE_OFFSET && addr < OBJ_OFFSET) {
-                    tDSPCACHE.ColumnTableInvalid=1;
-                }else if((addr >=OBJ_OFFSET)&&(addr < (OBJ_OFFSET+(OBJ_SIZE*1024)))) { //Writes to Obj Table
-                    tDSPCACHE.ObjDataCacheInvalid=1;
-                } else if((addr >=BGMAP_OFFSET)&&(addr < (BGMAP_OFFSET+(14*BGMAP_SIZE)))) { //Writes to BGMap Table
-                    tDSPCACHE.BGCacheInvalid[((addr-BGMAP_OFFSET)/BGMAP_SIZE)]=1;
-                }
-            }
-        } else if((addr & 0x7e000) == 0x5e000) {
+        if((addr & 0x7e000) == 0x5e000) {
             vipcreg_wbyte(addr, data);
-            // Mirror the Chr ram table to 078000-07FFFF
-        } else if(addr >= 0x00078000) {
-            if(addr < 0x0007A000) //CHR 0-511
-                ((BYTE *)(vb_state->V810_DISPLAY_RAM.off + ((addr-0x00078000) + 0x00006000)))[0] = data;
-            else if(addr < 0x0007C000) //CHR 512-1023
-                ((BYTE *)(vb_state->V810_DISPLAY_RAM.off + ((addr-0x0007A000) + 0x0000E000)))[0] = data;
-            else if(addr < 0x0007E000) //CHR 1024-1535
-                ((BYTE *)(vb_state->V810_DISPLAY_RAM.off + ((addr-0x0007C000) + 0x00016000)))[0] = data;
-            else //CHR 1536-2047
-                ((BYTE *)(vb_state->V810_DISPLAY_RAM.off + ((addr-0x0007E000) + 0x0001E000)))[0] = data;
-            if (emulating_self) {
-                //Invalidate, writes to Char table
-                for(i=0;i<14;i++) tDSPCACHE.BGCacheInvalid[i]=1;
-                tDSPCACHE.ObjDataCacheInvalid=1;
-                tDSPCACHE.CharCacheInvalid=1;
-                tDSPCACHE.CharacterCache[(addr - 0x78000) >> 4] = true;
-            }
         }
         return 1;
         break;
     case 0x1000000:
         sound_write(addr & 0x010007ff, data & 0xff);
         break;
-    case 0x5000000:
-        //~ dtprintf(0,ferr,"\nWrite BYTE  [%08x]:%02x  //VBRam",addr,data);
-        ((BYTE *)(vb_state->V810_VB_RAM.off + (addr & 0x0500ffff)))[0] = data;
-        break;
     case 0x6000000:
         is_sram = 1;
         //~ dtprintf(0,ferr,"\nWrite BYTE  PC:%08x [%08x]:%02x  //GameRam",PC,addr,data);
@@ -263,69 +298,30 @@ WORD mem_wbyte(WORD addr, WORD data) {
 }
 
 WORD mem_whword(WORD addr, WORD data) {
-    int i = 0;
     addr = addr & 0x07FFFFFE; // map to 24 bit address, mask first bit
 
     //~ if(dbg_watchpt_en)
     //~ dbg_watchpt(addr, 16, 1, data);
 
+    const V810_MEMPAGE *page = MEM_PAGE(addr);
+    if (likely(page->flags & MEM_PAGE_WRITE)) {
+        ((HWORD *)(page->off + addr))[0] = data;
+        if (page->written) page->written(addr, 2);
+        return page->wwait;
+    }
+
     switch((addr&0x7000000)) {
     case 0:
+        // VRAM and the Chr ram mirror are in the page table
         addr &= 0x7fffe;
-        if(!(addr & 0x40000)) {
-            ((HWORD *)(vb_state->V810_DISPLAY_RAM.off + addr))[0] = data;
-            if (emulating_self) {
-                if(addr < BGMAP_OFFSET) { //Kill it if writes to Char Table
-                    //Kill it if writes to Char Table
-                    if((addr & 0x6000) == 0x6000) {
-                        for(i=0;i<14;i++) tDSPCACHE.BGCacheInvalid[i]=1;
-                        tDSPCACHE.ObjDataCacheInvalid=1;
-                        tDSPCACHE.CharCacheInvalid=1;
-                        tDSPCACHE.CharacterCache[((addr & 0x1fff) | ((addr & 0x18000) >> 2)) >> 4] = true;
-                    } else { //Direct Mem Writes, darn thoes fragmented memorys!!!
-                        tDSPCACHE.DDSPDataState[(addr>>15)&1] = CPU_WROTE;
-                        SOFTBOUND *column = &tDSPCACHE.SoftBufWrote[(addr>>15)&1][(addr>>9)&63];
-                        int y = (addr>>1) & 31;
-                        if (y < column->min) column->min = y;
-                        if (y > column->max) column->max = y;
-                    }
-                } else if (addr >= COLTABLE_OFFSET && addr < OBJ_OFFSET) {
-                    tDSPCACHE.ColumnTableInvalid=1;
-                }else if((addr >=OBJ_OFFSET)&&(addr < (OBJ_OFFSET+(OBJ_SIZE*1024)))) { //Writes to Obj Table
-                    tDSPCACHE.ObjDataCacheInvalid=1;
-                } else if((addr >=BGMAP_OFFSET)&&(addr < (BGMAP_OFFSET+(14*BGMAP_SIZE)))) { //Writes to BGMap Table
-                    tDSPCACHE.BGCacheInvalid[((addr-BGMAP_OFFSET)/BGMAP_SIZE)]=1;
-                }
-            }
-        } else if((addr & 0x7e000) == 0x5e000) {
+        if((addr & 0x7e000) == 0x5e000) {
             vipcreg_whword(addr, data);
-            // Mirror the Chr ram table to 078000-07FFFF
-        } else if(addr >= 0x00078000) {
-            if(addr < 0x0007A000) //CHR 0-511
-                ((HWORD *)(vb_state->V810_DISPLAY_RAM.off + ((addr-0x00078000) + 0x00006000)))[0] = data;
-            else if(addr < 0x0007C000) //CHR 512-1023
-                ((HWORD *)(vb_state->V810_DISPLAY_RAM.off + ((addr-0x0007A000) + 0x0000E000)))[0] = data;
-            else if(addr < 0x0007E000) //CHR 1024-1535
-                ((HWORD *)(vb_state->V810_DISPLAY_RAM.off + ((addr-0x0007C000) + 0x00016000)))[0] = data;
-            else //CHR 1536-2047
-                ((HWORD *)(vb_state->V810_DISPLAY_RAM.off + ((addr-0x0007E000) + 0x0001E000)))[0] = data;
-            if (emulating_self) {
-                //Invalidate, writes to Char table
-                for(i=0;i<14;i++) tDSPCACHE.BGCacheInvalid[i]=1;
-                tDSPCACHE.ObjDataCacheInvalid=1;
-                tDSPCACHE.CharCacheInvalid=1;
-                tDSPCACHE.CharacterCache[(addr - 0x78000) >> 4] = true;
-            }
         }
         return 1;
         break;
     case 0x1000000:
         sound_write(addr & 0x010007fe, data & 0xff);
         break;
-    case 0x5000000:
-        //~ dtprintf(0,ferr,"\nWrite HWORD [%08x]:%04x  //VBRam",addr,data);
-        ((HWORD *)(vb_state->V810_VB_RAM.off + (addr & 0x0500fffe)))[0] = data;
-        break;
     case 0x6000000:
         is_sram = 1;
         //~ dtprintf(0,ferr,"\nWrite HWORD PC:%08x [%08x]:%04x  //GameRam",PC,addr,data);
@@ -342,70 +338,29 @@ WORD mem_whword(WORD addr, WORD data) {
 }
 
 WORD mem_wword(WORD addr, WORD data) {
-    int i = 0;
-    uint64_t wait;
-
     //~ if(dbg_watchpt_en)
     //~ dbg_watchpt(addr, 32, 1, data);
 
+    addr &= 0x07fffffc;
+    const V810_MEMPAGE *page = MEM_PAGE(addr);
+    if (likely(page->flags & MEM_PAGE_WRITE)) {
+        ((WORD *)(page->off + addr))[0] = data;
+        if (page->written) page->written(addr, 4);
+        return page->wwait * 2;
+    }
+
     switch((addr&0x7000000)) {
     case 0:
+        // VRAM and the Chr ram mirror are in the page table
         addr &= 0x7fffc;
-        if(!(addr & 0x40000)) {
-            ((WORD *)(vb_state->V810_DISPLAY_RAM.off + addr))[0] = data;
-            if (emulating_self) {
-                if(addr < BGMAP_OFFSET) { //Kill it if writes to Char Table
-                    //Kill it if writes to Char Table
-                    if((addr & 0x6000) == 0x6000) {
-                        for(i=0;i<14;i++) tDSPCACHE.BGCacheInvalid[i]=1;
-                        tDSPCACHE.ObjDataCacheInvalid=1;
-                        tDSPCACHE.CharCacheInvalid=1;
-                        tDSPCACHE.CharacterCache[((addr & 0x1fff) | ((addr & 0x18000) >> 2)) >> 4] = true;
-                    } else { //Direct Mem Writes, darn thoes fragmented memorys!!!
-                        tDSPCACHE.DDSPDataState[(addr>>15)&1] = CPU_WROTE;
-                        SOFTBOUND *column = &tDSPCACHE.SoftBufWrote[(addr>>15)&1][(addr>>9)&63];
-                        int y = (addr>>1) & 31;
-                        if (y < column->min) column->min = y;
-                        y++; // 32-bit write covers two tiles, so add 1 for the max calc
-                        if (y > column->max) column->max = y;
-                    }
-                } else if (addr >= COLTABLE_OFFSET && addr < OBJ_OFFSET) {
-                    tDSPCACHE.ColumnTableInvalid=1;
-                }else if((addr >=OBJ_OFFSET)&&(addr < (OBJ_OFFSET+(OBJ_SIZE*1024)))) { //Writes to Obj Table
-                    tDSPCACHE.ObjDataCacheInvalid=1;
-                } else if((addr >=BGMAP_OFFSET)&&(addr < (BGMAP_OFFSET+(14*BGMAP_SIZE)))) { //Writes to BGMap Table
-                    tDSPCACHE.BGCacheInvalid[((addr-BGMAP_OFFSET)/BGMAP_SIZE)]=1;
-                }
-            }
-        } else if((addr & 0x7e000) == 0x5e000) {
+        if((addr & 0x7e000) == 0x5e000) {
             vipcreg_wword(addr, data);
-            // Mirror the Chr ram table to 078000-07FFFF
-        } else if(addr >= 0x00078000) {
-            if(addr < 0x0007A000)  //CHR 0-511
-                ((WORD *)(vb_state->V810_DISPLAY_RAM.off + ((addr-0x00078000) + 0x00006000)))[0] = data;
-            else if(addr < 0x0007C000) //CHR 512-1023
-                ((WORD *)(vb_state->V810_DISPLAY_RAM.off + ((addr-0x0007A000) + 0x0000E000)))[0] = data;
-            else if(addr < 0x0007E000) //CHR 1024-1535
-                ((WORD *)(vb_state->V810_DISPLAY_RAM.off + ((addr-0x0007C000) + 0x00016000)))[0] = data;
-            else      //CHR 1536-2047
-                ((WORD *)(vb_state->V810_DISPLAY_RAM.off + ((addr-0x0007E000) + 0x0001E000)))[0] = data;
-            if (emulating_self) {
-                //Invalidate, writes to Char table
-                for(i=0;i<14;i++) tDSPCACHE.BGCacheInvalid[i]=1;
-                tDSPCACHE.ObjDataCacheInvalid=1;
-                tDSPCACHE.CharCacheInvalid=1;
-                tDSPCACHE.CharacterCache[(addr - 0x78000) >> 4] = true;
-            }
         }
         return 2;
         break;
     case 0x1000000:
         sound_write(addr & 0x010007fc, data & 0xff);
         break;
-    case 0x5000000:
-        //~ dtprintf(0,ferr,"\nWrite WORD  [%08x]:%08x  //VBRam",addr,data);
-        ((WORD *)(vb_state->V810_VB_RAM.off + (addr & 0x0500fffc)))[0] = data;
-        break;
     case 0x6000000:
         is_sram = 1;
         //~ dtprintf(0,ferr,"\nWrite WORD  PC:%08x [%08x]:%08x  //GameRam",PC,addr,data);
@@ -495,6 +450,8 @@ WORD hcreg_wbyte(WORD addr, BYTE data) {
             }
         }
         vb_state->tHReg.CCR = ((data|0x69)&0xFD);
+        // takes effect from the next serviceInt
+        scheduleEvent(vb_state, EVENT_COMM);
         if (data & 0x80) {
             // acknowledge interrupt
             vb_state->tHReg.cInt = false;
@@ -526,6 +483,7 @@ WORD hcreg_wbyte(WORD addr, BYTE data) {
         vb_state->tHReg.TLB = data;
         vb_state->tHReg.tTHW = (vb_state->tHReg.TLB | (vb_state->tHReg.tTHW & 0xFF00)); //Reset internal count
         vb_state->tHReg.tCount = vb_state->tHReg.tTHW;
+        scheduleEvent(vb_state, EVENT_TIMER);
         if (vb_state->tHReg.TCR & 0x01) predictEvent(true);
         //vb_state->tHReg.tTHW = (vb_state->tHReg.TLB | (vb_state->tHReg.THB << 8)); //Reset internal count
         break;
@@ -534,6 +492,7 @@ WORD hcreg_wbyte(WORD addr, BYTE data) {
         vb_state->tHReg.THB = data;
         vb_state->tHReg.tTHW = ((vb_state->tHReg.THB << 8) | (vb_state->tHReg.tTHW & 0xFF)); //Reset internal count
         vb_state->tHReg.tCount = vb_state->tHReg.tTHW;
+        scheduleEvent(vb_state, EVENT_TIMER);
         if (vb_state->tHReg.TCR & 0x01) predictEvent(true);
         //vb_state->tHReg.tTHW = (vb_state->tHReg.TLB | (vb_state->tHReg.THB << 8)); //Reset internal count
         break;
@@ -567,6 +526,7 @@ WORD hcreg_wbyte(WORD addr, BYTE data) {
             }
         }
 
+        scheduleEvent(vb_state, EVENT_TIMER);
         predictEvent(true);
 
         break;
@@ -574,6 +534,7 @@ WORD hcreg_wbyte(WORD addr, BYTE data) {
     case 0x02000024:    //WCR
         //~ dtprintf(3,ferr,"\nWrite  BYTE HCREG WCR [%08x]:%02x ",addr,data);
         vb_state->tHReg.WCR = (data|0xFC); // Mask
+        mem_mapRom(vb_state);
         break;
     case 0x02000028:    //SCR
         //~ dtprintf(3,ferr,"\nWrite  BYTE HCREG SCR [%08x]:%02x ",addr,data);
@@ -586,6 +547,7 @@ WORD hcreg_wbyte(WORD addr, BYTE data) {
                 vb_state->tHReg.SCR |= 2;
                 vb_state->tHReg.hwRead = 10240;
                 vb_state->tHReg.lastinput = vb_state->v810_state.cycles + vb_state->v810_state.cycles_until_event_full - vb_state->v810_state.cycles_until_event_partial;
+                scheduleEvent(vb_state, EVENT_INPUT);
                 predictEvent(true);
             }
         } else if(data & 0x20) { //Software Read, same for now....
@@ -10,6 +10,7 @@
 #include "vb_types.h"
 #include "v810_cpu.h"
 #include "v810_mem.h"
+#include "interpreter.h"
 #include "vb_dsp.h"
 #include "vb_gui.h"
 #include "vb_set.h"
@@ -245,6 +246,8 @@ int emulation_lstate(int state) {
     READ_VAR(new_state.PC);
     READ_VAR(new_state.cycles);
     READ_VAR(new_state.except_flags);
+    // PC is left on a HALT, so it's simply executed again
+    new_state.halted = false;
 
     //Load VIP registers
     V810_VIPREGDAT new_vipreg = {0};
@@ -474,6 +477,10 @@ int emulation_lstate(int state) {
     APPLY_MEMORY(V810_VB_RAM);
     APPLY_MEMORY(V810_GAME_RAM);
     #undef APPLY_MEMORY
+    // both players' memory moved, and WCR may have changed
+    mem_mapPages(&vb_players[0]);
+    mem_mapPages(&vb_players[1]);
+    interpreter_clearCache();
 
     // frametime was moved to end-of-frame in version 2
     if (ver < 2) {
@@ -485,6 +492,8 @@ int emulation_lstate(int state) {
         }
     }
 
+    scheduleAllEvents(vb_state);
+
     clearCache();
     C3D_FrameBegin(0);
     video_render((vb_state->tVIPREG.tDisplayedFB) % 2, false);
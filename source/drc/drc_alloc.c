@@ -0,0 +1,217 @@
+#include <stddef.h>
+#include "vb_types.h"
+#include "drc_alloc.h"
+
+// Free space in the cache is kept in segregated lists, TLSF style: the first
+// level splits sizes by powers of two and the second level splits each of
+// those into SL_COUNT ranges. The bitmaps tell which lists have anything in
+// them, so finding a block that fits never walks a list.
+#define SL_BITS 3
+#define SL_COUNT (1 << SL_BITS)
+#define FL_COUNT 24
+
+typedef struct {
+    WORD *start;
+    int size;
+    SHWORD prev, next;
+} FreeBlock;
+
+static FreeBlock free_blocks[MAX_NUM_BLOCKS];
+static int free_block_count = 0;
+
+// Entries of free_blocks not describing any free space, chained through next
+static SHWORD unused_blocks;
+static SHWORD free_lists[FL_COUNT][SL_COUNT];
+static WORD fl_bitmap;
+static WORD sl_bitmap[FL_COUNT];
+// Total size of the free blocks, not counting the space after cache_pos
+static WORD free_words;
+
+// Every block is surrounded by words holding the id of the free block it
+// belongs to, or -1 if it's allocated: the top half of the word before the
+// block and the bottom half of the word after. Adjacent blocks share a word.
+static void mark_block(WORD *start, WORD size, SHWORD id) {
+    ((SHWORD*)(start - 1))[1] = id;
+    ((SHWORD*)(start + size))[0] = id;
+}
+
+// Gets the list holding free blocks of the given size
+static void mapping(WORD size, int *fl, int *sl) {
+    if (size < SL_COUNT) {
+        *fl = 0;
+        *sl = size;
+    } else {
+        int msb = 31 - __builtin_clz(size);
+        *fl = msb - (SL_BITS - 1);
+        *sl = (size >> (msb - SL_BITS)) ^ SL_COUNT;
+    }
+}
+
+static void insert_block(SHWORD id) {
+    int fl, sl;
+    mapping(free_blocks[id].size, &fl, &sl);
+    free_blocks[id].prev = -1;
+    free_blocks[id].next = free_lists[fl][sl];
+    if (free_lists[fl][sl] >= 0)
+        free_blocks[free_lists[fl][sl]].prev = id;
+    free_lists[fl][sl] = id;
+    fl_bitmap |= 1 << fl;
+    sl_bitmap[fl] |= 1 << sl;
+    free_words += free_blocks[id].size;
+}
+
+static void remove_block(SHWORD id) {
+    int fl, sl;
+    mapping(free_blocks[id].size, &fl, &sl);
+    if (free_blocks[id].prev >= 0)
+        free_blocks[free_blocks[id].prev].next = free_blocks[id].next;
+    else
+        free_lists[fl][sl] = free_blocks[id].next;
+    if (free_blocks[id].next >= 0)
+        free_blocks[free_blocks[id].next].prev = free_blocks[id].prev;
+    if (free_lists[fl][sl] < 0) {
+        sl_bitmap[fl] &= ~(1 << sl);
+        if (!sl_bitmap[fl])
+            fl_bitmap &= ~(1 << fl);
+    }
+    free_words -= free_blocks[id].size;
+}
+
+static SHWORD new_block_id(void) {
+    SHWORD id = unused_blocks;
+    if (id >= 0) {
+        unused_blocks = free_blocks[id].next;
+        free_block_count++;
+    }
+    return id;
+}
+
+static void release_block_id(SHWORD id) {
+    free_blocks[id].next = unused_blocks;
+    unused_blocks = id;
+    free_block_count--;
+}
+
+// Finds a free block of at least inst_count words
+static SHWORD find_block(uint32_t inst_count) {
+    int fl, sl;
+    WORD sl_map;
+    // round up to the next list, where everything is big enough
+    if (inst_count >= SL_COUNT)
+        inst_count += (1 << (31 - __builtin_clz(inst_count) - SL_BITS)) - 1;
+    mapping(inst_count, &fl, &sl);
+    if (fl >= FL_COUNT) return -1;
+
+    sl_map = sl_bitmap[fl] & (~0U << sl);
+    if (!sl_map) {
+        WORD fl_map = fl + 1 < FL_COUNT ? fl_bitmap & (~0U << (fl + 1)) : 0;
+        if (!fl_map) return -1;
+        fl = __builtin_ctz(fl_map);
+        sl_map = sl_bitmap[fl];
+    }
+    sl = __builtin_ctz(sl_map);
+    return free_lists[fl][sl];
+}
+
+void drc_allocReset(void) {
+    int i, j;
+    for (i = 0; i < MAX_NUM_BLOCKS; i++)
+        free_blocks[i].next = i + 1 < MAX_NUM_BLOCKS ? i + 1 : -1;
+    unused_blocks = 0;
+    free_block_count = 0;
+    for (i = 0; i < FL_COUNT; i++) {
+        for (j = 0; j < SL_COUNT; j++)
+            free_lists[i][j] = -1;
+        sl_bitmap[i] = 0;
+    }
+    fl_bitmap = 0;
+    free_words = 0;
+}
+
+WORD *drc_alloc(uint32_t inst_count) {
+    SHWORD block = find_block(inst_count);
+    if (block >= 0) {
+        WORD *new_block = free_blocks[block].start;
+        remove_block(block);
+        free_blocks[block].size -= inst_count + 1;
+        free_blocks[block].start += inst_count + 1;
+        if (free_blocks[block].size < 0) {
+            // used it all up, including the word after it
+            release_block_id(block);
+        } else {
+            // mark shrunk block
+            insert_block(block);
+            mark_block(free_blocks[block].start, free_blocks[block].size, block);
+        }
+        mark_block(new_block, inst_count, -1);
+        return new_block;
+    }
+    if ((cache_pos - cache_start + inst_count)*4 >= CACHE_SIZE)
+        return NULL;
+    WORD *new_block = cache_pos;
+    cache_pos += inst_count + 1;
+    mark_block(new_block, inst_count, -1);
+    // additionally set the next (unallocated) block
+    new_block[inst_count] = -1;
+    return new_block;
+}
+
+void drc_free(exec_block *p_block) {
+    drc_unlinkBlock(p_block);
+    p_block->free = true;
+    WORD *start = p_block->phys_offset;
+    int size = p_block->size;
+    SHWORD last_block = ((SHWORD*)(start - 1))[0];
+    SHWORD next_block = ((SHWORD*)(start + size))[1];
+    SHWORD block = -1;
+    if (last_block >= 0) {
+        if (free_blocks[last_block].start + free_blocks[last_block].size + 1 != start) {
+            dprintf(0, "<invalid block %p..%d != %p\n", free_blocks[last_block].start, free_blocks[last_block].size, start);
+        }
+        remove_block(last_block);
+        start = free_blocks[last_block].start;
+        size += free_blocks[last_block].size + 1;
+        block = last_block;
+    } else if (start + size + 1 == cache_pos) {
+        // optimization for when the last block is freed
+        cache_pos = start;
+        return;
+    }
+    if (next_block >= 0) {
+        if (p_block->phys_offset + p_block->size + 1 != free_blocks[next_block].start) {
+            dprintf(0, ">invalid block %p..%ld != %p\n", p_block->phys_offset, p_block->size, free_blocks[next_block].start);
+        }
+        remove_block(next_block);
+        size += free_blocks[next_block].size + 1;
+        if (block >= 0)
+            release_block_id(next_block);
+        else
+            block = next_block;
+    }
+    if (block < 0) {
+        block = new_block_id();
+        // out of entries, so the space is lost until the next flush
+        if (block < 0) return;
+    }
+    free_blocks[block].start = start;
+    free_blocks[block].size = size;
+    insert_block(block);
+    mark_block(start, size, block);
+}
+
+int drc_fragmentation(void) {
+    WORD tail = CACHE_SIZE/4 - (cache_pos - cache_start);
+    WORD largest = tail;
+    WORD total = free_words + tail;
+    if (fl_bitmap) {
+        // the largest block is in the last list that has any
+        int fl = 31 - __builtin_clz(fl_bitmap);
+        int sl = 31 - __builtin_clz(sl_bitmap[fl]);
+        for (SHWORD id = free_lists[fl][sl]; id >= 0; id = free_blocks[id].next) {
+            if (free_blocks[id].size > largest)
+                largest = free_blocks[id].size;
+        }
+    }
+    if (total == 0) return 0;
+    return 100 - (int)((uint64_t)largest * 100 / total);
+}
@@ -0,0 +1,1727 @@
+/*
+ * V810 dynamic recompiler: backend-independent front end
+ *
+ * This file is distributed under the MIT License. However, some of the code
+ * (the V810 instruction decoding) is based on Reality Boy's interpreter and
+ * was written by David Tucker. For more information on the original license,
+ * check the README.
+ * 
+ * Copyright (c) 2015 danielps
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#ifdef __3DS__
+#include <3ds.h>
+#endif
+
+#include "utils.h"
+#include "drc_alloc.h"
+#include "drc_core.h"
+#include "drc_worker.h"
+#include "busywait.h"
+#include "hle.h"
+#include "interpreter.h"
+#include "v810_cpu.h"
+#include "v810_mem.h"
+#include "v810_opt.h"
+#include "vb_set.h"
+#include "vb_types.h"
+
+#include "replay.h"
+
+#include "vb_dsp.h"
+
+// Maps ROM addresses to the block and entrypoint translated for them. Pages
+// are only allocated once something in them is seen as code.
+typedef struct {
+    HWORD block[MAP_PAGE_SIZE];
+    HWORD entry[MAP_PAGE_SIZE];
+    BYTE data_code[MAP_PAGE_SIZE >> 3]; // a bit per halfword, set for code
+    // The HLE call replacing the routine here, for PCs a jal or far jr was
+    // seen going to, so drc_run doesn't have to look for it on every entry
+    BYTE hle_call[MAP_PAGE_SIZE];
+    bool mapped; // whether it's in mapped_pages
+#if DRC_PROFILE
+    BYTE translations[MAP_PAGE_SIZE]; // blocks translated starting here
+#endif
+} map_page;
+
+static map_page* map_pages[MAP_PAGE_COUNT];
+// Pages with entrypoints in them, so clearing the cache only has to go
+// through those
+static HWORD mapped_pages[MAP_PAGE_COUNT];
+static int mapped_page_count = 0;
+WORD reg_usage[32];
+WORD* cache_start;
+WORD* cache_pos;
+exec_block* block_ptr_start;
+int block_pos = 1;
+
+v810_instruction *inst_cache;
+
+// Block exits that have been patched to jump straight to another block
+typedef struct {
+    WORD *site;
+    exec_block *block;
+} block_link;
+
+static block_link links[MAX_NUM_LINKS];
+static int link_count = 0;
+// The exit the last block left through, if it can be linked
+static WORD *pending_link;
+
+return_stack ret_stack;
+
+// Counts the blocks entered from drc_run, to tell hot blocks from cold ones
+static WORD block_clock;
+static int evicted_blocks = 0;
+static int cache_flushes = 0;
+
+// The target of a hot jump, for drc_scanBlockBounds to pull into the block
+// the jump is from
+static WORD superblock_target;
+static int superblock_count = 0;
+
+// Loops worth keeping other registers cached in than the code around them get
+// split off into blocks of their own, at most this many per block
+#define LOOP_SPLIT_MAX 8
+// The PC drc_scanBlockBounds was last asked for and the bounds it found, or 0
+// if the block is a superblock, which is never split
+static WORD split_entry;
+static WORD split_start_PC, split_end_PC;
+// The first PC of each of the other parts of the last block split, for
+// drc_translate to translate next, decoding the same bounds again
+static WORD split_PCs[LOOP_SPLIT_MAX];
+static int split_count = 0;
+static bool split_again = false;
+
+// Targets of jumps out of the blocks translated so far, for the worker to
+// translate ahead of time
+#define JUMP_TARGET_QUEUE_SIZE 64
+static WORD jump_targets[JUMP_TARGET_QUEUE_SIZE];
+static int jump_target_head = 0, jump_target_count = 0;
+
+#if DRC_PROFILE
+static int profile_translations = 0;
+// Translations starting at a PC that was translated before
+static int profile_retranslations = 0;
+#endif
+
+// Whether a jal to PC gets decoded as the one instruction of the routine
+// there instead
+static bool drc_isInlined(WORD PC) {
+    int hle = hle_find(PC);
+    return hle && hle_entries[hle - 1].inline_op;
+}
+
+// V810 instructions are 16-bit aligned, so we can ignore the last bit of the PC
+static unsigned int drc_mapPos(WORD PC) {
+    return ((PC & V810_ROM1.highaddr) >> 1) & (BLOCK_MAP_COUNT - 1);
+}
+
+// Returns the page holding map_pos, allocating it if needed
+static map_page* drc_getMapPage(unsigned int map_pos) {
+    map_page **page = &map_pages[map_pos >> MAP_PAGE_BITS];
+    if (!*page) {
+        *page = calloc(1, sizeof(map_page));
+        if (!*page) dprintf(0, "[DRC]: couldn't allocate map page\n");
+    }
+    return *page;
+}
+
+static void drc_markCode(WORD PC) {
+    unsigned int map_pos = drc_mapPos(PC) & (MAP_PAGE_SIZE - 1);
+    map_page *page = drc_getMapPage(drc_mapPos(PC));
+    if (page) page->data_code[map_pos >> 3] |= 1 << (map_pos & 7);
+}
+
+static void drc_markData(WORD PC) {
+    unsigned int map_pos = drc_mapPos(PC) & (MAP_PAGE_SIZE - 1);
+    map_page *page = map_pages[drc_mapPos(PC) >> MAP_PAGE_BITS];
+    if (page) page->data_code[map_pos >> 3] &= ~(1 << (map_pos & 7));
+}
+
+static bool drc_isCode(WORD PC) {
+    unsigned int map_pos = drc_mapPos(PC) & (MAP_PAGE_SIZE - 1);
+    map_page *page = map_pages[drc_mapPos(PC) >> MAP_PAGE_BITS];
+    return page && !!(page->data_code[map_pos >> 3] & (1 << (map_pos & 7)));
+}
+
+static void drc_markHleCall(WORD PC, int hle) {
+    unsigned int map_pos = drc_mapPos(PC) & (MAP_PAGE_SIZE - 1);
+    map_page *page = drc_getMapPage(drc_mapPos(PC));
+    if (page) page->hle_call[map_pos] = hle;
+}
+
+static int drc_getHleCall(WORD PC) {
+    unsigned int map_pos = drc_mapPos(PC) & (MAP_PAGE_SIZE - 1);
+    map_page *page = map_pages[drc_mapPos(PC) >> MAP_PAGE_BITS];
+    if ((PC & 0x07000000) != 0x07000000) return 0;
+    return page ? page->hle_call[map_pos] : 0;
+}
+
+static bool drc_mapEntry(unsigned int map_pos, HWORD block, HWORD entry) {
+    map_page *page = drc_getMapPage(map_pos);
+    if (!page) return false;
+    if (!page->mapped) {
+        page->mapped = true;
+        mapped_pages[mapped_page_count++] = map_pos >> MAP_PAGE_BITS;
+    }
+    map_pos &= MAP_PAGE_SIZE - 1;
+    page->block[map_pos] = block;
+    page->entry[map_pos] = entry;
+    return true;
+}
+
+// Forgets every entrypoint, keeping the pages for next time
+static void drc_clearMap(void) {
+    for (int i = 0; i < mapped_page_count; i++) {
+        map_page *page = map_pages[mapped_pages[i]];
+        memset(page->block, 0, sizeof(page->block));
+        memset(page->entry, 0, sizeof(page->entry));
+        page->mapped = false;
+    }
+    mapped_page_count = 0;
+}
+
+// Frees all the pages, along with what was learnt about code and data
+static void drc_freeMap(void) {
+    for (int i = 0; i < MAP_PAGE_COUNT; i++) {
+        free(map_pages[i]);
+        map_pages[i] = NULL;
+    }
+    mapped_page_count = 0;
+}
+
+// Finds the starting and ending address of a V810 code block. It stops after a
+// jmp, jal, reti or a long jr unless it branches further.
+// All code accessible from the entry point is accounted for.
+void drc_scanBlockBounds(WORD* p_start_PC, WORD* p_end_PC) {
+    WORD entry_PC = *p_start_PC & V810_ROM1.highaddr;
+    bool is_superblock = superblock_target != 0;
+    WORD start_PC = entry_PC;
+    WORD end_PC = start_PC;
+    WORD cur_PC;
+    WORD branch_addr;
+    int branch_offset;
+    BYTE opcode;
+    bool finished;
+    BYTE lowB, highB, lowB2, highB2;
+
+    if (split_again) {
+        // another part of the block that was just split
+        split_entry = entry_PC;
+        *p_start_PC = split_start_PC;
+        *p_end_PC = split_end_PC;
+        return;
+    }
+
+    cur_PC = start_PC;
+    finished = false;
+    while(!finished) {
+        bool potentiallyDone = false;
+
+        exec_block *existing_block;
+        if (drc_getEntry(cur_PC, &existing_block) != cache_start) {
+            drc_free(existing_block);
+            WORD existing_start = existing_block->start_pc;
+            WORD existing_end = existing_start + existing_block->pc_range;
+            if (cur_PC < existing_start || cur_PC > existing_end) {
+                for (WORD PC = existing_start; PC <= existing_end; PC += 2)
+                    drc_markData(PC);
+                if (existing_start < cur_PC) cur_PC = start_PC;
+            } else {
+                if (existing_start < start_PC) start_PC = existing_start;
+                if (existing_end > end_PC) end_PC = existing_end;
+            }
+        }
+
+        drc_markCode(cur_PC);
+        if (cur_PC > end_PC)
+            end_PC = cur_PC;
+
+        cur_PC = (cur_PC & V810_ROM1.highaddr);
+        lowB   = ((BYTE *)(V810_ROM1.off + cur_PC))[0];
+        highB  = ((BYTE *)(V810_ROM1.off + cur_PC))[1];
+        lowB2  = ((BYTE *)(V810_ROM1.off + cur_PC))[2];
+        highB2 = ((BYTE *)(V810_ROM1.off + cur_PC))[3];
+
+        if ((highB & 0xE0) == 0x80)
+            opcode = highB>>1;
+        else
+            opcode = highB>>2;
+
+        switch (opcode) {
+            case V810_OP_JR:
+                branch_offset = (signed)sign_26(((highB & 0x3) << 24) + (lowB << 16) + (highB2 << 8) + lowB2);
+                if (abs(branch_offset) < 1024) {
+                    branch_addr = cur_PC + branch_offset;
+                    bool should_backjump = false;
+                    if (branch_addr < start_PC) {
+                        start_PC = branch_addr;
+                        should_backjump = true;
+                    } else if (branch_addr > end_PC) {
+                        end_PC = branch_addr;
+                    }
+
+                    bool was_code = drc_isCode(branch_addr);
+                    drc_markCode(branch_addr);
+                    if (branch_offset < 0) {
+                        if (!was_code) {
+                            // Not already scanned, so scan it.
+                            cur_PC = branch_addr;
+                            continue;
+                        } else {
+                            // Was previously scanned, so as long as we scanned it just now,
+                            // anything following from it should be accounted for.
+                            if (should_backjump) {
+                                cur_PC = branch_addr;
+                                continue;
+                            }
+                        }
+                    }
+                    
+                    potentiallyDone = true;
+                    break;
+                }
+            case V810_OP_JAL:
+                branch_addr = cur_PC + (signed)sign_26(((highB & 0x3) << 24) + (lowB << 16) + (highB2 << 8) + lowB2);
+                if (drc_isInlined(branch_addr)) break;
+            case V810_OP_JMP:
+            case V810_OP_RETI:
+                potentiallyDone = true;
+                break;
+            case V810_OP_BV:
+            case V810_OP_BL:
+            case V810_OP_BE:
+            case V810_OP_BNH:
+            case V810_OP_BN:
+            case V810_OP_BR:
+            case V810_OP_BLT:
+            case V810_OP_BLE:
+            case V810_OP_BNV:
+            case V810_OP_BNL:
+            case V810_OP_BNE:
+            case V810_OP_BH:
+            case V810_OP_BP:
+            case V810_OP_BGE:
+            case V810_OP_BGT:
+                branch_offset = (signed)sign_9(((highB & 0x1) << 8) + (lowB & 0xFE));
+                branch_addr = cur_PC + branch_offset;
+                bool should_backjump = false;
+                if (branch_addr < start_PC) {
+                    start_PC = branch_addr;
+                    should_backjump = true;
+                } else if (branch_addr > end_PC) {
+                    end_PC = branch_addr;
+                }
+                
+                if (opcode == V810_OP_BR) {
+                    potentiallyDone = true;
+                }
+
+                bool was_code = drc_isCode(branch_addr);
+                drc_markCode(branch_addr);
+                if (branch_offset < 0) {
+                    if (!was_code) {
+                        // Not already scanned, so scan it.
+                        cur_PC = branch_addr;
+                        continue;
+                    } else {
+                        // Was previously scanned, so as long as we scanned it just now,
+                        // anything following from it should be accounted for.
+                        if (should_backjump) {
+                            cur_PC = branch_addr;
+                            continue;
+                        }
+                    }
+                }
+                break;
+        }
+
+        if (potentiallyDone) {
+            if (cur_PC >= end_PC) {
+                end_PC = cur_PC;
+                finished = true;
+            } else {
+                // end_PC should always be marked as code, so we don't need to bounds check
+                do {
+                    cur_PC += 2;
+                } while (!drc_isCode(cur_PC));
+            }
+        } else {
+            cur_PC += am_size_table[optable[opcode].addr_mode];
+        }
+    }
+
+    if (superblock_target) {
+        WORD target_start = superblock_target;
+        WORD target_end;
+        superblock_target = 0;
+        drc_scanBlockBounds(&target_start, &target_end);
+        // the target's code can reach further than the target itself, so
+        // check again now that it's known
+        WORD new_start = target_start < start_PC ? target_start : start_PC;
+        WORD new_end = target_end > end_PC ? target_end : end_PC;
+        if (new_end - new_start <= SUPERBLOCK_MAX_SPAN) {
+            start_PC = new_start;
+            end_PC = new_end;
+        }
+    }
+
+    split_entry = is_superblock ? 0 : entry_PC;
+    split_start_PC = start_PC;
+    split_end_PC = end_PC;
+    *p_start_PC = start_PC;
+    *p_end_PC = end_PC;
+}
+
+// Finds an instruction in the given range at the given PC, or the one just after it.
+static v810_instruction *drc_findInstruction(v810_instruction *left, v810_instruction *right, WORD goal_PC) {
+    while (left != right) {
+        v810_instruction *pivot = left + (right - left) / 2;
+        if (pivot->PC < goal_PC) left = pivot + 1;
+        else if (pivot->PC > goal_PC) right = pivot;
+        else return pivot;
+    }
+    return right;
+}
+
+// Extra weight given to the registers used inside a loop, for each loop
+// they're in, when picking which ones to keep in host registers
+#define LOOP_REG_WEIGHT 8
+// How much a loop has to save on registers that aren't cached, weighed the
+// same way, to be worth swapping them on the way in and out
+#define LOOP_SPLIT_GAIN (2 * LOOP_REG_WEIGHT)
+
+// For each instruction in inst_cache, the number of loops it's in, and the
+// instruction its branch goes to within the block (or -1)
+static WORD loop_depth[MAX_V810_INST + 1];
+static int branch_dst[MAX_V810_INST];
+// Backward branches, to try splitting off the loops they close
+static int loop_branches[MAX_V810_INST];
+
+static void drc_addRegUsage(WORD *usage, v810_instruction *inst, WORD weight) {
+    if (optable[inst->opcode].addr_mode == AM_BSTR) {
+        for (int r = 26; r <= 30; r++)
+            usage[r] += weight;
+        return;
+    }
+    if (inst->reg1 < 32) usage[inst->reg1] += weight;
+    if (inst->reg2 < 32) usage[inst->reg2] += weight;
+}
+
+// The registers drc_mapRegs would cache for the given usage, as a mask
+static WORD drc_pickRegs(const WORD *usage) {
+    WORD picked = 0;
+    for (int i = 0; i < DRC_NUM_CACHE_REGS; i++) {
+        WORD max = 0;
+        int max_pos = 0;
+        for (int r = 1; r < 32; r++) {
+            if (!(picked & (1u << r)) && usage[r] > max) {
+                max_pos = r;
+                max = usage[r];
+            }
+        }
+        if (!max) break;
+        picked |= 1u << max_pos;
+    }
+    return picked;
+}
+
+// The weighed uses of the registers that aren't cached
+static WORD drc_spillCost(const WORD *usage, WORD cached) {
+    WORD cost = 0;
+    for (int r = 1; r < 32; r++)
+        if (!(cached & (1u << r))) cost += usage[r];
+    return cost;
+}
+
+static void drc_addLoopUsage(WORD *usage, int lo, int hi) {
+    memset(usage, 0, 32 * sizeof(WORD));
+    for (int i = lo; i <= hi; i++)
+        drc_addRegUsage(usage, &inst_cache[i], 1 + LOOP_REG_WEIGHT * loop_depth[i]);
+}
+
+// Grows [*p_lo, *p_hi] until no branch or jump goes in or out of it
+static void drc_closeLoop(unsigned int num_inst, int *p_lo, int *p_hi) {
+    bool grown = true;
+    while (grown) {
+        grown = false;
+        for (int i = 0; i < num_inst; i++) {
+            int dst = branch_dst[i];
+            if (dst < 0) continue;
+            bool from_inside = i >= *p_lo && i <= *p_hi;
+            bool to_inside = dst >= *p_lo && dst <= *p_hi;
+            if (from_inside == to_inside) continue;
+            if (i < *p_lo) *p_lo = i;
+            if (dst < *p_lo) *p_lo = dst;
+            if (i > *p_hi) *p_hi = i;
+            if (dst > *p_hi) *p_hi = dst;
+            grown = true;
+        }
+    }
+}
+
+static int drc_compareLoops(const void *a, const void *b) {
+    int i = *(const int*)a, j = *(const int*)b;
+    int size_i = i - branch_dst[i], size_j = j - branch_dst[j];
+    return size_i != size_j ? size_i - size_j : i - j;
+}
+
+// The loop instruction i was split off in, or num_loops if it wasn't
+static int drc_loopOf(int loops[][2], int num_loops, int i) {
+    for (int l = 0; l < num_loops; l++)
+        if (i >= loops[l][0] && i <= loops[l][1]) return l;
+    return num_loops;
+}
+
+// Whether execution can go on to the next instruction after this one
+static bool drc_fallsThrough(v810_instruction *inst) {
+    switch (inst->opcode) {
+        case V810_OP_BR:
+        case V810_OP_JMP:
+        case V810_OP_JR:
+        case V810_OP_RETI:
+            return false;
+        case V810_OP_JAL:
+            // other jals come back through a return site
+            return inst->jump_target == JUMP_TARGET_LOCAL;
+        default:
+            return true;
+    }
+}
+
+// Splits the loops that would rather have other registers cached than the
+// rest of the block off into blocks of their own, innermost first. Getting in
+// and out of them then goes through a block exit, which writes the cached
+// registers back and loads the ones the other side wants.
+// Only the part holding split_entry is kept in inst_cache, with reg_usage for
+// it; the others are left for drc_translate. Returns the number of
+// instructions kept.
+static unsigned int drc_splitLoops(exec_block *block, unsigned int num_inst) {
+    int loops[LOOP_SPLIT_MAX][2];
+    int num_loops = 0, num_branches = 0;
+    WORD usage[32], loop_usage[32];
+    WORD cached;
+    v810_instruction *entry;
+    int part;
+    unsigned int kept = 0;
+
+    if (!split_entry) return num_inst;
+    entry = drc_findInstruction(inst_cache, inst_cache + num_inst, split_entry);
+    if (entry == inst_cache + num_inst || entry->PC != split_entry) return num_inst;
+
+    drc_addLoopUsage(usage, 0, num_inst - 1);
+    cached = drc_pickRegs(usage);
+
+    for (int i = 0; i < num_inst; i++) {
+        if (branch_dst[i] >= 0 && branch_dst[i] <= i && inst_cache[i].opcode != V810_OP_JAL &&
+            (inst_cache[i].opcode != V810_OP_JR || abs(inst_cache[i].branch_offset) < 1024))
+            loop_branches[num_branches++] = i;
+    }
+    qsort(loop_branches, num_branches, sizeof(loop_branches[0]), drc_compareLoops);
+
+    for (int i = 0; i < num_branches && i < 4 * LOOP_SPLIT_MAX && num_loops < LOOP_SPLIT_MAX; i++) {
+        int lo = branch_dst[loop_branches[i]], hi = loop_branches[i];
+        bool overlaps = false;
+        drc_closeLoop(num_inst, &lo, &hi);
+        if (lo == 0 && hi == num_inst - 1) continue;
+        for (int j = 0; j < num_loops; j++)
+            if (lo <= loops[j][1] && hi >= loops[j][0]) overlaps = true;
+        if (overlaps) continue;
+
+        drc_addLoopUsage(loop_usage, lo, hi);
+        if (drc_spillCost(loop_usage, cached) - drc_spillCost(loop_usage, drc_pickRegs(loop_usage)) < LOOP_SPLIT_GAIN)
+            continue;
+        loops[num_loops][0] = lo;
+        loops[num_loops][1] = hi;
+        num_loops++;
+    }
+    if (!num_loops) return num_inst;
+
+    // the parts not holding the entry are translated next, decoding the same
+    // bounds again and picking the same loops
+    part = drc_loopOf(loops, num_loops, entry - inst_cache);
+    if (!split_again) {
+        split_count = 0;
+        for (int l = 0; l < num_loops; l++)
+            if (l != part) split_PCs[split_count++] = inst_cache[loops[l][0]].PC;
+        if (part != num_loops) {
+            for (int i = 0; i < num_inst; i++) {
+                if (drc_loopOf(loops, num_loops, i) == num_loops) {
+                    split_PCs[split_count++] = inst_cache[i].PC;
+                    break;
+                }
+            }
+        }
+    }
+
+    memset(reg_usage, 0, sizeof(reg_usage));
+    for (int i = 0; i < num_inst; i++) {
+        if (drc_loopOf(loops, num_loops, i) != part) continue;
+        if (i + 1 < num_inst && drc_loopOf(loops, num_loops, i + 1) != part && drc_fallsThrough(&inst_cache[i]))
+            inst_cache[i].fallthrough_PC = inst_cache[i + 1].PC;
+        drc_addRegUsage(reg_usage, &inst_cache[i], 1 + LOOP_REG_WEIGHT * loop_depth[i]);
+        inst_cache[kept++] = inst_cache[i];
+    }
+
+    block->start_pc = inst_cache[0].PC;
+    block->pc_range = inst_cache[kept - 1].PC - block->start_pc;
+    dprintf(3, "[DRC]: split %d loops off - 0x%lx->0x%lx\n", num_loops, block->start_pc, block->start_pc + block->pc_range);
+    return kept;
+}
+
+// Finds the target of a branch, or the instruction just after it.
+static v810_instruction *drc_findBranchTarget(int size, int pos) {
+    // attempt to narrow down
+    int close = pos;
+    int far = pos + inst_cache[pos].branch_offset / 2;
+    int left = close < far ? close : far;
+    int right = close < far ? far : close;
+    if (left < 0) left = 0;
+    if (right >= size) right = size - 1;
+    // if it's somehow outside our guessed range, look at the rest of it
+    WORD goal_PC = inst_cache[pos].PC + inst_cache[pos].branch_offset;
+    if (inst_cache[left].PC > goal_PC) {
+        right = left;
+        left = left > pos ? pos : 0;
+    } else if (inst_cache[right].PC < goal_PC) {
+        left = right;
+        right = right < pos ? pos : size - 1;
+    }
+    return drc_findInstruction(&inst_cache[left], &inst_cache[right], goal_PC);
+}
+
+// Guesses which memory region each load and store in inst_cache goes to, by
+// following the addresses built up with movhi/movea. It's only a guess, as
+// the block can be entered at any instruction and a mirror can be reached from
+// anywhere, so whatever uses it still has to check the address.
+static void drc_findMemRegions(unsigned int num_inst) {
+    bool known[32];
+    WORD value[32];
+    BYTE region[32];
+
+    #define FORGET_ALL() { \
+        memset(known, 0, sizeof(known)); \
+        memset(region, MEM_REGION_UNKNOWN, sizeof(region)); \
+        known[0] = true; \
+        value[0] = 0; \
+        region[0] = 0; \
+        /* the stack is in WRAM */ \
+        region[3] = MEM_REGION_WRAM; \
+    }
+    #define SET_REG(r, is_known, val, reg) \
+        if ((r) != 0 && (r) < 32) { \
+            known[r] = (is_known); \
+            value[r] = (val); \
+            region[r] = (is_known) ? ((val) >> 24) & 7 : (reg); \
+        }
+    #define FORGET_REG(r) SET_REG(r, false, 0, MEM_REGION_UNKNOWN)
+
+    FORGET_ALL();
+    for (unsigned int i = 0; i < num_inst; i++) {
+        v810_instruction *inst = &inst_cache[i];
+        BYTE r1 = inst->reg1 < 32 ? inst->reg1 : 0;
+
+        // anything could be in the registers coming from elsewhere
+        if (inst->is_branch_target) FORGET_ALL();
+
+        inst->mem_region = MEM_REGION_UNKNOWN;
+        switch (inst->opcode) {
+            case V810_OP_LD_B:
+            case V810_OP_LD_H:
+            case V810_OP_LD_W:
+            case V810_OP_IN_B:
+            case V810_OP_IN_H:
+            case V810_OP_IN_W:
+            case V810_OP_ST_B:
+            case V810_OP_ST_H:
+            case V810_OP_ST_W:
+            case V810_OP_OUT_B:
+            case V810_OP_OUT_H:
+            case V810_OP_OUT_W:
+                if (known[r1])
+                    inst->mem_region = ((value[r1] + (SHWORD)inst->imm) >> 24) & 7;
+                else
+                    inst->mem_region = region[r1];
+                // loads have bit 2 clear
+                if ((inst->opcode & 4) == 0)
+                    FORGET_REG(inst->reg2);
+                break;
+            case V810_OP_MOVHI:
+                SET_REG(inst->reg2, known[r1], value[r1] + (inst->imm << 16), MEM_REGION_UNKNOWN);
+                break;
+            case V810_OP_MOVEA:
+            case V810_OP_ADDI:
+                // small offsets from a pointer stay in the same region
+                SET_REG(inst->reg2, known[r1], value[r1] + (SHWORD)inst->imm, region[r1]);
+                break;
+            case V810_OP_MOV:
+                SET_REG(inst->reg2, known[r1], value[r1], region[r1]);
+                break;
+            case V810_OP_MOV_I:
+                SET_REG(inst->reg2, true, sign_5(inst->imm), 0);
+                break;
+            case V810_OP_ADD_I:
+                SET_REG(inst->reg2, known[inst->reg2], value[inst->reg2] + sign_5(inst->imm), region[inst->reg2]);
+                break;
+            case V810_OP_CMP:
+            case V810_OP_CMP_I:
+            case V810_OP_LDSR:
+                break;
+            case V810_OP_MUL:
+            case V810_OP_DIV:
+            case V810_OP_MULU:
+            case V810_OP_DIVU:
+                FORGET_REG(30);
+                FORGET_REG(inst->reg2);
+                break;
+            case V810_OP_BSTR:
+                for (int r = 26; r <= 30; r++)
+                    FORGET_REG(r);
+                break;
+            case V810_OP_JAL:
+            case V810_OP_JMP:
+            case V810_OP_JR:
+            case V810_OP_RETI:
+            case V810_OP_TRAP:
+                // whatever runs next starts from scratch
+                FORGET_ALL();
+                break;
+            default:
+                FORGET_REG(inst->reg2);
+                break;
+        }
+    }
+
+    #undef FORGET_ALL
+    #undef SET_REG
+    #undef FORGET_REG
+}
+
+// Works out where the target of the jal or far jr at pos is, relative to the
+// size instructions decoded. Targets in the block are marked as such.
+static void drc_findJumpTarget(int size, int pos) {
+    v810_instruction *inst = &inst_cache[pos];
+    WORD target_PC = inst->PC + inst->branch_offset;
+    v810_instruction *target;
+    // routines with a native version have to be reached through drc_run
+    int hle = hle_find(target_PC);
+    if (hle) {
+        drc_markHleCall(target_PC, hle);
+        inst->jump_target = JUMP_TARGET_FAR;
+        return;
+    }
+    target = drc_findInstruction(inst_cache, inst_cache + size, target_PC);
+    if (target != inst_cache + size && target->PC == target_PC) {
+        target->is_branch_target = true;
+        inst->jump_target = JUMP_TARGET_LOCAL;
+    } else {
+        WORD start_PC = target_PC < inst_cache[0].PC ? target_PC : inst_cache[0].PC;
+        WORD end_PC = target_PC > inst_cache[size - 1].PC ? target_PC : inst_cache[size - 1].PC;
+        inst->jump_target = end_PC - start_PC <= SUPERBLOCK_MAX_SPAN ? JUMP_TARGET_NEAR : JUMP_TARGET_FAR;
+        if ((target_PC & 0x07000000) == 0x07000000 && jump_target_count < JUMP_TARGET_QUEUE_SIZE) {
+            jump_targets[(jump_target_head + jump_target_count++) % JUMP_TARGET_QUEUE_SIZE] = target_PC & V810_ROM1.highaddr;
+        }
+    }
+}
+
+// Decodes the instructions from start_PC to end_PC and stores them in
+// inst_cache.
+// Returns the number of instructions decoded.
+unsigned int drc_decodeInstructions(exec_block *block, WORD start_PC, WORD end_PC) {
+    unsigned int i = 0;
+    // Up to 4 bytes for instruction (either 16 or 32 bits)
+    BYTE lowB, highB, lowB2, highB2;
+    WORD cur_PC = start_PC;
+    bool finished;
+
+    for (; (i < MAX_V810_INST) && (cur_PC <= end_PC); i++) {
+        cur_PC = (cur_PC & V810_ROM1.highaddr);
+        lowB   = ((BYTE *)(V810_ROM1.off + cur_PC))[0];
+        highB  = ((BYTE *)(V810_ROM1.off + cur_PC))[1];
+        lowB2  = ((BYTE *)(V810_ROM1.off + cur_PC))[2];
+        highB2 = ((BYTE *)(V810_ROM1.off + cur_PC))[3];
+
+        if (cur_PC == 0x07004e1a) {
+            dprintf(0, "iaupsdfhjasdjklfhasdlf %lx", cur_PC);
+        }
+
+        inst_cache[i].PC = cur_PC;
+        inst_cache[i].save_flags = false;
+        inst_cache[i].busywait = false;
+        inst_cache[i].is_branch_target = false;
+        inst_cache[i].branch_offset = 0;
+        inst_cache[i].jump_target = JUMP_TARGET_FAR;
+        inst_cache[i].fallthrough_PC = 0;
+
+        inst_cache[i].opcode = highB >> 2;
+        if ((highB & 0xE0) == 0x80)              // Special opcode format for
+            inst_cache[i].opcode = (highB >> 1); // type III instructions.
+
+        if ((inst_cache[i].opcode > 0x4F) || (inst_cache[i].opcode < 0))
+            return 0;
+
+        switch (optable[inst_cache[i].opcode].addr_mode) {
+            case AM_I:
+                inst_cache[i].reg1 = (BYTE)((lowB & 0x1F));
+                reg_usage[inst_cache[i].reg1]++;
+
+                // jmp [reg1] doesn't use the second register
+                if (inst_cache[i].opcode != V810_OP_JMP) {
+                    inst_cache[i].reg2 = (BYTE)((lowB >> 5) + ((highB & 0x3) << 3));
+                    reg_usage[inst_cache[i].reg2]++;
+                } else {
+                    inst_cache[i].reg2 = 0xFF;
+                }
+                break;
+            case AM_II:
+                inst_cache[i].imm = (unsigned)((lowB & 0x1F));
+                inst_cache[i].reg2 = (BYTE)((lowB >> 5) + ((highB & 0x3) << 3));
+                reg_usage[inst_cache[i].reg2]++;
+
+                inst_cache[i].reg1 = 0xFF;
+
+                if (inst_cache[i].opcode == V810_OP_SETF) {
+                    busywait_findLastConditionalInst(inst_cache, i);
+                }
+                break;
+            case AM_III: // Branch instructions
+                inst_cache[i].imm = (unsigned)(((highB & 0x1) << 8) + (lowB & 0xFE));
+                inst_cache[i].branch_offset = sign_9(inst_cache[i].imm);
+
+                inst_cache[i].reg1 = 0xFF;
+                inst_cache[i].reg2 = 0xFF;
+
+                if (inst_cache[i].opcode != V810_OP_BR &&
+                    inst_cache[i].opcode != V810_OP_NOP)
+                    busywait_findLastConditionalInst(inst_cache, i);
+                break;
+            case AM_IV: // Middle distance jump
+                inst_cache[i].imm = (unsigned)(((highB & 0x3) << 24) + (lowB << 16) + (highB2 << 8) + lowB2);
+                inst_cache[i].branch_offset = (signed)sign_26(inst_cache[i].imm);
+
+                inst_cache[i].reg1 = 0xFF;
+                inst_cache[i].reg2 = 0xFF;
+
+                // routines that are just a load get inlined
+                if (inst_cache[i].opcode == V810_OP_JAL) {
+                    int hle = hle_find(inst_cache[i].PC + inst_cache[i].branch_offset);
+                    if (hle && hle_entries[hle - 1].inline_op) {
+                        inst_cache[i].opcode = hle_entries[hle - 1].inline_op;
+                        inst_cache[i].imm = 0;
+                        inst_cache[i].reg1 = hle_entries[hle - 1].inline_reg1;
+                        inst_cache[i].reg2 = hle_entries[hle - 1].inline_reg2;
+                    }
+                }
+                break;
+            case AM_V:
+                inst_cache[i].reg2 = (BYTE)((lowB >> 5) + ((highB & 0x3) << 3));
+                inst_cache[i].reg1 = (BYTE)((lowB & 0x1F));
+                inst_cache[i].imm = (highB2 << 8) + lowB2;
+                reg_usage[inst_cache[i].reg1]++;
+                reg_usage[inst_cache[i].reg2]++;
+                break;
+            case AM_VIa: // Mode6 form1
+                inst_cache[i].imm = (highB2 << 8) + lowB2;
+                inst_cache[i].reg1 = (BYTE)((lowB & 0x1F));
+                inst_cache[i].reg2 = (BYTE)((lowB >> 5) + ((highB & 0x3) << 3));
+                reg_usage[inst_cache[i].reg1]++;
+                reg_usage[inst_cache[i].reg2]++;
+                break;
+            case AM_VIb: // Mode6 form2
+                inst_cache[i].reg2 = (BYTE)((lowB >> 5) + ((highB & 0x3) << 3));
+                inst_cache[i].imm = (highB2 << 8) + lowB2; // Whats the order??? 2,3,1 or 1,3,2
+                inst_cache[i].reg1 = (BYTE)((lowB & 0x1F));
+                reg_usage[inst_cache[i].reg1]++;
+                reg_usage[inst_cache[i].reg2]++;
+                break;
+            case AM_VII: // Unhandled
+                break;
+            case AM_VIII: // Unhandled
+                break;
+            case AM_IX:
+                inst_cache[i].imm = (unsigned)((lowB & 0x1)); // Mode ID, Ignore for now
+
+                inst_cache[i].reg1 = 0xFF;
+                inst_cache[i].reg2 = 0xFF;
+                break;
+            case AM_BSTR: // Bit String Subopcodes
+                inst_cache[i].imm = (unsigned)((lowB & 0x1F));
+                reg_usage[26]++;
+                reg_usage[27]++;
+                reg_usage[28]++;
+                reg_usage[29]++;
+                reg_usage[30]++;
+
+                inst_cache[i].reg1 = 0xFF;
+                inst_cache[i].reg2 = 0xFF;
+                break;
+            case AM_FPP: // Floating Point Subcode
+                inst_cache[i].reg2 = (BYTE)((lowB >> 5) + ((highB & 0x3) << 3));
+                inst_cache[i].reg1 = (BYTE)((lowB & 0x1F));
+                inst_cache[i].imm = (unsigned)(((highB2 >> 2)&0x3F));
+                reg_usage[inst_cache[i].reg1]++;
+                reg_usage[inst_cache[i].reg2]++;
+                break;
+            case AM_UDEF: // Invalid opcode.
+                inst_cache[i].reg1 = 0xFF;
+                inst_cache[i].reg2 = 0xFF;
+                break;
+            default: // Invalid opcode.
+                inst_cache[i].reg1 = 0xFF;
+                inst_cache[i].reg2 = 0xFF;
+                cur_PC += 2;
+                break;
+        }
+        
+        cur_PC += am_size_table[optable[inst_cache[i].opcode].addr_mode];
+        block->cycles += opcycle[inst_cache[i].opcode];
+
+        while (!drc_isCode(cur_PC) && cur_PC < end_PC) {
+            cur_PC += 2;
+        }
+    }
+
+    // mark branch targets
+    for (int j = 0; j < i; j++) {
+        branch_dst[j] = -1;
+        loop_depth[j] = 0;
+    }
+    loop_depth[i] = 0;
+    for (int j = 0; j < i; j++) {
+        if (inst_cache[j].opcode == V810_OP_JAL ||
+            (inst_cache[j].opcode == V810_OP_JR && abs(inst_cache[j].branch_offset) >= 1024)
+        ) {
+            drc_findJumpTarget(i, j);
+            if (inst_cache[j].jump_target == JUMP_TARGET_LOCAL) {
+                WORD target_PC = inst_cache[j].PC + inst_cache[j].branch_offset;
+                branch_dst[j] = drc_findInstruction(inst_cache, inst_cache + i, target_PC) - inst_cache;
+            }
+            continue;
+        }
+        if (optable[inst_cache[j].opcode].addr_mode != AM_III && inst_cache[j].opcode != V810_OP_JR)
+            continue;
+        if (inst_cache[j].branch_offset == 0)
+            continue;
+        if (inst_cache[j].opcode != V810_OP_JR || abs(inst_cache[j].branch_offset) < 1024) {
+            // find the branch target
+            v810_instruction *target = drc_findBranchTarget(i, j);
+            WORD target_PC = inst_cache[j].PC + inst_cache[j].branch_offset;
+            if (target->PC != target_PC) {
+                // this really should not happen anymore
+                dprintf(0, "Invalid jump from %lx to %lx (found %lx between %lx and %lx)\n", inst_cache[j].PC, target_PC, target->PC, inst_cache[0].PC, inst_cache[i-1].PC);
+                break;
+            } else {
+                // it's a valid target, so mark it as such
+                target->is_branch_target = true;
+                branch_dst[j] = target - inst_cache;
+                // a backward branch closes a loop, which is where keeping
+                // registers cached pays off the most
+                if (inst_cache[j].branch_offset < 0) {
+                    loop_depth[branch_dst[j]]++;
+                    loop_depth[j + 1]--;
+                }
+            }
+        }
+    }
+    for (int j = 0; j < i; j++) {
+        if (j > 0) loop_depth[j] += loop_depth[j - 1];
+        drc_addRegUsage(reg_usage, &inst_cache[j], LOOP_REG_WEIGHT * loop_depth[j]);
+    }
+
+    if (i == MAX_V810_INST) {
+        dprintf(0, "WARN:%lx-%lx exceeds max instrs\n", start_PC, end_PC);
+    }
+
+    i = drc_splitLoops(block, i);
+    drc_findMemRegions(i);
+
+    return i;
+}
+
+
+// Empties the return stack. Odd PCs never match a return address.
+static void drc_clearReturnStack(void) {
+    int i;
+    ret_stack.top = 0;
+    for (i = 0; i < RET_STACK_SIZE; i++) {
+        ret_stack.entries[i].PC = 1;
+        ret_stack.entries[i].site = NULL;
+    }
+}
+
+// Pops the return point pushed by a jal to a routine that was run natively,
+// so the returns after it still line up
+static void drc_dropReturn(WORD ret_PC) {
+    if (ret_stack.entries[ret_stack.top].PC == ret_PC)
+        ret_stack.top = (ret_stack.top - 1) & (RET_STACK_SIZE - 1);
+}
+
+// Clear and invalidate the dynarec cache
+void drc_clearCache(void) {
+    drc_workerSync();
+    dprintf(0, "[DRC]: clearing cache...\n");
+    cache_pos = cache_start + 1;
+    block_pos = 1;
+    drc_allocReset();
+    link_count = 0;
+    pending_link = NULL;
+    jump_target_count = 0;
+    drc_clearReturnStack();
+
+    memset(cache_start, 0, CACHE_SIZE);
+    drc_clearMap();
+
+    *cache_start = -1;
+}
+
+// Returns the entrypoint for the V810 instruction in location loc if it exists
+// and NULL if it needs to be translated. If p_block != NULL it will point to
+// the block structure.
+WORD* drc_getEntry(WORD loc, exec_block **p_block) {
+    unsigned int map_pos = drc_mapPos(loc);
+    map_page *page = map_pages[map_pos >> MAP_PAGE_BITS];
+    exec_block *block;
+
+    if (!page) return cache_start;
+    map_pos &= MAP_PAGE_SIZE - 1;
+    block = block_ptr_start + page->block[map_pos];
+    if (block == block_ptr_start || block->free) return cache_start;
+    if (p_block)
+        *p_block = block;
+    return block->phys_offset + page->entry[map_pos];
+}
+
+// Sets a new entrypoint for the V810 instruction in location loc and the
+// corresponding block
+void drc_setEntry(WORD loc, WORD *entry, exec_block *block) {
+    drc_mapEntry(drc_mapPos(loc), block - block_ptr_start, entry - block->phys_offset);
+}
+
+// Initialize the dynarec
+void drc_init(void) {
+    block_ptr_start = linearAlloc(MAX_NUM_BLOCKS*sizeof(exec_block));
+
+    inst_cache = linearAlloc(MAX_V810_INST*sizeof(v810_instruction));
+    drc_backendInit();
+
+    hbHaxInit();
+
+    cache_start = linearMemAlign(CACHE_SIZE, 0x1000);
+    ReprotectMemory(cache_start, CACHE_SIZE/0x1000, 0x7);
+    detectCitra(cache_start);
+
+    *cache_start = -1;
+    cache_pos = cache_start + 1;
+    drc_allocReset();
+    dprintf(0, "[DRC]: cache_start = %p\n", cache_start);
+
+    drc_workerInit();
+}
+
+void drc_reset(void) {
+    drc_workerSync();
+    drc_freeMap();
+    drc_clearCache();
+}
+
+// Cleanup and exit
+void drc_exit(void) {
+    drc_workerExit();
+#if DRC_PROFILE
+    drc_profileDump("drc_profile.txt");
+#endif
+    linearFree(cache_start);
+    drc_freeMap();
+    linearFree(block_ptr_start);
+    drc_backendExit();
+    linearFree(inst_cache);
+    hbHaxExit();
+}
+
+// Links an exit to the entrypoint it was just seen going to
+static void drc_link(WORD *site, WORD PC, WORD *entry, exec_block *block) {
+    if (link_count >= MAX_NUM_LINKS) return;
+    links[link_count].site = site;
+    links[link_count].block = block;
+    link_count++;
+    drc_linkExit(site, PC, entry, block);
+}
+
+void drc_unlinkBlock(exec_block *block) {
+    int i = 0;
+    while (i < link_count) {
+        WORD *site = links[i].site;
+        if ((size_t)(site - block->phys_offset) < block->size) {
+            // the exit goes away with the block
+        } else if (links[i].block == block) {
+            drc_unlinkExit(site);
+        } else {
+            i++;
+            continue;
+        }
+        links[i] = links[--link_count];
+    }
+    if (pending_link && (size_t)(pending_link - block->phys_offset) < block->size)
+        pending_link = NULL;
+    for (i = 0; i < RET_STACK_SIZE; i++) {
+        if ((size_t)(ret_stack.entries[i].site - block->phys_offset) < block->size)
+            ret_stack.entries[i].PC = 1;
+    }
+}
+
+static int drc_compareAges(const void *a, const void *b) {
+    WORD age_a = *(const WORD*)a, age_b = *(const WORD*)b;
+    return (age_a > age_b) - (age_a < age_b);
+}
+
+// Frees the older half of the blocks, by when drc_run last entered them.
+// Blocks that others link into are kept, as they can run without going
+// through drc_run. Returns the number of blocks freed.
+static int drc_evictColdBlocks(void) {
+    static WORD ages[MAX_NUM_BLOCKS];
+    static bool linked[MAX_NUM_BLOCKS];
+    int i, count = 0, freed = 0;
+    WORD threshold;
+
+    memset(linked, 0, sizeof(linked));
+    for (i = 0; i < link_count; i++) {
+        exec_block *block = links[i].block;
+        // a loop back into the same block doesn't count
+        if ((size_t)(links[i].site - block->phys_offset) >= block->size)
+            linked[block - block_ptr_start] = true;
+    }
+
+    for (i = 1; i < block_pos; i++) {
+        if (!block_ptr_start[i].free && !linked[i])
+            ages[count++] = block_clock - block_ptr_start[i].last_used;
+    }
+    if (count == 0) return 0;
+
+    qsort(ages, count, sizeof(ages[0]), drc_compareAges);
+    threshold = ages[count / 2];
+
+    for (i = 1; i < block_pos; i++) {
+        exec_block *block = &block_ptr_start[i];
+        if (!block->free && !linked[i] && block_clock - block->last_used >= threshold) {
+            drc_free(block);
+            freed++;
+        }
+    }
+
+    evicted_blocks += freed;
+    dprintf(0, "[DRC]: evicted %d cold blocks (%d evicted, %d flushes so far, %d%% fragmented)\n",
+        freed, evicted_blocks, cache_flushes, drc_fragmentation());
+    return freed;
+}
+
+exec_block* drc_getNextBlockStruct(void) {
+    if (block_pos >= MAX_NUM_BLOCKS) {
+        for (int i = 0; i < MAX_NUM_BLOCKS; i++) {
+            if (block_ptr_start[i].free) {
+                return &block_ptr_start[i];
+            }
+        }
+        return NULL;
+    }
+    return &block_ptr_start[block_pos++];
+}
+
+#if DRC_PROFILE
+// The V810 cycles run so far, whatever events came in between
+static WORD drc_elapsedCycles(void) {
+    return vb_state->v810_state.cycles + vb_state->v810_state.cycles_until_event_full
+        - vb_state->v810_state.cycles_until_event_partial;
+}
+
+static BYTE *drc_translationCount(WORD PC) {
+    unsigned int map_pos = drc_mapPos(PC);
+    map_page *page = map_pages[map_pos >> MAP_PAGE_BITS];
+    return page ? &page->translations[map_pos & (MAP_PAGE_SIZE - 1)] : NULL;
+}
+
+// Starts counting for a block that was just translated
+static void drc_profileTranslation(exec_block *block) {
+    BYTE *count = drc_translationCount(block->start_pc);
+    block->exec_count = 0;
+    block->exec_cycles = 0;
+    profile_translations++;
+    if (!count) return;
+    if (*count) profile_retranslations++;
+    if (*count < 0xFF) (*count)++;
+}
+#endif
+
+// A jump out of a block got hot, so translate the block again with the
+// jump's target pulled in. The jump then stays within the block, and the
+// code on both sides of it shares the cached registers.
+static void drc_formSuperblock(WORD jump_PC) {
+    exec_block *block = NULL;
+    int result;
+
+    if (drc_getEntry(jump_PC, &block) == cache_start) return;
+    superblock_target = vb_state->v810_state.PC;
+    result = drc_translateBlock(jump_PC);
+    superblock_target = 0;
+    // whatever was freed on the way gets translated again as usual
+    if (result) return;
+
+    if (drc_getEntry(jump_PC, &block) == cache_start) return;
+    FlushInvalidateCache(block->phys_offset, block->size * 4);
+#if DRC_PROFILE
+    drc_profileTranslation(block);
+#endif
+    superblock_count++;
+    dprintf(3, "[DRC]: superblock %d - 0x%lx->0x%lx\n", superblock_count, block->start_pc, block->start_pc + block->pc_range);
+}
+
+static int drc_translatePart(WORD PC) {
+    exec_block *block = NULL;
+    int result = drc_translateBlock(PC);
+    if (result) return result;
+
+    if (drc_getEntry(PC, &block) == cache_start) return DRC_ERR_BAD_ENTRY;
+    dprintf(3, "[DRC]: ARM block size - %ld\n", block->size);
+    FlushInvalidateCache(block->phys_offset, block->size * 4);
+#if DRC_PROFILE
+    drc_profileTranslation(block);
+#endif
+    return 0;
+}
+
+// Translates the block holding PC and gets it ready to run, along with the
+// loops split off from it (or the code they were split off from)
+int drc_translate(WORD PC) {
+    int result;
+    split_count = 0;
+    result = drc_translatePart(PC);
+    split_again = true;
+    for (int i = 0; !result && i < split_count; i++)
+        result = drc_translatePart(split_PCs[i]);
+    split_again = false;
+    split_count = 0;
+    return result;
+}
+
+// Translates the next jump target that's still missing. Returns false if
+// there's none left or the cache is full.
+bool drc_translateJumpTarget(void) {
+    while (jump_target_count) {
+        WORD PC = jump_targets[jump_target_head];
+        jump_target_head = (jump_target_head + 1) % JUMP_TARGET_QUEUE_SIZE;
+        jump_target_count--;
+        if (drc_getEntry(PC, NULL) == cache_start)
+            return drc_translate(PC) == 0;
+    }
+    return false;
+}
+
+// Makes room after a translation failed for the lack of it. Returns the
+// error if it was anything else.
+static int drc_recover(int result) {
+    if (result != DRC_ERR_CACHE_FULL && result != DRC_ERR_NO_BLOCKS) return result;
+    // only throw everything away if nothing's cold enough to go
+    if (!drc_evictColdBlocks()) {
+        cache_flushes++;
+        dprintf(0, "[DRC]: cache flush %d\n", cache_flushes);
+        drc_clearCache();
+    }
+    return 0;
+}
+
+// Run V810 code until the next frame interrupt
+int drc_run(void) {
+    exec_block* cur_block = NULL;
+    WORD* entrypoint;
+    WORD entry_PC;
+    int hle;
+    // whether to carry on in the interpreter while the worker translates
+    bool interpret = false;
+
+    vb_state->v810_state.PC &= V810_ROM1.highaddr;
+
+    {
+        int result = drc_workerPoll();
+        if (result == DRC_WORKER_BUSY) return interpreter_run();
+        if (unlikely(result) && (result = drc_recover(result))) return result;
+    }
+
+    // set up arm flags
+    // (other backends keep the same NZCV layout in the top nibble)
+    {
+        WORD psw = vb_state->v810_state.S_REG[PSW];
+        WORD cpsr = 0;
+#ifdef __arm__
+        asm volatile ("mrs %0, CPSR" : "=r" (cpsr));
+#endif
+        cpsr &= 0x0fffffff;
+        cpsr |= (psw & 0x3) << 30;
+        cpsr |= (psw & 0xc) << 26;
+        vb_state->v810_state.flags = cpsr;
+    }
+
+    serviceInt(vb_state->v810_state.cycles, vb_state->v810_state.PC);
+    pending_link = NULL;
+
+    while (true) {
+        // extra interrupt check in case we're jumping functions without looping
+        if (unlikely(vb_state->v810_state.cycles_until_event_partial <= 0)) {
+            serviceInt(vb_state->v810_state.cycles, vb_state->v810_state.PC);
+            if (unlikely(vb_state->v810_state.ret)) break;
+        }
+
+        entry_PC = vb_state->v810_state.PC;
+
+        // only the targets of translated jumps to a native routine are
+        // marked (see drc_findJumpTarget)
+        hle = drc_getHleCall(entry_PC);
+        if (unlikely(hle)) {
+            // never link straight to the original, or it'd be run from then on
+            pending_link = NULL;
+            int hle_cycles = hle_call(hle);
+            if (hle_cycles != HLE_PASS) {
+                vb_state->v810_state.cycles_until_event_partial -= hle_cycles;
+                vb_state->v810_state.PC = vb_state->v810_state.P_REG[31] & V810_ROM1.highaddr;
+                drc_dropReturn(vb_state->v810_state.PC);
+                if (unlikely(vb_state->v810_state.PC - V810_ROM1.lowaddr >= V810_ROM1.size)) break;
+                continue;
+            }
+        }
+
+        // Try to find a cached block
+        entrypoint = drc_getEntry(vb_state->v810_state.PC, &cur_block);
+        // entry_PC < cur_block->start_pc || entry_PC > cur_block->end_pc
+        if (unlikely(entrypoint == cache_start || entry_PC - cur_block->start_pc > cur_block->pc_range)) {
+            if (drc_workerPost(entry_PC)) {
+                interpret = true;
+                break;
+            }
+            int result = drc_translate(entry_PC);
+            if (unlikely(result)) {
+                if ((result = drc_recover(result))) return result;
+                continue;
+            }
+
+//            drc_dumpCache("cache_dump_rf.bin");
+
+            entrypoint = drc_getEntry(entry_PC, &cur_block);
+        }
+        dprintf(3, "[DRC]: entry - 0x%lx (0x%x)\n", entry_PC, (int)(entrypoint - cache_start)*4);
+        // entrypoint <= cache_start || entrypoint >= cache_start + CACHE_SIZE
+        if (unlikely(entrypoint - (cache_start + 1) >= CACHE_SIZE - 1)) {
+            dprintf(0, "Bad entry %p\n", drc_getEntry(entry_PC, NULL));
+            return DRC_ERR_BAD_ENTRY;
+        }
+
+        // the last block left with cycles to spare, so next time it can come
+        // straight here
+        if (pending_link && !DRC_PROFILE) {
+            drc_link(pending_link, entry_PC, entrypoint, cur_block);
+            pending_link = NULL;
+        }
+
+        cur_block->last_used = ++block_clock;
+#if DRC_PROFILE
+        WORD start_cycles = drc_elapsedCycles();
+        drc_executeBlock(entrypoint, cur_block);
+        cur_block->exec_count++;
+        cur_block->exec_cycles += drc_elapsedCycles() - start_cycles;
+        // returns into other blocks would skip drc_run too
+        drc_clearReturnStack();
+#else
+        drc_executeBlock(entrypoint, cur_block);
+#endif
+        pending_link = vb_state->v810_state.link_site;
+        vb_state->v810_state.link_site = NULL;
+
+        vb_state->v810_state.PC &= V810_ROM1.highaddr;
+
+        if (unlikely(vb_state->v810_state.hot_jump)) {
+            drc_formSuperblock(vb_state->v810_state.hot_jump);
+            vb_state->v810_state.hot_jump = 0;
+        }
+
+        dprintf(4, "[DRC]: end - 0x%lx\n", vb_state->v810_state.PC);
+        if (unlikely(vb_state->v810_state.PC - V810_ROM1.lowaddr >= V810_ROM1.size)) {
+            dprintf(0, "Last entry: 0x%lx\n", entry_PC);
+            //return DRC_ERR_BAD_PC;
+            break;
+        }
+
+        if (unlikely(vb_state->v810_state.ret)) {
+            break;
+        }
+    }
+
+    // sync arm flags to PSW
+    {
+        WORD cpsr = vb_state->v810_state.flags;
+        WORD psw = vb_state->v810_state.S_REG[PSW];
+        psw &= ~0xf;
+        psw |= cpsr >> 30;
+        psw |= (cpsr >> 26) & 0xc;
+        vb_state->v810_state.S_REG[PSW] = psw;
+    }
+
+    if (interpret) return interpreter_run();
+    return 0;
+}
+
+// The translation cache is saved per ROM, so the next run can skip
+// translating everything again. Translated code only reaches the outside
+// world through the reloc table in cpu_state and exits refer to their block
+// by index, so the blocks can be loaded anywhere in the cache as long as
+// they keep their indexes and no exits are linked.
+#define JIT_CACHE_MAGIC 0x4a425652 // "RVBJ"
+#define JIT_CACHE_FORMAT 4
+#ifdef VERSION
+#define JIT_CACHE_BUILD VERSION
+#else
+#define JIT_CACHE_BUILD __DATE__ " " __TIME__
+#endif
+
+typedef struct {
+    WORD magic;
+    WORD format;
+    char build[64];
+    WORD crc32;
+    WORD trap_word; // tells the backends apart
+    WORD block_struct_size;
+    WORD rom_size;
+    WORD block_pos;
+    WORD block_count;
+    WORD entry_count;
+    WORD page_count; // map pages with code marked in them
+} jit_cache_header;
+
+typedef struct {
+    WORD map_pos;
+    HWORD block;
+    HWORD entry;
+} jit_cache_entry;
+
+static bool drc_getCachePath(char *path, size_t len, bool write) {
+    struct stat st;
+    if (!tVBOpt.CRC32 || !tVBOpt.HOME_PATH[0]) return false;
+    if (stat(tVBOpt.HOME_PATH, &st) == -1) {
+        if (!write || mkdir(tVBOpt.HOME_PATH, 0777)) return false;
+    }
+    snprintf(path, len, "%s/jitcache", tVBOpt.HOME_PATH);
+    if (stat(path, &st) == -1) {
+        if (!write || mkdir(path, 0777)) return false;
+    }
+    snprintf(path, len, "%s/jitcache/%08" PRIX32 ".bin", tVBOpt.HOME_PATH, (WORD)tVBOpt.CRC32);
+    return true;
+}
+
+static void drc_fillCacheHeader(jit_cache_header *header) {
+    memset(header, 0, sizeof(*header));
+    header->magic = JIT_CACHE_MAGIC;
+    header->format = JIT_CACHE_FORMAT;
+    strncpy(header->build, JIT_CACHE_BUILD, sizeof(header->build) - 1);
+    header->crc32 = tVBOpt.CRC32;
+    header->trap_word = DRC_TRAP_WORD;
+    header->block_struct_size = sizeof(exec_block);
+    header->rom_size = V810_ROM1.size;
+}
+
+// Number of map pages covering the ROM
+static WORD drc_romPageCount(void) {
+    WORD count = ((V810_ROM1.size >> 1) + MAP_PAGE_SIZE - 1) >> MAP_PAGE_BITS;
+    return count < MAP_PAGE_COUNT ? count : MAP_PAGE_COUNT;
+}
+
+// Loads the translation cache saved for the current ROM, if there is one
+void drc_loadSavedCache(void) {
+    char path[300];
+    jit_cache_header header, expected;
+    jit_cache_entry entry;
+    exec_block block;
+    FILE* f;
+    WORD i;
+
+    drc_workerSync();
+    if (!drc_getCachePath(path, sizeof(path), false)) return;
+    f = fopen(path, "rb");
+    if (!f) return;
+
+    drc_fillCacheHeader(&expected);
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+            memcmp(&header, &expected, offsetof(jit_cache_header, block_pos)) != 0 ||
+            header.block_pos > MAX_NUM_BLOCKS || header.block_count >= header.block_pos) {
+        dprintf(0, "[DRC]: ignoring stale cache %s\n", path);
+        fclose(f);
+        return;
+    }
+
+    drc_clearCache();
+    for (i = 1; i < header.block_pos; i++)
+        block_ptr_start[i].free = true;
+    block_pos = header.block_pos;
+
+    for (i = 0; i < header.block_count; i++) {
+        HWORD index;
+        if (fread(&index, sizeof(index), 1, f) != 1 || fread(&block, sizeof(block), 1, f) != 1)
+            goto bail;
+        if (index == 0 || index >= block_pos || block.free || block.size == 0 ||
+                !block_ptr_start[index].free)
+            goto bail;
+        block.phys_offset = drc_alloc(block.size);
+        if (!block.phys_offset)
+            goto bail;
+        if (fread(block.phys_offset, sizeof(WORD), block.size, f) != block.size)
+            goto bail;
+        block.last_used = 0;
+        block_ptr_start[index] = block;
+    }
+
+    for (i = 0; i < header.entry_count; i++) {
+        if (fread(&entry, sizeof(entry), 1, f) != 1)
+            goto bail;
+        if ((entry.map_pos >> MAP_PAGE_BITS) >= drc_romPageCount() || entry.block >= block_pos ||
+                block_ptr_start[entry.block].free || entry.entry >= block_ptr_start[entry.block].size)
+            goto bail;
+        if (!drc_mapEntry(entry.map_pos, entry.block, entry.entry))
+            goto bail;
+    }
+
+    for (i = 0; i < header.page_count; i++) {
+        HWORD index;
+        map_page *page;
+        if (fread(&index, sizeof(index), 1, f) != 1 || index >= drc_romPageCount())
+            goto bail;
+        if (!(page = drc_getMapPage(index << MAP_PAGE_BITS)))
+            goto bail;
+        if (fread(page->data_code, sizeof(page->data_code), 1, f) != 1 ||
+                fread(page->hle_call, sizeof(page->hle_call), 1, f) != 1)
+            goto bail;
+    }
+    fclose(f);
+
+    FlushInvalidateCache(cache_start, (cache_pos - cache_start) * 4);
+    dprintf(0, "[DRC]: loaded %" PRIu32 " blocks from %s\n", header.block_count, path);
+    return;
+
+bail:
+    dprintf(0, "[DRC]: couldn't load %s\n", path);
+    fclose(f);
+    drc_freeMap();
+    drc_clearCache();
+}
+
+// Saves the translation cache for the current ROM
+void drc_saveCache(void) {
+    char path[300];
+    jit_cache_header header;
+    jit_cache_entry entry;
+    exec_block block;
+    FILE* f;
+    WORD i, j;
+
+    drc_workerSync();
+    if (block_pos <= 1 || !drc_getCachePath(path, sizeof(path), true)) return;
+
+    // links and the return stack hold pointers into the cache
+    for (i = 0; i < link_count; i++)
+        drc_unlinkExit(links[i].site);
+    link_count = 0;
+    pending_link = NULL;
+    drc_clearReturnStack();
+
+    f = fopen(path, "wb");
+    if (!f) return;
+
+    drc_fillCacheHeader(&header);
+    header.block_pos = block_pos;
+    for (i = 1; i < block_pos; i++) {
+        if (!block_ptr_start[i].free) header.block_count++;
+    }
+    for (i = 0; i < drc_romPageCount(); i++) {
+        map_page *page = map_pages[i];
+        if (!page) continue;
+        header.page_count++;
+        for (j = 0; j < MAP_PAGE_SIZE; j++) {
+            if (page->block[j] && !block_ptr_start[page->block[j]].free) header.entry_count++;
+        }
+    }
+    if (fwrite(&header, sizeof(header), 1, f) != 1) goto bail;
+
+    for (i = 1; i < block_pos; i++) {
+        HWORD index = i;
+        if (block_ptr_start[i].free) continue;
+        block = block_ptr_start[i];
+        block.phys_offset = NULL;
+        if (fwrite(&index, sizeof(index), 1, f) != 1 ||
+                fwrite(&block, sizeof(block), 1, f) != 1 ||
+                fwrite(block_ptr_start[i].phys_offset, sizeof(WORD), block.size, f) != block.size)
+            goto bail;
+    }
+
+    for (i = 0; i < drc_romPageCount(); i++) {
+        map_page *page = map_pages[i];
+        if (!page) continue;
+        for (j = 0; j < MAP_PAGE_SIZE; j++) {
+            if (!page->block[j] || block_ptr_start[page->block[j]].free) continue;
+            entry.map_pos = (i << MAP_PAGE_BITS) | j;
+            entry.block = page->block[j];
+            entry.entry = page->entry[j];
+            if (fwrite(&entry, sizeof(entry), 1, f) != 1) goto bail;
+        }
+    }
+
+    for (i = 0; i < drc_romPageCount(); i++) {
+        HWORD index = i;
+        if (!map_pages[i]) continue;
+        if (fwrite(&index, sizeof(index), 1, f) != 1 ||
+                fwrite(map_pages[i]->data_code, sizeof(map_pages[i]->data_code), 1, f) != 1 ||
+                fwrite(map_pages[i]->hle_call, sizeof(map_pages[i]->hle_call), 1, f) != 1)
+            goto bail;
+    }
+    fclose(f);
+    dprintf(0, "[DRC]: saved %" PRIu32 " blocks to %s\n", header.block_count, path);
+    return;
+
+bail:
+    // don't leave a truncated cache behind
+    fclose(f);
+    remove(path);
+}
+
+// Dumps the translation cache onto a file
+void drc_dumpCache(char* filename) {
+    FILE* f = fopen(filename, "w");
+    fwrite(cache_start, CACHE_SIZE, 1, f);
+    fclose(f);
+}
+
+void drc_dumpDebugInfo(int code) {
+    int i;
+    FILE* f = fopen("debug_info.txt", "w");
+
+    fprintf(f, "Error code: %d\n", code);
+    fprintf(f, "PC: 0x%08" PRIx32 "\n", vb_state->v810_state.PC);
+    for (i = 0; i < 32; i++)
+        fprintf(f, "r%d: 0x%08" PRIx32 "\n", i, vb_state->v810_state.P_REG[i]);
+
+    for (i = 0; i < 32; i++)
+        fprintf(f, "s%d: 0x%08" PRIx32 "\n", i, vb_state->v810_state.S_REG[i]);
+
+    fprintf(f, "Cycles: %" PRIu32 "\n", vb_state->v810_state.cycles);
+    fprintf(f, "Cache start: %p\n", cache_start);
+    fprintf(f, "Cache pos: %p\n", cache_pos);
+    fprintf(f, "Evicted blocks: %d\n", evicted_blocks);
+    fprintf(f, "Cache flushes: %d\n", cache_flushes);
+    fprintf(f, "Cache fragmentation: %d%%\n", drc_fragmentation());
+
+    fprintf(f, "VIP overclock: %d\n", tVBOpt.VIP_OVERCLOCK);
+
+    replay_save("debug_replay.bin.gz");
+
+    fclose(f);
+}
+
+#if DRC_PROFILE
+void drc_profileReset(void) {
+    for (int i = 1; i < block_pos; i++) {
+        block_ptr_start[i].exec_count = 0;
+        block_ptr_start[i].exec_cycles = 0;
+    }
+}
+
+static int drc_compareBlockCycles(const void *a, const void *b) {
+    uint64_t cycles_a = (*(exec_block* const*)a)->exec_cycles;
+    uint64_t cycles_b = (*(exec_block* const*)b)->exec_cycles;
+    return (cycles_a < cycles_b) - (cycles_a > cycles_b);
+}
+
+typedef struct {
+    WORD PC;
+    WORD count;
+} translation_count;
+
+static int drc_compareTranslations(const void *a, const void *b) {
+    WORD count_a = ((const translation_count*)a)->count;
+    WORD count_b = ((const translation_count*)b)->count;
+    return (count_a < count_b) - (count_a > count_b);
+}
+
+void drc_profileDump(const char *filename) {
+    static exec_block *blocks[MAX_NUM_BLOCKS];
+    static translation_count churn[MAX_NUM_BLOCKS];
+    int block_count = 0, churn_count = 0;
+    uint64_t total_cycles = 0;
+    int i, j;
+
+    FILE* f = fopen(filename, "w");
+    if (!f) return;
+
+    for (i = 1; i < block_pos; i++) {
+        exec_block *block = &block_ptr_start[i];
+        if (block->free || !block->exec_count) continue;
+        blocks[block_count++] = block;
+        total_cycles += block->exec_cycles;
+    }
+    qsort(blocks, block_count, sizeof(blocks[0]), drc_compareBlockCycles);
+
+    fprintf(f, "Blocks run: %d, cycles: %" PRIu64 "\n", block_count, total_cycles);
+    fprintf(f, "Translations: %d, retranslations: %d, superblocks: %d\n",
+        profile_translations, profile_retranslations, superblock_count);
+    fprintf(f, "Evicted blocks: %d, cache flushes: %d\n\n", evicted_blocks, cache_flushes);
+
+    fprintf(f, "start_pc   pc_range host_size translated       runs           cycles      %%\n");
+    for (i = 0; i < block_count && i < PROFILE_TOP_BLOCKS; i++) {
+        exec_block *block = blocks[i];
+        BYTE *count = drc_translationCount(block->start_pc);
+        fprintf(f, "0x%08" PRIx32 " %8" PRIu32 " %9" PRIu32 " %10d %10" PRIu32 " %16" PRIu64 " %5.1f\n",
+            block->start_pc, block->pc_range, block->size * 4, count ? *count : 0,
+            block->exec_count, block->exec_cycles,
+            total_cycles ? block->exec_cycles * 100.0 / total_cycles : 0.0);
+    }
+
+    // whatever keeps coming back after being evicted or pulled into another
+    // block is worth a look too
+    for (i = 0; i < MAP_PAGE_COUNT && churn_count < MAX_NUM_BLOCKS; i++) {
+        map_page *page = map_pages[i];
+        if (!page) continue;
+        for (j = 0; j < MAP_PAGE_SIZE && churn_count < MAX_NUM_BLOCKS; j++) {
+            if (page->translations[j] < 2) continue;
+            churn[churn_count].PC = V810_ROM1.lowaddr | (((i << MAP_PAGE_BITS) | j) << 1);
+            churn[churn_count].count = page->translations[j];
+            churn_count++;
+        }
+    }
+    qsort(churn, churn_count, sizeof(churn[0]), drc_compareTranslations);
+
+    fprintf(f, "\nTranslated more than once: %d\n", churn_count);
+    for (i = 0; i < churn_count && i < PROFILE_TOP_BLOCKS; i++)
+        fprintf(f, "0x%08" PRIx32 " %d\n", churn[i].PC, churn[i].count);
+
+    fclose(f);
+}
+#endif
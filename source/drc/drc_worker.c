@@ -0,0 +1,222 @@
+#include <stddef.h>
+
+#ifdef __3DS__
+#include <3ds.h>
+#else
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "vb_types.h"
+#include "utils.h"
+#include "drc_core.h"
+#include "drc_worker.h"
+
+// Translation goes deeper than the usual helper threads
+#define WORKER_STACK_SIZE 0x8000
+
+static bool worker_running = false;
+// Set when a job is posted, cleared by the worker once it's done with it
+static bool job_busy = false;
+// Whether the emulation thread has yet to pick up the job's result
+static bool job_pending = false;
+static WORD job_PC;
+static int job_result;
+// Set by the worker once the block asked for is in
+static bool job_ready;
+// Set once the emulation thread wants the cache back, so the worker stops
+// translating ahead
+static bool job_cancel;
+
+#ifdef __3DS__
+static Thread worker_thread;
+static Handle start_event, done_event;
+
+static void waitForJob(void) {
+    svcWaitSynchronization(start_event, INT64_MAX);
+}
+
+static void signalStart(void) {
+    svcClearEvent(done_event);
+    __atomic_store_n(&job_busy, true, __ATOMIC_RELEASE);
+    svcSignalEvent(start_event);
+}
+
+static void signalDone(void) {
+    __atomic_store_n(&job_busy, false, __ATOMIC_RELEASE);
+    svcSignalEvent(done_event);
+}
+
+static void waitForDone(void) {
+    svcWaitSynchronization(done_event, INT64_MAX);
+}
+#else
+static pthread_t worker_thread;
+static pthread_mutex_t worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_cond = PTHREAD_COND_INITIALIZER;
+
+static void waitForJob(void) {
+    pthread_mutex_lock(&worker_mutex);
+    while (worker_running && !job_busy)
+        pthread_cond_wait(&worker_cond, &worker_mutex);
+    pthread_mutex_unlock(&worker_mutex);
+}
+
+static void signalStart(void) {
+    pthread_mutex_lock(&worker_mutex);
+    job_busy = true;
+    pthread_cond_broadcast(&worker_cond);
+    pthread_mutex_unlock(&worker_mutex);
+}
+
+static void signalDone(void) {
+    pthread_mutex_lock(&worker_mutex);
+    job_busy = false;
+    pthread_cond_broadcast(&worker_cond);
+    pthread_mutex_unlock(&worker_mutex);
+}
+
+static void waitForDone(void) {
+    pthread_mutex_lock(&worker_mutex);
+    while (job_busy)
+        pthread_cond_wait(&worker_cond, &worker_mutex);
+    pthread_mutex_unlock(&worker_mutex);
+}
+#endif
+
+static void drc_workerMain(void) {
+    while (true) {
+        waitForJob();
+        if (!__atomic_load_n(&worker_running, __ATOMIC_ACQUIRE)) break;
+
+        int result = drc_translate(job_PC);
+        job_result = result;
+        __atomic_store_n(&job_ready, true, __ATOMIC_RELEASE);
+
+        // the emulation thread is still interpreting, so get the jumps out
+        // of the code seen so far ready while it's at it
+        for (int i = 0; !result && i < DRC_WORKER_SPECULATE_MAX; i++) {
+            if (__atomic_load_n(&job_cancel, __ATOMIC_ACQUIRE)) break;
+            if (!drc_translateJumpTarget()) break;
+        }
+
+        signalDone();
+    }
+}
+
+#ifdef __3DS__
+static void drc_workerThread(void *arg) {
+    drc_workerMain();
+}
+#else
+static void *drc_workerThread(void *arg) {
+    drc_workerMain();
+    return NULL;
+}
+#endif
+
+// Picks up the result of a job the worker is done with
+static int drc_finishJob(void) {
+    exec_block *block = NULL;
+    job_pending = false;
+    if (job_result) return job_result;
+    // The worker flushed the block from its own core's caches, but on the
+    // 3DS the instruction cache of this one still needs it
+    if (drc_getEntry(job_PC, &block) != cache_start)
+        FlushInvalidateCache(block->phys_offset, block->size * 4);
+    return 0;
+}
+
+bool drc_workerInit(void) {
+#ifdef __3DS__
+    bool new_3ds = false;
+    APT_CheckNew3DS(&new_3ds);
+    // the old 3DS has no core to spare
+    if (!new_3ds) return false;
+
+    svcCreateEvent(&start_event, RESET_ONESHOT);
+    svcCreateEvent(&done_event, RESET_STICKY);
+    worker_running = true;
+    worker_thread = threadCreate(drc_workerThread, NULL, WORKER_STACK_SIZE, 0x18, 2, false);
+    if (!worker_thread) {
+        worker_running = false;
+        svcCloseHandle(start_event);
+        svcCloseHandle(done_event);
+        return false;
+    }
+#else
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) return false;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, WORKER_STACK_SIZE > PTHREAD_STACK_MIN ? WORKER_STACK_SIZE : PTHREAD_STACK_MIN);
+    worker_running = true;
+    if (pthread_create(&worker_thread, &attr, drc_workerThread, NULL) != 0) {
+        worker_running = false;
+        pthread_attr_destroy(&attr);
+        return false;
+    }
+    pthread_attr_destroy(&attr);
+#endif
+    dprintf(0, "[DRC]: translating on a worker thread\n");
+    return true;
+}
+
+void drc_workerExit(void) {
+    if (!worker_running) return;
+    drc_workerSync();
+
+#ifdef __3DS__
+    __atomic_store_n(&worker_running, false, __ATOMIC_RELEASE);
+    svcSignalEvent(start_event);
+    threadJoin(worker_thread, U64_MAX);
+    threadFree(worker_thread);
+    svcCloseHandle(start_event);
+    svcCloseHandle(done_event);
+#else
+    pthread_mutex_lock(&worker_mutex);
+    worker_running = false;
+    pthread_cond_broadcast(&worker_cond);
+    pthread_mutex_unlock(&worker_mutex);
+    pthread_join(worker_thread, NULL);
+#endif
+}
+
+bool drc_workerPost(WORD PC) {
+    if (!worker_running) return false;
+    job_PC = PC;
+    job_result = 0;
+    job_ready = false;
+    job_cancel = false;
+    job_pending = true;
+    signalStart();
+    return true;
+}
+
+bool drc_workerRunning(void) {
+    return worker_running;
+}
+
+bool drc_workerBusy(void) {
+    if (!job_pending) return false;
+    if (!__atomic_load_n(&job_ready, __ATOMIC_RELAXED)) return true;
+    // the block is in, so it's time to stop translating ahead
+    __atomic_store_n(&job_cancel, true, __ATOMIC_RELAXED);
+    return __atomic_load_n(&job_busy, __ATOMIC_RELAXED);
+}
+
+int drc_workerPoll(void) {
+    if (!job_pending) return 0;
+    if (drc_workerBusy()) return DRC_WORKER_BUSY;
+    // pairs with signalDone, so the worker's writes are all seen
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return drc_finishJob();
+}
+
+void drc_workerSync(void) {
+    if (!job_pending) return;
+    __atomic_store_n(&job_cancel, true, __ATOMIC_RELEASE);
+    waitForDone();
+    drc_finishJob();
+}
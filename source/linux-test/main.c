@@ -53,8 +53,39 @@ void sdl_flush(bool displayed_fb, int player) {
     SDL_BlitScaled(game_surface, NULL, window_surface, &rect);
 }
 
+// Runs frames with no window or rendering, for timing the CPU core
+static int benchmark(int frames) {
+    struct timespec start, end;
+    uint64_t start_idle = vb_players[0].v810_state.idle_cycles;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int frame = 0; frame < frames; frame++) {
+        if (replay_playing()) {
+            HWORD inputs = replay_read();
+            vb_players[0].tHReg.SLB = inputs;
+            vb_players[0].tHReg.SHB = inputs >> 8;
+        }
+        vb_state = &vb_players[0];
+        int err = v810_run();
+        if (err) {
+            printf("Error code %d\n", err);
+            return 1;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    // a frame is 400000 cycles
+    double idle = (vb_players[0].v810_state.idle_cycles - start_idle) / (frames * 4000.0);
+    printf("%d frames in %.3f s (%.1f fps), %.1f%% idle\n", frames, secs, frames / secs, idle);
+    #if DRC_AVAILABLE && DRC_PROFILE
+    drc_profileDump("drc_profile.txt");
+    #endif
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     int err;
+    char *replay_path = NULL;
+    int bench_frames = 0;
 
     if (argc < 2) {
         puts("Pass a ROM please");
@@ -77,9 +108,15 @@ int main(int argc, char* argv[]) {
     strncpy(tVBOpt.ROM_PATH, argv[1], sizeof(tVBOpt.ROM_PATH));
 
     // -m for multiplayer
+    // -r <file> to play back a replay
+    // -b <frames> to time that many frames without a window
     for (int i = 0; i < argc; i++) {
         if (strcmp(argv[i], "-m") == 0) {
             is_multiplayer = true;
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            bench_frames = atoi(argv[++i]);
         }
     }
 
@@ -90,10 +127,14 @@ int main(int argc, char* argv[]) {
         if (ret == 100) break;
     }
 
+    if (replay_path) replay_load(replay_path);
+
     tVBOpt.RENDERMODE = RM_CPUONLY;
 
     clearCache();
 
+    if (bench_frames > 0) return benchmark(bench_frames);
+
     SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
     window = SDL_CreateWindow("Red Viper", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 384*2, 224*2*(1+is_multiplayer), 0);
     window_surface = SDL_GetWindowSurface(window);
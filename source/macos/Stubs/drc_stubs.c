@@ -51,6 +51,10 @@ void drc_loadSavedCache(void) {
     // No-op on macOS - DRC not available
 }
 
+void drc_saveCache(void) {
+    // No-op on macOS - DRC not available
+}
+
 void drc_dumpCache(char* filename) {
     (void)filename;
     // No-op on macOS - DRC not available
@@ -0,0 +1,1180 @@
+/*
+ * V810 dynamic recompiler for x86-64
+ *
+ * This file is distributed under the MIT License.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "utils.h"
+#include "drc_alloc.h"
+#include "drc_core.h"
+#include "busywait.h"
+#include "hle.h"
+#include "v810_cpu.h"
+#include "v810_mem.h"
+#include "v810_opt.h"
+#include "vb_set.h"
+#include "vb_types.h"
+
+#include "x86_emit.h"
+
+#define X86_NOREG 0xFF
+
+static BYTE *trans_cache;
+BYTE *x86_ptr;
+
+// Host registers available for caching V810 registers, in reg_map order.
+// drc_executeBlock loads and stores them in the same order.
+static const BYTE cache_regs[X86_NUM_CACHE_REGS] = {X86_RBP, X86_R12, X86_R13, X86_R15};
+
+// Maps V810 registers to host registers (X86_NOREG if not cached)
+static BYTE phys_regs[32];
+
+// A rel32 branch to a V810 address, resolved once the block has been placed
+typedef struct {
+    unsigned int disp_pos;
+    WORD v810_dest;
+} x86_fixup;
+
+static x86_fixup fixups[MAX_V810_INST * 2];
+static unsigned int num_fixups;
+
+// Maps the most used registers in the block to V810 registers
+static void drc_mapRegs(exec_block* block) {
+    int i, j, max, max_pos;
+
+    block->reg_map = 0;
+
+    for (i = 0; i < X86_NUM_CACHE_REGS; i++) {
+        max = max_pos = 0;
+        // P_REG[0] is always 0, so it's never worth caching
+        for (j = 1; j < 32; j++) {
+            if (reg_usage[j] > max) {
+                max_pos = j;
+                max = reg_usage[j];
+            }
+        }
+        if (max) {
+            block->reg_map |= max_pos << (5 * i);
+            reg_usage[max_pos] = 0;
+        }
+    }
+}
+
+// Gets the host register corresponding to a cached V810 register
+static BYTE drc_getPhysReg(BYTE vb_reg, WORD reg_map) {
+    int i;
+    for (i = 0; i < X86_NUM_CACHE_REGS; i++) {
+        if (((reg_map >> (i * 5)) & 0x1f) == vb_reg)
+            return cache_regs[i];
+    }
+    return X86_NOREG;
+}
+
+// Loads a V810 register into a host register
+static void drc_loadReg(BYTE rd, BYTE vb_reg) {
+    if (vb_reg == 0)
+        MOV_RI(rd, 0);
+    else if (phys_regs[vb_reg] == X86_NOREG)
+        MOV_RM(rd, X86_RBX, offsetof(cpu_state, P_REG[vb_reg]));
+    else if (phys_regs[vb_reg] != rd)
+        MOV_RR(rd, phys_regs[vb_reg]);
+}
+
+// Gets the host register holding a V810 register, loading it into rd if it
+// isn't cached
+static BYTE drc_getReg(BYTE rd, BYTE vb_reg) {
+    if (vb_reg != 0 && phys_regs[vb_reg] != X86_NOREG)
+        return phys_regs[vb_reg];
+    drc_loadReg(rd, vb_reg);
+    return rd;
+}
+
+// Gets the host register an instruction should write a V810 register to
+static BYTE drc_getDestReg(BYTE rd, BYTE vb_reg) {
+    if (vb_reg != 0 && phys_regs[vb_reg] != X86_NOREG)
+        return phys_regs[vb_reg];
+    return rd;
+}
+
+// Writes back a V810 register computed in rs (writes to r0 are dropped)
+static void drc_storeReg(BYTE vb_reg, BYTE rs) {
+    if (vb_reg == 0)
+        return;
+    if (phys_regs[vb_reg] == X86_NOREG)
+        MOV_MR(X86_RBX, offsetof(cpu_state, P_REG[vb_reg]), rs);
+    else if (phys_regs[vb_reg] != rs)
+        MOV_RR(phys_regs[vb_reg], rs);
+}
+
+// Calls an entry of the relocation table
+static void drc_callReloc(int index) {
+    MOV_RM64(X86_RAX, X86_RBX, offsetof(cpu_state, reloc_table));
+    CALL_M(X86_RAX, index * 8);
+}
+
+// Emits a rel32 jump to a V810 address
+static void drc_jumpTo(int cc, WORD v810_dest) {
+    BYTE *disp = x86_jcc32(cc);
+    fixups[num_fixups].disp_pos = (unsigned int)(disp - trans_cache);
+    fixups[num_fixups].v810_dest = v810_dest;
+    num_fixups++;
+}
+
+// Tests a V810 condition (as in Bcond and SETF) against the flags in r14.
+// Returns the x86 condition code that's true when the V810 one is, or -1 if
+// the condition is always true and -2 if it's never true.
+static int drc_testCond(BYTE cond) {
+    int cc = X86_CC_NE;
+    switch (cond & 7) {
+        case 0: // V
+            TEST_RI(X86_R14, X86_FLAG_V);
+            break;
+        case 1: // C/L
+            TEST_RI(X86_R14, X86_FLAG_C);
+            break;
+        case 2: // Z/E
+            TEST_RI(X86_R14, X86_FLAG_Z);
+            break;
+        case 3: // NH
+            TEST_RI(X86_R14, X86_FLAG_C | X86_FLAG_Z);
+            break;
+        case 4: // N
+            TEST_RI(X86_R14, X86_FLAG_S);
+            break;
+        case 5: // T
+            return (cond & 8) ? -2 : -1;
+        case 6: // LT: S != OV
+            MOV_RR(X86_RAX, X86_R14);
+            SHIFT_RI(X86_SHIFT_SHR, X86_RAX, 4);
+            ALU_RR(X86_ALU_XOR, X86_RAX, X86_R14);
+            TEST_RI(X86_RAX, X86_FLAG_S);
+            break;
+        case 7: // LE: (S != OV) || Z
+            MOV_RR(X86_RAX, X86_R14);
+            SHIFT_RI(X86_SHIFT_SHR, X86_RAX, 4);
+            ALU_RR(X86_ALU_XOR, X86_RAX, X86_R14);
+            ALU_RI(X86_ALU_AND, X86_RAX, X86_FLAG_S);
+            MOV_RR(X86_RCX, X86_R14);
+            ALU_RI(X86_ALU_AND, X86_RCX, X86_FLAG_Z);
+            ALU_RR(X86_ALU_OR, X86_RAX, X86_RCX);
+            break;
+    }
+    return (cond & 8) ? (cc ^ 1) : cc;
+}
+
+// Sets r14 from the float in xmm0: Z if zero, S and CY if negative
+static void drc_saveFloatFlags(void) {
+    XORPS(1, 1);
+    UCOMISS(0, 1);
+    SETCC(X86_CC_B, X86_RCX);
+    SETCC(X86_CC_E, X86_RDX);
+    SETCC(X86_CC_NP, X86_RAX);
+    MOVZX8_RR(X86_RCX, X86_RCX);
+    MOVZX8_RR(X86_RDX, X86_RDX);
+    MOVZX8_RR(X86_RAX, X86_RAX);
+    ALU_RR(X86_ALU_AND, X86_RCX, X86_RAX);
+    ALU_RR(X86_ALU_AND, X86_RDX, X86_RAX);
+    NEG_R(X86_RCX);
+    ALU_RI(X86_ALU_AND, X86_RCX, X86_FLAG_S | X86_FLAG_C);
+    SHIFT_RI(X86_SHIFT_SHL, X86_RDX, 6);
+    ALU_RR(X86_ALU_OR, X86_RCX, X86_RDX);
+    MOV_RR(X86_R14, X86_RCX);
+}
+
+// Converts the low nibble of a PSW value in rs to x86 flags in rd
+// (rs must not be rcx or rdx)
+static void drc_flagsFromPsw(BYTE rd, BYTE rs) {
+    MOV_RR(X86_RCX, rs);
+    ALU_RI(X86_ALU_AND, X86_RCX, 3);
+    SHIFT_RI(X86_SHIFT_SHL, X86_RCX, 6);
+    MOV_RR(X86_RDX, rs);
+    ALU_RI(X86_ALU_AND, X86_RDX, 4);
+    SHIFT_RI(X86_SHIFT_SHL, X86_RDX, 9);
+    ALU_RR(X86_ALU_OR, X86_RCX, X86_RDX);
+    MOV_RR(X86_RDX, rs);
+    SHIFT_RI(X86_SHIFT_SHR, X86_RDX, 3);
+    ALU_RI(X86_ALU_AND, X86_RDX, 1);
+    ALU_RR(X86_ALU_OR, X86_RCX, X86_RDX);
+    MOV_RR(rd, X86_RCX);
+}
+
+// Converts flags in the NZCV layout in rs to x86 flags in rd
+// (rs must not be rcx, and is clobbered)
+static void drc_flagsFromCanonical(BYTE rd, BYTE rs) {
+    MOV_RR(X86_RCX, rs);
+    SHIFT_RI(X86_SHIFT_SHR, X86_RCX, 29);
+    ALU_RI(X86_ALU_AND, X86_RCX, X86_FLAG_C);
+    MOV_RR(rd, rs);
+    SHIFT_RI(X86_SHIFT_SHR, rd, 24);
+    ALU_RI(X86_ALU_AND, rd, X86_FLAG_Z | X86_FLAG_S);
+    ALU_RR(X86_ALU_OR, rd, X86_RCX);
+    SHIFT_RI(X86_SHIFT_SHR, rs, 17);
+    ALU_RI(X86_ALU_AND, rs, X86_FLAG_V);
+    ALU_RR(X86_ALU_OR, rd, rs);
+}
+
+// Computes the effective address of a load/store into edi
+static void drc_loadAddress(BYTE vb_reg, WORD imm) {
+    drc_loadReg(X86_RDI, vb_reg);
+    if ((SHWORD)imm != 0)
+        ALU_RI(X86_ALU_ADD, X86_RDI, (SHWORD)imm);
+}
+
+// Translates a V810 block into x86-64 code
+int drc_translateBlock(WORD start_PC) {
+    int i, j;
+    int err = 0;
+    // Stores the number of clock cycles since the last branch
+    unsigned int cycles = 0;
+    unsigned int num_v810_inst, num_words;
+    WORD end_PC, next_PC;
+    // For each V810 instruction, the host registers holding reg1 and reg2
+    BYTE src, dst;
+
+    // Games with specific hacks; additional explanation follows where each check is used.
+    bool is_waterworld = memcmp(tVBOpt.GAME_ID, "67VWEE", 6) == 0;
+    bool is_virtual_lab = memcmp(tVBOpt.GAME_ID, "AHVJVJ", 6) == 0;
+    bool is_space_invaders = memcmp(tVBOpt.GAME_ID, "C0VSPJ", 6) == 0;
+    bool is_jack_bros = memcmp(tVBOpt.GAME_ID, "EBVJBE", 6) == 0 || memcmp(tVBOpt.GAME_ID, "EBVJBJ", 6) == 0;
+    bool is_vertical_force = memcmp(tVBOpt.GAME_ID, "01VH3E", 6) == 0 || memcmp(tVBOpt.GAME_ID, "18VH3J", 6) == 0;
+    bool chcw_load_seen = (vb_state->v810_state.S_REG[CHCW] & 2) != 0;
+    bool is_marios_tennis_multiplayer = memcmp(tVBOpt.GAME_ID, "01VMTJ", 6) == 0 &&
+        memcmp((u8*)V810_ROM1.pmemory + (0x1FFDB0 & V810_ROM1.highaddr), "MULTIPLAYER HACK V0.1 BY MARTIN KUJACZYNSKI ", 44) == 0;
+
+    // Virtual Bowling and Niko-Chan Battle need their interrupts to run a little slower
+    // in order for the samples to play at the right speed.
+    bool is_virtual_bowling = memcmp(tVBOpt.GAME_ID, "E7VVBJ", 6) == 0;
+    bool is_niko_chan = memcmp(tVBOpt.GAME_ID, "8BVTRJ", 6) == 0;
+    bool slow_memory = is_virtual_bowling || is_niko_chan ||
+        // If memory is too fast, Blox 2's intro jingle doesn't finish.
+        memcmp(tVBOpt.GAME_ID, "CRVB2M", 6) == 0;
+
+    // Emulating memory clocks introduces lag to Galactic Pinball's UFO table.
+    bool is_pinball = memcmp(tVBOpt.GAME_ID, "01VGPJ", 6) == 0;
+
+    bool is_waterworld_sample = is_waterworld && (start_PC == 0x0701b2b2);
+
+    exec_block *block = NULL;
+
+    drc_scanBlockBounds(&start_PC, &end_PC);
+    dprintf(3, "[DRC]: new block - 0x%lx->0x%lx\n", start_PC, end_PC);
+
+    // Clear previous block register stats
+    memset(reg_usage, 0, sizeof(reg_usage));
+
+    block = drc_getNextBlockStruct();
+    if (block == NULL)
+        return DRC_ERR_NO_BLOCKS;
+    block->free = false;
+
+    block->start_pc = start_PC;
+    block->pc_range = end_PC - start_PC;
+
+    // First pass: decode V810 instructions
+    num_v810_inst = drc_decodeInstructions(block, start_PC, end_PC);
+    dprintf(3, "[DRC]: V810 block size - %d\n", num_v810_inst);
+
+    // Waterworld-exclusive pass: find busywaits
+    if (is_waterworld)
+        busywait_findWaterworld(inst_cache, num_v810_inst);
+
+    // Second pass: map the most used V810 registers to host registers
+    drc_mapRegs(block);
+    phys_regs[0] = X86_NOREG;
+    for (i = 1; i < 32; i++)
+        phys_regs[i] = drc_getPhysReg(i, block->reg_map);
+
+    x86_ptr = trans_cache;
+    num_fixups = 0;
+
+    // Third pass: generate x86 code
+    for (i = 0; i < num_v810_inst; i++) {
+        // The longest sequence (bitstring) is about 150 bytes, keep some margin
+        if (x86_ptr - trans_cache >= MAX_X86_BYTES - 512) {
+            // Truncate the block, the rest will be translated separately
+            num_v810_inst = i;
+            block->pc_range = inst_cache[i - 1].PC - block->start_pc;
+            break;
+        }
+
+        // Entrypoints are WORD-aligned
+        x86_align4();
+        inst_cache[i].start_pos = (HWORD) ((x86_ptr - trans_cache) / 4);
+        cycles += opcycle[inst_cache[i].opcode];
+
+        // Native code spliced in here (see hle.c)
+        int hook = hle_findHook(inst_cache[i].PC);
+        if (unlikely(hook)) {
+            MOV_RI(X86_RDI, hook);
+            drc_callReloc(DRC_RELOC_HLEHOOK);
+            // skip the code it replaces
+            if (hle_entries[hook - 1].resume_PC)
+                drc_jumpTo(-1, hle_entries[hook - 1].resume_PC);
+        }
+
+        // Waterworld hack: slow down the sample at the start.
+        // This roughly emulates register hazards to a certain extent,
+        // with some tweaks to bring it as close as possible to a hardware recording.
+        if (is_waterworld_sample) {
+            if (inst_cache[i].PC == 0x0701b2b4) cycles -= 1;
+            if (opcycle[inst_cache[i].opcode] == 1 && (inst_cache[i].PC & 6) == 0) {
+                if (i > 0 && inst_cache[i-1].reg2 != 0xFF && (inst_cache[i].reg1 == inst_cache[i-1].reg2)) {
+                    cycles++;
+                }
+            }
+        }
+
+        switch (inst_cache[i].opcode) {
+            case V810_OP_JMP: // jmp [reg1]
+                src = drc_getReg(X86_RAX, inst_cache[i].reg1);
+                MOV_MR(X86_RBX, offsetof(cpu_state, PC), src);
+                ADDCYCLES();
+                RET();
+                break;
+            case V810_OP_JR: // jr imm26
+                if (abs(inst_cache[i].branch_offset) < 1024) {
+                    if (inst_cache[i].busywait) {
+                        HALT(inst_cache[i].PC + inst_cache[i].branch_offset);
+                    } else {
+                        if (inst_cache[i].branch_offset <= 0) {
+                            HANDLEINT(inst_cache[i].PC + inst_cache[i].branch_offset);
+                        } else {
+                            ADDCYCLES();
+                        }
+                        drc_jumpTo(-1, inst_cache[i].PC + inst_cache[i].branch_offset);
+                    }
+                } else {
+                    ADDCYCLES();
+                    MOV_MI(X86_RBX, offsetof(cpu_state, PC), inst_cache[i].PC + inst_cache[i].branch_offset);
+                    RET();
+                }
+                break;
+            case V810_OP_JAL: // jal disp26
+            {
+                if (is_space_invaders && inst_cache[i].PC == 0x07007fb6) {
+                    // Make sure the Space Invaders intro FMV runs at the correct speed (ish).
+                    // Value determined through trial and error.
+                    cycles += 24;
+                }
+
+                // Save the new PC
+                MOV_MI(X86_RBX, offsetof(cpu_state, PC), inst_cache[i].PC + inst_cache[i].branch_offset);
+                // Link the return address
+                if (phys_regs[31] != X86_NOREG)
+                    MOV_RI(phys_regs[31], inst_cache[i].PC + 4);
+                else
+                    MOV_MI(X86_RBX, offsetof(cpu_state, P_REG[31]), inst_cache[i].PC + 4);
+                ADDCYCLES();
+                RET();
+                break;
+            }
+            case V810_OP_RETI:
+            {
+                BYTE *is_eip, *done;
+                MOV_RM(X86_RAX, X86_RBX, offsetof(cpu_state, S_REG[PSW]));
+                TEST_RI(X86_RAX, PSW_NP);
+                is_eip = x86_jcc8(X86_CC_E);
+                MOV_RM(X86_RCX, X86_RBX, offsetof(cpu_state, S_REG[FEPC]));
+                MOV_RM(X86_RDX, X86_RBX, offsetof(cpu_state, S_REG[FEPSW]));
+                done = x86_jcc8(-1);
+                x86_patch8(is_eip, x86_ptr);
+                MOV_RM(X86_RCX, X86_RBX, offsetof(cpu_state, S_REG[EIPC]));
+                MOV_RM(X86_RDX, X86_RBX, offsetof(cpu_state, S_REG[EIPSW]));
+                x86_patch8(done, x86_ptr);
+
+                MOV_MR(X86_RBX, offsetof(cpu_state, PC), X86_RCX);
+                MOV_MR(X86_RBX, offsetof(cpu_state, S_REG[PSW]), X86_RDX);
+
+                ADDCYCLES();
+
+                // restore flags and handle any lingering interrupts
+                MOV_RM(X86_RAX, X86_RBX, offsetof(cpu_state, except_flags));
+                MOV_MR(X86_RBX, offsetof(cpu_state, flags), X86_RAX);
+                MOV_RR(X86_RSI, X86_RCX);
+                drc_flagsFromCanonical(X86_R14, X86_RAX);
+                MOV_RR(X86_RDI, X86_R14);
+                CALL_M(X86_RBX, offsetof(cpu_state, irq_handler));
+
+                // if we didn't exit already, leave the block
+                RET();
+                break;
+            }
+            case V810_OP_BR:
+                if (inst_cache[i].branch_offset == 0) {
+                    HALT(inst_cache[i].PC);
+                    break;
+                }
+                // vertical force doesn't have a tight spinloop like most games, so we can't detect it
+                // it just continuously loops through entities, doing nothing more when each one done
+                // so let's just artificially skip a bunch of time so that the game isn't slow
+                if (is_vertical_force && inst_cache[i].PC == 0x07000c08) {
+                    ALU_MI(X86_ALU_SUB, X86_RBX, offsetof(cpu_state, cycles_until_event_partial), 1 << 25);
+                    HANDLEINT(inst_cache[i].PC + inst_cache[i].branch_offset);
+                    drc_jumpTo(-1, inst_cache[i].PC + inst_cache[i].branch_offset);
+                    break;
+                }
+            case V810_OP_BV:
+            case V810_OP_BL:
+            case V810_OP_BE:
+            case V810_OP_BNH:
+            case V810_OP_BN:
+            case V810_OP_BLT:
+            case V810_OP_BLE:
+            case V810_OP_BNV:
+            case V810_OP_BNL:
+            case V810_OP_BNE:
+            case V810_OP_BH:
+            case V810_OP_BP:
+            case V810_OP_BGE:
+            case V810_OP_BGT:
+            {
+                int cc;
+                if (inst_cache[i].busywait) {
+                    BYTE *not_taken;
+                    cc = drc_testCond(inst_cache[i].opcode & 0xF);
+                    not_taken = cc == -1 ? NULL : x86_jcc8(cc ^ 1);
+                    HALT(inst_cache[i].PC + inst_cache[i].branch_offset);
+                    if (not_taken) x86_patch8(not_taken, x86_ptr);
+                } else {
+                    // If we just got back from a JAL, an interrupt check already happened, so don't bother.
+                    if (inst_cache[i].branch_offset <= 0 && (inst_cache[i].is_branch_target || (i > 0 && inst_cache[i-1].opcode != V810_OP_JAL))) {
+                        // The Jack Bros. intro chime delay consists of "add; bne" loops
+                        // running with the instruction cache off, which take 24 cycles
+                        // per iteration (see the ARM backend for the details).
+                        if (is_jack_bros && !chcw_load_seen) {
+                            cycles += 20;
+                        }
+                        HANDLEINT(inst_cache[i].PC);
+                    } else {
+                        ADDCYCLES();
+                    }
+                    cc = drc_testCond(inst_cache[i].opcode & 0xF);
+                    drc_jumpTo(cc, inst_cache[i].PC + inst_cache[i].branch_offset);
+                }
+                // branch not taken, so it only took 1 cycle
+                ALU_MI(X86_ALU_ADD, X86_RBX, offsetof(cpu_state, cycles_until_event_partial), 2);
+                break;
+            }
+            case V810_OP_MOVHI: // movhi imm16, reg1, reg2
+                dst = drc_getDestReg(X86_RAX, inst_cache[i].reg2);
+                if (inst_cache[i].reg1 == 0) {
+                    MOV_RI(dst, inst_cache[i].imm << 16);
+                } else {
+                    drc_loadReg(dst, inst_cache[i].reg1);
+                    if (inst_cache[i].imm != 0)
+                        ALU_RI(X86_ALU_ADD, dst, inst_cache[i].imm << 16);
+                }
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            case V810_OP_MOVEA: // movea imm16, reg1, reg2
+                dst = drc_getDestReg(X86_RAX, inst_cache[i].reg2);
+                if (inst_cache[i].reg1 == 0) {
+                    MOV_RI(dst, (SHWORD)inst_cache[i].imm);
+                } else {
+                    drc_loadReg(dst, inst_cache[i].reg1);
+                    if (inst_cache[i].imm != 0)
+                        ALU_RI(X86_ALU_ADD, dst, (SHWORD)inst_cache[i].imm);
+                }
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            case V810_OP_MOV: // mov reg1, reg2
+                dst = drc_getDestReg(X86_RAX, inst_cache[i].reg2);
+                drc_loadReg(dst, inst_cache[i].reg1);
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            case V810_OP_ADD: // add reg1, reg2
+            case V810_OP_SUB: // sub reg1, reg2
+            case V810_OP_CMP: // cmp reg1, reg2
+            {
+                BYTE op = inst_cache[i].opcode == V810_OP_ADD ? X86_ALU_ADD :
+                          inst_cache[i].opcode == V810_OP_SUB ? X86_ALU_SUB : X86_ALU_CMP;
+                dst = drc_getReg(X86_RAX, inst_cache[i].reg2);
+                src = drc_getReg(X86_RCX, inst_cache[i].reg1);
+                ALU_RR(op, dst, src);
+                SAVE_FLAGS();
+                if (op != X86_ALU_CMP)
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            }
+            case V810_OP_SHL: // shl reg1, reg2
+            case V810_OP_SHR: // shr reg1, reg2
+            case V810_OP_SAR: // sar reg1, reg2
+            {
+                BYTE op = inst_cache[i].opcode == V810_OP_SHL ? X86_SHIFT_SHL :
+                          inst_cache[i].opcode == V810_OP_SHR ? X86_SHIFT_SHR : X86_SHIFT_SAR;
+                drc_loadReg(X86_RCX, inst_cache[i].reg1);
+                dst = drc_getReg(X86_RAX, inst_cache[i].reg2);
+                // a shift by 0 leaves CF alone, so clear it first
+                ALU_RI(X86_ALU_AND, X86_RCX, 0x1F);
+                SHIFT_RCL(op, dst);
+                SETCC(X86_CC_B, X86_RDX);
+                TEST_RR(dst, dst);
+                SAVE_FLAGS();
+                MOVZX8_RR(X86_RDX, X86_RDX);
+                ALU_RR(X86_ALU_OR, X86_R14, X86_RDX);
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            }
+            case V810_OP_SHL_I: // shl imm5, reg2
+            case V810_OP_SHR_I: // shr imm5, reg2
+            case V810_OP_SAR_I: // sar imm5, reg2
+            {
+                BYTE op = inst_cache[i].opcode == V810_OP_SHL_I ? X86_SHIFT_SHL :
+                          inst_cache[i].opcode == V810_OP_SHR_I ? X86_SHIFT_SHR : X86_SHIFT_SAR;
+                dst = drc_getReg(X86_RAX, inst_cache[i].reg2);
+                if (inst_cache[i].imm != 0) {
+                    SHIFT_RI(op, dst, inst_cache[i].imm);
+                    SETCC(X86_CC_B, X86_RDX);
+                    TEST_RR(dst, dst);
+                    SAVE_FLAGS();
+                    MOVZX8_RR(X86_RDX, X86_RDX);
+                    ALU_RR(X86_ALU_OR, X86_R14, X86_RDX);
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                } else {
+                    TEST_RR(dst, dst);
+                    SAVE_FLAGS();
+                }
+                break;
+            }
+            case V810_OP_MUL: // mul reg1, reg2
+                drc_loadReg(X86_RAX, inst_cache[i].reg2);
+                drc_loadReg(X86_RCX, inst_cache[i].reg1);
+                MOVSXD_RR(X86_RAX, X86_RAX);
+                MOVSXD_RR(X86_RCX, X86_RCX);
+                IMUL_RR64(X86_RAX, X86_RCX);
+                // overflow if the result doesn't fit in 32 bits
+                MOVSXD_RR(X86_RDX, X86_RAX);
+                ALU_RR64(X86_ALU_CMP, X86_RDX, X86_RAX);
+                SETCC(X86_CC_NE, X86_RDX);
+                MOVZX8_RR(X86_RDX, X86_RDX);
+                SHIFT_RI(X86_SHIFT_SHL, X86_RDX, 11);
+                TEST_RR64(X86_RAX, X86_RAX);
+                SAVE_FLAGS();
+                ALU_RR(X86_ALU_OR, X86_R14, X86_RDX);
+                MOV_RR64(X86_RCX, X86_RAX);
+                SHIFT_RI64(X86_SHIFT_SHR, X86_RCX, 32);
+                drc_storeReg(30, X86_RCX);
+                drc_storeReg(inst_cache[i].reg2, X86_RAX);
+                break;
+            case V810_OP_MULU: // mulu reg1, reg2
+                drc_loadReg(X86_RAX, inst_cache[i].reg2);
+                drc_loadReg(X86_RCX, inst_cache[i].reg1);
+                IMUL_RR64(X86_RAX, X86_RCX);
+                // overflow if the high word isn't 0
+                MOV_RR64(X86_RDX, X86_RAX);
+                SHIFT_RI64(X86_SHIFT_SHR, X86_RDX, 32);
+                SETCC(X86_CC_NE, X86_RDX);
+                MOVZX8_RR(X86_RDX, X86_RDX);
+                SHIFT_RI(X86_SHIFT_SHL, X86_RDX, 11);
+                // sign from the low word, zero from the whole result
+                TEST_RR(X86_RAX, X86_RAX);
+                SAVE_FLAGS();
+                ALU_RI(X86_ALU_AND, X86_R14, X86_FLAG_S);
+                ALU_RR(X86_ALU_OR, X86_R14, X86_RDX);
+                TEST_RR64(X86_RAX, X86_RAX);
+                SETCC(X86_CC_E, X86_RDX);
+                MOVZX8_RR(X86_RDX, X86_RDX);
+                SHIFT_RI(X86_SHIFT_SHL, X86_RDX, 6);
+                ALU_RR(X86_ALU_OR, X86_R14, X86_RDX);
+                MOV_RR64(X86_RCX, X86_RAX);
+                SHIFT_RI64(X86_SHIFT_SHR, X86_RCX, 32);
+                drc_storeReg(30, X86_RCX);
+                drc_storeReg(inst_cache[i].reg2, X86_RAX);
+                break;
+            case V810_OP_DIV: // div reg1, reg2
+            {
+                // reg2/reg1 -> reg2 (eax)
+                // reg2%reg1 -> r30 (edx)
+                BYTE *by_zero, *not_min1, *not_min2, *done1, *done2;
+                drc_loadReg(X86_RAX, inst_cache[i].reg2);
+                drc_loadReg(X86_RCX, inst_cache[i].reg1);
+                // overflow flag in esi
+                MOV_RI(X86_RSI, 0);
+                TEST_RR(X86_RCX, X86_RCX);
+                by_zero = x86_jcc8(X86_CC_E);
+                ALU_RI(X86_ALU_CMP, X86_RCX, -1);
+                not_min1 = x86_jcc8(X86_CC_NE);
+                ALU_RI(X86_ALU_CMP, X86_RAX, INT32_MIN);
+                not_min2 = x86_jcc8(X86_CC_NE);
+                // 0x80000000 / -1 overflows, and the remainder is 0
+                MOV_RI(X86_RDX, 0);
+                MOV_RI(X86_RSI, X86_FLAG_V);
+                done1 = x86_jcc8(-1);
+                x86_patch8(not_min1, x86_ptr);
+                x86_patch8(not_min2, x86_ptr);
+                CDQ();
+                IDIV_R(X86_RCX);
+                done2 = x86_jcc8(-1);
+                x86_patch8(by_zero, x86_ptr);
+                MOV_RI(X86_RAX, 0);
+                MOV_RI(X86_RDX, 0);
+                x86_patch8(done1, x86_ptr);
+                x86_patch8(done2, x86_ptr);
+
+                drc_storeReg(30, X86_RDX);
+                drc_storeReg(inst_cache[i].reg2, X86_RAX);
+
+                TEST_RR(X86_RAX, X86_RAX);
+                SAVE_FLAGS_LOGIC();
+                ALU_RR(X86_ALU_OR, X86_R14, X86_RSI);
+                break;
+            }
+            case V810_OP_DIVU: // divu reg1, reg2
+            {
+                BYTE *by_zero, *done;
+                drc_loadReg(X86_RAX, inst_cache[i].reg2);
+                drc_loadReg(X86_RCX, inst_cache[i].reg1);
+                TEST_RR(X86_RCX, X86_RCX);
+                by_zero = x86_jcc8(X86_CC_E);
+                MOV_RI(X86_RDX, 0);
+                DIV_R(X86_RCX);
+                done = x86_jcc8(-1);
+                x86_patch8(by_zero, x86_ptr);
+                MOV_RI(X86_RAX, 0);
+                MOV_RI(X86_RDX, 0);
+                x86_patch8(done, x86_ptr);
+
+                drc_storeReg(30, X86_RDX);
+                drc_storeReg(inst_cache[i].reg2, X86_RAX);
+
+                TEST_RR(X86_RAX, X86_RAX);
+                SAVE_FLAGS_LOGIC();
+                break;
+            }
+            case V810_OP_OR: // or reg1, reg2
+            case V810_OP_AND: // and reg1, reg2
+            case V810_OP_XOR: // xor reg1, reg2
+            {
+                BYTE op = inst_cache[i].opcode == V810_OP_OR ? X86_ALU_OR :
+                          inst_cache[i].opcode == V810_OP_AND ? X86_ALU_AND : X86_ALU_XOR;
+                dst = drc_getReg(X86_RAX, inst_cache[i].reg2);
+                src = drc_getReg(X86_RCX, inst_cache[i].reg1);
+                ALU_RR(op, dst, src);
+                drc_storeReg(inst_cache[i].reg2, dst);
+                SAVE_FLAGS_LOGIC();
+                break;
+            }
+            case V810_OP_NOT: // not reg1, reg2
+                dst = drc_getDestReg(X86_RAX, inst_cache[i].reg2);
+                drc_loadReg(dst, inst_cache[i].reg1);
+                NOT_R(dst);
+                TEST_RR(dst, dst);
+                drc_storeReg(inst_cache[i].reg2, dst);
+                SAVE_FLAGS_LOGIC();
+                break;
+            case V810_OP_MOV_I: // mov imm5, reg2
+                if (inst_cache[i].reg2 == 0)
+                    break;
+                if (phys_regs[inst_cache[i].reg2] != X86_NOREG)
+                    MOV_RI(phys_regs[inst_cache[i].reg2], sign_5(inst_cache[i].imm));
+                else
+                    MOV_MI(X86_RBX, offsetof(cpu_state, P_REG[inst_cache[i].reg2]), sign_5(inst_cache[i].imm));
+                break;
+            case V810_OP_ADD_I: // add imm5, reg2
+                dst = drc_getReg(X86_RAX, inst_cache[i].reg2);
+                ALU_RI(X86_ALU_ADD, dst, sign_5(inst_cache[i].imm));
+                SAVE_FLAGS();
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            case V810_OP_CMP_I: // cmp imm5, reg2
+                dst = drc_getReg(X86_RAX, inst_cache[i].reg2);
+                ALU_RI(X86_ALU_CMP, dst, sign_5(inst_cache[i].imm));
+                SAVE_FLAGS();
+                break;
+            case V810_OP_ANDI: // andi imm16, reg1, reg2
+            case V810_OP_XORI: // xori imm16, reg1, reg2
+            case V810_OP_ORI: // ori imm16, reg1, reg2
+            {
+                BYTE op = inst_cache[i].opcode == V810_OP_ANDI ? X86_ALU_AND :
+                          inst_cache[i].opcode == V810_OP_XORI ? X86_ALU_XOR : X86_ALU_OR;
+                dst = drc_getDestReg(X86_RAX, inst_cache[i].reg2);
+                drc_loadReg(dst, inst_cache[i].reg1);
+                // the immediate is zero-extended
+                ALU_RI(op, dst, inst_cache[i].imm & 0xFFFF);
+                drc_storeReg(inst_cache[i].reg2, dst);
+                SAVE_FLAGS_LOGIC();
+                break;
+            }
+            case V810_OP_ADDI: // addi imm16, reg1, reg2
+                dst = drc_getDestReg(X86_RAX, inst_cache[i].reg2);
+                drc_loadReg(dst, inst_cache[i].reg1);
+                ALU_RI(X86_ALU_ADD, dst, (SHWORD)inst_cache[i].imm);
+                SAVE_FLAGS();
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            case V810_OP_LD_B: // ld.b disp16 [reg1], reg2
+            case V810_OP_IN_B: // in.b disp16 [reg1], reg2
+            case V810_OP_LD_H: // ld.h disp16 [reg1], reg2
+            case V810_OP_IN_H: // in.h disp16 [reg1], reg2
+            case V810_OP_LD_W: // ld.w disp16 [reg1], reg2
+            case V810_OP_IN_W: // in.w disp16 [reg1], reg2
+            {
+                BYTE opcode = inst_cache[i].opcode;
+                bool is_word = opcode == V810_OP_LD_W || opcode == V810_OP_IN_W;
+                drc_loadAddress(inst_cache[i].reg1, inst_cache[i].imm);
+                if (opcode == V810_OP_LD_B || opcode == V810_OP_IN_B)
+                    drc_callReloc(DRC_RELOC_RBYTE);
+                else if (opcode == V810_OP_LD_H || opcode == V810_OP_IN_H)
+                    drc_callReloc(DRC_RELOC_RHWORD);
+                else
+                    drc_callReloc(DRC_RELOC_RWORD);
+
+                // Subtract the cycles returned in the high word
+                if (!is_pinball) {
+                    MOV_RR64(X86_RDX, X86_RAX);
+                    SHIFT_RI64(X86_SHIFT_SHR, X86_RDX, 32);
+                    ALU_MR(X86_ALU_SUB, X86_RBX, offsetof(cpu_state, cycles_until_event_partial), X86_RDX);
+                }
+
+                if (slow_memory) cycles += is_word ? 4 : 2;
+
+                if (inst_cache[i].reg2 != 0) {
+                    dst = drc_getDestReg(X86_RAX, inst_cache[i].reg2);
+                    switch (opcode) {
+                        case V810_OP_LD_B: MOVSX8_RR(dst, X86_RAX); break;
+                        case V810_OP_IN_B: MOVZX8_RR(dst, X86_RAX); break;
+                        case V810_OP_LD_H: MOVSX16_RR(dst, X86_RAX); break;
+                        case V810_OP_IN_H: MOVZX16_RR(dst, X86_RAX); break;
+                        default: if (dst != X86_RAX) MOV_RR(dst, X86_RAX); break;
+                    }
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                }
+
+                if (i > 0 && (inst_cache[i - 1].opcode & 0x34) == 0x30 && (inst_cache[i - 1].opcode & 3) != 2) {
+                    // load immediately following another load takes 1 cycle less
+                    cycles -= 1;
+                } else if (i > 0 && opcycle[inst_cache[i - 1].opcode] > 4) {
+                    // load following instruction taking "many" cycles only takes 1 cycles
+                    // guessing "many" is 4 for now
+                    cycles -= is_word ? 4 : 2;
+                }
+                break;
+            }
+            case V810_OP_ST_B:  // st.b reg2, disp16 [reg1]
+            case V810_OP_OUT_B: // out.b reg2, disp16 [reg1]
+            case V810_OP_ST_H:  // st.h reg2, disp16 [reg1]
+            case V810_OP_OUT_H: // out.h reg2, disp16 [reg1]
+            case V810_OP_ST_W:  // st.w reg2, disp16 [reg1]
+            case V810_OP_OUT_W: // out.w reg2, disp16 [reg1]
+            {
+                BYTE opcode = inst_cache[i].opcode;
+                bool is_word = opcode == V810_OP_ST_W || opcode == V810_OP_OUT_W;
+                drc_loadAddress(inst_cache[i].reg1, inst_cache[i].imm);
+                drc_loadReg(X86_RSI, inst_cache[i].reg2);
+                if (opcode == V810_OP_ST_B || opcode == V810_OP_OUT_B)
+                    drc_callReloc(DRC_RELOC_WBYTE);
+                else if (opcode == V810_OP_ST_H || opcode == V810_OP_OUT_H)
+                    drc_callReloc(DRC_RELOC_WHWORD);
+                else
+                    drc_callReloc(DRC_RELOC_WWORD);
+
+                if (slow_memory) cycles += is_word ? 4 : 2;
+
+                if (i > 1 && (inst_cache[i - 1].opcode & 0x34) == 0x34 && (inst_cache[i - 1].opcode & 3) != 2) {
+                    // with two consecutive stores, the second one takes longer
+                    cycles += is_word ? 3 : 1;
+                }
+
+                // Subtract the cycles returned in eax
+                if (!is_pinball)
+                    ALU_MR(X86_ALU_SUB, X86_RBX, offsetof(cpu_state, cycles_until_event_partial), X86_RAX);
+
+                // if we load the same thing immediately after saving it, skip the loading
+                if (is_word && i + 1 < num_v810_inst &&
+                    !inst_cache[i].fallthrough_PC && !inst_cache[i + 1].fallthrough_PC &&
+                    (inst_cache[i + 1].opcode == V810_OP_LD_W || inst_cache[i + 1].opcode == V810_OP_IN_W) &&
+                    inst_cache[i + 1].imm == inst_cache[i].imm && inst_cache[i + 1].reg1 == inst_cache[i].reg1 &&
+                    inst_cache[i + 1].reg2 == inst_cache[i].reg2
+                ) {
+                    cycles += 5;
+                    ADDCYCLES();
+                    drc_jumpTo(-1, inst_cache[i].PC + 8);
+                }
+                break;
+            }
+            case V810_OP_LDSR: // ldsr reg2, regID
+                // Stores reg2 in vb_state->v810_state.S_REG[regID]
+                src = drc_getReg(X86_RAX, inst_cache[i].reg2);
+                MOV_MR(X86_RBX, offsetof(cpu_state, S_REG[inst_cache[i].imm]), src);
+                if (inst_cache[i].imm == CHCW) chcw_load_seen = true;
+                if (inst_cache[i].imm == PSW) {
+                    drc_flagsFromPsw(X86_R14, src);
+                } else if (inst_cache[i].imm == EIPSW) {
+                    // except_flags: ((psw & 3) << 30) | ((psw & 0xc) << 26)
+                    MOV_RR(X86_RCX, src);
+                    ALU_RI(X86_ALU_AND, X86_RCX, 3);
+                    SHIFT_RI(X86_SHIFT_SHL, X86_RCX, 30);
+                    MOV_RR(X86_RDX, src);
+                    ALU_RI(X86_ALU_AND, X86_RDX, 0xc);
+                    SHIFT_RI(X86_SHIFT_SHL, X86_RDX, 26);
+                    ALU_RR(X86_ALU_OR, X86_RCX, X86_RDX);
+                    MOV_MR(X86_RBX, offsetof(cpu_state, except_flags), X86_RCX);
+                }
+                break;
+            case V810_OP_STSR: // stsr regID, reg2
+                // Loads vb_state->v810_state.S_REG[regID] into reg2
+                dst = drc_getDestReg(X86_RAX, inst_cache[i].reg2);
+                MOV_RM(dst, X86_RBX, offsetof(cpu_state, S_REG[inst_cache[i].imm]));
+                if (inst_cache[i].imm == PSW || inst_cache[i].imm == EIPSW) {
+                    // clear out condition flags
+                    ALU_RI(X86_ALU_AND, dst, ~0xf);
+                    if (inst_cache[i].imm == PSW) {
+                        // Z, S from bits 6-7, OV from bit 11, CY from bit 0
+                        MOV_RR(X86_RCX, X86_R14);
+                        SHIFT_RI(X86_SHIFT_SHR, X86_RCX, 6);
+                        ALU_RI(X86_ALU_AND, X86_RCX, 3);
+                        MOV_RR(X86_RDX, X86_R14);
+                        SHIFT_RI(X86_SHIFT_SHR, X86_RDX, 9);
+                        ALU_RI(X86_ALU_AND, X86_RDX, 4);
+                        ALU_RR(X86_ALU_OR, X86_RCX, X86_RDX);
+                        MOV_RR(X86_RDX, X86_R14);
+                        ALU_RI(X86_ALU_AND, X86_RDX, 1);
+                        SHIFT_RI(X86_SHIFT_SHL, X86_RDX, 3);
+                    } else {
+                        // (except_flags >> 30) | ((except_flags >> 26) & 0xc)
+                        MOV_RM(X86_RCX, X86_RBX, offsetof(cpu_state, except_flags));
+                        MOV_RR(X86_RDX, X86_RCX);
+                        SHIFT_RI(X86_SHIFT_SHR, X86_RCX, 30);
+                        SHIFT_RI(X86_SHIFT_SHR, X86_RDX, 26);
+                        ALU_RI(X86_ALU_AND, X86_RDX, 0xc);
+                    }
+                    ALU_RR(X86_ALU_OR, X86_RCX, X86_RDX);
+                    ALU_RR(X86_ALU_OR, dst, X86_RCX);
+                }
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            case V810_OP_SEI: // sei
+                // Set the 12th bit in vb_state->v810_state.S_REG[PSW]
+                ALU_MI(X86_ALU_OR, X86_RBX, offsetof(cpu_state, S_REG[PSW]), 1 << 12);
+                break;
+            case V810_OP_CLI: // cli
+                // Clear the 12th bit in vb_state->v810_state.S_REG[PSW]
+                ALU_MI(X86_ALU_AND, X86_RBX, offsetof(cpu_state, S_REG[PSW]), ~(1 << 12));
+                break;
+            case V810_OP_SETF: // setf imm5, reg2
+            {
+                int cc = drc_testCond(inst_cache[i].imm & 0xF);
+                dst = drc_getDestReg(X86_RAX, inst_cache[i].reg2);
+                if (cc < 0) {
+                    MOV_RI(dst, cc == -1 ? 1 : 0);
+                } else {
+                    SETCC(cc, X86_RAX);
+                    MOVZX8_RR(dst, X86_RAX);
+                }
+                drc_storeReg(inst_cache[i].reg2, dst);
+                break;
+            }
+            case V810_OP_HALT: // halt
+                // leave the block and let v810_run idle
+                ADDCYCLES();
+                MOV_MI(X86_RBX, offsetof(cpu_state, PC), inst_cache[i].PC);
+                MOV_MI(X86_RBX, offsetof(cpu_state, halted), 1);
+                RET();
+                break;
+            case V810_OP_BSTR:
+            {
+                BYTE *inst_start = trans_cache + inst_cache[i].start_pos * 4;
+                // offsets -> ecx
+                drc_loadReg(X86_RCX, 27);
+                ALU_RI(X86_ALU_AND, X86_RCX, 31);
+                if (inst_cache[i].imm >= 4) {
+                    // non-search, we have a destination
+                    drc_loadReg(X86_RDX, 26);
+                    ALU_RI(X86_ALU_AND, X86_RDX, 31);
+                    SHIFT_RI(X86_SHIFT_SHL, X86_RDX, 5);
+                    ALU_RR(X86_ALU_OR, X86_RCX, X86_RDX);
+                    // cycle count << 10
+                    MOV_RM(X86_RDX, X86_RBX, offsetof(cpu_state, cycles_until_event_partial));
+                    SHIFT_RI(X86_SHIFT_SHL, X86_RDX, 10);
+                    ALU_RR(X86_ALU_OR, X86_RCX, X86_RDX);
+                    // destination address, word-aligned
+                    drc_loadReg(X86_RSI, 29);
+                    ALU_RI(X86_ALU_AND, X86_RSI, ~3);
+                } else {
+                    // search, leave as-is
+                    drc_loadReg(X86_RSI, 29);
+                }
+                // source address, word-aligned
+                drc_loadReg(X86_RDI, 30);
+                ALU_RI(X86_ALU_AND, X86_RDI, ~3);
+                // length
+                drc_loadReg(X86_RDX, 28);
+
+                drc_callReloc(DRC_RELOC_BSTR + inst_cache[i].imm);
+
+                // reload registers
+                for (j = inst_cache[i].imm >= 4 ? 26 : 27; j <= 30; j++)
+                    if (phys_regs[j] != X86_NOREG)
+                        MOV_RM(phys_regs[j], X86_RBX, offsetof(cpu_state, P_REG[j]));
+                if (inst_cache[i].imm < 4) {
+                    // zero flag for search
+                    MOVZX8_RR(X86_RAX, X86_RAX);
+                    TEST_RR(X86_RAX, X86_RAX);
+                    SETCC(X86_CC_E, X86_RDX);
+                    MOVZX8_RR(X86_RDX, X86_RDX);
+                    SHIFT_RI(X86_SHIFT_SHL, X86_RDX, 6);
+                    ALU_RI(X86_ALU_AND, X86_R14, ~X86_FLAG_Z);
+                    ALU_RR(X86_ALU_OR, X86_R14, X86_RDX);
+                } else {
+                    // subtract the cycles taken and check interrupt
+                    ALU_MR(X86_ALU_SUB, X86_RBX, offsetof(cpu_state, cycles_until_event_partial), X86_RAX);
+                    HANDLEINT(inst_cache[i].PC);
+                    // loop until the whole string has been processed
+                    if (phys_regs[28] != X86_NOREG)
+                        TEST_RR(phys_regs[28], phys_regs[28]);
+                    else
+                        ALU_MI(X86_ALU_CMP, X86_RBX, offsetof(cpu_state, P_REG[28]), 0);
+                    x86_patch32(x86_jcc32(X86_CC_NE), inst_start);
+                }
+                break;
+            }
+            case V810_OP_FPP:
+                switch (inst_cache[i].imm) {
+                case V810_OP_CVT_WS:
+                    src = drc_getReg(X86_RCX, inst_cache[i].reg1);
+                    dst = drc_getDestReg(X86_RAX, inst_cache[i].reg2);
+                    CVTSI2SS(0, src);
+                    MOVD_RX(dst, 0);
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                    drc_saveFloatFlags();
+                    break;
+                case V810_OP_CVT_SW:
+                {
+                    // round to nearest, halfway cases away from zero
+                    BYTE *no_round, *invalid;
+                    drc_loadReg(X86_RCX, inst_cache[i].reg1);
+                    MOVD_XR(0, X86_RCX);
+                    CVTTSS2SI(X86_RAX, 0);
+                    // out of range, leave the integer indefinite value alone
+                    ALU_RI(X86_ALU_CMP, X86_RAX, INT32_MIN);
+                    invalid = x86_jcc8(X86_CC_E);
+                    CVTSI2SS(1, X86_RAX);
+                    SUBSS(0, 1);
+                    MOVD_RX(X86_RCX, 0);
+                    MOV_RR(X86_RDX, X86_RCX);
+                    ALU_RI(X86_ALU_AND, X86_RDX, 0x7fffffff);
+                    // 0.5f
+                    ALU_RI(X86_ALU_CMP, X86_RDX, 0x3f000000);
+                    no_round = x86_jcc8(X86_CC_B);
+                    // eax += fraction < 0 ? -1 : 1
+                    SHIFT_RI(X86_SHIFT_SAR, X86_RCX, 31);
+                    ALU_RR(X86_ALU_ADD, X86_RAX, X86_RCX);
+                    ALU_RR(X86_ALU_ADD, X86_RAX, X86_RCX);
+                    ALU_RI(X86_ALU_ADD, X86_RAX, 1);
+                    x86_patch8(no_round, x86_ptr);
+                    x86_patch8(invalid, x86_ptr);
+                    TEST_RR(X86_RAX, X86_RAX);
+                    SAVE_FLAGS();
+                    drc_storeReg(inst_cache[i].reg2, X86_RAX);
+                    break;
+                }
+                case V810_OP_TRNC_SW:
+                    drc_loadReg(X86_RCX, inst_cache[i].reg1);
+                    MOVD_XR(0, X86_RCX);
+                    CVTTSS2SI(X86_RAX, 0);
+                    TEST_RR(X86_RAX, X86_RAX);
+                    SAVE_FLAGS();
+                    drc_storeReg(inst_cache[i].reg2, X86_RAX);
+                    break;
+                case V810_OP_CMPF_S:
+                case V810_OP_ADDF_S:
+                case V810_OP_SUBF_S:
+                case V810_OP_MULF_S:
+                case V810_OP_DIVF_S:
+                    src = drc_getReg(X86_RCX, inst_cache[i].reg1);
+                    MOVD_XR(1, src);
+                    src = drc_getReg(X86_RAX, inst_cache[i].reg2);
+                    MOVD_XR(0, src);
+                    switch (inst_cache[i].imm) {
+                        case V810_OP_ADDF_S: ADDSS(0, 1); break;
+                        case V810_OP_MULF_S: MULSS(0, 1); break;
+                        case V810_OP_DIVF_S: cycles += 44; DIVSS(0, 1); break;
+                        default: SUBSS(0, 1); break;
+                    }
+                    if (inst_cache[i].imm != V810_OP_CMPF_S) {
+                        dst = drc_getDestReg(X86_RAX, inst_cache[i].reg2);
+                        MOVD_RX(dst, 0);
+                        drc_storeReg(inst_cache[i].reg2, dst);
+                    }
+                    drc_saveFloatFlags();
+                    break;
+                case V810_OP_XB:
+                    cycles += 6;
+                    dst = drc_getReg(X86_RAX, inst_cache[i].reg2);
+                    ROL16_8(dst);
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                    break;
+                case V810_OP_XH:
+                    cycles += 1;
+                    dst = drc_getReg(X86_RAX, inst_cache[i].reg2);
+                    SHIFT_RI(X86_SHIFT_ROL, dst, 16);
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                    break;
+                case V810_OP_REV:
+                {
+                    static const WORD rev_masks[3] = {0x0F0F0F0F, 0x33333333, 0x55555555};
+                    cycles += 22;
+                    // swap the bytes, then the nibbles, bit pairs and bits
+                    dst = drc_getDestReg(X86_RAX, inst_cache[i].reg2);
+                    drc_loadReg(dst, inst_cache[i].reg1);
+                    BSWAP(dst);
+                    for (j = 0; j < 3; j++) {
+                        MOV_RR(X86_RCX, dst);
+                        SHIFT_RI(X86_SHIFT_SHR, X86_RCX, 4 >> j);
+                        ALU_RI(X86_ALU_AND, X86_RCX, rev_masks[j]);
+                        ALU_RI(X86_ALU_AND, dst, rev_masks[j]);
+                        SHIFT_RI(X86_SHIFT_SHL, dst, 4 >> j);
+                        ALU_RR(X86_ALU_OR, dst, X86_RCX);
+                    }
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                    break;
+                }
+                case V810_OP_MPYHW:
+                    cycles += 9;
+                    drc_loadReg(X86_RCX, inst_cache[i].reg1);
+                    SHIFT_RI(X86_SHIFT_SHL, X86_RCX, 15);
+                    SHIFT_RI(X86_SHIFT_SAR, X86_RCX, 15);
+                    dst = drc_getReg(X86_RAX, inst_cache[i].reg2);
+                    IMUL_RR(dst, X86_RCX);
+                    drc_storeReg(inst_cache[i].reg2, dst);
+                    break;
+                default:
+                    dprintf(0, "[DRC]: Invalid FPU subop 0x%lx\n", inst_cache[i].imm);
+                    break;
+                }
+                break;
+            case V810_OP_NOP:
+                break;
+            case END_BLOCK:
+                RET();
+                break;
+            default:
+                dprintf(0, "[DRC]: %s (0x%x) not implemented\n", optable[inst_cache[i].opcode].opname, inst_cache[i].opcode);
+                // Skip unimplemented instructions and hope the game still runs
+                break;
+        }
+
+        if (inst_cache[i].fallthrough_PC) {
+            // the next instruction is in another block (see drc_splitLoops)
+            ADDCYCLES();
+            MOV_MI(X86_RBX, offsetof(cpu_state, PC), inst_cache[i].fallthrough_PC);
+            RET();
+        } else if (i + 1 < num_v810_inst) {
+            if (is_virtual_lab && inst_cache[i + 1].PC == 0x07002446) {
+                // virtual lab hack
+                // interrupts don't save registers, and clearing levels relies on
+                // registers getting dirty
+                HALT(0x07002446);
+            } else if (inst_cache[i+1].opcode == V810_OP_ST_B
+                    && inst_cache[i+1].imm == 0x20
+                    && inst_cache[i].opcode == V810_OP_MOVEA
+                    && inst_cache[i].reg1 == 0
+                    && inst_cache[i].reg2 == inst_cache[i+1].reg2
+                    && inst_cache[i].imm == 0x1d) {
+                // Hack for Virtual Bowling and Niko-Chan Battle:
+                // These games acknowledge the timer in a way that only works
+                // if the timer is not zero at this point.
+                // Therefore, we need to handle the interrupt to update it,
+                // so that it doesn't accidentally run an extra time.
+                ADDCYCLES();
+                MOV_RR(X86_RDI, X86_R14);
+                MOV_RI(X86_RSI, inst_cache[i+1].PC);
+                CALL_M(X86_RBX, offsetof(cpu_state, irq_handler));
+            } else if (is_marios_tennis_multiplayer && inst_cache[i + 1].PC == 0x07010442) {
+                // Mario's Tennis multiplayer hack:
+                // Place an interrupt check between the CC-Wr writes so that
+                // the two systems can desync (see the ARM backend).
+                HANDLEINT(inst_cache[i + 1].PC);
+            } else if (cycles >= 200) {
+                HANDLEINT(inst_cache[i + 1].PC);
+            } else if (cycles != 0 && (inst_cache[i + 1].is_branch_target || inst_cache[i + 1].opcode == V810_OP_BSTR)) {
+                // branch target or bitstring instruction coming up
+                ADDCYCLES();
+            } else if (inst_cache[i + 1].PC > (0xfffffe00 & V810_ROM1.highaddr) && !(inst_cache[i + 1].PC & 0xf)) {
+                // potential interrupt handler coming up
+                ADDCYCLES();
+            }
+        }
+    }
+
+    // Leave the block if execution falls off its end
+    if (num_v810_inst < 1)
+        return DRC_ERR_BAD_INST;
+    next_PC = inst_cache[num_v810_inst - 1].PC +
+        am_size_table[optable[inst_cache[num_v810_inst - 1].opcode].addr_mode];
+    ADDCYCLES();
+    MOV_MI(X86_RBX, offsetof(cpu_state, PC), next_PC);
+    RET();
+
+    while ((x86_ptr - trans_cache) & 3)
+        x86_byte(0xCC);
+    num_words = (unsigned int)(x86_ptr - trans_cache) / 4;
+
+    // Fourth pass: copy to the new memory block
+    WORD *cache_ptr = drc_alloc(num_words);
+    if (cache_ptr == NULL) {
+        // hand the block back, drc_run will make room and try again
+        block->free = true;
+        err = DRC_ERR_CACHE_FULL;
+        goto cleanup;
+    }
+    block->phys_offset = cache_ptr;
+    memcpy(cache_ptr, trans_cache, num_words * 4);
+    for (i = 0; i < num_v810_inst; i++) {
+        drc_setEntry(inst_cache[i].PC, cache_ptr + inst_cache[i].start_pos, block);
+    }
+
+    // Fifth pass: link
+    for (i = 0; i < num_fixups; i++) {
+        WORD *x86_dest = drc_getEntry(fixups[i].v810_dest, NULL);
+
+        if (x86_dest == cache_start) {
+            // Should be fixed, but just in case
+            dprintf(0, "WARN:can't jump to %lx\n", fixups[i].v810_dest);
+        }
+
+        x86_patch32((BYTE*)cache_ptr + fixups[i].disp_pos, (BYTE*)x86_dest);
+    }
+
+    block->size = num_words;
+
+cleanup:
+    return err;
+}
+
+// Allocate the x86-specific translation buffer
+void drc_backendInit(void) {
+    trans_cache = linearAlloc(MAX_X86_BYTES);
+}
+
+void drc_backendExit(void) {
+    linearFree(trans_cache);
+}
+
+// Blocks here always return to drc_run and never set link_site
+void drc_linkExit(WORD *site, WORD PC, WORD *entry, exec_block *block) {}
+void drc_unlinkExit(WORD *site) {}
@@ -0,0 +1,173 @@
+.intel_syntax noprefix
+
+# Defining v810_state offsets
+.struct 0
+state_regs:
+.struct state_regs + (4*32)
+state_statusregs:
+.struct state_statusregs + (4*32)
+state_pc:
+.struct state_pc + 4
+state_flags:
+.struct state_flags + 4
+state_exceptflags:
+.struct state_exceptflags + 4
+state_cycles:
+.struct state_cycles + 4
+state_cycles_until_event_partial:
+.struct state_cycles_until_event_partial + 4
+state_cycles_until_event_full:
+.struct state_cycles_until_event_full + 4
+
+# Defining exec_block offsets
+.struct 0
+block_phys_offset:
+.struct block_phys_offset + 8
+block_virt_loc:
+.struct block_virt_loc + 4
+block_size:
+.struct block_size + 4
+block_cycles:
+.struct block_cycles + 4
+block_reg_map_pad:
+.struct block_reg_map_pad + 4
+block_reg_map:
+.struct block_reg_map + 8
+
+.text
+
+# Converts NZCV flags in eax to x86 flags in r14d (clobbers eax, ecx)
+.macro flagsToX86
+    mov     ecx, eax
+    shr     ecx, 29
+    and     ecx, 0x001
+    mov     r14d, eax
+    shr     r14d, 24
+    and     r14d, 0x0c0
+    or      r14d, ecx
+    shr     eax, 17
+    and     eax, 0x800
+    or      r14d, eax
+.endm
+
+# Converts x86 flags in \src to NZCV flags in eax (clobbers ecx)
+.macro flagsFromX86 src
+    mov     eax, \src
+    and     eax, 0x0c0
+    shl     eax, 24
+    mov     ecx, \src
+    and     ecx, 0x001
+    shl     ecx, 29
+    or      eax, ecx
+    mov     ecx, \src
+    and     ecx, 0x800
+    shl     ecx, 17
+    or      eax, ecx
+.endm
+
+# Loads (or stores) the cached V810 register in \reg, from slot \slot of the
+# reg map in edx
+.macro cachedReg op, reg, slot
+    mov     ecx, edx
+    shr     ecx, 5*\slot
+    and     ecx, 0x1f
+.ifc \op, ld
+    mov     \reg, [rbx + rcx*4]
+.else
+    mov     [rbx + rcx*4], \reg
+.endif
+.endm
+
+# cycles += cuef - cuep
+# cuef = cuep
+.macro syncCycles
+    mov     eax, [rbx + state_cycles_until_event_partial]
+    mov     ecx, [rbx + state_cycles_until_event_full]
+    mov     [rbx + state_cycles_until_event_full], eax
+    sub     ecx, eax
+    add     [rbx + state_cycles], ecx
+.endm
+
+# void drc_executeBlock(WORD* entrypoint, exec_block* block);
+
+.globl drc_executeBlock
+.type drc_executeBlock, @function
+drc_executeBlock:
+    push    rbx
+    push    rbp
+    push    r12
+    push    r13
+    push    r14
+    push    r15
+    push    rsi
+    # keep the stack 16-byte aligned inside the block
+    sub     rsp, 8
+
+    mov     rbx, [rip + vb_state@GOTPCREL]
+    mov     rbx, [rbx]
+
+    mov     eax, [rbx + state_flags]
+    flagsToX86
+
+    # Load cached V810 registers (r0 is a placeholder for unused slots)
+    mov     edx, [rsi + block_reg_map]
+    cachedReg ld, ebp, 0
+    cachedReg ld, r12d, 1
+    cachedReg ld, r13d, 2
+    cachedReg ld, r15d, 3
+
+    # The block returns with "ret"
+    call    rdi
+
+postexec:
+    add     rsp, 8
+    pop     rsi
+
+    # Store cached V810 registers
+    mov     edx, [rsi + block_reg_map]
+    cachedReg st, ebp, 0
+    cachedReg st, r12d, 1
+    cachedReg st, r13d, 2
+    cachedReg st, r15d, 3
+
+    flagsFromX86 r14d
+    mov     [rbx + state_flags], eax
+
+    syncCycles
+
+    pop     r15
+    pop     r14
+    pop     r13
+    pop     r12
+    pop     rbp
+    pop     rbx
+    ret
+
+# Checks for pending interrupts and exits the block if necessary
+# int drc_handleInterrupts(WORD flags, WORD PC), with x86 flags
+.globl drc_handleInterrupts
+.type drc_handleInterrupts, @function
+drc_handleInterrupts:
+    # Save flags and PC
+    flagsFromX86 edi
+    mov     [rbx + state_flags], eax
+    mov     [rbx + state_pc], esi
+
+    syncCycles
+
+    sub     rsp, 8
+    mov     edi, [rbx + state_cycles]
+    call    serviceInt@PLT
+    add     rsp, 8
+    test    eax, eax
+    jnz     exit_block
+
+    # Return to the block
+    ret
+
+exit_block:
+    # Exit the block ignoring the return address into it
+    add     rsp, 8
+    ret
+
+.section .note.GNU-stack,"",@progbits
@@ -0,0 +1,38 @@
+.intel_syntax noprefix
+
+# A cheap relocation table
+.section .data.rel.ro
+.align 8
+.globl drc_relocTable
+.type drc_relocTable, @object
+drc_relocTable:
+# division is inlined, so the divmod entries are never called
+.quad       0
+.quad       0
+.quad       mem_rbyte
+.quad       mem_rhword
+.quad       mem_rword
+.quad       mem_wbyte
+.quad       mem_whword
+.quad       mem_wword
+.quad       ins_sch0bsu
+.quad       ins_sch0bsd
+.quad       ins_sch1bsu
+.quad       ins_sch1bsd
+.quad       ins_err
+.quad       ins_err
+.quad       ins_err
+.quad       ins_err
+.quad       ins_orbsu
+.quad       ins_andbsu
+.quad       ins_xorbsu
+.quad       ins_movbsu
+.quad       ins_ornbsu
+.quad       ins_andnbsu
+.quad       ins_xornbsu
+.quad       ins_notbsu
+.quad       ins_rev
+.quad       hle_runHook
+.size drc_relocTable, . - drc_relocTable
+
+.section .note.GNU-stack,"",@progbits